@@ -261,7 +261,10 @@ enum {
     COMPATF_COLLISION   = (1 << 0),     // don't use maxradius for mobj position checks
     COMPATF_MOBJPASS    = (1 << 1),     // allow mobjs to stand on top one another
     COMPATF_LIMITPAIN   = (1 << 2),     // pain elemental limited to 17 lost souls?
-    COMPATF_REACHITEMS  = (1 << 3)      // able to grab high items by bumping
+    COMPATF_REACHITEMS  = (1 << 3),     // able to grab high items by bumping
+    COMPATF_INTERCEPTS  = (1 << 4),     // traces keep more than MAXINTERCEPTS intercepts
+    COMPATF_SECTORTHINGS = (1 << 5),    // moving sectors only check the things touching them
+    COMPATF_PVSSIGHT    = (1 << 6)      // sight checks are culled with the PVS
 };
 
 enum sndflags_e : uint32 {
@@ -49,6 +49,7 @@ extern  dboolean    respawnitem;
 extern  dboolean    fastparm;       // checkparm of -fast
 extern  dboolean    nolights;
 extern  dboolean    devparm;        // DEBUG: launched with -devparm
+extern  dboolean    headless;       // -headless: no video, audio or input
 
 
 // -------------------------------------------
@@ -111,6 +111,9 @@ typedef    struct {
     // if == validcount, already checked
     int             validcount;
 
+    // bumped by P_SectorChanged when a plane moves
+    int             changecount;
+
     // list of mobjs in sector
     mobj_t*         thinglist;
 
@@ -121,8 +124,8 @@ typedef    struct {
     struct line_s** lines;    // [linecount] size
 
     // [kex] stuff that happens in between tics
-    fixed_t         frame_z1[2];
-    fixed_t         frame_z2[2];
+    fixed_t         frame_z1;
+    fixed_t         frame_z2;
 
     // [kex] plane/normal info for ceiling and floor
     plane_t         ceilingplane;
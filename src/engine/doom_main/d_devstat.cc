@@ -37,6 +37,8 @@
 #include "d_englsh.h"
 #include "r_drawlist.h"
 #include "i_video.h"
+#include "g_actions.h"
+#include "con_console.h"
 
 static dboolean showstats = true;
 
@@ -158,6 +160,10 @@ void D_DeveloperDisplay(void) {
 
         Draw_Text(0, y, WHITE, 0.35f, false, "P_Mobj Total Things: %i", p_nummobjthinkers);
         y+=16;
+
+        Draw_Text(0, y, WHITE, 0.35f, false, "Sight Cache Hits/Misses: %i/%i",
+                  sightcachecounts[0], sightcachecounts[1]);
+        y+=16;
     }
 
     /*RENDERING INFORMATION*/
@@ -200,6 +206,247 @@ void D_DeveloperDisplay(void) {
     statindice = 0;
 }
 
+//
+// MEMORY HISTORY
+//
+// Once per second of game time the zone usage of every tag and subsystem is
+// recorded into a ring buffer, which can be written out as CSV with the
+// memcsv command. When a level ends, what is left of the heap is compared
+// against the end of the previous level so slow leaks show up over a long
+// map rotation.
+//
+
+#define MEMSAMPLES  3600    // one hour of history
+
+typedef struct {
+    int tic;
+    int tags[PU_MAX];
+    int subsys[ZS_MAX];
+} memsample_t;
+
+typedef struct {
+    int map;
+    int tags[PU_MAX];
+    int blocks[PU_MAX];
+    int subsys[ZS_MAX];
+} memsnapshot_t;
+
+static const char *tagnames[PU_MAX] = {
+    "PU_STATIC",
+    "PU_MAPLUMP",
+    "PU_AUTO",
+    "PU_AUDIO",
+    "PU_LEVEL",
+    "PU_LEVSPEC",
+    "PU_CACHE"
+};
+
+static const char *subsysnames[ZS_MAX] = {
+    "other",
+    "textures",
+    "audio",
+    "wad",
+    "level"
+};
+
+static memsample_t memsamples[MEMSAMPLES];
+static int memsamplehead = 0;
+static int memsamplecount = 0;
+static int memsampletic = 0;
+
+static memsnapshot_t memlastlevel;
+static dboolean memhavelastlevel = false;
+
+//
+// D_SampleMemory
+//
+
+void D_SampleMemory(void) {
+    memsample_t *sample;
+    int i;
+
+    if(memsamplecount && gametic - memsampletic < TICRATE) {
+        return;
+    }
+
+    memsampletic = gametic;
+    sample = &memsamples[memsamplehead];
+    sample->tic = gametic;
+
+    for(i = 0; i < PU_MAX; i++) {
+        sample->tags[i] = Z_TagUsage(i);
+    }
+
+    for(i = 0; i < ZS_MAX; i++) {
+        sample->subsys[i] = Z_SubsystemUsage(i);
+    }
+
+    memsamplehead = (memsamplehead + 1) % MEMSAMPLES;
+
+    if(memsamplecount < MEMSAMPLES) {
+        memsamplecount++;
+    }
+}
+
+//
+// D_WriteMemoryCSV
+//
+
+dboolean D_WriteMemoryCSV(const char *filename) {
+    FILE *fp;
+    int i;
+    int j;
+
+    if(!(fp = fopen(filename, "w"))) {
+        return false;
+    }
+
+    fprintf(fp, "tic,seconds");
+
+    for(i = 0; i < PU_MAX; i++) {
+        fprintf(fp, ",%s", tagnames[i]);
+    }
+
+    for(i = 0; i < ZS_MAX; i++) {
+        fprintf(fp, ",%s", subsysnames[i]);
+    }
+
+    fprintf(fp, "\n");
+
+    // oldest sample first
+    for(i = 0; i < memsamplecount; i++) {
+        memsample_t *sample = &memsamples[(memsamplehead - memsamplecount + i + MEMSAMPLES) % MEMSAMPLES];
+
+        fprintf(fp, "%d,%d", sample->tic, sample->tic / TICRATE);
+
+        for(j = 0; j < PU_MAX; j++) {
+            fprintf(fp, ",%d", sample->tags[j]);
+        }
+
+        for(j = 0; j < ZS_MAX; j++) {
+            fprintf(fp, ",%d", sample->subsys[j]);
+        }
+
+        fprintf(fp, "\n");
+    }
+
+    fclose(fp);
+    return true;
+}
+
+//
+// D_MemoryLevelDiff
+// Called by P_Stop once the level tags have been freed.
+//
+
+void D_MemoryLevelDiff(void) {
+    memsnapshot_t snap;
+    int i;
+
+    snap.map = gamemap;
+
+    for(i = 0; i < PU_MAX; i++) {
+        snap.tags[i] = Z_TagUsage(i);
+        snap.blocks[i] = Z_TagBlocks(i);
+    }
+
+    for(i = 0; i < ZS_MAX; i++) {
+        snap.subsys[i] = Z_SubsystemUsage(i);
+    }
+
+    if(memhavelastlevel) {
+        dboolean changed = false;
+
+        for(i = 0; i < PU_MAX; i++) {
+            if(snap.tags[i] != memlastlevel.tags[i] || snap.blocks[i] != memlastlevel.blocks[i]) {
+                if(!changed) {
+                    I_Printf("D_MemoryLevelDiff: heap after map %02d vs map %02d\n", snap.map, memlastlevel.map);
+                    changed = true;
+                }
+
+                I_Printf("    %-10s %+9d bytes %+6d blocks\n", tagnames[i],
+                         snap.tags[i] - memlastlevel.tags[i],
+                         snap.blocks[i] - memlastlevel.blocks[i]);
+            }
+        }
+
+        for(i = 0; i < ZS_MAX; i++) {
+            if(snap.subsys[i] != memlastlevel.subsys[i]) {
+                I_Printf("    %-10s %+9d bytes\n", subsysnames[i],
+                         snap.subsys[i] - memlastlevel.subsys[i]);
+            }
+        }
+    }
+
+    memlastlevel = snap;
+    memhavelastlevel = true;
+}
+
+//
+// CMD_MemCSV
+//
+
+static CMD(MemCSV) {
+    const char *filename = param[0] ? param[0] : "memhistory.csv";
+
+    if(D_WriteMemoryCSV(filename)) {
+        CON_Printf(WHITE, "Wrote %d memory samples to %s\n", memsamplecount, filename);
+    }
+    else {
+        CON_Warnf("Couldn't write %s\n", filename);
+    }
+}
+
+//
+// CMD_MemDiff
+//
+
+static CMD(MemDiff) {
+    int i;
+
+    if(!memhavelastlevel) {
+        CON_Printf(WHITE, "No level has ended yet\n");
+        return;
+    }
+
+    for(i = 0; i < PU_MAX; i++) {
+        CON_Printf(WHITE, "%-10s %+9d bytes\n", tagnames[i], Z_TagUsage(i) - memlastlevel.tags[i]);
+    }
+}
+
+//
+// CMD_SightStats
+//
+
+static CMD(SightStats) {
+    int lookups = sightcachecounts[0] + sightcachecounts[1];
+    int checks = sightcounts[0] + sightcounts[1];
+
+    if(param[0] && !dstricmp(param[0], "reset")) {
+        sightcounts[0] = sightcounts[1] = sightcounts[2] = 0;
+        sightcachecounts[0] = sightcachecounts[1] = 0;
+        return;
+    }
+
+    CON_Printf(WHITE, "Sight checks rejected: %d traced: %d\n", sightcounts[0], sightcounts[1]);
+    CON_Printf(WHITE, "Early rejects: %d%% (%d%% with the map's own REJECT)\n",
+               checks ? (sightcounts[0] * 100) / checks : 0,
+               checks ? (sightcounts[2] * 100) / checks : 0);
+    CON_Printf(WHITE, "Sight cache hits: %d misses: %d (%d%%)\n",
+               sightcachecounts[0], sightcachecounts[1],
+               lookups ? (sightcachecounts[0] * 100) / lookups : 0);
+}
+
+//
+// D_InitDevStat
+//
+
+void D_InitDevStat(void) {
+    G_AddCommand("memcsv", CMD_MemCSV, 0);
+    G_AddCommand("memdiff", CMD_MemDiff, 0);
+    G_AddCommand("sightstats", CMD_SightStats, 0);
+}
+
 //
 // D_BoyISuck
 //
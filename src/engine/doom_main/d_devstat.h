@@ -24,6 +24,10 @@
 #define __D_DEVSTAT_H
 
 void D_DeveloperDisplay(void);
+void D_InitDevStat(void);
+void D_SampleMemory(void);
+void D_MemoryLevelDiff(void);
+dboolean D_WriteMemoryCSV(const char *filename);
 void D_BoyISuck(void);
 dboolean D_DevKeyResponder(event_t* ev);
 
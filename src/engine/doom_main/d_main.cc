@@ -92,6 +92,7 @@ dboolean        setWindow       = true;
 int             validcount      = 1;
 dboolean        windowpause     = false;
 dboolean        devparm         = false;    // started game with -devparm
+dboolean        headless        = false;    // started game with -headless
 dboolean        nomonsters      = false;    // checkparm of -nomonsters
 dboolean        respawnparm     = false;    // checkparm of -respawn
 dboolean        respawnitem     = false;    // checkparm of -respawnitem
@@ -205,6 +206,36 @@ int             oldnettics = 0;
 int GetLowTic(void);
 dboolean PlayersInGame(void);
 
+static int      headlessrate = 0;       // tics per second, 0 for as fast as possible
+static int      headlessclock = 0;
+static int      headlessmaxtics = 0;
+static int      headlessstart = 0;
+
+//
+// D_HeadlessTime
+// Tics for NetUpdate to build ticcmds up to. Without a rate every
+// call is a new tic, so the game runs as fast as it can.
+//
+
+int D_HeadlessTime(void) {
+    if(!headlessrate) {
+        return headlessclock++;
+    }
+
+    return (int)(((int64)I_GetTimeMS() * headlessrate) / 1000);
+}
+
+//
+// D_HeadlessReport
+//
+
+void D_HeadlessReport(void) {
+    int time = I_GetTimeMS() - headlessstart;
+
+    I_Printf("D_HeadlessReport: %i tics in %ims (%i tics per second)\n",
+             gametic, time, time ? (int)((int64)gametic * 1000 / time) : 0);
+}
+
 static void D_DrawInterface(void) {
     if(menuactive) {
         M_Drawer();
@@ -263,7 +294,7 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
         realtics = entertic - oldentertics;
         oldentertics = entertic;
 
-        if(i_interpolateframes) {
+        if(i_interpolateframes && !headless) {
             renderinframe = true;
 
             if(I_StartDisplay()) {
@@ -357,7 +388,7 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
                 I_Error("D_MiniLoop: lowtic < gametic");
             }
 
-            if(i_interpolateframes) {
+            if(i_interpolateframes && !headless) {
                 renderinframe = true;
 
                 if(I_StartDisplay()) {
@@ -411,6 +442,13 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
 
                 gametic++;
 
+                D_SampleMemory();
+
+                if(headlessmaxtics && gametic >= headlessmaxtics) {
+                    D_HeadlessReport();
+                    I_Quit();
+                }
+
                 // modify command for duplicated tics
                 if(i != ticdup-1) {
                     ticcmd_t *cmd;
@@ -435,6 +473,11 @@ drawframe:
 
         S_UpdateSounds();
 
+        // nothing to draw to
+        if(headless) {
+            goto freealloc;
+        }
+
         // Update display, next frame, with current state.
         if(i_interpolateframes) {
             if(!I_StartDisplay()) {
@@ -942,6 +985,35 @@ static void D_Init(void) {
     if(M_CheckParm("-nogun")) {
         ShowGun = false;
     }
+
+    // -allocwatch [steady tics] [max allocations per tic]
+    p = M_CheckParm("-allocwatch");
+    if(p) {
+        int steadytics = TICRATE * 5;
+        int maxpertic = 0;
+
+        if(p < myargc-1 && myargv[p+1][0] != '-') {
+            steadytics = datoi(myargv[p+1]);
+
+            if(p < myargc-2 && myargv[p+2][0] != '-') {
+                maxpertic = datoi(myargv[p+2]);
+            }
+        }
+
+        Z_EnableAllocWatch(steadytics, maxpertic);
+    }
+
+    // -headless [tics per second]
+    p = M_CheckParm("-headless");
+    if(p && p < myargc-1 && myargv[p+1][0] != '-') {
+        headlessrate = datoi(myargv[p+1]);
+    }
+
+    // -maxtics <tics>: quit after that many tics
+    p = M_CheckParm("-maxtics");
+    if(p && p < myargc-1) {
+        headlessmaxtics = datoi(myargv[p+1]);
+    }
 }
 
 //
@@ -962,6 +1034,13 @@ static int D_CheckDemo(void) {
     p = M_CheckParm("-playdemo");
     if(p && p < myargc-1) {
         //singledemo = true;              // quit after one demo
+
+        // allocation checks and headless runs need an exit status at
+        // the end of the demo
+        if(M_CheckParm("-allocwatch") || headless) {
+            singledemo = true;
+        }
+
         G_PlayDemo(myargv[p+1]);
         return 1;
     }
@@ -975,7 +1054,10 @@ static int D_CheckDemo(void) {
 
 [[noreturn]]
 void D_DoomMain(void) {
+    int p;
+
     devparm = M_CheckParm("-devparm");
+    headless = M_CheckParm("-headless");
 
     // init subsystems
 
@@ -990,6 +1072,7 @@ void D_DoomMain(void) {
 
     I_Printf("G_Init: Setting up game input and commands\n");
     G_Init();
+    D_InitDevStat();
 
     I_Printf("M_LoadDefaults: Loading game configuration\n");
     M_LoadDefaults();
@@ -1015,6 +1098,24 @@ void D_DoomMain(void) {
     I_Printf("P_Init: Init Playloop state.\n");
     P_Init();
 
+    // build the PVS for every map and quit
+    if(M_CheckParm("-buildpvs")) {
+        P_BuildAllPVS();
+        I_Quit();
+    }
+
+    if(M_CheckParm("-checkpointgrid")) {
+        R_CheckAllPointGrids();
+        I_Quit();
+    }
+
+    // -statecompare <log> <log>: first tic two -statelog runs differ at
+    p = M_CheckParm("-statecompare");
+    if(p && p < myargc-2) {
+        G_CompareStateLogs(myargv[p+1], myargv[p+2]);
+        I_Quit();
+    }
+
     I_Printf("NET_Init: Init network subsystem.\n");
     NET_Init();
 
@@ -1027,14 +1128,20 @@ void D_DoomMain(void) {
     I_Printf("ST_Init: Init status bar.\n");
     ST_Init();
 
-    I_Printf("GL_Init: Init OpenGL\n");
-    GL_Init();
+    if(!headless) {
+        I_Printf("GL_Init: Init OpenGL\n");
+        GL_Init();
+    }
 
     native_ui::console_show(false);
 
     // garbage collection
     Z_FreeAlloca();
 
+    G_InitStateLog();
+
+    headlessstart = I_GetTimeMS();
+
     if(!D_CheckDemo()) {
         if(!autostart) {
             // start legal screen and title map stuff
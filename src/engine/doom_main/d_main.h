@@ -47,6 +47,10 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
 // Called by IO functions when input is detected.
 void D_PostEvent(event_t* ev);
 
+// -headless clock and timing
+int D_HeadlessTime(void);
+void D_HeadlessReport(void);
+
 
 //
 // BASE LEVEL
@@ -36,6 +36,7 @@
 #include "tables.h"
 #include "m_misc.h"
 #include "con_console.h"
+#include "d_main.h"
 #include "SDL.h"
 #include "i_video.h"
 
@@ -86,6 +87,10 @@ dboolean renderinframe = false;
 static int GetAdjustedTime(void) {
     int time_ms;
 
+    if(headless) {
+        return D_HeadlessTime();
+    }
+
     time_ms = I_GetTimeMS();
 
     if(net_cl_new_sync) {
@@ -33,7 +33,9 @@
 #include "g_demo.h"
 #include "m_misc.h"
 #include "m_random.h"
+#include "p_saveg.h"
 #include "con_console.h"
+#include "d_main.h"
 #include <imp/Wad>
 
 #ifdef _MSC_VER
@@ -61,6 +63,14 @@ dboolean        iwadDemo        = false;
 
 extern int      starttime;
 
+static FILE     *statelog       = NULL;
+static int      statelogtic     = 0;
+static int      statedumptic    = -1;
+
+static const char *statehashnames[NUMSTATEHASHES] = {
+    "mobjs", "players", "world", "specials", "random"
+};
+
 //
 // DEMO RECORDING
 //
@@ -334,6 +344,16 @@ dboolean G_CheckDemoStatus(void) {
 
     if(demoplayback) {
         if(singledemo) {
+            if(headless) {
+                D_HeadlessReport();
+            }
+
+            Z_AllocWatchReport();
+
+            if(Z_AllocWatchFailed()) {
+                I_Error("G_CheckDemoStatus: steady state allocations exceeded the -allocwatch limit");
+            }
+
             I_Quit();
         }
 
@@ -355,3 +375,325 @@ dboolean G_CheckDemoStatus(void) {
 
     return false;
 }
+
+//
+// STATE LOGS
+//
+// -statelog <file> writes the state hashes of every tic the world runs,
+// to be checked against a log of another run of the same demo with
+// -statecompare. -statedump <tic> adds a hash per object at that tic,
+// so the compare can say which objects differ. The savecheck command
+// checks a save and load keeps the same hashes.
+//
+
+//
+// CMD_SaveCheck
+// Saves the level to a scratch file, loads it back and reports which
+// state hashes changed. Everything but random has to come back as it
+// was; the savegame doesn't keep the random indexes
+//
+
+static CMD(SaveCheck) {
+    unsigned int before[NUMSTATEHASHES];
+    unsigned int after[NUMSTATEHASHES];
+    char *name;
+    int differ = 0;
+    int i;
+
+    if(gamestate != GS_LEVEL || netgame || demoplayback) {
+        CON_Printf(WHITE, "savecheck: must be in a local game\n");
+        return;
+    }
+
+    name = I_GetUserFile("savecheck.dsg");
+    P_HashState(before);
+
+    if(!P_WriteSaveGameFile((char*)"savecheck", name)) {
+        CON_Warnf("savecheck: couldn't write %s\n", name);
+        free(name);
+        return;
+    }
+
+    P_ReadSaveGame(name);
+    P_HashState(after);
+
+    remove(name);
+    free(name); // Allocated by I_GetUserFile
+
+    for(i = 0; i < NUMSTATEHASHES; i++) {
+        if(before[i] == after[i]) {
+            CON_Printf(WHITE, "%-8s %08x ok\n", statehashnames[i], before[i]);
+            continue;
+        }
+
+        CON_Printf(WHITE, "%-8s %08x %08x differs\n", statehashnames[i], before[i], after[i]);
+
+        if(i != SH_RANDOM) {
+            differ++;
+        }
+    }
+
+    if(differ) {
+        CON_Warnf("savecheck: %i states differ after loading\n", differ);
+    }
+    else {
+        CON_Printf(WHITE, "savecheck: save and load round trip matches\n");
+    }
+}
+
+//
+// G_InitStateLog
+//
+
+void G_InitStateLog(void) {
+    int p;
+
+    G_AddCommand("savecheck", CMD_SaveCheck, 0);
+
+    p = M_CheckParm("-statelog");
+    if(!p || p >= myargc-1) {
+        return;
+    }
+
+    statelog = fopen(myargv[p+1], "w");
+
+    if(!statelog) {
+        I_Error("G_InitStateLog: Couldn't open %s", myargv[p+1]);
+        return;
+    }
+
+    p = M_CheckParm("-statedump");
+    if(p && p < myargc-1) {
+        statedumptic = datoi(myargv[p+1]);
+    }
+
+    fprintf(statelog, "# tic %s %s %s %s %s\n", statehashnames[0], statehashnames[1],
+            statehashnames[2], statehashnames[3], statehashnames[4]);
+}
+
+//
+// G_LogStateHash
+// Called at the end of each tic the world runs
+//
+
+void G_LogStateHash(void) {
+    unsigned int hashes[NUMSTATEHASHES];
+
+    if(!statelog) {
+        return;
+    }
+
+    P_HashState(hashes);
+
+    fprintf(statelog, "%i %08x %08x %08x %08x %08x\n", statelogtic,
+            hashes[0], hashes[1], hashes[2], hashes[3], hashes[4]);
+
+    if(statelogtic == statedumptic) {
+        P_DumpStateHashes(statelog, statelogtic);
+    }
+
+    statelogtic++;
+}
+
+typedef struct {
+    char            kind[16];
+    int             num;
+    int             info;
+    unsigned int    hash;
+} statedump_t;
+
+//
+// G_ReadStateHashes
+// Next tic's hashes from a log; false at the end
+//
+
+static dboolean G_ReadStateHashes(FILE* f, int* tic, unsigned int* hashes) {
+    char line[256];
+
+    while(fgets(line, sizeof(line), f)) {
+        if(sscanf(line, "%i %x %x %x %x %x", tic, &hashes[0], &hashes[1],
+                  &hashes[2], &hashes[3], &hashes[4]) == 6) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//
+// G_ReadStateDumps
+// Object hashes a log has for the tic
+//
+
+static statedump_t *G_ReadStateDumps(FILE* f, int tic, int* count) {
+    statedump_t *dumps = NULL;
+    statedump_t dump;
+    char line[256];
+    int max = 0;
+    int dumptic;
+
+    *count = 0;
+    rewind(f);
+
+    while(fgets(line, sizeof(line), f)) {
+        if(sscanf(line, "dump %i %15s %i %i %x", &dumptic, dump.kind,
+                  &dump.num, &dump.info, &dump.hash) != 5 || dumptic != tic) {
+            continue;
+        }
+
+        if(*count == max) {
+            max = max ? max * 2 : 1024;
+            dumps = (statedump_t*)Z_Realloc(dumps, max * sizeof(statedump_t), PU_STATIC, 0);
+        }
+
+        dumps[(*count)++] = dump;
+    }
+
+    return dumps;
+}
+
+//
+// G_CompareStateDumps
+// Lists the objects that differ between two dumps of a tic
+//
+
+static void G_CompareStateDumps(statedump_t* dumps1, int count1,
+                                statedump_t* dumps2, int count2) {
+    int differ = 0;
+    int i;
+    int j;
+
+    for(i = 0; i < count1; i++) {
+        for(j = 0; j < count2; j++) {
+            if(dumps2[j].num == dumps1[i].num && !dstrcmp(dumps2[j].kind, dumps1[i].kind)) {
+                break;
+            }
+        }
+
+        if(j == count2) {
+            I_Printf("  %s %i (%i): only in the first log\n",
+                     dumps1[i].kind, dumps1[i].num, dumps1[i].info);
+            differ++;
+        }
+        else if(dumps2[j].hash != dumps1[i].hash || dumps2[j].info != dumps1[i].info) {
+            I_Printf("  %s %i (%i / %i) differs\n",
+                     dumps1[i].kind, dumps1[i].num, dumps1[i].info, dumps2[j].info);
+            differ++;
+        }
+    }
+
+    for(j = 0; j < count2; j++) {
+        for(i = 0; i < count1; i++) {
+            if(dumps1[i].num == dumps2[j].num && !dstrcmp(dumps1[i].kind, dumps2[j].kind)) {
+                break;
+            }
+        }
+
+        if(i == count1) {
+            I_Printf("  %s %i (%i): only in the second log\n",
+                     dumps2[j].kind, dumps2[j].num, dumps2[j].info);
+            differ++;
+        }
+    }
+
+    I_Printf("%i objects differ\n", differ);
+}
+
+//
+// G_CompareStateLogs
+// Reports the first tic two state logs differ at, and quits with an
+// error if they do
+//
+
+void G_CompareStateLogs(const char* name1, const char* name2) {
+    FILE *f1;
+    FILE *f2;
+    statedump_t *dumps1;
+    statedump_t *dumps2;
+    int count1;
+    int count2;
+    unsigned int hashes1[NUMSTATEHASHES];
+    unsigned int hashes2[NUMSTATEHASHES];
+    int tic1 = 0;
+    int tic2 = 0;
+    int more1;
+    int more2;
+    int tics = 0;
+    int i;
+
+    f1 = fopen(name1, "r");
+    f2 = fopen(name2, "r");
+
+    if(!f1 || !f2) {
+        I_Error("G_CompareStateLogs: Couldn't open %s", f1 ? name2 : name1);
+        return;
+    }
+
+    while(1) {
+        more1 = G_ReadStateHashes(f1, &tic1, hashes1);
+        more2 = G_ReadStateHashes(f2, &tic2, hashes2);
+
+        if(!more1 || !more2) {
+            break;
+        }
+
+        for(i = 0; i < NUMSTATEHASHES; i++) {
+            if(hashes1[i] != hashes2[i]) {
+                break;
+            }
+        }
+
+        if(i < NUMSTATEHASHES) {
+            break;
+        }
+
+        tics++;
+    }
+
+    if(!more1 && !more2) {
+        I_Printf("G_CompareStateLogs: %i tics match\n", tics);
+        fclose(f1);
+        fclose(f2);
+        return;
+    }
+
+    if(!more1 || !more2) {
+        fclose(f1);
+        fclose(f2);
+        I_Error("G_CompareStateLogs: %s ends after %i matching tics", more1 ? name2 : name1, tics);
+        return;
+    }
+
+    I_Printf("G_CompareStateLogs: logs diverge at tic %i:", tic1);
+
+    for(i = 0; i < NUMSTATEHASHES; i++) {
+        if(hashes1[i] != hashes2[i]) {
+            I_Printf(" %s", statehashnames[i]);
+        }
+    }
+
+    I_Printf("\n");
+
+    dumps1 = G_ReadStateDumps(f1, tic1, &count1);
+    dumps2 = G_ReadStateDumps(f2, tic1, &count2);
+
+    if(count1 && count2) {
+        G_CompareStateDumps(dumps1, count1, dumps2, count2);
+    }
+    else {
+        I_Printf("Rerun both with -statedump %i to list the objects that differ\n", tic1);
+    }
+
+    if(dumps1) {
+        Z_Free(dumps1);
+    }
+
+    if(dumps2) {
+        Z_Free(dumps2);
+    }
+
+    fclose(f1);
+    fclose(f2);
+
+    I_Error("G_CompareStateLogs: logs diverge at tic %i", tic1);
+}
@@ -32,6 +32,9 @@ void G_RecordDemo(const char* name);
 void G_PlayDemo(const char* name);
 void G_ReadDemoTiccmd(ticcmd_t* cmd);
 void G_WriteDemoTiccmd(ticcmd_t* cmd);
+void G_InitStateLog(void);
+void G_LogStateHash(void);
+void G_CompareStateLogs(const char* name1, const char* name2);
 
 extern char             demoname[256];  // name of demo lump
 extern dboolean         demorecording;  // currently recording a demo
@@ -155,6 +155,9 @@ BoolProperty compat_collision("compat_collision", "", true, Property::network, G
 BoolProperty compat_mobjpass("compat_mobjpass", "", true, Property::network, G_SetGameFlagsCvarCallback);
 BoolProperty compat_limitpain("compat_limitpain", "", true, Property::network, G_SetGameFlagsCvarCallback);
 BoolProperty compat_grabitems("compat_grabitems", "", true, Property::network, G_SetGameFlagsCvarCallback);
+BoolProperty compat_intercepts("compat_intercepts", "Don't limit traces to 128 intercepts", true, Property::network, G_SetGameFlagsCvarCallback);
+BoolProperty compat_sectorthings("compat_sectorthings", "Moving sectors only check the things touching them", false, Property::network, G_SetGameFlagsCvarCallback);
+BoolProperty compat_pvssight("compat_pvssight", "Cull sight checks with the PVS", false, Property::network, G_SetGameFlagsCvarCallback);
 
 extern BoolProperty v_mlook;
 extern BoolProperty v_mlookinvert;
@@ -880,6 +883,15 @@ static void G_SetGameFlags(void) {
 
     if (compat_grabitems)
         compatflags |= COMPATF_REACHITEMS;
+
+    if (compat_intercepts)
+        compatflags |= COMPATF_INTERCEPTS;
+
+    if (compat_sectorthings)
+        compatflags |= COMPATF_SECTORTHINGS;
+
+    if (compat_pvssight)
+        compatflags |= COMPATF_PVSSIGHT;
 }
 
 //
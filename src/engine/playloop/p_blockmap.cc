@@ -0,0 +1,487 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Blockmap builder, for maps whose BLOCKMAP lump is missing, broken or
+//    too big for 16-bit offsets. Offsets are 32-bit, every line is listed
+//    once in each block it passes through, and blocks with the same list
+//    share it. Unlike nodebuilder output, lists don't start with line 0.
+//
+//-----------------------------------------------------------------------------
+
+#include <math.h>
+
+#include <imp/Property>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "p_local.h"
+#include "i_system.h"
+#include "m_misc.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+#include "Map.hh"
+
+// 0 = never, 1 = when the map's blockmap is unusable, 2 = always
+IntProperty p_buildblockmap("p_buildblockmap", "Build the blockmap for maps without a usable one", 1);
+
+// lumps the built blockmap depends on
+static const int blockmaplumps[] = { ML_VERTEXES, ML_LINEDEFS };
+
+#define BLOCKMAPCACHEVERSION    1
+#define BLOCKMAPEPSILON         (1.0 / 256)     // lines touching a block edge go in both
+
+//
+// P_LineBlocks
+// Adds line num to every block it passes through: counts them if fill
+// is NULL, writes them at fill[block]++ otherwise
+//
+
+static void P_LineBlocks(line_t *li, int num, int orgx, int orgy, int width, int height,
+                         int *counts, int **fill) {
+    double x1 = (double)li->v1->x / FRACUNIT - orgx;
+    double y1 = (double)li->v1->y / FRACUNIT - orgy;
+    double x2 = (double)li->v2->x / FRACUNIT - orgx;
+    double y2 = (double)li->v2->y / FRACUNIT - orgy;
+    double t;
+    int bx;
+    int bx1;
+    int by;
+    int by1;
+
+    if(x1 > x2) {
+        t = x1;
+        x1 = x2;
+        x2 = t;
+        t = y1;
+        y1 = y2;
+        y2 = t;
+    }
+
+    bx = MAX((int)floor((x1 - BLOCKMAPEPSILON) / MAPBLOCKUNITS), 0);
+    bx1 = MIN((int)floor((x2 + BLOCKMAPEPSILON) / MAPBLOCKUNITS), width - 1);
+
+    // one column at a time, the rows covered by the part of the line in it
+    for(; bx <= bx1; bx++) {
+        double cx1 = MAX(x1, (double)bx * MAPBLOCKUNITS);
+        double cx2 = MIN(x2, (double)(bx + 1) * MAPBLOCKUNITS);
+        double ya = y1;
+        double yb = y2;
+
+        if(x2 > x1) {
+            ya = y1 + (y2 - y1) * (cx1 - x1) / (x2 - x1);
+            yb = y1 + (y2 - y1) * (cx2 - x1) / (x2 - x1);
+        }
+
+        by = MAX((int)floor((MIN(ya, yb) - BLOCKMAPEPSILON) / MAPBLOCKUNITS), 0);
+        by1 = MIN((int)floor((MAX(ya, yb) + BLOCKMAPEPSILON) / MAPBLOCKUNITS), height - 1);
+
+        for(; by <= by1; by++) {
+            if(fill) {
+                *fill[by * width + bx]++ = num;
+            }
+            else {
+                counts[by * width + bx]++;
+            }
+        }
+    }
+}
+
+//
+// P_ListHash
+//
+
+static unsigned int P_ListHash(const int *list, int length) {
+    unsigned int hash = 2166136261u;
+    int i;
+
+    for(i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned int)list[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+//
+// P_BuildBlockMap
+// Returns a blockmap in the layout of the lump, with int entries
+//
+
+static int *P_BuildBlockMap(int *size) {
+    fixed_t minx = D_MAXINT;
+    fixed_t miny = D_MAXINT;
+    fixed_t maxx = D_MININT;
+    fixed_t maxy = D_MININT;
+    int orgx;
+    int orgy;
+    int width;
+    int height;
+    int numblocks;
+    int *counts;
+    int *starts;
+    int *entries;
+    int **fill;
+    int *hashtable;
+    int *listoffset;
+    int *result;
+    int hashsize;
+    int total;
+    int count;
+    int i;
+    int j;
+
+    for(i = 0; i < numvertexes; i++) {
+        minx = MIN(minx, vertexes[i].x);
+        miny = MIN(miny, vertexes[i].y);
+        maxx = MAX(maxx, vertexes[i].x);
+        maxy = MAX(maxy, vertexes[i].y);
+    }
+
+    if(!numvertexes) {
+        minx = miny = maxx = maxy = 0;
+    }
+
+    // same margin as the nodebuilders
+    orgx = F2INT(minx) - 8;
+    orgy = F2INT(miny) - 8;
+    width = ((F2INT(maxx) - orgx) >> 7) + 1;
+    height = ((F2INT(maxy) - orgy) >> 7) + 1;
+    numblocks = width * height;
+
+    counts = (int*)Z_Calloc(numblocks * sizeof(int), PU_STATIC, 0);
+
+    for(i = 0; i < numlines; i++) {
+        P_LineBlocks(&lines[i], i, orgx, orgy, width, height, counts, NULL);
+    }
+
+    // lines go in in order, so every list comes out sorted
+    starts = (int*)Z_Malloc((numblocks + 1) * sizeof(int), PU_STATIC, 0);
+    fill = (int**)Z_Malloc(numblocks * sizeof(int*), PU_STATIC, 0);
+
+    for(i = 0, total = 0; i < numblocks; i++) {
+        starts[i] = total;
+        total += counts[i];
+    }
+
+    starts[numblocks] = total;
+    entries = (int*)Z_Malloc(MAX(total, 1) * sizeof(int), PU_STATIC, 0);
+
+    for(i = 0; i < numblocks; i++) {
+        fill[i] = entries + starts[i];
+    }
+
+    for(i = 0; i < numlines; i++) {
+        P_LineBlocks(&lines[i], i, orgx, orgy, width, height, NULL, fill);
+    }
+
+    // blocks with the same list share it
+    for(hashsize = 1; hashsize < numblocks * 2; hashsize <<= 1);
+
+    hashtable = (int*)Z_Malloc(hashsize * sizeof(int), PU_STATIC, 0);
+    listoffset = (int*)Z_Malloc(numblocks * sizeof(int), PU_STATIC, 0);
+
+    for(i = 0; i < hashsize; i++) {
+        hashtable[i] = -1;
+    }
+
+    count = 4 + numblocks;
+
+    for(i = 0; i < numblocks; i++) {
+        unsigned int slot = P_ListHash(entries + starts[i], counts[i]) & (hashsize - 1);
+
+        while((j = hashtable[slot]) != -1) {
+            if(counts[j] == counts[i] &&
+                    !memcmp(entries + starts[j], entries + starts[i], counts[i] * sizeof(int))) {
+                break;
+            }
+
+            slot = (slot + 1) & (hashsize - 1);
+        }
+
+        if(j != -1) {
+            listoffset[i] = listoffset[j];
+            continue;
+        }
+
+        hashtable[slot] = i;
+        listoffset[i] = count;
+        count += counts[i] + 1;
+    }
+
+    result = (int*)Z_Malloc(count * sizeof(int), PU_LEVEL, 0);
+    result[0] = orgx;
+    result[1] = orgy;
+    result[2] = width;
+    result[3] = height;
+
+    for(i = 0; i < numblocks; i++) {
+        int *list = result + listoffset[i];
+
+        result[4 + i] = listoffset[i];
+
+        // shared lists are just written again
+        dmemcpy(list, entries + starts[i], counts[i] * sizeof(int));
+        list[counts[i]] = -1;
+    }
+
+    Z_Free(counts);
+    Z_Free(starts);
+    Z_Free(fill);
+    Z_Free(entries);
+    Z_Free(hashtable);
+    Z_Free(listoffset);
+
+    *size = count;
+    return result;
+}
+
+//
+// P_CheckBlockMapCache
+// A stale or damaged cache must not be trusted: every block has to
+// point at a list inside the data, made of lines of this map and ended
+// by -1.
+//
+
+static dboolean P_CheckBlockMapCache(const int *blocks, int count) {
+    int numblocks;
+    int i;
+    int j;
+
+    // width and height must fit
+    if(count < 4 || blocks[2] <= 0 || blocks[3] <= 0 ||
+            (int64)blocks[2] * blocks[3] > count - 4) {
+        return false;
+    }
+
+    numblocks = blocks[2] * blocks[3];
+
+    for(i = 0; i < numblocks; i++) {
+        int offset = blocks[4 + i];
+
+        if(offset < 4 + numblocks || offset >= count) {
+            return false;
+        }
+
+        for(j = offset; blocks[j] != -1; j++) {
+            if(blocks[j] < 0 || blocks[j] >= numlines || j + 1 >= count) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// P_ReadBlockMapCache
+//
+
+static int *P_ReadBlockMapCache(const char *filename, int *size) {
+    byte *data;
+    byte *p;
+    int *result;
+    int length;
+    int count;
+    int i;
+
+    if(filename == NULL || (length = M_ReadFile(filename, &data)) == -1) {
+        return NULL;
+    }
+
+    count = (length - 8) / 4;
+
+    if(length < 8 + 16 || data[0] != 'B' || data[1] != 'M' || data[2] != 'P' ||
+            data[3] != BLOCKMAPCACHEVERSION ||
+            (data[4] | (data[5] << 8) | (data[6] << 16) | (data[7] << 24)) != count) {
+        Z_Free(data);
+        return NULL;
+    }
+
+    result = (int*)Z_Malloc(count * sizeof(int), PU_LEVEL, 0);
+
+    for(i = 0, p = data + 8; i < count; i++, p += 4) {
+        result[i] = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+    }
+
+    Z_Free(data);
+
+    if(!P_CheckBlockMapCache(result, count)) {
+        Z_Free(result);
+        return NULL;
+    }
+
+    *size = count;
+    return result;
+}
+
+//
+// P_WriteBlockMapCache
+//
+
+static void P_WriteBlockMapCache(const char *filename, int *blocks, int count) {
+    byte *data;
+    byte *p;
+    int i;
+
+    if(filename == NULL) {
+        return;
+    }
+
+    data = (byte*)Z_Malloc(8 + count * 4, PU_STATIC, 0);
+
+    data[0] = 'B';
+    data[1] = 'M';
+    data[2] = 'P';
+    data[3] = BLOCKMAPCACHEVERSION;
+    data[4] = count & 0xff;
+    data[5] = (count >> 8) & 0xff;
+    data[6] = (count >> 16) & 0xff;
+    data[7] = (count >> 24) & 0xff;
+
+    for(i = 0, p = data + 8; i < count; i++, p += 4) {
+        p[0] = blocks[i] & 0xff;
+        p[1] = (blocks[i] >> 8) & 0xff;
+        p[2] = (blocks[i] >> 16) & 0xff;
+        p[3] = (blocks[i] >> 24) & 0xff;
+    }
+
+    if(!M_WriteFile(filename, data, 8 + count * 4)) {
+        CON_Warnf("P_WriteBlockMapCache: couldn't write %s\n", filename);
+    }
+
+    Z_Free(data);
+}
+
+//
+// P_PrintBlockMapStats
+// List lengths of the current blockmap
+//
+
+static void P_PrintBlockMapStats(void) {
+    int numblocks = bmapwidth * bmapheight;
+    int empty = 0;
+    int longest = 0;
+    int total = 0;
+    int end = 0;
+    int lists = 0;
+    byte *seen;
+    int i;
+
+    for(i = 0; i < numblocks; i++) {
+        int *list = blockmaplump + blockmap[i];
+        int length = 0;
+
+        while(list[length] != -1) {
+            length++;
+        }
+
+        if(!length) {
+            empty++;
+        }
+
+        total += length;
+        longest = MAX(longest, length);
+        end = MAX(end, blockmap[i] + length + 1);
+    }
+
+    seen = (byte*)Z_Calloc(end, PU_STATIC, 0);
+
+    for(i = 0; i < numblocks; i++) {
+        if(!seen[blockmap[i]]) {
+            seen[blockmap[i]] = 1;
+            lists++;
+        }
+    }
+
+    Z_Free(seen);
+
+    CON_Printf(WHITE, "Blockmap %ix%i: %i empty blocks, %i distinct lists, %iKB\n",
+               bmapwidth, bmapheight, empty, lists, end * (int)sizeof(int) / 1024);
+    CON_Printf(WHITE, "Lines per block: %i.%02i average, %i longest\n",
+               total / MAX(numblocks, 1), (total * 100 / MAX(numblocks, 1)) % 100, longest);
+}
+
+//
+// P_SetupBlockMap
+// Called once the map's BLOCKMAP lump has been loaded and checked, with
+// the lump cached. Returns false if there is no usable blockmap.
+//
+
+dboolean P_SetupBlockMap(const char *error) {
+    int starttime = I_GetTimeMS();
+    char *filename;
+    int *blocks;
+    int count;
+
+    if(p_buildblockmap <= 0 || (p_buildblockmap == 1 && error == NULL)) {
+        return error == NULL;
+    }
+
+    if(error) {
+        CON_Warnf("Map blockmap is unusable (%s), building one\n", error);
+    }
+
+    filename = P_MapCacheFile("blockmap", blockmaplumps, sizeof(blockmaplumps) / sizeof(int));
+
+    if((blocks = P_ReadBlockMapCache(filename, &count)) == NULL) {
+        blocks = P_BuildBlockMap(&count);
+        P_WriteBlockMapCache(filename, blocks, count);
+
+        CON_Printf(WHITE, "Built blockmap in %ims\n", I_GetTimeMS() - starttime);
+    }
+
+    if(filename) {
+        free(filename);
+    }
+
+    Z_Free(blockmaplump);
+
+    blockmaplump = blocks;
+    blockmap = blockmaplump + 4;
+    bmaporgx = INT2F(blockmaplump[0]);
+    bmaporgy = INT2F(blockmaplump[1]);
+    bmapwidth = blockmaplump[2];
+    bmapheight = blockmaplump[3];
+
+    P_PrintBlockMapStats();
+    return true;
+}
+
+//
+// CMD_BlockMapStats
+//
+
+static CMD(BlockMapStats) {
+    if(gamestate != GS_LEVEL) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    P_PrintBlockMapStats();
+}
+
+//
+// P_InitBlockMap
+//
+
+void P_InitBlockMap(void) {
+    G_AddCommand("blockmapstats", CMD_BlockMapStats, 0);
+}
@@ -156,7 +156,7 @@ int EV_DoCeiling(line_t* line, ceiling_e type, fixed_t speed) {
 
         // new door thinker
         rtn = 1;
-        ceiling = (ceiling_t*) Z_Malloc(sizeof(*ceiling), PU_LEVSPEC, 0);
+        ceiling = (ceiling_t*) P_AllocThinker(sizeof(*ceiling), (actionf_p1)T_MoveCeiling);
         P_AddThinker(&ceiling->thinker);
         sec->specialdata = ceiling;
         // Midway assumed that ceiling->instant is true only if the
@@ -178,7 +178,7 @@ int EV_DoDoor(line_t* line, vldoor_e type) {
 
         // new door thinker
         rtn = 1;
-        door = (vldoor_t*) Z_Malloc(sizeof(*door), PU_LEVSPEC, 0);
+        door = (vldoor_t*) P_AllocThinker(sizeof(*door), (actionf_p1)T_VerticalDoor);
         P_AddThinker(&door->thinker);
         sec->specialdata = door;
 
@@ -289,7 +289,7 @@ void EV_VerticalDoor(line_t* line, mobj_t* thing) {
 
 
     // new door thinker
-    door = (vldoor_t*) Z_Malloc(sizeof(*door), PU_LEVSPEC, 0);
+    door = (vldoor_t*) P_AllocThinker(sizeof(*door), (actionf_p1)T_VerticalDoor);
     P_AddThinker(&door->thinker);
     sec->specialdata = door;
     door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
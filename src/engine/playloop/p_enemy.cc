@@ -46,6 +46,7 @@
 #include "info.h"
 #include "z_zone.h"
 
+extern BoolProperty p_multitrace;
 
 typedef int dirtype_t;
 enum {
@@ -90,63 +91,6 @@ void A_Fall(mobj_t *actor);
 //
 
 
-//
-// P_RecursiveSound
-//
-// Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
-// sound blocking lines cut off traversal.
-//
-
-mobj_t* soundtarget;
-
-void P_RecursiveSound(sector_t* sec, int soundblocks) {
-    int        i;
-    line_t*    check;
-    sector_t*    other;
-
-    // wake up all monsters in this sector
-    if(sec->validcount == validcount && sec->soundtraversed <= soundblocks+1) {
-        return;    // already flooded
-    }
-
-    sec->validcount     = validcount;
-    sec->soundtraversed = soundblocks+1;
-
-    P_SetTarget(&sec->soundtarget, soundtarget);
-
-    for(i = 0; i < sec->linecount; i++) {
-        check = sec->lines[i];
-        if(!(check->flags & ML_TWOSIDED)) {
-            continue;
-        }
-
-        P_LineOpening(check);
-
-        if(openrange <= 0) {
-            continue;    // closed door
-        }
-
-        if(sides[check->sidenum[0] ].sector == sec) {
-            other = sides[check->sidenum[1]].sector;
-        }
-        else {
-            other = sides[check->sidenum[0]].sector;
-        }
-
-        if(check->flags & ML_SOUNDBLOCK) {
-            if(!soundblocks) {
-                P_RecursiveSound(other, 1);
-            }
-        }
-        else {
-            P_RecursiveSound(other, soundblocks);
-        }
-    }
-}
-
-
-
 //
 // P_NoiseAlert
 // If a monster yells at a player,
@@ -154,9 +98,7 @@ void P_RecursiveSound(sector_t* sec, int soundblocks) {
 //
 
 void P_NoiseAlert(mobj_t* target, mobj_t* emmiter) {
-    soundtarget = target;
-    D_IncValidCount();
-    P_RecursiveSound(emmiter->subsector->sector, 0);
+    P_FloodNoise(emmiter->subsector->sector, target);
 }
 
 
@@ -407,6 +349,8 @@ dboolean P_Move(mobj_t* actor) {
                 actor->z -= FLOATSPEED;
             }
 
+            P_MarkMobjFrame(actor);
+
             //actor->flags |= MF_INFLOAT;
             return true;
         }
@@ -936,13 +880,12 @@ void A_OnDeathTrigger(mobj_t* actor) {
 
     A_Fall(actor);
 
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
+    for(mo = P_FindMobjFromTID(actor->tid, NULL); mo; mo = P_FindMobjFromTID(actor->tid, mo)) {
         if(mo->player) {
             continue;
         }
 
-        if(mo != actor && mo->tid == actor->tid &&
-                mo->flags & MF_SHOOTABLE && mo->health > 0) {
+        if(mo != actor && mo->flags & MF_SHOOTABLE && mo->health > 0) {
             return;
         }
     }
@@ -987,6 +930,9 @@ void A_SPosAttack(mobj_t* actor) {
     int     bangle;
     int     damage;
     int     slope;
+    angle_t angles[3];
+    fixed_t slopes[3];
+    int     damages[3];
 
     if(!actor->target) {
         return;
@@ -997,11 +943,22 @@ void A_SPosAttack(mobj_t* actor) {
     bangle = actor->angle;
     slope = P_AimLineAttack(actor, bangle, 0, MISSILERANGE);
 
+    if(!p_multitrace) {
+        for(i = 0; i < 3; i++) {
+            angle = bangle + P_RandomShift(pr_sposattack, 20);
+            damage = ((P_Random(pr_sposattack) % 5) * 3) + 3;
+            P_LineAttack(actor, angle, MISSILERANGE, slope, damage);
+        }
+        return;
+    }
+
     for(i = 0; i < 3; i++) {
-        angle = bangle + P_RandomShift(pr_sposattack, 20);
-        damage = ((P_Random(pr_sposattack) % 5) * 3) + 3;
-        P_LineAttack(actor, angle, MISSILERANGE, slope, damage);
+        angles[i] = bangle + P_RandomShift(pr_sposattack, 20);
+        damages[i] = ((P_Random(pr_sposattack) % 5) * 3) + 3;
+        slopes[i] = slope;
     }
+
+    P_LineAttacks(actor, 3, angles, MISSILERANGE, slopes, damages);
 }
 
 //
@@ -1193,7 +1150,7 @@ void A_CyberSpecial(mobj_t* actor) {
 void A_CyberDeathEvent(mobj_t* actor) {
     mobjexp_t *exp;
 
-    exp = (mobjexp_t*) Z_Calloc(sizeof(*exp), PU_LEVSPEC, 0);
+    exp = (mobjexp_t*) P_AllocThinker(sizeof(*exp), (actionf_p1)T_MobjExplode);
     P_AddThinker(&exp->thinker);
 
     exp->thinker.function.acp1 = (actionf_p1)T_MobjExplode;
@@ -1412,6 +1369,7 @@ void A_MoveGroundFire(mobj_t* fire) {
 
     if(fire->z > fire->floorz && fire->momz > 0) {
         fire->z = fire->floorz;
+        P_MarkMobjFrame(fire);
     }
 
     mo = P_SpawnMobj(fire->x, fire->y, fire->floorz, MT_PROP_FIRE);
@@ -1425,7 +1383,7 @@ void A_MoveGroundFire(mobj_t* fire) {
 void A_RectDeathEvent(mobj_t* actor) {
     mobjexp_t *exp;
 
-    exp = (mobjexp_t*) Z_Calloc(sizeof(*exp), PU_LEVSPEC, 0);
+    exp = (mobjexp_t*) P_AllocThinker(sizeof(*exp), (actionf_p1)T_MobjExplode);
     P_AddThinker(&exp->thinker);
 
     exp->thinker.function.acp1 = (actionf_p1)T_MobjExplode;
@@ -1860,12 +1818,9 @@ void A_TargetCamera(mobj_t* actor) {
 
     actor->threshold = D_MAXINT;
 
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
-        if(actor->tid+1 == mo->tid) {
-            P_SetTarget(&actor->target, mo);
-            P_SetMobjState(actor, actor->info->missilestate);
-            return;
-        }
+    if((mo = P_FindMobjFromTID(actor->tid+1, NULL)) != NULL) {
+        P_SetTarget(&actor->target, mo);
+        P_SetMobjState(actor, actor->info->missilestate);
     }
 }
 
@@ -154,6 +154,7 @@ result_e T_MovePlane(sector_t* sector, fixed_t speed, fixed_t dest,
             }
             else {
                 sector->ceilingheight += speed;
+                P_SectorChanged(sector);
             }
             break;
         }
@@ -218,7 +219,7 @@ int EV_DoFloor(line_t* line, floor_e floortype, fixed_t speed) {
 
         // new floor thinker
         rtn = 1;
-        floor = (floormove_t*) Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+        floor = (floormove_t*) P_AllocThinker(sizeof(*floor), (actionf_p1)T_MoveFloor);
         P_AddThinker(&floor->thinker);
         sec->specialdata = floor;
         // Midway assumed that ceiling->instant is true only if the
@@ -368,7 +369,7 @@ int EV_BuildStairs(line_t* line, stair_e type) {
         rtn = 1;
 
         // new floor thinker
-        floor = (floormove_t*) Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+        floor = (floormove_t*) P_AllocThinker(sizeof(*floor), (actionf_p1)T_MoveFloor);
         P_AddThinker(&floor->thinker);
 
         sec->specialdata = floor;
@@ -430,7 +431,7 @@ int EV_BuildStairs(line_t* line, stair_e type) {
                 sec = tsec;
                 secnum = newsecnum;
 
-                floor = (floormove_t*) Z_Malloc(sizeof(*floor), PU_LEVSPEC, 0);
+                floor = (floormove_t*) P_AllocThinker(sizeof(*floor), (actionf_p1)T_MoveFloor);
                 P_AddThinker(&floor->thinker);
 
                 sec->specialdata = floor;
@@ -543,7 +544,7 @@ int EV_SplitSector(line_t *line, dboolean sync) {
         }
 
         rtn = 1;
-        split = (splitmove_t*) Z_Malloc(sizeof(*split), PU_LEVSPEC, 0);
+        split = (splitmove_t*) P_AllocThinker(sizeof(*split), (actionf_p1)T_MoveSplitPlane);
         P_AddThinker(&split->thinker);
         sec->specialdata = split;
 
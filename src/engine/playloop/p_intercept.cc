@@ -0,0 +1,208 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Intercept buffers. A trace's intercepts are sorted once before they
+//    are traversed. The sort is stable, so intercepts at the same frac come
+//    in the order they were found, just as the original closest-first scan
+//    picked them.
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "z_zone.h"
+#include "p_local.h"
+
+#define MININTERCEPTS   64
+
+//
+// P_ClearIntercepts
+// Empties the buffer for a new trace
+//
+
+void P_ClearIntercepts(interceptbuf_t* buf, int limit) {
+    buf->numintercepts = 0;
+    buf->limit = limit;
+}
+
+//
+// P_AddIntercept
+// Returns false if the limit has been hit
+//
+
+dboolean P_AddIntercept(interceptbuf_t* buf, fixed_t frac, line_t* line, mobj_t* thing) {
+    intercept_t* in;
+
+    if(buf->limit && buf->numintercepts >= buf->limit) {
+        return false;
+    }
+
+    if(buf->numintercepts == buf->maxintercepts) {
+        buf->maxintercepts = MAX(buf->maxintercepts * 2, MININTERCEPTS);
+        buf->intercepts = (intercept_t*)Z_Realloc(buf->intercepts,
+                          buf->maxintercepts * sizeof(intercept_t), PU_STATIC, 0);
+    }
+
+    in = &buf->intercepts[buf->numintercepts++];
+    in->frac = frac;
+
+    if(line) {
+        in->isaline = true;
+        in->d.line = line;
+    }
+    else {
+        in->isaline = false;
+        in->d.thing = thing;
+    }
+
+    return true;
+}
+
+//
+// P_MergeIntercepts
+// Merges the sorted runs a[0..mid) and a[mid..count) into out
+//
+
+static void P_MergeIntercepts(intercept_t* a, int mid, int count, intercept_t* out) {
+    int i = 0;
+    int j = mid;
+    int k = 0;
+
+    while(i < mid && j < count) {
+        // take from the left on ties to keep the sort stable
+        if(a[j].frac < a[i].frac) {
+            out[k++] = a[j++];
+        }
+        else {
+            out[k++] = a[i++];
+        }
+    }
+
+    while(i < mid) {
+        out[k++] = a[i++];
+    }
+
+    while(j < count) {
+        out[k++] = a[j++];
+    }
+}
+
+//
+// P_SortIntercepts
+// Stable sort by frac. Short runs are insertion sorted, then merged.
+//
+
+#define SORTRUN 8
+
+void P_SortIntercepts(interceptbuf_t* buf) {
+    intercept_t* src = buf->intercepts;
+    intercept_t* dst;
+    intercept_t* swap;
+    intercept_t in;
+    int count = buf->numintercepts;
+    int width;
+    int i;
+    int j;
+
+    for(i = 0; i < count; i += SORTRUN) {
+        int end = MIN(i + SORTRUN, count);
+
+        for(j = i + 1; j < end; j++) {
+            int k = j;
+
+            in = src[j];
+
+            while(k > i && src[k - 1].frac > in.frac) {
+                src[k] = src[k - 1];
+                k--;
+            }
+
+            src[k] = in;
+        }
+    }
+
+    if(count <= SORTRUN) {
+        return;
+    }
+
+    buf->scratch = (intercept_t*)Z_Realloc(buf->scratch,
+                   buf->maxintercepts * sizeof(intercept_t), PU_STATIC, 0);
+    dst = buf->scratch;
+
+    for(width = SORTRUN; width < count; width *= 2) {
+        for(i = 0; i < count; i += width * 2) {
+            int mid = MIN(width, count - i);
+            int len = MIN(width * 2, count - i);
+
+            P_MergeIntercepts(src + i, mid, len, dst + i);
+        }
+
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    // keep the sorted array as the buffer and the other as scratch
+    buf->intercepts = src;
+    buf->scratch = dst;
+}
+
+//
+// P_TraverseIntercepts
+// Sorts the buffer and calls func for every intercept up to maxfrac,
+// nearest first. Returns true if func returned true for all of them.
+//
+
+dboolean P_TraverseIntercepts(interceptbuf_t* buf, traverser_t func, fixed_t maxfrac) {
+    int i;
+
+    P_SortIntercepts(buf);
+
+    for(i = 0; i < buf->numintercepts; i++) {
+        if(buf->intercepts[i].frac > maxfrac) {
+            return true;    // checked everything in range
+        }
+
+        if(!func(&buf->intercepts[i])) {
+            return false;    // don't bother going farther
+        }
+    }
+
+    return true;        // everything was traversed
+}
+
+//
+// P_FreeIntercepts
+//
+
+void P_FreeIntercepts(interceptbuf_t* buf) {
+    if(buf->intercepts) {
+        Z_Free(buf->intercepts);
+    }
+
+    if(buf->scratch) {
+        Z_Free(buf->scratch);
+    }
+
+    buf->intercepts = NULL;
+    buf->scratch = NULL;
+    buf->numintercepts = 0;
+    buf->maxintercepts = 0;
+}
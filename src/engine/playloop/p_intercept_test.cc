@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "doomdef.h"
+#include "z_zone.h"
+#include "p_local.h"
+
+namespace {
+  line_t test_lines[4];
+  mobj_t test_things[4];
+
+  std::vector<fixed_t> visited;
+
+  dboolean record(intercept_t *in)
+  {
+      visited.push_back(in->frac);
+      return true;
+  }
+
+  // Fills a buffer the way a trace across a whole map would
+  void fill(interceptbuf_t *buf, int count, unsigned int seed)
+  {
+      unsigned int rnd = seed;
+
+      for (int i = 0; i < count; i++)
+      {
+          rnd = rnd * 1103515245u + 12345u;
+
+          fixed_t frac = (rnd >> 8) % (FRACUNIT + 1);
+
+          if (rnd & 1)
+              P_AddIntercept(buf, frac, &test_lines[i & 3], nullptr);
+          else
+              P_AddIntercept(buf, frac, nullptr, &test_things[i & 3]);
+      }
+  }
+
+  interceptbuf_t inner_buf;
+  int inner_traces;
+
+  dboolean nested(intercept_t *in)
+  {
+      visited.push_back(in->frac);
+
+      // a traverser that starts another trace of its own
+      P_ClearIntercepts(&inner_buf, 0);
+      fill(&inner_buf, 300, inner_traces++);
+      P_TraverseIntercepts(&inner_buf, [](intercept_t *) -> dboolean { return true; }, FRACUNIT);
+      return true;
+  }
+}
+
+TEST(Intercepts, long_trace_keeps_everything_in_order)
+{
+    Z_Init();
+
+    interceptbuf_t buf = {};
+    P_ClearIntercepts(&buf, 0);
+    fill(&buf, 20000, 1);
+
+    ASSERT_EQ(buf.numintercepts, 20000);
+
+    visited.clear();
+    ASSERT_TRUE(P_TraverseIntercepts(&buf, record, FRACUNIT));
+    ASSERT_EQ(visited.size(), 20000u);
+
+    for (size_t i = 1; i < visited.size(); i++)
+        ASSERT_LE(visited[i - 1], visited[i]);
+
+    P_FreeIntercepts(&buf);
+}
+
+TEST(Intercepts, ties_keep_the_order_they_were_found_in)
+{
+    Z_Init();
+
+    interceptbuf_t buf = {};
+    P_ClearIntercepts(&buf, 0);
+
+    for (int i = 0; i < 1000; i++)
+        P_AddIntercept(&buf, (i % 3) * FRACUNIT / 4, &test_lines[0] + (i & 3), nullptr);
+
+    P_SortIntercepts(&buf);
+
+    for (int i = 1; i < buf.numintercepts; i++)
+    {
+        intercept_t *a = &buf.intercepts[i - 1];
+        intercept_t *b = &buf.intercepts[i];
+
+        ASSERT_LE(a->frac, b->frac);
+
+        // lines were added in a repeating order, so a stable sort keeps it
+        if (a->frac == b->frac)
+        {
+            ASSERT_EQ((b->d.line - a->d.line + 4) & 3, 3);
+        }
+    }
+
+    P_FreeIntercepts(&buf);
+}
+
+TEST(Intercepts, limit_drops_the_rest)
+{
+    Z_Init();
+
+    interceptbuf_t buf = {};
+    P_ClearIntercepts(&buf, MAXINTERCEPTS);
+    fill(&buf, 1000, 2);
+
+    ASSERT_EQ(buf.numintercepts, MAXINTERCEPTS);
+    ASSERT_FALSE(P_AddIntercept(&buf, 0, &test_lines[0], nullptr));
+
+    P_FreeIntercepts(&buf);
+}
+
+TEST(Intercepts, stops_at_maxfrac)
+{
+    Z_Init();
+
+    interceptbuf_t buf = {};
+    P_ClearIntercepts(&buf, 0);
+
+    for (int i = 0; i < 10; i++)
+        P_AddIntercept(&buf, (10 - i) * FRACUNIT / 10, &test_lines[0], nullptr);
+
+    visited.clear();
+    ASSERT_TRUE(P_TraverseIntercepts(&buf, record, FRACUNIT / 2));
+    ASSERT_EQ(visited.size(), 5u);
+
+    P_FreeIntercepts(&buf);
+}
+
+TEST(Intercepts, nested_traces_use_their_own_buffers)
+{
+    Z_Init();
+
+    interceptbuf_t buf = {};
+    P_ClearIntercepts(&buf, 0);
+    fill(&buf, 500, 3);
+
+    visited.clear();
+    inner_traces = 0;
+    ASSERT_TRUE(P_TraverseIntercepts(&buf, nested, FRACUNIT));
+    ASSERT_EQ(visited.size(), 500u);
+
+    for (size_t i = 1; i < visited.size(); i++)
+        ASSERT_LE(visited[i - 1], visited[i]);
+
+    P_FreeIntercepts(&buf);
+    P_FreeIntercepts(&inner_buf);
+}
+
+TEST(Intercepts, hitscan_benchmark)
+{
+    Z_Init();
+
+    // a shotgun blast in a crowded open area: many traces, each crossing
+    // a few dozen lines and things
+    constexpr int traces = 20000;
+    constexpr int per_trace = 96;
+
+    interceptbuf_t buf = {};
+    int visits = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int t = 0; t < traces; t++)
+    {
+        P_ClearIntercepts(&buf, 0);
+        fill(&buf, per_trace, t);
+
+        P_TraverseIntercepts(&buf, [](intercept_t *) -> dboolean { return true; }, FRACUNIT);
+        visits += buf.numintercepts;
+    }
+
+    auto sorted = std::chrono::steady_clock::now() - start;
+
+    // the original closest-first scan over the same intercepts
+    start = std::chrono::steady_clock::now();
+
+    for (int t = 0; t < traces; t++)
+    {
+        P_ClearIntercepts(&buf, 0);
+        fill(&buf, per_trace, t);
+
+        for (int n = 0; n < buf.numintercepts; n++)
+        {
+            intercept_t *in = nullptr;
+            fixed_t dist = D_MAXINT;
+
+            for (int i = 0; i < buf.numintercepts; i++)
+            {
+                if (buf.intercepts[i].frac < dist)
+                {
+                    dist = buf.intercepts[i].frac;
+                    in = &buf.intercepts[i];
+                }
+            }
+
+            in->frac = D_MAXINT;
+        }
+    }
+
+    auto scanned = std::chrono::steady_clock::now() - start;
+
+    using std::chrono::microseconds;
+    std::printf("[          ] %d traces of %d intercepts: sorted %lldus, scanned %lldus\n",
+                traces, per_trace,
+                (long long)std::chrono::duration_cast<microseconds>(sorted).count(),
+                (long long)std::chrono::duration_cast<microseconds>(scanned).count());
+
+    ASSERT_EQ(visits, traces * per_trace);
+
+    P_FreeIntercepts(&buf);
+}
@@ -25,6 +25,12 @@
 // DESCRIPTION:
 //    Handle Sector base lighting effects.
 //
+//    The effects don't get a thinker each. They live in one array in the
+//    order they were started and a lightbatch_t thinker runs each run of
+//    them that sits together in the thinker list, so they still think
+//    and draw random numbers in the same order as before. Effects report
+//    the sectors and lights they change each tic.
+//
 //-----------------------------------------------------------------------------
 
 
@@ -35,33 +41,270 @@
 #include "p_local.h"
 #include "i_system.h"
 #include "r_lights.h"
+#include "p_macros.h"
+#include "con_console.h"
+#include "g_actions.h"
 
 //------------------------------------------------------------------------
 //
-// FIRELIGHT FLICKER
+// LIGHT EFFECTS
 //
 //------------------------------------------------------------------------
 
+static lighteffect_t *lighteffects = NULL;  // by id, live and removed
+static int numlighteffects = 0;
+static int maxlighteffects = 0;
+static int numremovedeffects = 0;
+static int lasteffectid = 0;
+
+static int *changedsectors = NULL;
+static byte *sectorchanged = NULL;
+static int numchangedsectors = 0;
+static int *changedlights = NULL;
+static byte *lightchanged = NULL;
+static int numchangedlights = 0;
+
 //
-// T_FireFlicker
+// P_FindLightEffect
+// Index of the first effect whose id isn't below id
 //
 
-void T_FireFlicker(void *data) {
-    fireflicker_t* flick = (fireflicker_t*) data;
-    int    amount;
+static int P_FindLightEffect(int id) {
+    int low = 0;
+    int high = numlighteffects;
+
+    while(low < high) {
+        int mid = (low + high) >> 1;
+
+        if(lighteffects[mid].id < id) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+//
+// P_LightEffectById
+//
+
+static lighteffect_t *P_LightEffectById(int id) {
+    int i = P_FindLightEffect(id);
+
+    if(i == numlighteffects || lighteffects[i].id != id || lighteffects[i].removed) {
+        return NULL;
+    }
+
+    return &lighteffects[i];
+}
+
+//
+// P_AddLightEffect
+// Starts effect as if it were a thinker added now and returns its id.
+// It joins the batch at the end of the thinker list or starts one.
+//
+
+int P_AddLightEffect(lighteffect_t *effect) {
+    lighteffect_t *le;
+    lightbatch_t *batch;
+
+    if(numlighteffects == maxlighteffects) {
+        maxlighteffects = maxlighteffects ? maxlighteffects * 2 : 64;
+        lighteffects = (lighteffect_t*)Z_Realloc(lighteffects,
+                       maxlighteffects * sizeof(lighteffect_t), PU_LEVEL, &lighteffects);
+    }
+
+    le = &lighteffects[numlighteffects++];
+    *le = *effect;
+    le->id = ++lasteffectid;
+    le->removed = false;
+
+    batch = (lightbatch_t*)thinkercap.prev;
+
+    if(&batch->thinker == &thinkercap ||
+            batch->thinker.function.acp1 != (actionf_p1)T_LightBatch) {
+        batch = (lightbatch_t*) P_AllocThinker(sizeof(*batch), (actionf_p1)T_LightBatch);
+        P_AddThinker(&batch->thinker);
+        batch->thinker.function.acp1 = (actionf_p1)T_LightBatch;
+        batch->first = le->id;
+    }
+
+    batch->last = le->id;
+
+    return le->id;
+}
+
+//
+// P_RemoveLightEffect
+// Like P_RemoveThinker, the record stays until P_StartLightEffects
+//
+
+static void P_RemoveLightEffect(lighteffect_t *le) {
+    le->removed = true;
+    numremovedeffects++;
+
+    P_MacroDetachEffect(le->id);
+}
+
+//
+// P_StopLightEffect
+//
+
+void P_StopLightEffect(int id) {
+    lighteffect_t *le = P_LightEffectById(id);
+
+    if(le) {
+        P_RemoveLightEffect(le);
+    }
+}
+
+//
+// P_LightBatchEffects
+// The records batch runs, removed ones included
+//
+
+lighteffect_t *P_LightBatchEffects(lightbatch_t *batch, int *count) {
+    int first = P_FindLightEffect(batch->first);
+
+    *count = P_FindLightEffect(batch->last + 1) - first;
+    return &lighteffects[first];
+}
 
-    if(--flick->count) {
+//
+// P_LastLightEffect
+// Id of the newest effect, for telling whether any were started
+//
+
+int P_LastLightEffect(void) {
+    return lasteffectid;
+}
+
+//
+// P_ClearLightEffects
+// Called whenever the thinker list is emptied
+//
+
+void P_ClearLightEffects(void) {
+    if(!lighteffects) {
+        maxlighteffects = 0;
+    }
+
+    numlighteffects = 0;
+    numremovedeffects = 0;
+    lasteffectid = 0;
+
+    // owners are cleared when PU_LEVEL is freed
+    if(!sectorchanged) {
+        Z_Malloc(numsectors * sizeof(int), PU_LEVEL, &changedsectors);
+        Z_Malloc(numlights * sizeof(int), PU_LEVEL, &changedlights);
+        Z_Calloc(numsectors * sizeof(byte), PU_LEVEL, &sectorchanged);
+        Z_Calloc(numlights * sizeof(byte), PU_LEVEL, &lightchanged);
+        numchangedsectors = 0;
+        numchangedlights = 0;
+    }
+}
+
+//
+// P_StartLightEffects
+// Called at the start of a tic. Forgets what changed last tic and drops
+// the records of removed effects.
+//
+
+void P_StartLightEffects(void) {
+    int i;
+    int j;
+
+    for(i = 0; i < numchangedsectors; i++) {
+        sectorchanged[changedsectors[i]] = false;
+    }
+
+    for(i = 0; i < numchangedlights; i++) {
+        lightchanged[changedlights[i]] = false;
+    }
+
+    numchangedsectors = 0;
+    numchangedlights = 0;
+
+    if(!numremovedeffects) {
         return;
     }
 
-    if(flick->special != flick->sector->special) {
-        flick->sector->lightlevel = 0;
-        P_RemoveThinker(&flick->thinker);
+    for(i = 0, j = 0; i < numlighteffects; i++) {
+        if(!lighteffects[i].removed) {
+            lighteffects[j++] = lighteffects[i];
+        }
+    }
+
+    numlighteffects = j;
+    numremovedeffects = 0;
+}
+
+//
+// P_ChangedLightSectors
+// The sectors light effects changed the light level of last tic
+//
+
+int P_ChangedLightSectors(int **list) {
+    *list = changedsectors;
+    return numchangedsectors;
+}
+
+//
+// P_ChangedLights
+// The lights light effects changed the color of last tic
+//
+
+int P_ChangedLights(int **list) {
+    *list = changedlights;
+    return numchangedlights;
+}
+
+//
+// P_MarkChangedSector
+//
+
+static void P_MarkChangedSector(int secnum) {
+    if(!sectorchanged[secnum]) {
+        sectorchanged[secnum] = true;
+        changedsectors[numchangedsectors++] = secnum;
+    }
+}
+
+//
+// P_MarkChangedLight
+//
+
+static void P_MarkChangedLight(int light) {
+    if(!lightchanged[light]) {
+        lightchanged[light] = true;
+        changedlights[numchangedlights++] = light;
+    }
+}
+
+//------------------------------------------------------------------------
+//
+// FIRELIGHT FLICKER
+//
+//------------------------------------------------------------------------
+
+//
+// P_FireFlicker
+//
+
+static void P_FireFlicker(lighteffect_t *flick, sector_t *sector) {
+    int    amount;
+
+    if(flick->special != sector->special) {
+        sector->lightlevel = 0;
+        P_RemoveLightEffect(flick);
         return;
     }
 
     amount = (P_Random(pr_lights) & 31);
-    flick->sector->lightlevel = amount;
+    sector->lightlevel = amount;
     flick->count = 3;
 }
 
@@ -71,16 +314,14 @@ void T_FireFlicker(void *data) {
 
 void P_SpawnFireFlicker(void *data) {
     sector_t* sector = (sector_t*) data;
-    fireflicker_t*    flick;
-
-    flick = (fireflicker_t*) Z_Malloc(sizeof(*flick), PU_LEVSPEC, 0);
+    lighteffect_t flick;
 
-    P_AddThinker(&flick->thinker);
+    flick.type = le_fireflicker;
+    flick.sector = sector - sectors;
+    flick.special = sector->special;
+    flick.count = 3;
 
-    flick->thinker.function.acp1 = (actionf_p1)T_FireFlicker;
-    flick->sector = sector;
-    flick->special = sector->special;
-    flick->count = 3;
+    P_AddLightEffect(&flick);
 }
 
 //------------------------------------------------------------------------
@@ -90,28 +331,23 @@ void P_SpawnFireFlicker(void *data) {
 //------------------------------------------------------------------------
 
 //
-// T_LightFlash
+// P_LightFlash
 // Do flashing lights.
 //
 
-void T_LightFlash(void *data) {
-    lightflash_t* flash = (lightflash_t*) data;
-    if(--flash->count) {
-        return;
-    }
-
-    if(flash->special != flash->sector->special) {
-        flash->sector->lightlevel = 0;
-        P_RemoveThinker(&flash->thinker);
+static void P_LightFlash(lighteffect_t *flash, sector_t *sector) {
+    if(flash->special != sector->special) {
+        sector->lightlevel = 0;
+        P_RemoveLightEffect(flash);
         return;
     }
 
-    if(flash->sector->lightlevel == 32) {
-        flash->sector->lightlevel = 0;
+    if(sector->lightlevel == 32) {
+        sector->lightlevel = 0;
         flash->count = (P_Random(pr_lights) & 7) + 1;
     }
     else {
-        flash->sector->lightlevel = 32;
+        sector->lightlevel = 32;
         flash->count = (P_Random(pr_lights) & 32) + 1;
     }
 }
@@ -124,16 +360,14 @@ void T_LightFlash(void *data) {
 //
 void P_SpawnLightFlash(void *data) {
     sector_t* sector = (sector_t*) data;
-    lightflash_t*    flash;
-
-    flash = (lightflash_t*) Z_Malloc(sizeof(*flash), PU_LEVSPEC, 0);
+    lighteffect_t flash;
 
-    P_AddThinker(&flash->thinker);
+    flash.type = le_flash;
+    flash.sector = sector - sectors;
+    flash.special = sector->special;
+    flash.count = (P_Random(pr_lights) & 63) + 1;
 
-    flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
-    flash->sector = sector;
-    flash->special = sector->special;
-    flash->count = (P_Random(pr_lights) & 63) + 1;
+    P_AddLightEffect(&flash);
 }
 
 
@@ -144,29 +378,23 @@ void P_SpawnLightFlash(void *data) {
 //------------------------------------------------------------------------
 
 //
-// T_StrobeFlash
+// P_StrobeFlash
 //
 
-
-void T_StrobeFlash(void *data) {
-    strobe_t* flash = (strobe_t*) data;
-    if(--flash->count) {
-        return;
-    }
-
-    if(flash->special != flash->sector->special) {
-        flash->sector->lightlevel = 0;
-        P_RemoveThinker(&flash->thinker);
+static void P_StrobeFlash(lighteffect_t *flash, sector_t *sector) {
+    if(flash->special != sector->special) {
+        sector->lightlevel = 0;
+        P_RemoveLightEffect(flash);
         return;
     }
 
-    if(flash->sector->lightlevel != 0) {
-        flash->sector->lightlevel = 0;
-        flash->count =flash->darktime;
+    if(sector->lightlevel != 0) {
+        sector->lightlevel = 0;
+        flash->count = flash->strobe.darktime;
     }
     else {
-        flash->sector->lightlevel = flash->maxlight;
-        flash->count = flash->brighttime;
+        sector->lightlevel = flash->strobe.maxlight;
+        flash->count = flash->strobe.brighttime;
     }
 }
 
@@ -179,19 +407,17 @@ void T_StrobeFlash(void *data) {
 //
 
 void P_SpawnStrobeFlash(sector_t* sector, int speed) {
-    strobe_t* flash;
-
-    flash = (strobe_t*) Z_Malloc(sizeof(*flash), PU_LEVSPEC, 0);
+    lighteffect_t flash;
 
-    P_AddThinker(&flash->thinker);
+    flash.type = le_strobe;
+    flash.sector = sector - sectors;
+    flash.strobe.darktime = speed;
+    flash.special = sector->special;
+    flash.strobe.maxlight = 16;
+    flash.strobe.brighttime = 3;
+    flash.count = (P_Random(pr_lights) & 7) + 1;
 
-    flash->sector = sector;
-    flash->darktime = speed;
-    flash->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
-    flash->special = sector->special;
-    flash->maxlight = 16;
-    flash->brighttime = 3;
-    flash->count = (P_Random(pr_lights) & 7) + 1;
+    P_AddLightEffect(&flash);
 }
 
 //
@@ -200,19 +426,17 @@ void P_SpawnStrobeFlash(sector_t* sector, int speed) {
 //
 
 void P_SpawnStrobeAltFlash(sector_t* sector, int speed) {      // 0x80015C44
-    strobe_t* flash;
-
-    flash = (strobe_t*) Z_Malloc(sizeof(*flash), PU_LEVSPEC, 0);
+    lighteffect_t flash;
 
-    P_AddThinker(&flash->thinker);
+    flash.type = le_strobe;
+    flash.sector = sector - sectors;
+    flash.strobe.darktime = speed;
+    flash.special = sector->special;
+    flash.strobe.maxlight = 127;
+    flash.strobe.brighttime = 1;
+    flash.count = 1;
 
-    flash->sector = sector;
-    flash->darktime = speed;
-    flash->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
-    flash->special = sector->special;
-    flash->maxlight = 127;
-    flash->brighttime = 1;
-    flash->count = 1;
+    P_AddLightEffect(&flash);
 }
 
 //
@@ -243,54 +467,45 @@ void EV_StartLightStrobing(void *data) {
 //------------------------------------------------------------------------
 
 //
-// T_Glow
+// P_Glow
 //
 
-void T_Glow(void *data) {
-    glow_t *g = (glow_t*) data;
-    sector_t *sector;
-
-    if(--g->count) {
-        return;
-    }
-
-    sector = g->sector;
-
+static void P_Glow(lighteffect_t *g, sector_t *sector) {
     if(g->special != sector->special) {
         sector->lightlevel = 0;
-        P_RemoveThinker(&g->thinker);
+        P_RemoveLightEffect(g);
         return;
     }
 
     g->count = 2;
 
-    if(g->direction == -1) {
+    if(g->glow.direction == -1) {
         sector->lightlevel -= 2;
-        if(!(sector->lightlevel < g->minlight)) {
+        if(!(sector->lightlevel < g->glow.minlight)) {
             return;
         }
 
-        sector->lightlevel = g->minlight;
+        sector->lightlevel = g->glow.minlight;
 
-        if(g->type == PULSERANDOM) {
-            g->maxlight = (P_Random(pr_lights) & 31) + 17;
+        if(g->glow.type == PULSERANDOM) {
+            g->glow.maxlight = (P_Random(pr_lights) & 31) + 17;
         }
 
-        g->direction = 1;
+        g->glow.direction = 1;
 
         return;
     }
-    else if(g->direction == 1) {
+    else if(g->glow.direction == 1) {
         sector->lightlevel += 2;
-        if(!(g->maxlight < sector->lightlevel)) {
+        if(!(g->glow.maxlight < sector->lightlevel)) {
             return;
         }
 
-        if(g->type == PULSERANDOM) {
-            g->minlight = (P_Random(pr_lights) & 15);
+        if(g->glow.type == PULSERANDOM) {
+            g->glow.minlight = (P_Random(pr_lights) & 15);
         }
 
-        g->direction = -1;
+        g->glow.direction = -1;
     }
     else {
         return;
@@ -302,26 +517,25 @@ void T_Glow(void *data) {
 //
 
 void P_SpawnGlowingLight(sector_t*    sector, byte type) {
-    glow_t*    g;
-
-    g = (glow_t*) Z_Malloc(sizeof(*g), PU_LEVSPEC, 0);
-
-    P_AddThinker(&g->thinker);
-    g->count = 2;
-    g->direction = 1;
-    g->sector = sector;
-    g->type = type;
-    g->special = sector->special;
-    g->thinker.function.acp1 = (actionf_p1)T_Glow;
-    g->minlight = 0;
-
-    if(g->type == PULSENORMAL) {
-        g->maxlight = 32;
+    lighteffect_t g;
+
+    g.type = le_glow;
+    g.count = 2;
+    g.glow.direction = 1;
+    g.sector = sector - sectors;
+    g.glow.type = type;
+    g.special = sector->special;
+    g.glow.minlight = 0;
+    g.glow.maxlight = 0;
+
+    if(g.glow.type == PULSENORMAL) {
+        g.glow.maxlight = 32;
     }
-    else if(g->type == PULSERANDOM || g->type == PULSESLOW) {
-        g->maxlight = 48;
+    else if(g.glow.type == PULSERANDOM || g.glow.type == PULSESLOW) {
+        g.glow.maxlight = 48;
     }
 
+    P_AddLightEffect(&g);
 }
 
 //------------------------------------------------------------------------
@@ -333,28 +547,20 @@ void P_SpawnGlowingLight(sector_t*    sector, byte type) {
 #define SEQUENCELIGHTMAX    48
 
 //
-// T_Sequence
+// P_Sequence
+// Can start more sequence lights, which moves the effect records
 //
 
-void T_Sequence(void *data) {
-    sequenceGlow_t* seq = (sequenceGlow_t*) data;
-    sector_t *sector;
-
-    if(--seq->count) {
-        return;
-    }
-
-    sector = seq->sector;
-
+static void P_Sequence(lighteffect_t *seq, sector_t *sector) {
     if(seq->special != sector->special) {
         sector->lightlevel = 0;
-        P_RemoveThinker(&seq->thinker);
+        P_RemoveLightEffect(seq);
         return;
     }
 
     seq->count = 1;
 
-    if(seq->start == -1) {
+    if(seq->sequence.start == -1) {
         sector->lightlevel -= 2;
         if(sector->lightlevel > 0) {
             return;
@@ -362,23 +568,23 @@ void T_Sequence(void *data) {
 
         sector->lightlevel = 0;
 
-        if(seq->headsector == NULL) {
+        if(seq->sequence.headsector == -1) {
             sector->special = 0;
             sector->lightlevel = 0;
-            P_RemoveThinker(&seq->thinker);
+            P_RemoveLightEffect(seq);
             return;
         }
 
-        seq->start = 0;
+        seq->sequence.start = 0;
     }
-    else if(seq->start == 0) {
-        if(!seq->headsector->lightlevel) {
+    else if(seq->sequence.start == 0) {
+        if(!sectors[seq->sequence.headsector].lightlevel) {
             return;
         }
 
-        seq->start = 1;
+        seq->sequence.start = 1;
     }
-    else if(seq->start == 1) {
+    else if(seq->sequence.start == 1) {
         sector->lightlevel += 2;
         if(sector->lightlevel < (SEQUENCELIGHTMAX + 1)) {
             sector_t *next = NULL;
@@ -411,7 +617,7 @@ void T_Sequence(void *data) {
         }
         else {
             sector->lightlevel = SEQUENCELIGHTMAX;
-            seq->start = -1;
+            seq->sequence.start = -1;
         }
     }
 }
@@ -421,7 +627,7 @@ void T_Sequence(void *data) {
 //
 
 void P_SpawnSequenceLight(sector_t* sector, dboolean first) {
-    sequenceGlow_t* seq;
+    lighteffect_t seq;
     sector_t *headsector = NULL;
     int i = 0;
 
@@ -446,17 +652,15 @@ void P_SpawnSequenceLight(sector_t* sector, dboolean first) {
         }
     }
 
-    seq = (sequenceGlow_t*) Z_Malloc(sizeof(*seq), PU_LEVSPEC, 0);
+    seq.type = le_sequence;
+    seq.sector = sector - sectors;
+    seq.special = sector->special;
+    seq.count = 1;
+    seq.sequence.index = sector->tag;
+    seq.sequence.start = (headsector == NULL ? 1 : 0);
+    seq.sequence.headsector = (headsector == NULL ? -1 : headsector - sectors);
 
-    P_AddThinker(&seq->thinker);
-
-    seq->thinker.function.acp1 = (actionf_p1)T_Sequence;
-    seq->sector = sector;
-    seq->special = sector->special;
-    seq->count = 1;
-    seq->index = sector->tag;
-    seq->start = (headsector == NULL ? 1 : 0);
-    seq->headsector = headsector;
+    P_AddLightEffect(&seq);
 }
 
 //------------------------------------------------------------------------
@@ -466,38 +670,38 @@ void P_SpawnSequenceLight(sector_t* sector, dboolean first) {
 //------------------------------------------------------------------------
 
 //
-// T_Combine
+// P_Combine
 //
 
-void T_Combine(void *data) {
-    combine_t *combine = (combine_t *) data;
-    sector_t *sector;
+static void P_Combine(lighteffect_t *combine, sector_t *sector) {
+    lighteffect_t *combiner;
 
-    sector = combine->sector;
+    combiner = P_LightEffectById(combine->combine.combiner);
 
-    if(combine->special != sector->special ||
-            combine->func != combine->combiner->function.acp1) {
+    if(combine->special != sector->special || !combiner ||
+            combiner->type != combine->combine.type) {
         sector->lightlevel = 0;
-        P_RemoveThinker(&combine->thinker);
+        P_RemoveLightEffect(combine);
         return;
     }
 
-    sector->lightlevel = ((combine_t*)combine->combiner)->sector->lightlevel;
+    sector->lightlevel = sectors[combiner->sector].lightlevel;
 }
 
 //
 // P_CombineLightSpecials
+// Follows the first effect of the kind the sector's special would start
 //
 
 void P_CombineLightSpecials(void *data) {
     sector_t *sector = (sector_t *) data;
-    actionf_p1 func;
-    thinker_t *thinker;
-    combine_t *combine;
+    lighteffect_t combine;
+    int type;
+    int i;
 
     switch(sector->special) {
     case 1:
-        func = T_LightFlash;
+        type = le_flash;
         break;
     case 2:
     case 3:
@@ -507,34 +711,33 @@ void P_CombineLightSpecials(void *data) {
     case 205:
     case 206:
     case 208:
-        func = T_StrobeFlash;
+        type = le_strobe;
         break;
     case 8:
     case 9:
     case 11:
-        func = T_Glow;
+        type = le_glow;
         break;
     case 17:
-        func = T_FireFlicker;
+        type = le_fireflicker;
         break;
     default:
         return;
     }
 
-    for(thinker = thinkercap.next; thinker != &thinkercap; thinker = thinker->next) {
-        if((actionf_p1)func != (actionf_p1)thinker->function.acp1) {
+    for(i = 0; i < numlighteffects; i++) {
+        if(lighteffects[i].removed || lighteffects[i].type != type) {
             continue;
         }
 
-        combine = (combine_t*) Z_Malloc(sizeof(*combine), PU_LEVSPEC, 0);
-
-        P_AddThinker(&combine->thinker);
+        combine.type = le_combine;
+        combine.sector = sector - sectors;
+        combine.special = sector->special;
+        combine.count = 0;
+        combine.combine.combiner = lighteffects[i].id;
+        combine.combine.type = type;
 
-        combine->sector = sector;
-        combine->special = sector->special;
-        combine->combiner = thinker;
-        combine->func = func;
-        combine->thinker.function.acp1 = (actionf_p1)T_Combine;
+        P_AddLightEffect(&combine);
         return;
     }
 }
@@ -548,27 +751,29 @@ void P_CombineLightSpecials(void *data) {
 int P_FindSectorFromTag(int tag);
 
 //
-// T_LightMorph
+// P_LightMorph
 //
 // Interpolates one light_t's RGB to another light_t's RGB
 //
 
-void T_LightMorph(void *data) {
-    lightmorph_t *lt = (lightmorph_t *) data;
-    lt->inc += 4;
+static void P_LightMorph(lighteffect_t *lt) {
+    light_t *dest = &lights[lt->sector];
+    light_t *src = &lights[lt->morph.src];
 
-    if(lt->inc > 256) {
-        lt->dest->base_r = lt->dest->active_r;
-        lt->dest->base_g = lt->dest->active_g;
-        lt->dest->base_b = lt->dest->active_b;
+    lt->morph.inc += 4;
 
-        P_RemoveThinker(&lt->thinker);
+    if(lt->morph.inc > 256) {
+        dest->base_r = dest->active_r;
+        dest->base_g = dest->active_g;
+        dest->base_b = dest->active_b;
+
+        P_RemoveLightEffect(lt);
         return;
     }
 
-    lt->dest->active_r = (lt->r + ((lt->inc * (lt->src->base_r - lt->r)) >> 8));
-    lt->dest->active_g = (lt->g + ((lt->inc * (lt->src->base_g - lt->g)) >> 8));
-    lt->dest->active_b = (lt->b + ((lt->inc * (lt->src->base_b - lt->b)) >> 8));
+    dest->active_r = (lt->morph.r + ((lt->morph.inc * (src->base_r - lt->morph.r)) >> 8));
+    dest->active_g = (lt->morph.g + ((lt->morph.inc * (src->base_g - lt->morph.g)) >> 8));
+    dest->active_b = (lt->morph.b + ((lt->morph.inc * (src->base_b - lt->morph.b)) >> 8));
 }
 
 //
@@ -576,11 +781,7 @@ void T_LightMorph(void *data) {
 //
 
 void P_UpdateLightThinker(light_t* destlight, light_t* srclight) {
-    lightmorph_t* lt;
-
-    lt = (lightmorph_t*) Z_Malloc(sizeof(*lt), PU_LEVSPEC, 0);
-    P_AddThinker(&lt->thinker);
-    lt->thinker.function.acp1 = (actionf_p1)T_LightMorph;
+    lighteffect_t lt;
 
     if(destlight) {
         destlight->r = srclight->r;
@@ -588,12 +789,151 @@ void P_UpdateLightThinker(light_t* destlight, light_t* srclight) {
         destlight->b = srclight->b;
     }
 
-    lt->inc = 0;
-    lt->src = srclight; // the light to morph to
-    lt->dest = destlight == NULL ? srclight : destlight; // the light to morph from
-    lt->r = destlight == NULL ? 0 : destlight->base_r;
-    lt->g = destlight == NULL ? 0 : destlight->base_g;
-    lt->b = destlight == NULL ? 0 : destlight->base_b;
+    lt.type = le_morph;
+    lt.special = 0;
+    lt.count = 0;
+    lt.morph.inc = 0;
+    lt.morph.src = srclight - lights; // the light to morph to
+    lt.sector = (destlight == NULL ? srclight : destlight) - lights; // the light to morph from
+    lt.morph.r = destlight == NULL ? 0 : destlight->base_r;
+    lt.morph.g = destlight == NULL ? 0 : destlight->base_g;
+    lt.morph.b = destlight == NULL ? 0 : destlight->base_b;
+
+    P_AddLightEffect(&lt);
+}
+
+//------------------------------------------------------------------------
+//
+// LIGHT BATCHES
+//
+//------------------------------------------------------------------------
+
+//
+// T_LightBatch
+// Runs the batch's effects in the order they were started, the ones
+// started while it runs included, as their own thinkers would have
+//
+
+void T_LightBatch(void *data) {
+    lightbatch_t *batch = (lightbatch_t*) data;
+    lighteffect_t *le;
+    sector_t *sector;
+    int lightlevel;
+    int live = 0;
+    int i;
+
+    for(i = P_FindLightEffect(batch->first);
+            i < numlighteffects && lighteffects[i].id <= batch->last; i++) {
+        le = &lighteffects[i];
+
+        if(le->removed) {
+            continue;
+        }
+
+        live++;
+
+        if(le->type == le_morph) {
+            P_MarkChangedLight(le->sector);
+            P_LightMorph(le);
+            continue;
+        }
+
+        if(le->type != le_combine && --le->count) {
+            continue;
+        }
+
+        sector = &sectors[le->sector];
+        lightlevel = sector->lightlevel;
+
+        switch(le->type) {
+        case le_fireflicker:
+            P_FireFlicker(le, sector);
+            break;
+        case le_flash:
+            P_LightFlash(le, sector);
+            break;
+        case le_strobe:
+            P_StrobeFlash(le, sector);
+            break;
+        case le_glow:
+            P_Glow(le, sector);
+            break;
+        case le_sequence:
+            P_Sequence(le, sector);
+            break;
+        case le_combine:
+            P_Combine(le, sector);
+            break;
+        }
+
+        if(sector->lightlevel != lightlevel) {
+            P_MarkChangedSector(sector - sectors);
+        }
+    }
+
+    if(!live) {
+        P_RemoveThinker(&batch->thinker);
+    }
+}
+
+//
+// CMD_LightStats
+//
+
+static CMD(LightStats) {
+    static const char *names[NUMLIGHTEFFECTS] = {
+        "flicker", "flash", "strobe", "glow", "sequence", "combine", "morph"
+    };
+    int count[NUMLIGHTEFFECTS];
+    int batches = 0;
+    thinker_t *th;
+    int i;
+
+    if(gamestate != GS_LEVEL) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    dmemset(count, 0, sizeof(count));
+
+    for(i = 0; i < numlighteffects; i++) {
+        if(!lighteffects[i].removed) {
+            count[lighteffects[i].type]++;
+        }
+    }
+
+    for(th = thinkercap.next; th != &thinkercap; th = th->next) {
+        if(th->function.acp1 == (actionf_p1)T_LightBatch) {
+            batches++;
+        }
+    }
+
+    for(i = 0; i < NUMLIGHTEFFECTS; i++) {
+        CON_Printf(WHITE, "%s: %i\n", names[i], count[i]);
+    }
+
+    CON_Printf(WHITE, "%i effects in %i batches, %i sectors and %i lights changed last tic\n",
+               numlighteffects - numremovedeffects, batches, numchangedsectors, numchangedlights);
+}
+
+//
+// P_InitLightEffects
+//
+
+void P_InitLightEffects(void) {
+    P_AddWorldState(&lighteffects, sizeof(lighteffects));
+    P_AddWorldState(&numlighteffects, sizeof(numlighteffects));
+    P_AddWorldState(&maxlighteffects, sizeof(maxlighteffects));
+    P_AddWorldState(&numremovedeffects, sizeof(numremovedeffects));
+    P_AddWorldState(&lasteffectid, sizeof(lasteffectid));
+    P_AddWorldState(&changedsectors, sizeof(changedsectors));
+    P_AddWorldState(&sectorchanged, sizeof(sectorchanged));
+    P_AddWorldState(&numchangedsectors, sizeof(numchangedsectors));
+    P_AddWorldState(&changedlights, sizeof(changedlights));
+    P_AddWorldState(&lightchanged, sizeof(lightchanged));
+    P_AddWorldState(&numchangedlights, sizeof(numchangedlights));
+
+    G_AddCommand("lightstats", CMD_LightStats, 0);
 }
 
 //
@@ -706,7 +1046,7 @@ void T_FadeInBrightness(fadebright_t* fb) {
 void P_FadeInBrightness(void) {
     fadebright_t* fb;
 
-    fb = (fadebright_t*) Z_Malloc(sizeof(*fb), PU_LEVSPEC, 0);
+    fb = (fadebright_t*) P_AllocThinker(sizeof(*fb), (actionf_p1)T_FadeInBrightness);
     P_AddThinker(&fb->thinker);
     fb->thinker.function.acp1 = (actionf_p1)T_FadeInBrightness;
     fb->factor = 0;
@@ -0,0 +1,209 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Line geometry. Movement and sight read lines and sectors from
+//    arrays indexed by line and sector number instead of going through
+//    line_t, vertex_t and sector_t. What a blockmap walk looks at for
+//    every line it passes, the bounding box and the line itself, takes
+//    32 bytes; everything else is only read for lines the box touches.
+//
+//    Lines never move, and only their flags change after the level is
+//    loaded. Sector heights follow P_SectorChanged.
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "m_fixed.h"
+#include "m_misc.h"
+#include "i_system.h"
+#include "p_local.h"
+#include "info.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+geoline_t   *geolines = NULL;
+byte        *geolineslope = NULL;
+int         *geolineflags = NULL;
+int         (*geolinesectors)[2] = NULL;
+geosector_t *geosectors = NULL;
+
+static int  linechangeclock = 0;
+
+//
+// P_BuildLineGeometry
+// Called once the lines know their sectors
+//
+
+void P_BuildLineGeometry(void) {
+    line_t *line;
+    int i;
+
+    // owners are cleared when PU_LEVEL is freed
+    Z_Malloc(numlines * sizeof(geoline_t), PU_LEVEL, &geolines);
+    Z_Malloc(numlines * sizeof(byte), PU_LEVEL, &geolineslope);
+    Z_Malloc(numlines * sizeof(int), PU_LEVEL, &geolineflags);
+    Z_Malloc(numlines * sizeof(int) * 2, PU_LEVEL, &geolinesectors);
+    Z_Malloc(numsectors * sizeof(geosector_t), PU_LEVEL, &geosectors);
+
+    for(i = 0, line = lines; i < numlines; i++, line++) {
+        geoline_t *gl = &geolines[i];
+
+        gl->bbox[BOXTOP] = line->bbox[BOXTOP];
+        gl->bbox[BOXBOTTOM] = line->bbox[BOXBOTTOM];
+        gl->bbox[BOXLEFT] = line->bbox[BOXLEFT];
+        gl->bbox[BOXRIGHT] = line->bbox[BOXRIGHT];
+        gl->x = line->v1->x;
+        gl->y = line->v1->y;
+        gl->dx = line->dx;
+        gl->dy = line->dy;
+
+        geolineslope[i] = (byte)line->slopetype;
+        geolineflags[i] = line->flags;
+        geolinesectors[i][0] = line->frontsector ? line->frontsector - sectors : -1;
+        geolinesectors[i][1] = line->backsector ? line->backsector - sectors : -1;
+    }
+
+    for(i = 0; i < numsectors; i++) {
+        P_SetSectorGeometry(&sectors[i]);
+    }
+}
+
+//
+// P_SetSectorGeometry
+// Copies the heights of a sector
+//
+
+void P_SetSectorGeometry(sector_t *sec) {
+    geosector_t *gs;
+
+    if(!geosectors) {
+        return;
+    }
+
+    gs = &geosectors[sec - sectors];
+    gs->floorheight = sec->floorheight;
+    gs->ceilingheight = sec->ceilingheight;
+}
+
+//
+// P_SetLineGeometry
+// Copies the flags of a line after they are changed
+//
+
+void P_SetLineGeometry(line_t *line) {
+    if(!geolineflags) {
+        return;
+    }
+
+    geolineflags[line - lines] = line->flags;
+    linechangeclock++;
+}
+
+//
+// P_LineChangeClock
+// Changes whenever any line's flags do
+//
+
+int P_LineChangeClock(void) {
+    return linechangeclock;
+}
+
+//
+// CMD_TryMoveBench
+// Walks a thing around the player with P_TryMove
+//
+
+static CMD(TryMoveBench) {
+    mobj_t *mo;
+    mobj_t *thing;
+    unsigned int rnd = 1;
+    int solid;
+    int count;
+    int moved = 0;
+    int time;
+    int i;
+
+    if(gamestate != GS_LEVEL || !(mo = players[consoleplayer].mo)) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    count = param[0] ? datoi(param[0]) : 200000;
+
+    if(count <= 0) {
+        return;
+    }
+
+    // teleport flag keeps it from crossing special lines or stepping,
+    // and the player is let through while it starts on top of them
+    thing = P_SpawnMobj(mo->x, mo->y, mo->z, MT_POSSESSED1);
+    thing->flags |= MF_TELEPORT;
+    solid = mo->flags & MF_SOLID;
+    mo->flags &= ~MF_SOLID;
+
+    time = I_GetTimeMS();
+
+    for(i = 0; i < count; i++) {
+        fixed_t x;
+        fixed_t y;
+
+        rnd = rnd * 1103515245u + 12345u;
+        x = thing->x + (fixed_t)((rnd >> 8) & (32*FRACUNIT-1)) - 16*FRACUNIT;
+        rnd = rnd * 1103515245u + 12345u;
+        y = thing->y + (fixed_t)((rnd >> 8) & (32*FRACUNIT-1)) - 16*FRACUNIT;
+
+        if(P_TryMove(thing, x, y)) {
+            moved++;
+        }
+
+        // keep it near the player
+        if(P_AproxDistance(thing->x - mo->x, thing->y - mo->y) > 1024*FRACUNIT) {
+            P_UnsetThingPosition(thing);
+            thing->x = mo->x;
+            thing->y = mo->y;
+            P_SetThingPosition(thing);
+        }
+    }
+
+    time = I_GetTimeMS() - time;
+
+    mo->flags |= solid;
+    P_RemoveMobj(thing);
+
+    CON_Printf(WHITE, "%i P_TryMove in %ims, %i moved\n", count, time, moved);
+}
+
+//
+// P_InitLineGeometry
+//
+
+void P_InitLineGeometry(void) {
+    P_AddWorldState(&geolines, sizeof(geolines));
+    P_AddWorldState(&geolineslope, sizeof(geolineslope));
+    P_AddWorldState(&geolineflags, sizeof(geolineflags));
+    P_AddWorldState(&geolinesectors, sizeof(geolinesectors));
+    P_AddWorldState(&geosectors, sizeof(geosectors));
+    P_AddWorldState(&linechangeclock, sizeof(linechangeclock));
+
+    G_AddCommand("trymovebench", CMD_TryMoveBench, 0);
+}
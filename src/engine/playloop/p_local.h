@@ -83,10 +83,50 @@ extern    thinker_t    thinkercap;
 extern    mobj_t        mobjhead;
 
 void P_InitThinkers(void);
+void* P_AllocThinker(int size, actionf_p1 function);
+void P_FreeThinker(void* thinker);
 void P_AddThinker(void* thinker);
 void P_RemoveThinker(void* thinker);
 void P_LinkMobj(void* mobj);
 void P_UnlinkMobj(void* mobj);
+mobj_t* P_AllocMobj(void);
+void P_FreeMobj(mobj_t* mobj);
+mobj_t* P_MobjFromIndex(int index);
+int P_MobjPoolSize(void);
+void P_InitThinkerPools(void);
+mobj_t** P_SpawnBenchCrowd(int count, fixed_t* box);
+void P_RemoveBenchCrowd(mobj_t** things, int count);
+
+// p_world.cc
+typedef struct gameworld_s gameworld_t;
+
+void P_AddWorldState(void* data, int size);
+gameworld_t* P_NewWorld(void);
+void P_SetWorld(gameworld_t* world);
+gameworld_t* P_CurrentWorld(void);
+void P_FreeWorld(gameworld_t* world);
+void P_InitWorld(void);
+
+// p_tags.cc
+void P_ClearTIDs(void);
+void P_LinkTID(mobj_t* mobj);
+void P_UnlinkTID(mobj_t* mobj);
+void P_SetMobjTID(mobj_t* mobj, int tid);
+mobj_t* P_FindMobjFromTID(int tid, mobj_t* prev);
+
+// p_tick.cc
+typedef struct {
+    fixed_t floorheight;
+    fixed_t ceilingheight;
+} framesector_t;
+
+extern framesector_t *framesectors;    // heights at the start of the tic
+
+void P_SetupFrameStates(void);
+void P_ClearFrameMobjs(void);
+void P_MarkSectorFrame(sector_t* sec);
+void P_MarkMobjFrame(mobj_t* mobj);
+void P_InitFrameStates(void);
 
 extern angle_t frame_angle;
 extern angle_t frame_pitch;
@@ -196,13 +236,28 @@ typedef struct {
     }            d;
 } intercept_t;
 
-#define MAXINTERCEPTS    128
+#define MAXINTERCEPTS    128    // the original limit, kept unless compat_intercepts
 
-extern intercept_t    intercepts[MAXINTERCEPTS];
-extern intercept_t*    intercept_p;
+//
+// Intercepts of one trace. Buffers grow as needed and keep their memory
+// between traces; each nesting level of P_PathTraverse has its own.
+//
+typedef struct {
+    intercept_t*    intercepts;
+    int             numintercepts;
+    int             maxintercepts;  // allocated
+    int             limit;          // 0 for no limit
+    intercept_t*    scratch;        // for sorting
+} interceptbuf_t;
 
 typedef dboolean(*traverser_t)(intercept_t *in);
 
+void        P_ClearIntercepts(interceptbuf_t* buf, int limit);
+dboolean    P_AddIntercept(interceptbuf_t* buf, fixed_t frac, line_t* line, mobj_t* thing);
+void        P_SortIntercepts(interceptbuf_t* buf);
+dboolean    P_TraverseIntercepts(interceptbuf_t* buf, traverser_t func, fixed_t maxfrac);
+void        P_FreeIntercepts(interceptbuf_t* buf);
+
 fixed_t P_AproxDistance(fixed_t dx, fixed_t dy);
 int     P_PointOnLineSide(fixed_t x, fixed_t y, line_t* line);
 int     P_PointOnDivlineSide(fixed_t x, fixed_t y, divline_t* line);
@@ -227,8 +282,75 @@ dboolean    P_BlockThingsIterator(int x, int y, dboolean(*func)(mobj_t*));
 extern divline_t    trace;
 
 dboolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int    flags, dboolean(*trav)(intercept_t *));
+interceptbuf_t* P_PushTrace(void);
+void    P_PopTrace(divline_t* outertrace);
 void    P_UnsetThingPosition(mobj_t* thing);
 void    P_SetThingPosition(mobj_t* thing);
+int     P_BlockLinkClock(void);
+
+// p_multitrace.cc
+#define MAXMULTIRAYS    32
+
+void        P_GatherRays(fixed_t x1, fixed_t y1, fixed_t *x2, fixed_t *y2, int count, int flags);
+dboolean    P_RayTraverse(int ray, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags,
+                          traverser_t trav);
+void        P_InitMultiTrace(void);
+
+// p_thinggrid.cc
+void        P_ClearThingGrid(void);
+void        P_LinkThingGrid(mobj_t *thing, int blockx, int blocky);
+void        P_UnlinkThingGrid(mobj_t *thing);
+void        P_MoveThingGrid(mobj_t *thing);
+void        P_FreeThingGrid(mobj_t *thing);
+dboolean    P_BoxThingsIterator(fixed_t *box, int xl, int xh, int yl, int yh,
+                                dboolean rows, dboolean(*func)(mobj_t*));
+void        P_InitThingGrid(void);
+
+// p_touching.cc
+void        P_ClearTouching(void);
+void        P_LinkTouching(mobj_t *thing);
+void        P_UnlinkTouching(mobj_t *thing);
+dboolean    P_TouchingThingsIterator(sector_t *sector, dboolean(*func)(mobj_t*));
+void        P_InitTouching(void);
+
+// p_linegeom.cc
+typedef struct {
+    fixed_t     bbox[4];
+    fixed_t     x;          // v1
+    fixed_t     y;
+    fixed_t     dx;
+    fixed_t     dy;
+} geoline_t;
+
+typedef struct {
+    fixed_t     floorheight;
+    fixed_t     ceilingheight;
+} geosector_t;
+
+extern geoline_t    *geolines;
+extern byte         *geolineslope;      // slopetype_t
+extern int          *geolineflags;      // ML_MAPPED is not kept up
+extern int          (*geolinesectors)[2];   // front, back; -1 for none
+extern geosector_t  *geosectors;
+
+void        P_BuildLineGeometry(void);
+void        P_SetSectorGeometry(sector_t *sec);
+void        P_SetLineGeometry(line_t *line);
+int         P_LineChangeClock(void);
+void        P_InitLineGeometry(void);
+
+// p_noise.cc
+void        P_BuildSoundGraph(void);
+void        P_UpdateSoundGraph(sector_t *sec);
+void        P_FloodNoise(sector_t *sec, mobj_t *target);
+void        P_InitNoise(void);
+
+// p_moveplan.cc
+void        P_ScanMoves(void);
+void        P_DropMovePlans(void);
+dboolean    P_PlannedLines(mobj_t *thing, fixed_t x, fixed_t y, subsector_t *newsubsec,
+                           fixed_t *bbox, dboolean *result);
+void        P_InitMovePlans(void);
 
 
 //
@@ -242,13 +364,21 @@ extern fixed_t      tmfloorz;
 extern fixed_t      tmceilingz;
 extern line_t*      tmhitline;
 
+void        P_BlockMapBox(fixed_t* box, fixed_t* bbox, fixed_t x, fixed_t y, fixed_t radius);
 dboolean    P_CheckPosition(mobj_t *thing, fixed_t x, fixed_t y);
 dboolean    P_TryMove(mobj_t* thing, fixed_t x, fixed_t y);
 dboolean    P_PlayerMove(mobj_t* thing, fixed_t x, fixed_t y);
 dboolean    P_TeleportMove(mobj_t* thing, fixed_t x, fixed_t y);
 void        P_SlideMove(mobj_t* mo);
+
+extern int  sightcounts[3];         // rejected, traced, rejected by map lump
+extern int  sightcachecounts[2];    // hits, misses
+
 dboolean    P_CheckSight(mobj_t* t1, mobj_t* t2);
 void        P_ScanSights(void);
+void        P_SectorChanged(sector_t *sec);
+int         P_SectorChangeClock(void);
+void        P_InitSight(void);
 dboolean    P_UseLines(player_t* player, dboolean showcontext);
 dboolean    P_ChangeSector(sector_t* sector, dboolean crunch);
 mobj_t*     P_CheckOnMobj(mobj_t *thing);
@@ -264,6 +394,7 @@ extern int      numspechit;
 
 fixed_t P_AimLineAttack(mobj_t*    t1, angle_t angle, fixed_t zheight, fixed_t distance);
 void    P_LineAttack(mobj_t* t1,angle_t angle, fixed_t distance, fixed_t slope, int damage);
+void    P_LineAttacks(mobj_t* t1, int count, angle_t* angles, fixed_t distance, fixed_t* slopes, int* damages);
 void    P_RadiusAttack(mobj_t* spot, mobj_t* source, int damage);
 
 
@@ -272,14 +403,39 @@ void    P_RadiusAttack(mobj_t* spot, mobj_t* source, int damage);
 // P_SETUP
 //
 extern byte*        rejectmatrix;    // for fast sight rejection
-extern short*        blockmaplump;    // offsets in blockmap are from here
-extern short*        blockmap;
+extern byte*        rejectlump;      // map's own table if rejectmatrix was generated
+extern int*        blockmaplump;    // offsets in blockmap are from here
+extern int*        blockmap;
 extern int            bmapwidth;
 extern int            bmapheight;    // in mapblocks
 extern fixed_t        bmaporgx;
 extern fixed_t        bmaporgy;    // origin of block map
 extern mobj_t**        blocklinks;    // for thing chains
 
+char    *P_MapCacheFile(const char *prefix, const int *maplumps, int count);
+
+// p_blockmap.cc
+dboolean P_SetupBlockMap(const char *error);
+void    P_InitBlockMap(void);
+
+void    P_InitReject(void);
+void    P_SetupReject(void);
+
+//
+// P_PVS
+//
+extern byte*        pvsmatrix;      // subsector visibility, NULL if none
+extern int          pvsrowbytes;
+
+void    P_SetupPVS(void);
+byte    *P_PVSNodes(int from);
+void    P_InitPVS(void);
+
+// true if anything in subsector 'to' can possibly be seen from 'from'
+static inline dboolean P_CheckPVS(int from, int to) {
+    return !pvsmatrix || (pvsmatrix[from * pvsrowbytes + (to >> 3)] & (1 << (to & 7)));
+}
+
 
 
 //
@@ -33,6 +33,7 @@
 #include "i_system.h"
 
 thinker_t       *macrothinker    = NULL;
+int             macroeffect     = 0;
 macrodef_t      *macro           = NULL;
 macrodata_t     *nextmacro       = NULL;
 mobj_t          *mobjmacro       = NULL;
@@ -98,6 +99,17 @@ void P_MacroDetachThinker(thinker_t* thinker) {
     }
 }
 
+//
+// P_MacroDetachEffect
+// The same for a light effect
+//
+
+void P_MacroDetachEffect(int id) {
+    if(id == macroeffect) {
+        macroeffect = 0;
+    }
+}
+
 //
 // P_ToggleMacros
 //
@@ -130,6 +142,7 @@ void P_ToggleMacros(int tag, dboolean toggleon) {
 void P_InitMacroVars(void) {
     macro = NULL;
     macrothinker = NULL;
+    macroeffect = 0;
     nextmacro = NULL;
     mobjmacro = NULL;
     macroid = -1;
@@ -195,11 +208,16 @@ int P_SuspendMacro(int tag) {
         return 0;
     }
 
-    if(!macrothinker) {
+    if(macrothinker) {
+        P_RemoveThinker(macrothinker);
+    }
+    else if(macroeffect) {
+        P_StopLightEffect(macroeffect);
+    }
+    else {
         return 0;
     }
 
-    P_RemoveThinker(macrothinker);
     P_InitMacroVars();
 
     return 1;
@@ -218,6 +236,7 @@ void P_RunMacros(void) {
     int currentID = 0;
     macrodata_t* m;
     thinker_t* thinker;
+    int effect;
     line_t l;
 
     if(!macro) {
@@ -231,7 +250,7 @@ void P_RunMacros(void) {
         return;
     }
 
-    if(macrothinker) {
+    if(macrothinker || macroeffect) {
         return;
     }
 
@@ -243,6 +262,7 @@ void P_RunMacros(void) {
     }
 
     thinker = NULL;
+    effect = 0;
 
     for(currentID = m->id; m != &macro->data[macro->count]; m++) {
         if(m->id != currentID) {
@@ -257,22 +277,33 @@ void P_RunMacros(void) {
         l.tag = m->tag;
 
         thinker = thinkercap.prev;
+        effect = P_LastLightEffect();
 
         if(P_DoSpecialLine(mobjmacro, &l, 0) == -1 && macrocounter) {
             return;
         }
 
-        // Look for any new thinkers that need to be watched
-        if(thinker != thinkercap.prev) {
+        // Look for any new thinkers that need to be watched. A light
+        // effect that joined the last batch is newer than the batch.
+        if(effect != P_LastLightEffect() &&
+                thinkercap.prev->function.acp1 == (actionf_p1)T_LightBatch &&
+                ((lightbatch_t*)thinkercap.prev)->last == P_LastLightEffect()) {
+            thinker = NULL;
+            effect = P_LastLightEffect();
+        }
+        else if(thinker != thinkercap.prev) {
             thinker = thinkercap.prev;
+            effect = 0;
         }
         else {
             thinker = NULL;
+            effect = 0;
         }
     }
 
     nextmacro = m;
     macrothinker = thinker;
+    macroeffect = effect;
 
     if(m == &macro->data[macro->count]) {
         if(bTriggerOnce) {
@@ -36,6 +36,7 @@ extern int taglistidx;
 void P_QueueSpecial(mobj_t* mobj);
 
 extern thinker_t    *macrothinker;
+extern int          macroeffect;
 extern macrodef_t   *macro;
 extern macrodata_t  *nextmacro;
 extern mobj_t       *mobjmacro;
@@ -45,6 +46,7 @@ extern short        macroid;
 void P_InitMacroVars(void);
 void P_ToggleMacros(int tag, dboolean toggleon);
 void P_MacroDetachThinker(thinker_t *thinker);
+void P_MacroDetachEffect(int id);
 void P_RunMacros(void);
 
 int P_StartMacro(mobj_t *thing, line_t *line);
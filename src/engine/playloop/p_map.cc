@@ -123,12 +123,12 @@ static dboolean P_CheckThingCollision(mobj_t *thing) {
 
 //
 // P_BlockMapBox
+// Sets box to a thing's box at x, y and bbox to the blocks it covers
 //
 
 extern byte forcecollision;
 
-d_inline
-static void P_BlockMapBox(fixed_t* bbox, fixed_t x, fixed_t y, mobj_t* thing) {
+void P_BlockMapBox(fixed_t* box, fixed_t* bbox, fixed_t x, fixed_t y, fixed_t radius) {
     fixed_t extent = MAXRADIUS;
 
     if(forcecollision != 2) {
@@ -137,15 +137,15 @@ static void P_BlockMapBox(fixed_t* bbox, fixed_t x, fixed_t y, mobj_t* thing) {
         }
     }
 
-    tmbbox[BOXTOP]      = y + thing->radius;
-    tmbbox[BOXBOTTOM]   = y - thing->radius;
-    tmbbox[BOXRIGHT]    = x + thing->radius;
-    tmbbox[BOXLEFT]     = x - thing->radius;
+    box[BOXTOP]         = y + radius;
+    box[BOXBOTTOM]      = y - radius;
+    box[BOXRIGHT]       = x + radius;
+    box[BOXLEFT]        = x - radius;
 
-    bbox[BOXLEFT]       = (tmbbox[BOXLEFT] - bmaporgx - extent) >> MAPBLOCKSHIFT;
-    bbox[BOXRIGHT]      = (tmbbox[BOXRIGHT] - bmaporgx + extent) >> MAPBLOCKSHIFT;
-    bbox[BOXBOTTOM]     = (tmbbox[BOXBOTTOM] - bmaporgy - extent) >> MAPBLOCKSHIFT;
-    bbox[BOXTOP]        = (tmbbox[BOXTOP] - bmaporgy + extent) >> MAPBLOCKSHIFT;
+    bbox[BOXLEFT]       = (box[BOXLEFT] - bmaporgx - extent) >> MAPBLOCKSHIFT;
+    bbox[BOXRIGHT]      = (box[BOXRIGHT] - bmaporgx + extent) >> MAPBLOCKSHIFT;
+    bbox[BOXBOTTOM]     = (box[BOXBOTTOM] - bmaporgy - extent) >> MAPBLOCKSHIFT;
+    bbox[BOXTOP]        = (box[BOXTOP] - bmaporgy + extent) >> MAPBLOCKSHIFT;
 
     if(bbox[BOXLEFT] < 0) {
         bbox[BOXLEFT] = 0;
@@ -193,12 +193,15 @@ static void P_BlockMapBox(fixed_t* bbox, fixed_t x, fixed_t y, mobj_t* thing) {
 //
 
 dboolean PIT_CheckLine(line_t* ld) {
-    sector_t* sector;
-
-    if(tmbbox[BOXRIGHT] <= ld->bbox[BOXLEFT]
-    || tmbbox[BOXLEFT] >= ld->bbox[BOXRIGHT]
-    || tmbbox[BOXTOP] <= ld->bbox[BOXBOTTOM]
-    || tmbbox[BOXBOTTOM] >= ld->bbox[BOXTOP]) {
+    int num = ld - lines;
+    fixed_t *bbox = geolines[num].bbox;
+    int *secnum;
+    geosector_t* sector;
+
+    if(tmbbox[BOXRIGHT] <= bbox[BOXLEFT]
+    || tmbbox[BOXLEFT] >= bbox[BOXRIGHT]
+    || tmbbox[BOXTOP] <= bbox[BOXBOTTOM]
+    || tmbbox[BOXBOTTOM] >= bbox[BOXTOP]) {
         return true;
     }
 
@@ -217,7 +220,9 @@ dboolean PIT_CheckLine(line_t* ld) {
     // so two special lines that are only 8 pixels apart
     // could be crossed in either order.
 
-    if(!ld->backsector) {
+    secnum = geolinesectors[num];
+
+    if(secnum[1] == -1) {
         if(tmthing->flags & MF_MISSILE) {
             tmhitline = ld;
         }
@@ -226,29 +231,29 @@ dboolean PIT_CheckLine(line_t* ld) {
     }
 
     if(!(tmthing->flags & MF_MISSILE)) {
-        if(ld->flags & ML_BLOCKING) {
+        if(geolineflags[num] & ML_BLOCKING) {
             return false;    // explicitly blocking everything
         }
 
-        if(!tmthing->player && ld->flags & ML_BLOCKMONSTERS) {
+        if(!tmthing->player && geolineflags[num] & ML_BLOCKMONSTERS) {
             return false;    // block monsters only
         }
     }
 
     // [d64] don't cross mid-pegged lines
-    if(ld->flags & ML_DONTPEGMID) {
+    if(geolineflags[num] & ML_DONTPEGMID) {
         tmhitline = ld;
         return false;
     }
 
     // [kex] check if thing's midpoint is inside sector
-    if(tmthing->blockflag & BF_MIDPOINTONLY && ld->backsector) {
-        if(tmthing->subsector->sector != ld->backsector) {
+    if(tmthing->blockflag & BF_MIDPOINTONLY) {
+        if(tmthing->subsector->sector - sectors != secnum[1]) {
             return true;
         }
     }
 
-    sector = ld->frontsector;
+    sector = &geosectors[secnum[0]];
 
     // [d64] check for valid sector heights
     if(sector->ceilingheight == sector->floorheight) {
@@ -256,7 +261,7 @@ dboolean PIT_CheckLine(line_t* ld) {
         return false;
     }
 
-    sector = ld->backsector;
+    sector = &geosectors[secnum[1]];
 
     // [d64] check for valid sector heights
     if(sector->ceilingheight == sector->floorheight) {
@@ -415,6 +420,7 @@ dboolean P_CheckPosition(mobj_t* thing, fixed_t x, fixed_t y) {
     int             by;
     subsector_t*    newsubsec;
     fixed_t         bbox[4];
+    dboolean        planned;
 
     tmthing = thing;
     tmflags = thing->flags;
@@ -443,14 +449,16 @@ dboolean P_CheckPosition(mobj_t* thing, fixed_t x, fixed_t y) {
 
     // Check things first, possibly picking things up.
     // [d64] MAXRADIUS is not used
-    P_BlockMapBox(bbox, x, y, tmthing);
+    P_BlockMapBox(tmbbox, bbox, x, y, tmthing->radius);
 
-    for(bx = bbox[BOXLEFT]; bx <= bbox[BOXRIGHT]; bx++) {
-        for(by = bbox[BOXBOTTOM]; by <= bbox[BOXTOP]; by++) {
-            if(!P_BlockThingsIterator(bx, by, PIT_CheckThing)) {
-                return false;
-            }
-        }
+    if(!P_BoxThingsIterator(tmbbox, bbox[BOXLEFT], bbox[BOXRIGHT],
+                            bbox[BOXBOTTOM], bbox[BOXTOP], false, PIT_CheckThing)) {
+        return false;
+    }
+
+    // the lines may already have been checked on a worker thread
+    if(P_PlannedLines(thing, x, y, newsubsec, bbox, &planned)) {
+        return planned;
     }
 
     // check lines
@@ -579,8 +587,6 @@ dboolean P_PlayerMove(mobj_t* thing, fixed_t x, fixed_t y) {
 //
 
 dboolean P_TeleportMove(mobj_t* thing, fixed_t x, fixed_t y) {
-    int             bx;
-    int             by;
     subsector_t*    newsubsec;
     fixed_t         bbox[4];
 
@@ -603,15 +609,12 @@ dboolean P_TeleportMove(mobj_t* thing, fixed_t x, fixed_t y) {
     D_IncValidCount();
     numspechit = 0;
 
-    P_BlockMapBox(bbox, x, y, tmthing);
+    P_BlockMapBox(tmbbox, bbox, x, y, tmthing->radius);
 
-    for(bx = bbox[BOXLEFT]; bx <= bbox[BOXRIGHT]; bx++) {
-        for(by = bbox[BOXBOTTOM]; by <= bbox[BOXTOP]; by++) {
-            // [d64] do stomping in actual teleport function
-            if(!P_BlockThingsIterator(bx, by, PIT_CheckThing)) {
-                return false;
-            }
-        }
+    // [d64] do stomping in actual teleport function
+    if(!P_BoxThingsIterator(tmbbox, bbox[BOXLEFT], bbox[BOXRIGHT],
+                            bbox[BOXBOTTOM], bbox[BOXTOP], false, PIT_CheckThing)) {
+        return false;
     }
 
     // the move is ok,
@@ -661,6 +664,8 @@ static dboolean P_ThingHeightClip(mobj_t* thing) {
         }
     }
 
+    P_MarkMobjFrame(thing);
+
     if(thing->ceilingz - thing->floorz < thing->height) {
         return false;
     }
@@ -709,7 +714,6 @@ static dboolean PIT_CheckMobjZ(mobj_t *thing) {
 void P_ZMovement(mobj_t* mo, dboolean checkmissile);
 
 mobj_t *P_CheckOnMobj(mobj_t *thing) {
-    int    bx, by;
     subsector_t *newsubsec;
     fixed_t x;
     fixed_t y;
@@ -749,15 +753,12 @@ mobj_t *P_CheckOnMobj(mobj_t *thing) {
     // into mapblocks based on their origin point, and can overlap into adjacent
     // blocks by up to MAXRADIUS units
     //
-    P_BlockMapBox(bbox, x, y, tmthing);
+    P_BlockMapBox(tmbbox, bbox, x, y, tmthing->radius);
 
-    for(bx = bbox[BOXLEFT]; bx <= bbox[BOXRIGHT]; bx++) {
-        for(by = bbox[BOXBOTTOM]; by <= bbox[BOXTOP]; by++) {
-            if(!P_BlockThingsIterator(bx, by, PIT_CheckMobjZ)) {
-                *tmthing = oldmo;
-                return onmobj;
-            }
-        }
+    if(!P_BoxThingsIterator(tmbbox, bbox[BOXLEFT], bbox[BOXRIGHT],
+                            bbox[BOXBOTTOM], bbox[BOXTOP], false, PIT_CheckMobjZ)) {
+        *tmthing = oldmo;
+        return onmobj;
     }
 
     *tmthing = oldmo;
@@ -1394,20 +1395,17 @@ fixed_t P_AimLineAttack(mobj_t* t1, angle_t angle, fixed_t zheight, fixed_t dist
 
 
 //
-// P_LineAttack
-// If damage == 0, it is just a test trace
-// that will leave linetarget set.
+// P_SetupLineAttack
+// Sets up a shot from t1 and returns where its trace ends
 //
 
-void P_LineAttack(mobj_t* t1, angle_t angle, fixed_t distance, fixed_t slope, int damage) {
-    fixed_t x2;
-    fixed_t y2;
-
+static void P_SetupLineAttack(mobj_t* t1, angle_t angle, fixed_t distance, fixed_t slope, int damage,
+                              fixed_t* x2, fixed_t* y2) {
     angle >>= ANGLETOFINESHIFT;
     shootthing = t1;
     la_damage = damage;
-    x2 = t1->x + F2INT(distance)*finecosine[angle];
-    y2 = t1->y + F2INT(distance)*finesine[angle];
+    *x2 = t1->x + F2INT(distance)*finecosine[angle];
+    *y2 = t1->y + F2INT(distance)*finesine[angle];
     shootz = t1->z + (t1->height>>1) + 12*FRACUNIT; // [d64] changed from 8 to 12
     attackrange = distance;
     aimslope = slope;
@@ -1422,10 +1420,51 @@ void P_LineAttack(mobj_t* t1, angle_t angle, fixed_t distance, fixed_t slope, in
     laserhit_x  = t1->x;
     laserhit_y  = t1->y;
     laserhit_z  = t1->z;
+}
+
+//
+// P_LineAttack
+// If damage == 0, it is just a test trace
+// that will leave linetarget set.
+//
+
+void P_LineAttack(mobj_t* t1, angle_t angle, fixed_t distance, fixed_t slope, int damage) {
+    fixed_t x2;
+    fixed_t y2;
 
+    P_SetupLineAttack(t1, angle, distance, slope, damage, &x2, &y2);
     P_PathTraverse(t1->x, t1->y, x2, y2, PT_ADDLINES|PT_ADDTHINGS, PTR_ShootTraverse);
 }
 
+//
+// P_LineAttacks
+// A spread of shots from t1, traced together. Does what calling
+// P_LineAttack for each of them in turn does.
+//
+
+void P_LineAttacks(mobj_t* t1, int count, angle_t* angles, fixed_t distance, fixed_t* slopes, int* damages) {
+    fixed_t x2[MAXMULTIRAYS];
+    fixed_t y2[MAXMULTIRAYS];
+    fixed_t x;
+    fixed_t y;
+    int     numrays = MIN(count, MAXMULTIRAYS);
+    int     i;
+
+    for(i = 0; i < numrays; i++) {
+        angle_t an = angles[i] >> ANGLETOFINESHIFT;
+
+        x2[i] = t1->x + F2INT(distance)*finecosine[an];
+        y2[i] = t1->y + F2INT(distance)*finesine[an];
+    }
+
+    P_GatherRays(t1->x, t1->y, x2, y2, numrays, PT_ADDLINES|PT_ADDTHINGS);
+
+    for(i = 0; i < count; i++) {
+        P_SetupLineAttack(t1, angles[i], distance, slopes[i], damages[i], &x, &y);
+        P_RayTraverse(i, t1->x, t1->y, x, y, PT_ADDLINES|PT_ADDTHINGS, PTR_ShootTraverse);
+    }
+}
+
 //
 // USE LINES
 //
@@ -1619,15 +1658,13 @@ dboolean PIT_RadiusAttack(mobj_t* thing) {
 // Source is the creature that caused the explosion at spot.
 //
 void P_RadiusAttack(mobj_t* spot, mobj_t* source, int damage) {
-    int         x;
-    int         y;
-
     int         xl;
     int         xh;
     int         yl;
     int         yh;
 
     fixed_t     dist;
+    fixed_t     box[4];
 
     dist = INT2F(damage);
     yh = (spot->y + dist - bmaporgy)>>MAPBLOCKSHIFT;
@@ -1638,10 +1675,12 @@ void P_RadiusAttack(mobj_t* spot, mobj_t* source, int damage) {
     bombsource = source;
     bombdamage = damage;
 
-    for(y=yl ; y<=yh ; y++)
-        for(x=xl ; x<=xh ; x++) {
-            P_BlockThingsIterator(x, y, PIT_RadiusAttack);
-        }
+    box[BOXTOP] = spot->y + dist;
+    box[BOXBOTTOM] = spot->y - dist;
+    box[BOXRIGHT] = spot->x + dist;
+    box[BOXLEFT] = spot->x - dist;
+
+    P_BoxThingsIterator(box, xl, xh, yl, yh, true, PIT_RadiusAttack);
 }
 
 
@@ -1732,6 +1771,8 @@ dboolean P_ChangeSector(sector_t* sector, dboolean crunch) {
     int         x;
     int         y;
 
+    P_SectorChanged(sector);
+
     nofit = false;
     crushchange = crunch;
 
@@ -1740,6 +1781,12 @@ dboolean P_ChangeSector(sector_t* sector, dboolean crunch) {
         crushchange = 2;
     }
 
+    if(compatflags & COMPATF_SECTORTHINGS) {
+        // re-check heights for the things touching the moving sector
+        P_TouchingThingsIterator(sector, PIT_ChangeSector);
+        return nofit;
+    }
+
     // re-check heights for all things near the moving sector
     for(x = sector->blockbox[BOXLEFT]; x <= sector->blockbox[BOXRIGHT]; x++)
         for(y = sector->blockbox[BOXBOTTOM]; y <= sector->blockbox[BOXTOP]; y++) {
@@ -1802,6 +1849,7 @@ static dboolean PTR_ChaseCamTraverse(intercept_t* in) {
 
         tmcamera->x = x;
         tmcamera->y = y;
+        P_MoveThingGrid(tmcamera);
 
         return false; // don't go any farther
     }
@@ -1819,6 +1867,7 @@ void P_CheckChaseCamPosition(mobj_t* target, mobj_t* camera, fixed_t x, fixed_t
     if(P_PathTraverse(target->x, target->y, x, y, PT_ADDLINES, PTR_ChaseCamTraverse)) {
         camera->x = x;
         camera->y = y;
+        P_MoveThingGrid(camera);
     }
 }
 
@@ -38,6 +38,7 @@
 #include "r_local.h"
 #include "doomstat.h"
 #include "z_zone.h"
+#include "p_trace.h"
 
 
 //
@@ -63,11 +64,13 @@ P_AproxDistance
 // Returns 0 or 1
 //
 int P_PointOnLineSide(fixed_t x, fixed_t y, line_t *line) {
+    geoline_t *gl = &geolines[line - lines];
+
     return
-        !line->dx ? x <= line->v1->x ? line->dy > 0 : line->dy < 0 :
-        !line->dy ? y <= line->v1->y ? line->dx < 0 : line->dx > 0 :
-        FixedMul(y-line->v1->y, line->dx>>FRACBITS) >=
-        FixedMul(line->dy>>FRACBITS, x-line->v1->x);
+        !gl->dx ? x <= gl->x ? gl->dy > 0 : gl->dy < 0 :
+        !gl->dy ? y <= gl->y ? gl->dx < 0 : gl->dx > 0 :
+        FixedMul(y-gl->y, gl->dx>>FRACBITS) >=
+        FixedMul(gl->dy>>FRACBITS, x-gl->x);
 }
 
 
@@ -78,22 +81,23 @@ int P_PointOnLineSide(fixed_t x, fixed_t y, line_t *line) {
 // Returns side 0 or 1, -1 if box crosses the line.
 //
 int P_BoxOnLineSide(fixed_t* tmbox, line_t* ld) {
+    geoline_t *gl = &geolines[ld - lines];
     int p1;
     int p2;
 
-    switch(ld->slopetype) {
+    switch(geolineslope[ld - lines]) {
     case ST_HORIZONTAL:
-        p1 = tmbox[BOXTOP] > ld->v1->y;
-        p2 = tmbox[BOXBOTTOM] > ld->v1->y;
-        if(ld->dx < 0) {
+        p1 = tmbox[BOXTOP] > gl->y;
+        p2 = tmbox[BOXBOTTOM] > gl->y;
+        if(gl->dx < 0) {
             p1 ^= 1;
             p2 ^= 1;
         }
         break;
     case ST_VERTICAL:
-        p1 = tmbox[BOXRIGHT] < ld->v1->x;
-        p2 = tmbox[BOXLEFT] < ld->v1->x;
-        if(ld->dy < 0) {
+        p1 = tmbox[BOXRIGHT] < gl->x;
+        p2 = tmbox[BOXLEFT] < gl->x;
+        if(gl->dy < 0) {
             p1 ^= 1;
             p2 ^= 1;
         }
@@ -287,28 +291,34 @@ sector_t *openfrontsector;
 sector_t *openbacksector;
 
 void P_LineOpening(line_t *linedef) {
-    if(linedef->sidenum[1] == NO_SIDE_INDEX) {  // single sided line
+    int *secnum = geolinesectors[linedef - lines];
+    geosector_t *front;
+    geosector_t *back;
+
+    if(secnum[1] == -1) {  // single sided line
         openrange = 0;
         return;
     }
 
-    openfrontsector = linedef->frontsector;
-    openbacksector = linedef->backsector;
+    openfrontsector = &sectors[secnum[0]];
+    openbacksector = &sectors[secnum[1]];
+    front = &geosectors[secnum[0]];
+    back = &geosectors[secnum[1]];
 
-    if(openfrontsector->ceilingheight < openbacksector->ceilingheight) {
-        opentop = openfrontsector->ceilingheight;
+    if(front->ceilingheight < back->ceilingheight) {
+        opentop = front->ceilingheight;
     }
     else {
-        opentop = openbacksector->ceilingheight;
+        opentop = back->ceilingheight;
     }
 
-    if(openfrontsector->floorheight > openbacksector->floorheight) {
-        openbottom = openfrontsector->floorheight;
-        lowfloor = openbacksector->floorheight;
+    if(front->floorheight > back->floorheight) {
+        openbottom = front->floorheight;
+        lowfloor = back->floorheight;
     }
     else {
-        openbottom = openbacksector->floorheight;
-        lowfloor = openfrontsector->floorheight;
+        openbottom = back->floorheight;
+        lowfloor = front->floorheight;
     }
     openrange = opentop - openbottom;
 }
@@ -318,6 +328,16 @@ void P_LineOpening(line_t *linedef) {
 // THING POSITION SETTING
 //
 
+// changes whenever a thing is linked into or out of the blockmap
+static int blocklinkclock = 0;
+
+//
+// P_BlockLinkClock
+//
+
+int P_BlockLinkClock(void) {
+    return blocklinkclock;
+}
 
 //
 // P_UnsetThingPosition
@@ -364,7 +384,12 @@ void P_UnsetThingPosition(mobj_t* thing) {
                 blocklinks[blocky*bmapwidth+blockx] = thing->bnext;
             }
         }
+
+        P_UnlinkThingGrid(thing);
+        blocklinkclock++;
     }
+
+    P_UnlinkTouching(thing);
 }
 
 
@@ -420,12 +445,18 @@ P_SetThingPosition(mobj_t* thing) {
             }
 
             *link = thing;
+            blocklinkclock++;
+
+            P_LinkThingGrid(thing, blockx, blocky);
+            P_LinkTouching(thing);
         }
         else {
             // thing is off the map
             thing->bnext = thing->bprev = NULL;
         }
     }
+
+    P_MarkMobjFrame(thing);
 }
 
 
@@ -453,7 +484,7 @@ P_BlockLinesIterator
  int            y,
  dboolean(*func)(line_t*)) {
     int            offset;
-    short*        list;
+    int*        list;
     line_t*        ld;
 
     if(x<0
@@ -521,13 +552,45 @@ P_BlockThingsIterator
 //
 // INTERCEPT ROUTINES
 //
-intercept_t    intercepts[MAXINTERCEPTS];
-intercept_t*    intercept_p;
+#define MAXTRACEDEPTH   8
+
+// one buffer for each level of nested traces
+static interceptbuf_t tracebuffers[MAXTRACEDEPTH];
+static int tracedepth = 0;
+
+static interceptbuf_t *curintercepts;
 
 divline_t     trace;
 dboolean     earlyout;
 int        ptflags;
 
+//
+// P_PushTrace
+// For tracers that collect intercepts themselves. Returns the buffer for
+// this nesting level; traces started before P_PopTrace nest inside it.
+//
+
+interceptbuf_t *P_PushTrace(void) {
+    if(tracedepth == MAXTRACEDEPTH) {
+        I_Error("P_PushTrace: traces nested too deeply");
+    }
+
+    return &tracebuffers[tracedepth++];
+}
+
+//
+// P_PopTrace
+// Puts back the trace of the traverser outertrace was saved from
+//
+
+void P_PopTrace(divline_t *outertrace) {
+    tracedepth--;
+
+    if(tracedepth > 0) {
+        trace = *outertrace;    // still used by the outer traverser
+    }
+}
+
 //
 // PIT_AddLineIntercepts.
 // Looks for lines in the given block
@@ -577,16 +640,8 @@ PIT_AddLineIntercepts(line_t* ld) {
         return false;    // stop checking
     }
 
-    // [d64] exit out if max intercepts has been hit
-    if((intercept_p - intercepts) >= MAXINTERCEPTS) {
-        return true;
-    }
-
-
-    intercept_p->frac = frac;
-    intercept_p->isaline = true;
-    intercept_p->d.line = ld;
-    intercept_p++;
+    // [d64] stops adding once max intercepts has been hit
+    P_AddIntercept(curintercepts, frac, ld, NULL);
 
     return true;    // continue
 }
@@ -647,74 +702,13 @@ dboolean PIT_AddThingIntercepts(mobj_t* thing) {
         return true;    // behind source
     }
 
-    // [d64] exit out if max intercepts has been hit
-    if((intercept_p - intercepts) >= MAXINTERCEPTS) {
-        return true;
-    }
-
-    intercept_p->frac = frac;
-    intercept_p->isaline = false;
-    intercept_p->d.thing = thing;
-    intercept_p++;
+    // [d64] stops adding once max intercepts has been hit
+    P_AddIntercept(curintercepts, frac, NULL, thing);
 
     return true;        // keep going
 }
 
 
-//
-// P_TraverseIntercepts
-// Returns true if the traverser function returns true
-// for all lines.
-//
-dboolean
-P_TraverseIntercepts
-(traverser_t    func,
- fixed_t    maxfrac) {
-    int            count;
-    fixed_t        dist;
-    intercept_t*    scan;
-    intercept_t*    in;
-
-    count = intercept_p - intercepts;
-
-    in = 0;            // shut up compiler warning
-
-    while(count--) {
-        dist = D_MAXINT;
-        for(scan = intercepts ; scan<intercept_p ; scan++) {
-            if(scan->frac < dist) {
-                dist = scan->frac;
-                in = scan;
-            }
-        }
-
-        if(dist > maxfrac) {
-            return true;    // checked everything in range
-        }
-
-#if 0  // UNUSED
-        {
-            // don't check these yet, there may be others inserted
-            in = scan = intercepts;
-            for(scan = intercepts ; scan<intercept_p ; scan++)
-                if(scan->frac > maxfrac) {
-                    *in++ = *scan;
-                }
-            intercept_p = in;
-            return false;
-        }
-#endif
-
-        if(!func(in)) {
-            return false;    // don't bother going farther
-        }
-
-        in->frac = D_MAXINT;
-    }
-
-    return true;        // everything was traversed
-}
-
 //
 // T_TraceDrawer
 //
@@ -728,20 +722,17 @@ void T_TraceDrawer(void *data) {
 
 
 //
-// P_PathTraverse
-// Traces a line from x1,y1 to x2,y2,
-// calling the traverser function for each.
-// Returns true if the traverser function returns true
-// for all lines.
+// P_CollectIntercepts
+// Fills curintercepts with everything the line from x1,y1 to x2,y2
+// crosses. Returns false on an early out.
 //
-dboolean
-P_PathTraverse
+static dboolean
+P_CollectIntercepts
 (fixed_t        x1,
  fixed_t        y1,
  fixed_t        x2,
  fixed_t        y2,
- int            flags,
- dboolean(*trav)(intercept_t *)) {
+ int            flags) {
     fixed_t    xt1;
     fixed_t    yt1;
     fixed_t    xt2;
@@ -757,25 +748,9 @@ P_PathTraverse
     int        mapystep;
     int        count;
 
-    if(r_drawtrace) {
-        tracedrawer_t* tdrawer;
-
-        tdrawer = (tracedrawer_t*) Z_Malloc(sizeof(*tdrawer), PU_LEVSPEC, 0);
-        P_AddThinker(&tdrawer->thinker);
-        tdrawer->thinker.function.acp1 = (actionf_p1)T_TraceDrawer;
-        tdrawer->tic = gametic + 32;
-        tdrawer->x1 = x1;
-        tdrawer->x2 = x2;
-        tdrawer->y1 = y1;
-        tdrawer->y2 = y2;
-        tdrawer->z = viewz;
-        tdrawer->flags = flags;
-    }
-
     earlyout = flags & PT_EARLYOUT;
 
     D_IncValidCount();
-    intercept_p = intercepts;
 
     if(((x1-bmaporgx)&(MAPBLOCKSIZE-1)) == 0) {
         x1 += FRACUNIT;    // don't side exactly on a line
@@ -870,8 +845,73 @@ P_PathTraverse
         }
 
     }
-    // go through the sorted list
-    return P_TraverseIntercepts(trav, FRACUNIT);
+
+    return true;
+}
+
+//
+// P_PathTraverse
+// Traces a line from x1,y1 to x2,y2,
+// calling the traverser function for each.
+// Returns true if the traverser function returns true
+// for all lines.
+//
+dboolean
+P_PathTraverse
+(fixed_t        x1,
+ fixed_t        y1,
+ fixed_t        x2,
+ fixed_t        y2,
+ int            flags,
+ dboolean(*trav)(intercept_t *)) {
+    interceptbuf_t*    buf;
+    divline_t        outertrace;
+    dboolean        result;
+
+    if(r_drawtrace) {
+        tracedrawer_t* tdrawer;
+
+        tdrawer = (tracedrawer_t*) P_AllocThinker(sizeof(*tdrawer), (actionf_p1)T_TraceDrawer);
+        P_AddThinker(&tdrawer->thinker);
+        tdrawer->thinker.function.acp1 = (actionf_p1)T_TraceDrawer;
+        tdrawer->tic = gametic + 32;
+        tdrawer->x1 = x1;
+        tdrawer->x2 = x2;
+        tdrawer->y1 = y1;
+        tdrawer->y2 = y2;
+        tdrawer->z = viewz;
+        tdrawer->flags = flags;
+    }
+
+    if(p_gridtrace) {
+        return P_GridPathTraverse(x1, y1, x2, y2, flags, trav);
+    }
+
+    if(tracedepth == MAXTRACEDEPTH) {
+        I_Error("P_PathTraverse: traces nested too deeply");
+    }
+
+    // a traverser may start another trace while this one is being walked
+    buf = &tracebuffers[tracedepth];
+    outertrace = trace;
+
+    curintercepts = buf;
+    P_ClearIntercepts(buf, (compatflags & COMPATF_INTERCEPTS) ? 0 : MAXINTERCEPTS);
+
+    result = P_CollectIntercepts(x1, y1, x2, y2, flags);
+
+    if(result) {
+        // go through the sorted list
+        tracedepth++;
+        result = P_TraverseIntercepts(buf, trav, FRACUNIT);
+        tracedepth--;
+    }
+
+    if(tracedepth > 0) {
+        trace = outertrace;    // still used by the outer traverser
+    }
+
+    return result;
 }
 
 
@@ -312,6 +312,7 @@ void P_ZMovement(mobj_t* mo, dboolean checkmissile) {
 
     // adjust height
     mo->z += mo->momz;
+    P_MarkMobjFrame(mo);
 
     if(mo->flags & MF_FLOAT && mo->target) {
         // float down towards target if too close
@@ -506,6 +507,7 @@ dboolean P_OnMobjZ(mobj_t* mobj) {
                     mobj->player->viewheight -= onmo->z + onmo->height - mobj->z;
                     mobj->player->deltaviewheight = (VIEWHEIGHT - mobj->player->viewheight) >> 3;
                     mobj->z = onmo->z + onmo->height;
+                    P_MarkMobjFrame(mobj);
                     mobj->blockflag |= BF_MOBJSTAND;
                     mobj->player->onground = 1;
                     mobj->momz = 0;
@@ -589,8 +591,7 @@ mobj_t* P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type) {
     state_t*    st;
     mobjinfo_t* info;
 
-    mobj = (mobj_t*) Z_Malloc(sizeof(*mobj), PU_LEVEL, NULL);
-    dmemset(mobj, 0, sizeof(*mobj));
+    mobj = P_AllocMobj();
     info = &mobjinfo[type];
 
     mobj->type      = type;
@@ -669,7 +670,7 @@ mobj_t* P_SpawnMobj(fixed_t x, fixed_t y, fixed_t z, mobjtype_t type) {
 void P_SafeRemoveMobj(mobj_t* mobj) {
     if(!mobj->refcount) {
         P_UnlinkMobj(mobj); // unlink from mobj list
-        Z_Free(mobj);       // free block
+        P_FreeMobj(mobj);   // back to the pool
     }
 }
 
@@ -744,7 +745,7 @@ void P_SpawnPlayer(mapthing_t* mthing) {
     mobj->angle         = ANG45 * (mthing->angle/45);
     mobj->player        = p;
     mobj->health        = p->health;
-    mobj->tid           = mthing->tid;
+    P_SetMobjTID(mobj, mthing->tid);
     mobj->z             = mobj->z + INT2F(mthing->z);
 
     p->mo               = mobj;
@@ -833,7 +834,7 @@ void T_MobjFadeThinker(void *data) {
 void P_FadeMobj(mobj_t* mobj, int amount, int alpha, int flags) {
     mobjfade_t *mobjfade;
 
-    mobjfade = (mobjfade_t*) Z_Calloc(sizeof(*mobjfade), PU_LEVSPEC, 0);
+    mobjfade = (mobjfade_t*) P_AllocThinker(sizeof(*mobjfade), (actionf_p1)T_MobjFadeThinker);
     P_AddThinker(&mobjfade->thinker);
     mobjfade->thinker.function.acp1 = (actionf_p1)T_MobjFadeThinker;
     P_SetTarget(&mobjfade->mobj, mobj);
@@ -935,13 +936,7 @@ int EV_FadeOutMobj(line_t* line) {
     mobj_t* mo;
     dboolean ok = false;
 
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
-        // not matching the tid
-
-        if(mo->tid != line->tag) {
-            continue;
-        }
-
+    for(mo = P_FindMobjFromTID(line->tag, NULL); mo; mo = P_FindMobjFromTID(line->tag, mo)) {
         // don't remove teleportmans
 
         if(mo->type == MT_DEST_TELEPORT) {
@@ -1071,7 +1066,7 @@ mobj_t* P_SpawnMapThing(mapthing_t* mthing) {
     mobj = P_SpawnMobj(x, y, z, i);
     mobj->z += INT2F(mthing->z);
     mobj->spawnpoint = *mthing;
-    mobj->tid = mthing->tid;
+    P_SetMobjTID(mobj, mthing->tid);
 
     if(mobj->flags & MF_SOLID &&
             compatflags & COMPATF_MOBJPASS &&
@@ -1386,17 +1381,12 @@ void P_SpawnDartMissile(int tid, int type, mobj_t *target) {
     mobj_t* mo;
     mobj_t* th;
 
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
+    for(mo = P_FindMobjFromTID(tid, NULL); mo; mo = P_FindMobjFromTID(tid, mo)) {
         // not a dart projector
         if(mo->type != MT_DEST_PROJECTILE) {
             continue;
         }
 
-        // not matching the tid
-        if(mo->tid != tid) {
-            continue;
-        }
-
         if(type == MT_PROJ_TRACER) {
             th = P_SpawnMissile(mo, target, type,
                                 FixedMul(mo->radius, dcos(mo->angle)),
@@ -1405,6 +1395,7 @@ void P_SpawnDartMissile(int tid, int type, mobj_t *target) {
 
             th->x = (th->x + th->momx);
             th->y = (th->y + th->momy);
+            P_MoveThingGrid(th);
             P_SetTarget(&th->tracer, target);
         }
         else {
@@ -155,31 +155,31 @@ enum {
 struct mobj_s;
 typedef void (*mobjfunc_t)(struct mobj_s *mo);
 
+//
+// The fields of mobj_t are ordered by how often they are touched. The
+// first part is read or written by P_RunMobjs, P_MobjThinker, P_ScanSights
+// and the movement code every tic, and is kept together so that walking
+// the mobj list pulls in as few cache lines as possible. Everything after
+// it is used by the renderer, savegames or only on rare occasions.
+//
+// x, y and z must stay first: sector sound origins (degenmobj_t) are
+// passed around as mobj_t pointers.
+//
+
 typedef struct mobj_s {
+    //
+    // Hot: touched every tic
+    //
+
     // Info for drawing: position.
     fixed_t             x;
     fixed_t             y;
     fixed_t             z;
 
-    // [d64] mobj tag
-    int                 tid;
-
-    // More list: links in sector (if needed)
-    struct mobj_s*      snext;
-    struct mobj_s*      sprev;
-
-    //More drawing info: to determine current sprite.
-    angle_t             angle;    // orientation
-    angle_t             pitch;  // [kex] pitch orientation; for looking up/down
-    spritenum_t         sprite;    // used to find patch_t and flip value
-    int                 frame;    // might be ORed with FF_FULLBRIGHT
-
-    // Interaction info, by BLOCKMAP.
-    // Links in blocks (if needed).
-    struct mobj_s*      bnext;
-    struct mobj_s*      bprev;
-
-    struct subsector_s* subsector;
+    // Momentums, used to update position.
+    fixed_t             momx;
+    fixed_t             momy;
+    fixed_t             momz;
 
     // The closest interval over all contacted Sectors.
     fixed_t             floorz;
@@ -189,36 +189,49 @@ typedef struct mobj_s {
     fixed_t             radius;
     fixed_t             height;
 
-    // Momentums, used to update position.
-    fixed_t             momx;
-    fixed_t             momy;
-    fixed_t             momz;
-
-    // If == validcount, already checked.
-    int                 validcount;
+    dword               flags;
 
-    mobjtype_t          type;
-    mobjinfo_t*         info;    // &mobjinfo[mobj->type]
+    // [kex] flags for mobj collision
+    mobjblockflag_t     blockflag;
 
     int                 tics;    // state tic counter
     state_t*            state;
-    dword               flags;
+
+    mobjtype_t          type;
     int                 health;
+    mobjinfo_t*         info;    // &mobjinfo[mobj->type]
 
-    // [d64] alpha value for rendering
-    int                 alpha;
+    struct subsector_s* subsector;
 
-    // [kex] flags for mobj collision
-    mobjblockflag_t     blockflag;
+    // [d64] Mobj linked list: used to seperate from thinkers
+    struct mobj_s*      prev;
+    struct mobj_s*      next;
 
-    // Movement direction, movement generation (zig-zagging).
-    int                 movedir;    // 0-7
-    int                 movecount;    // when 0, select a new dir
+    // [d64] callback routine called at end of P_Tick
+    mobjfunc_t          mobjfunc;
+
+    // Additional info record for player avatars only.
+    // Only valid if type == MT_PLAYER
+    struct player_s*    player;
 
     // Thing being chased/attacked (or NULL),
     // also the originator for missiles.
     struct mobj_s*      target;
 
+    // Interaction info, by BLOCKMAP.
+    // Links in blocks (if needed).
+    struct mobj_s*      bnext;
+    struct mobj_s*      bprev;
+
+    // If == validcount, already checked.
+    int                 validcount;
+
+    angle_t             angle;    // orientation
+
+    // Movement direction, movement generation (zig-zagging).
+    int                 movedir;    // 0-7
+    int                 movecount;    // when 0, select a new dir
+
     // Reaction time: if non 0, don't attack yet.
     // Used by player to freeze a bit after teleporting.
     int                 reactiontime;
@@ -227,22 +240,32 @@ typedef struct mobj_s {
     // no matter what (even if shot)
     int                 threshold;
 
-    // Additional info record for player avatars only.
-    // Only valid if type == MT_PLAYER
-    struct player_s*    player;
+    //
+    // Cold: rendering, savegames and rarely used state
+    //
 
-    // For nightmare respawn.
-    mapthing_t          spawnpoint;
+    // [d64] mobj tag
+    int                 tid;
 
-    // Thing being chased/attacked for tracers.
-    struct mobj_s*      tracer;
+    // chain of mobjs with a tid of the same hash; see P_FindMobjFromTID
+    struct mobj_s*      tidnext;
+    struct mobj_s*      tidprev;
+    unsigned int        tidorder;   // mobj list order
 
-    // [d64] Mobj linked list: used to seperate from thinkers
-    struct mobj_s*      prev;
-    struct mobj_s*      next;
+    // More list: links in sector (if needed)
+    struct mobj_s*      snext;
+    struct mobj_s*      sprev;
 
-    // [d64] callback routine called at end of P_Tick
-    mobjfunc_t          mobjfunc;
+    //More drawing info: to determine current sprite.
+    angle_t             pitch;  // [kex] pitch orientation; for looking up/down
+    spritenum_t         sprite;    // used to find patch_t and flip value
+    int                 frame;    // might be ORed with FF_FULLBRIGHT
+
+    // [d64] alpha value for rendering
+    int                 alpha;
+
+    // Thing being chased/attacked for tracers.
+    struct mobj_s*      tracer;
 
     // [d64] misc data for various actions
     void*               extradata;
@@ -255,6 +278,12 @@ typedef struct mobj_s {
     // [kex] mobj reference id
     unsigned int        refcount;
 
+    // slot in the mobj pool; see P_MobjFromIndex
+    int                 index;
+
+    // For nightmare respawn.
+    mapthing_t          spawnpoint;
+
 } mobj_t;
 
 #endif
@@ -0,0 +1,587 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Move planning. Most of a monster's step is spent walking the blockmap
+//    for the lines its box touches, and what that finds only depends on
+//    where the step goes and on the map, not on the other mobjs. So before
+//    the mobjs run, the steps that monsters about to chase are likely to
+//    try are checked against the lines on worker threads.
+//
+//    P_CheckPosition still checks things itself, in mobj order, and takes
+//    the lines from a plan only if nothing the plan read has changed since:
+//    the same box, the same sector heights and the same line flags. The
+//    special lines crossed are picked out when the plan is used, so the
+//    outcome is exactly what checking the lines then would have given.
+//
+//-----------------------------------------------------------------------------
+
+#include <imp/Property>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "m_misc.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "p_local.h"
+#include "r_local.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+BoolProperty p_parallelmoves("p_parallelmoves", "Check monster steps against lines on worker threads", false);
+
+#define MOVEPLANLINES       16      // two sided lines a plan may cross
+#define MAXMOVECONTEXTS     64
+
+extern fixed_t  tmdropoffz;
+extern fixed_t  xspeed[8];
+extern fixed_t  yspeed[8];
+
+void A_Chase(mobj_t* actor);
+void P_RunMobjs(void);
+
+typedef struct {
+    int         slot;           // mobj index
+    fixed_t     x;
+    fixed_t     y;
+    fixed_t     radius;
+    fixed_t     box[4];
+    fixed_t     bbox[4];        // blocks covered
+    int         midsector;      // -1 unless BF_MIDPOINTONLY
+
+    // filled in by P_PlanJob
+    dboolean    usable;
+    dboolean    result;
+    fixed_t     basefloor;
+    fixed_t     baseceiling;
+    fixed_t     floorz;
+    fixed_t     ceilingz;
+    fixed_t     dropoffz;
+    int         hitline;        // -1 for none
+    int         numcrossed;
+    int         crossed[MOVEPLANLINES];
+} moveplan_t;
+
+typedef struct {
+    int     first;
+    int     count;
+} moveslot_t;
+
+typedef struct {
+    int     validcount;
+    int     *linevalid;     // per-line validcount; freed with the level
+} movecontext_t;
+
+static movecontext_t    movecontexts[MAXMOVECONTEXTS];
+
+static moveplan_t       *moveplans = NULL;
+static int              nummoveplans = 0;
+static int              maxmoveplans = 0;
+static moveslot_t       *moveslots = NULL;  // by mobj index
+static int              nummoveslots = 0;
+static dboolean         moveplanning = false;
+static int              moveplanclock[2];   // sectors, lines
+
+static int              movestattics = 0;
+static int              movestatcounts[3];  // planned, used, checked without one
+
+//
+// P_PlanLine
+// PIT_CheckLine for a monster that isn't a missile
+//
+
+static dboolean P_PlanLine(moveplan_t *plan, line_t *ld) {
+    int num = ld - lines;
+    fixed_t *bbox = geolines[num].bbox;
+    int *secnum;
+    geosector_t *front;
+    geosector_t *back;
+    fixed_t top;
+    fixed_t bottom;
+    fixed_t low;
+
+    if(plan->box[BOXRIGHT] <= bbox[BOXLEFT]
+    || plan->box[BOXLEFT] >= bbox[BOXRIGHT]
+    || plan->box[BOXTOP] <= bbox[BOXBOTTOM]
+    || plan->box[BOXBOTTOM] >= bbox[BOXTOP]) {
+        return true;
+    }
+
+    if(P_BoxOnLineSide(plan->box, ld) != -1) {
+        return true;
+    }
+
+    secnum = geolinesectors[num];
+
+    if(secnum[1] == -1) {
+        return false;           // one sided line
+    }
+
+    if(geolineflags[num] & (ML_BLOCKING|ML_BLOCKMONSTERS)) {
+        return false;
+    }
+
+    if(geolineflags[num] & ML_DONTPEGMID) {
+        plan->hitline = num;
+        return false;
+    }
+
+    if(plan->midsector != -1 && plan->midsector != secnum[1]) {
+        return true;
+    }
+
+    front = &geosectors[secnum[0]];
+    back = &geosectors[secnum[1]];
+
+    if(front->ceilingheight == front->floorheight ||
+            back->ceilingheight == back->floorheight) {
+        plan->hitline = num;
+        return false;
+    }
+
+    // what P_LineOpening gives
+    top = (front->ceilingheight < back->ceilingheight) ? front->ceilingheight : back->ceilingheight;
+
+    if(front->floorheight > back->floorheight) {
+        bottom = front->floorheight;
+        low = back->floorheight;
+    }
+    else {
+        bottom = back->floorheight;
+        low = front->floorheight;
+    }
+
+    if(top < plan->ceilingz) {
+        plan->ceilingz = top;
+        plan->hitline = num;
+    }
+
+    if(bottom > plan->floorz) {
+        plan->floorz = bottom;
+    }
+
+    if(low < plan->dropoffz) {
+        plan->dropoffz = low;
+    }
+
+    if(plan->numcrossed == MOVEPLANLINES) {
+        plan->usable = false;
+        return false;
+    }
+
+    plan->crossed[plan->numcrossed++] = num;
+    return true;
+}
+
+//
+// P_PlanBlockLines
+// P_BlockLinesIterator with the context's own line marks
+//
+
+static dboolean P_PlanBlockLines(moveplan_t *plan, movecontext_t *mc, int x, int y) {
+    int *list;
+
+    if(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight) {
+        return true;
+    }
+
+    for(list = blockmaplump + blockmap[y * bmapwidth + x]; *list != -1; list++) {
+        if(*list >= numlines) {
+            // leave it to P_BlockLinesIterator to complain
+            plan->usable = false;
+            return false;
+        }
+
+        if(mc->linevalid[*list] == mc->validcount) {
+            continue;
+        }
+
+        mc->linevalid[*list] = mc->validcount;
+
+        if(!P_PlanLine(plan, &lines[*list])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//
+// P_PlanJob
+//
+
+static void P_PlanJob(int index, int worker, void *data) {
+    moveplan_t *plan = &((moveplan_t*)data)[index];
+    movecontext_t *mc = &movecontexts[worker];
+    sector_t *sec = R_PointInSubsector(plan->x, plan->y)->sector;
+    int bx;
+    int by;
+
+    plan->basefloor = plan->floorz = plan->dropoffz = sec->floorheight;
+    plan->baseceiling = plan->ceilingz = sec->ceilingheight;
+    plan->hitline = -1;
+    plan->numcrossed = 0;
+    plan->usable = true;
+    plan->result = true;
+
+    mc->validcount++;
+
+    for(bx = plan->bbox[BOXLEFT]; bx <= plan->bbox[BOXRIGHT]; bx++) {
+        for(by = plan->bbox[BOXBOTTOM]; by <= plan->bbox[BOXTOP]; by++) {
+            if(!P_PlanBlockLines(plan, mc, bx, by)) {
+                plan->result = false;
+                return;
+            }
+        }
+    }
+}
+
+//
+// P_AddMovePlan
+// Plans a step in one direction
+//
+
+static void P_AddMovePlan(mobj_t *mobj, int dir) {
+    moveplan_t *plan;
+
+    if(nummoveplans == maxmoveplans) {
+        maxmoveplans = maxmoveplans ? maxmoveplans * 2 : 512;
+        moveplans = (moveplan_t*)Z_Realloc(moveplans,
+                    maxmoveplans * sizeof(moveplan_t), PU_STATIC, NULL);
+    }
+
+    plan = &moveplans[nummoveplans++];
+    plan->slot = mobj->index;
+    plan->x = mobj->x + mobj->info->speed * xspeed[dir];
+    plan->y = mobj->y + mobj->info->speed * yspeed[dir];
+    plan->radius = mobj->radius;
+    plan->midsector = (mobj->blockflag & BF_MIDPOINTONLY) ? mobj->subsector->sector - sectors : -1;
+
+    P_BlockMapBox(plan->box, plan->bbox, plan->x, plan->y, plan->radius);
+}
+
+//
+// P_ScanMoves
+// Plans the steps of the monsters that will chase this tic. Like
+// P_ScanSights it runs between the thinkers and the mobjs, so the planes
+// have already moved for the tic. A monster that keeps going plans one
+// step; one about to pick a new direction plans all eight.
+//
+
+void P_ScanMoves(void) {
+    mobj_t *mobj;
+    moveslot_t *slot;
+    int numworkers;
+    int dir;
+    int i;
+
+    if(!p_parallelmoves) {
+        return;
+    }
+
+    numworkers = I_NumWorkers();
+
+    if(numworkers > MAXMOVECONTEXTS) {
+        static dboolean warned = false;
+
+        // each worker needs its own line marks
+        if(!warned) {
+            CON_Warnf("P_ScanMoves: %i workers but only %i move contexts, not planning steps\n",
+                      numworkers, MAXMOVECONTEXTS);
+            warned = true;
+        }
+
+        return;
+    }
+
+    if(numworkers <= 1) {
+        return;
+    }
+
+    if(nummoveslots < P_MobjPoolSize()) {
+        moveslots = (moveslot_t*)Z_Realloc(moveslots,
+                    P_MobjPoolSize() * sizeof(moveslot_t), PU_STATIC, NULL);
+        dmemset(moveslots + nummoveslots, 0, (P_MobjPoolSize() - nummoveslots) * sizeof(moveslot_t));
+        nummoveslots = P_MobjPoolSize();
+    }
+
+    for(mobj = mobjhead.next; mobj != &mobjhead; mobj = mobj->next) {
+        if(!(mobj->flags & MF_COUNTKILL) || mobj->player) {
+            continue;
+        }
+
+        // about to enter a chase state
+        if(mobj->tics != 1 || !mobj->state || !mobj->target) {
+            continue;
+        }
+
+        if(states[mobj->state->nextstate].action.acp1 != (actionf_p1)A_Chase) {
+            continue;
+        }
+
+        if(mobj->flags & (MF_MISSILE|MF_NOCLIP)) {
+            continue;
+        }
+
+        // P_Move won't step
+        if(mobj->flags & MF_GRAVITY && mobj->floorz != mobj->z) {
+            continue;
+        }
+
+        if(mobj->index >= nummoveslots) {
+            continue;
+        }
+
+        slot = &moveslots[mobj->index];
+        slot->first = nummoveplans;
+
+        if(mobj->movecount > 0 && mobj->movedir < 8) {
+            P_AddMovePlan(mobj, mobj->movedir);
+        }
+        else {
+            for(dir = 0; dir < 8; dir++) {
+                P_AddMovePlan(mobj, dir);
+            }
+        }
+
+        slot->count = nummoveplans - slot->first;
+    }
+
+    movestattics++;
+
+    if(!nummoveplans) {
+        return;
+    }
+
+    for(i = 0; i < numworkers; i++) {
+        if(movecontexts[i].linevalid == NULL) {
+            // owner is cleared when PU_LEVEL is freed
+            Z_Calloc(numlines * sizeof(int), PU_LEVEL, &movecontexts[i].linevalid);
+            movecontexts[i].validcount = 0;
+        }
+    }
+
+    I_ParallelFor(nummoveplans, P_PlanJob, moveplans);
+
+    moveplanclock[0] = P_SectorChangeClock();
+    moveplanclock[1] = P_LineChangeClock();
+    moveplanning = true;
+
+    movestatcounts[0] += nummoveplans;
+}
+
+//
+// P_DropMovePlans
+// Called once the mobjs have run
+//
+
+void P_DropMovePlans(void) {
+    int i;
+
+    for(i = 0; i < nummoveplans; i++) {
+        moveslots[moveplans[i].slot].count = 0;
+    }
+
+    nummoveplans = 0;
+    moveplanning = false;
+}
+
+//
+// P_MovePlanValid
+// Checks that a plan saw what P_CheckPosition would see now
+//
+
+static dboolean P_MovePlanValid(moveplan_t *plan, mobj_t *thing, subsector_t *newsubsec, fixed_t *bbox) {
+    int midsector;
+
+    if(!plan->usable || plan->radius != thing->radius) {
+        return false;
+    }
+
+    if(thing->player || thing->flags & MF_MISSILE) {
+        return false;
+    }
+
+    midsector = (thing->blockflag & BF_MIDPOINTONLY) ? thing->subsector->sector - sectors : -1;
+
+    if(plan->midsector != midsector) {
+        return false;
+    }
+
+    if(plan->bbox[BOXLEFT] != bbox[BOXLEFT] || plan->bbox[BOXRIGHT] != bbox[BOXRIGHT] ||
+            plan->bbox[BOXBOTTOM] != bbox[BOXBOTTOM] || plan->bbox[BOXTOP] != bbox[BOXTOP]) {
+        return false;
+    }
+
+    if(plan->basefloor != newsubsec->sector->floorheight ||
+            plan->baseceiling != newsubsec->sector->ceilingheight) {
+        return false;
+    }
+
+    return (moveplanclock[0] == P_SectorChangeClock() &&
+            moveplanclock[1] == P_LineChangeClock());
+}
+
+//
+// P_PlannedLines
+// Called by P_CheckPosition once the things are checked. If there is a
+// plan for the step, sets what checking the lines would have and returns
+// true with the result.
+//
+
+dboolean P_PlannedLines(mobj_t *thing, fixed_t x, fixed_t y, subsector_t *newsubsec,
+                        fixed_t *bbox, dboolean *result) {
+    moveslot_t *slot;
+    moveplan_t *plan;
+    line_t *ld;
+    int i;
+
+    if(!moveplanning || thing->index >= nummoveslots) {
+        return false;
+    }
+
+    slot = &moveslots[thing->index];
+
+    if(!slot->count) {
+        return false;
+    }
+
+    for(i = 0, plan = &moveplans[slot->first]; i < slot->count; i++, plan++) {
+        if(plan->x == x && plan->y == y) {
+            break;
+        }
+    }
+
+    if(i == slot->count || !P_MovePlanValid(plan, thing, newsubsec, bbox)) {
+        movestatcounts[2]++;
+        return false;
+    }
+
+    tmfloorz = plan->floorz;
+    tmceilingz = plan->ceilingz;
+    tmdropoffz = plan->dropoffz;
+    tmhitline = (plan->hitline == -1) ? NULL : &lines[plan->hitline];
+
+    // specials can change at any time, so they are picked out now;
+    // a plan never crosses more lines than spechit holds
+    for(i = 0; i < plan->numcrossed; i++) {
+        ld = &lines[plan->crossed[i]];
+
+        if(ld->special & MLU_CROSS) {
+            spechit[numspechit++] = ld;
+        }
+    }
+
+    // leave the opening as the last line checked did
+    if(plan->numcrossed) {
+        P_LineOpening(&lines[plan->crossed[plan->numcrossed - 1]]);
+    }
+
+    movestatcounts[1]++;
+    *result = plan->result;
+    return true;
+}
+
+//
+// CMD_MoveStats
+// Monster steps planned since the last time it was asked
+//
+
+static CMD(MoveStats) {
+    if(!movestattics) {
+        CON_Printf(WHITE, "No steps planned (p_parallelmoves is %s)\n", p_parallelmoves ? "on" : "off");
+        return;
+    }
+
+    CON_Printf(WHITE, "%i tics: %i steps planned per tic, %i used, %i checked without a plan\n",
+               movestattics, movestatcounts[0] / movestattics, movestatcounts[1], movestatcounts[2]);
+
+    movestattics = 0;
+    movestatcounts[0] = movestatcounts[1] = movestatcounts[2] = 0;
+}
+
+//
+// CMD_MoveBench
+// Spawns a crowd of monsters chasing the player and times the mobjs
+// running for a second of tics, once checking every step as it is
+// taken and once with the steps planned on the worker threads
+//
+
+#define BENCHTICS       35
+
+static CMD(MoveBench) {
+    mobj_t **things;
+    dboolean oldparallel = p_parallelmoves;
+    fixed_t box[4];
+    int count;
+    int planned[2];
+    int time[2];
+    int i;
+    int j;
+    int t;
+
+    count = param[0] ? datoi(param[0]) : 5000;
+
+    for(j = 0; j < 2; j++) {
+        // the same crowd both times
+        if(!(things = P_SpawnBenchCrowd(count, box))) {
+            p_parallelmoves = oldparallel;
+            return;
+        }
+
+        for(i = 0; i < count; i++) {
+            P_SetTarget(&things[i]->target, players[consoleplayer].mo);
+            P_SetMobjState(things[i], things[i]->info->seestate);
+        }
+
+        p_parallelmoves = j;
+        planned[j] = movestatcounts[0];
+        time[j] = I_GetTimeMS();
+
+        for(t = 0; t < BENCHTICS; t++) {
+            P_ScanMoves();
+            P_RunMobjs();
+            P_DropMovePlans();
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+        planned[j] = movestatcounts[0] - planned[j];
+
+        P_RemoveBenchCrowd(things, count);
+    }
+
+    p_parallelmoves = oldparallel;
+
+    CON_Printf(WHITE, "%i monsters, %i tics: serial %ims, %i workers %ims\n",
+               count, BENCHTICS, time[0], I_NumWorkers(), time[1]);
+    CON_Printf(WHITE, "%i steps planned per tic\n", planned[1] / BENCHTICS);
+}
+
+//
+// P_InitMovePlans
+//
+
+void P_InitMovePlans(void) {
+    P_AddWorldState(movecontexts, sizeof(movecontexts));
+
+    G_AddCommand("movestats", CMD_MoveStats, 0);
+    G_AddCommand("movebench", CMD_MoveBench, 0);
+}
@@ -0,0 +1,634 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Multi-ray traces. A spread of pellets from one point crosses much
+//    the same blocks, so the blocks under all the rays are gathered once
+//    with their lines and things copied into flat lists. Each ray then
+//    takes its intercepts from those lists the way P_PathTraverse would:
+//    its own blocks in the same order, each block's lines in blockmap
+//    order and then its things in link order. Every ray gets the same
+//    intercepts in the same order, and under the same limit, as a trace
+//    of its own.
+//
+//    A ray's traverser can link things into or out of the blockmap, by
+//    a kill dropping an item for one. The things are gathered again before
+//    the next ray when that happens.
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "m_fixed.h"
+#include "p_local.h"
+#include "p_trace.h"
+#include "r_local.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+BoolProperty p_multitrace("p_multitrace", "Trace pellet spreads together", false);
+
+#define MAXRAYBLOCKS    64      // P_PathTraverse gives up after as many steps
+
+typedef struct {
+    fixed_t     x2;
+    fixed_t     y2;
+    int         firstblock;     // into rayblocks
+    int         numblocks;
+} multiray_t;
+
+typedef struct {
+    int         block;          // in the blockmap
+    int         firstline;      // into blocklines
+    int         numlines;
+    int         firstthing;     // into blockthings
+    int         numthings;
+} multiblock_t;
+
+typedef struct {
+    line_t      *line;
+    divline_t   dl;
+    fixed_t     x2;
+    fixed_t     y2;
+    int         valid;          // last ray to check it
+} multiline_t;
+
+static dboolean     gathered = false;
+static fixed_t      rayx;           // as given
+static fixed_t      rayy;
+static fixed_t      tracex;         // moved off block edges
+static fixed_t      tracey;
+static int          rayflags;
+static int          thingclock;
+static int          raystamp = 0;
+static int          raydepth = 0;       // rays being traversed
+
+static multiray_t   rays[MAXMULTIRAYS];
+static int          numrays = 0;
+
+static int          *rayblocks = NULL;
+static int          numrayblocks = 0;
+static int          maxrayblocks = 0;
+static multiblock_t *blocks = NULL;
+static int          numblocks = 0;
+static int          maxblocks = 0;
+static int          *blocklines = NULL;
+static int          numblocklines = 0;
+static int          maxblocklines = 0;
+static multiline_t  *multilines = NULL;
+static int          nummultilines = 0;
+static int          maxmultilines = 0;
+static mobj_t       **blockthings = NULL;
+static int          numblockthings = 0;
+static int          maxblockthings = 0;
+
+// per block and per line: the gather that last took it, and where to
+static int          *blockgather = NULL;
+static int          *blockslot = NULL;
+static int          *linegather = NULL;
+static int          *lineslot = NULL;
+static int          gathercount = 0;
+
+//
+// P_GrowMulti
+// Makes room for one more item in a list
+//
+
+static void *P_GrowMulti(void *list, int count, int *max, int size) {
+    if(count < *max) {
+        return list;
+    }
+
+    *max = MAX(*max * 2, 64);
+    return Z_Realloc(list, *max * size, PU_STATIC, 0);
+}
+
+//
+// P_GatherLine
+//
+
+static int P_GatherLine(int l) {
+    multiline_t *ml;
+    line_t *ld;
+
+    if(linegather[l] == gathercount) {
+        return lineslot[l];
+    }
+
+    multilines = (multiline_t*)P_GrowMulti(multilines, nummultilines, &maxmultilines, sizeof(multiline_t));
+
+    ld = &lines[l];
+    ml = &multilines[nummultilines];
+    ml->line = ld;
+    P_MakeDivline(ld, &ml->dl);
+    ml->x2 = ld->v2->x;
+    ml->y2 = ld->v2->y;
+    ml->valid = 0;
+
+    linegather[l] = gathercount;
+    lineslot[l] = nummultilines;
+
+    return nummultilines++;
+}
+
+//
+// P_GatherBlock
+//
+
+static int P_GatherBlock(int block) {
+    multiblock_t *mb;
+    int *list;
+
+    if(blockgather[block] == gathercount) {
+        return blockslot[block];
+    }
+
+    blocks = (multiblock_t*)P_GrowMulti(blocks, numblocks, &maxblocks, sizeof(multiblock_t));
+
+    mb = &blocks[numblocks];
+    mb->block = block;
+    mb->firstline = numblocklines;
+    mb->firstthing = 0;
+    mb->numthings = 0;
+
+    for(list = blockmaplump + blockmap[block]; *list != -1; list++) {
+        if(*list >= numlines) {
+            I_Error("P_GatherBlock: Linedef out of range");
+        }
+
+        blocklines = (int*)P_GrowMulti(blocklines, numblocklines, &maxblocklines, sizeof(int));
+        blocklines[numblocklines++] = P_GatherLine(*list);
+    }
+
+    mb = &blocks[numblocks];
+    mb->numlines = numblocklines - mb->firstline;
+
+    blockgather[block] = gathercount;
+    blockslot[block] = numblocks;
+
+    return numblocks++;
+}
+
+//
+// P_GatherThings
+// Copies the blockmap links of the gathered blocks
+//
+
+static void P_GatherThings(void) {
+    mobj_t *mo;
+    int i;
+
+    numblockthings = 0;
+
+    for(i = 0; i < numblocks; i++) {
+        blocks[i].firstthing = numblockthings;
+
+        for(mo = blocklinks[blocks[i].block]; mo; mo = mo->bnext) {
+            blockthings = (mobj_t**)P_GrowMulti(blockthings, numblockthings, &maxblockthings, sizeof(mobj_t*));
+            blockthings[numblockthings++] = mo;
+        }
+
+        blocks[i].numthings = numblockthings - blocks[i].firstthing;
+    }
+
+    thingclock = P_BlockLinkClock();
+}
+
+//
+// P_GatherRay
+// Lists the blocks P_CollectIntercepts would step through
+//
+
+static void P_GatherRay(multiray_t *ray) {
+    fixed_t    x1 = tracex - bmaporgx;
+    fixed_t    y1 = tracey - bmaporgy;
+    fixed_t    x2 = ray->x2 - bmaporgx;
+    fixed_t    y2 = ray->y2 - bmaporgy;
+    int        xt1 = x1>>MAPBLOCKSHIFT;
+    int        yt1 = y1>>MAPBLOCKSHIFT;
+    int        xt2 = x2>>MAPBLOCKSHIFT;
+    int        yt2 = y2>>MAPBLOCKSHIFT;
+    fixed_t    xstep;
+    fixed_t    ystep;
+    fixed_t    partial;
+    fixed_t    xintercept;
+    fixed_t    yintercept;
+    int        mapx;
+    int        mapy;
+    int        mapxstep;
+    int        mapystep;
+    int        count;
+
+    if(xt2 > xt1) {
+        mapxstep = 1;
+        partial = FRACUNIT - ((x1>>MAPBTOFRAC)&(FRACUNIT-1));
+        ystep = FixedDiv(y2-y1,D_abs(x2-x1));
+    }
+    else if(xt2 < xt1) {
+        mapxstep = -1;
+        partial = (x1>>MAPBTOFRAC)&(FRACUNIT-1);
+        ystep = FixedDiv(y2-y1,D_abs(x2-x1));
+    }
+    else {
+        mapxstep = 0;
+        partial = FRACUNIT;
+        ystep = 256*FRACUNIT;
+    }
+
+    yintercept = (y1>>MAPBTOFRAC) + FixedMul(partial, ystep);
+
+    if(yt2 > yt1) {
+        mapystep = 1;
+        partial = FRACUNIT - ((y1>>MAPBTOFRAC)&(FRACUNIT-1));
+        xstep = FixedDiv(x2-x1,D_abs(y2-y1));
+    }
+    else if(yt2 < yt1) {
+        mapystep = -1;
+        partial = (y1>>MAPBTOFRAC)&(FRACUNIT-1);
+        xstep = FixedDiv(x2-x1,D_abs(y2-y1));
+    }
+    else {
+        mapystep = 0;
+        partial = FRACUNIT;
+        xstep = 256*FRACUNIT;
+    }
+
+    xintercept = (x1>>MAPBTOFRAC) + FixedMul(partial, xstep);
+
+    ray->firstblock = numrayblocks;
+
+    // the same walk, blocks it stays in more than once included
+    mapx = xt1;
+    mapy = yt1;
+
+    for(count = 0; count < MAXRAYBLOCKS; count++) {
+        if(mapx >= 0 && mapy >= 0 && mapx < bmapwidth && mapy < bmapheight) {
+            int slot = P_GatherBlock(mapy*bmapwidth+mapx);
+
+            rayblocks = (int*)P_GrowMulti(rayblocks, numrayblocks, &maxrayblocks, sizeof(int));
+            rayblocks[numrayblocks++] = slot;
+        }
+
+        if(mapx == xt2 && mapy == yt2) {
+            break;
+        }
+
+        if(F2INT(yintercept) == mapy) {
+            yintercept += ystep;
+            mapx += mapxstep;
+        }
+        else if(F2INT(xintercept) == mapx) {
+            xintercept += xstep;
+            mapy += mapystep;
+        }
+    }
+
+    ray->numblocks = numrayblocks - ray->firstblock;
+}
+
+//
+// P_GatherRays
+// Gathers what the rays from x1,y1 to each x2,y2 can cross, for
+// P_RayTraverse with the same PT_ flags. Takes up to MAXMULTIRAYS.
+//
+
+void P_GatherRays(fixed_t x1, fixed_t y1, fixed_t *x2, fixed_t *y2, int count, int flags) {
+    int i;
+
+    // a traverser shooting again goes its own way, as do those
+    if(raydepth > 0 || !p_multitrace || p_gridtrace || r_drawtrace) {
+        return;
+    }
+
+    gathered = false;
+
+    if(blockgather == NULL) {
+        // owners are cleared when PU_LEVEL is freed
+        Z_Calloc(MAX(bmapwidth * bmapheight, 1) * sizeof(int), PU_LEVEL, &blockgather);
+        Z_Malloc(MAX(bmapwidth * bmapheight, 1) * sizeof(int), PU_LEVEL, &blockslot);
+        Z_Calloc(MAX(numlines, 1) * sizeof(int), PU_LEVEL, &linegather);
+        Z_Malloc(MAX(numlines, 1) * sizeof(int), PU_LEVEL, &lineslot);
+        gathercount = 0;
+    }
+
+    gathercount++;
+
+    rayx = x1;
+    rayy = y1;
+    rayflags = flags;
+
+    // don't side exactly on a line, as P_CollectIntercepts
+    if(((x1-bmaporgx)&(MAPBLOCKSIZE-1)) == 0) {
+        x1 += FRACUNIT;
+    }
+
+    if(((y1-bmaporgy)&(MAPBLOCKSIZE-1)) == 0) {
+        y1 += FRACUNIT;
+    }
+
+    tracex = x1;
+    tracey = y1;
+
+    numrays = MIN(count, MAXMULTIRAYS);
+    numrayblocks = 0;
+    numblocks = 0;
+    numblocklines = 0;
+    nummultilines = 0;
+
+    for(i = 0; i < numrays; i++) {
+        rays[i].x2 = x2[i];
+        rays[i].y2 = y2[i];
+        P_GatherRay(&rays[i]);
+    }
+
+    if(flags & PT_ADDTHINGS) {
+        P_GatherThings();
+    }
+
+    gathered = true;
+}
+
+//
+// P_CollectRay
+// The intercepts of a ray, as P_CollectIntercepts would add them to buf.
+// Returns false on an early out.
+//
+
+static dboolean P_CollectRay(interceptbuf_t *buf, multiray_t *ray) {
+    dboolean    far;
+    dboolean    tracepositive;
+    int         stamp = ++raystamp;
+    int         i;
+    int         j;
+
+    // avoid precision problems with two routines
+    far = (trace.dx > FRACUNIT*16 || trace.dy > FRACUNIT*16 ||
+           trace.dx < -FRACUNIT*16 || trace.dy < -FRACUNIT*16);
+
+    tracepositive = (trace.dx ^ trace.dy) > 0;
+
+    for(i = 0; i < ray->numblocks; i++) {
+        multiblock_t *mb = &blocks[rayblocks[ray->firstblock + i]];
+
+        if(rayflags & PT_ADDLINES) {
+            int *list = &blocklines[mb->firstline];
+
+            for(j = 0; j < mb->numlines; j++) {
+                multiline_t *ml = &multilines[list[j]];
+                fixed_t frac;
+                int s1;
+                int s2;
+
+                if(ml->valid == stamp) {
+                    continue;    // line has already been checked
+                }
+
+                ml->valid = stamp;
+
+                if(far) {
+                    s1 = P_PointOnDivlineSide(ml->dl.x, ml->dl.y, &trace);
+                    s2 = P_PointOnDivlineSide(ml->x2, ml->y2, &trace);
+                }
+                else {
+                    s1 = P_PointOnLineSide(trace.x, trace.y, ml->line);
+                    s2 = P_PointOnLineSide(trace.x+trace.dx, trace.y+trace.dy, ml->line);
+                }
+
+                if(s1 == s2) {
+                    continue;    // line isn't crossed
+                }
+
+                frac = P_InterceptVector(&trace, &ml->dl);
+
+                if(frac < 0) {
+                    continue;    // behind source
+                }
+
+                if((rayflags & PT_EARLYOUT) && frac < FRACUNIT && !ml->line->backsector) {
+                    return false;    // stop checking
+                }
+
+                P_AddIntercept(buf, frac, ml->line, NULL);
+            }
+        }
+
+        if(rayflags & PT_ADDTHINGS) {
+            mobj_t **list = &blockthings[mb->firstthing];
+
+            for(j = 0; j < mb->numthings; j++) {
+                mobj_t *thing = list[j];
+                divline_t dl;
+                fixed_t frac;
+                int s1;
+                int s2;
+
+                // check a corner to corner crossection for hit
+                if(tracepositive) {
+                    dl.x = thing->x - thing->radius;
+                    dl.y = thing->y + thing->radius;
+                    dl.dx = (thing->x + thing->radius) - dl.x;
+                    dl.dy = (thing->y - thing->radius) - dl.y;
+                }
+                else {
+                    dl.x = thing->x - thing->radius;
+                    dl.y = thing->y - thing->radius;
+                    dl.dx = (thing->x + thing->radius) - dl.x;
+                    dl.dy = (thing->y + thing->radius) - dl.y;
+                }
+
+                s1 = P_PointOnDivlineSide(dl.x, dl.y, &trace);
+                s2 = P_PointOnDivlineSide(dl.x + dl.dx, dl.y + dl.dy, &trace);
+
+                if(s1 == s2) {
+                    continue;    // line isn't crossed
+                }
+
+                frac = P_InterceptVector(&trace, &dl);
+
+                if(frac < 0) {
+                    continue;    // behind source
+                }
+
+                P_AddIntercept(buf, frac, NULL, thing);
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// P_RayTraverse
+// P_PathTraverse for the ray-th ray of the last P_GatherRays. Anything
+// that doesn't match what was gathered is traced on its own.
+//
+
+dboolean P_RayTraverse(int ray, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int flags,
+                       traverser_t trav) {
+    interceptbuf_t  *buf;
+    divline_t       outertrace;
+    dboolean        result;
+
+    if(!gathered || raydepth > 0 || ray < 0 || ray >= numrays || flags != rayflags ||
+            x1 != rayx || y1 != rayy || x2 != rays[ray].x2 || y2 != rays[ray].y2) {
+        return P_PathTraverse(x1, y1, x2, y2, flags, trav);
+    }
+
+    // the last ray linked or unlinked something
+    if((flags & PT_ADDTHINGS) && thingclock != P_BlockLinkClock()) {
+        P_GatherThings();
+    }
+
+    outertrace = trace;
+    buf = P_PushTrace();
+
+    P_ClearIntercepts(buf, (compatflags & COMPATF_INTERCEPTS) ? 0 : MAXINTERCEPTS);
+
+    trace.x = tracex;
+    trace.y = tracey;
+    trace.dx = x2 - tracex;
+    trace.dy = y2 - tracey;
+
+    result = P_CollectRay(buf, &rays[ray]);
+
+    if(result) {
+        raydepth++;
+        result = P_TraverseIntercepts(buf, trav, FRACUNIT);
+        raydepth--;
+    }
+
+    P_PopTrace(&outertrace);
+
+    return result;
+}
+
+//
+// CMD_RayBench
+// Times spreads of rays from the player traced one by one against
+// traced together. The traverser stops at one sided lines and touches
+// nothing, so both runs see the same world.
+//
+
+#define BENCHRAYS       20
+
+static int64 benchsum;
+
+static dboolean PTR_RayBenchTraverse(intercept_t *in) {
+    benchsum = benchsum * 31 + in->frac +
+               (in->isaline ? (int64)(in->d.line - lines) : (int64)in->d.thing->x);
+
+    return !(in->isaline && !in->d.line->backsector);
+}
+
+static CMD(RayBench) {
+    mobj_t *mo;
+    fixed_t x2[BENCHRAYS];
+    fixed_t y2[BENCHRAYS];
+    int64 *sums;
+    dboolean oldmulti = p_multitrace;
+    unsigned int rnd;
+    int count;
+    int differ = 0;
+    int time[2];
+    int i;
+    int j;
+    int k;
+
+    if(gamestate != GS_LEVEL || !(mo = players[consoleplayer].mo)) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    if(p_gridtrace || r_drawtrace) {
+        CON_Printf(WHITE, "Turn off p_gridtrace and r_drawtrace first\n");
+        return;
+    }
+
+    count = param[0] ? datoi(param[0]) : 5000;
+
+    if(count <= 0) {
+        return;
+    }
+
+    sums = (int64*)Z_Malloc(count * BENCHRAYS * sizeof(int64), PU_STATIC, 0);
+    p_multitrace = true;
+
+    // one by one, then together; the same spreads both times
+    for(j = 0; j < 2; j++) {
+        time[j] = I_GetTimeMS();
+        rnd = 1;
+
+        for(i = 0; i < count; i++) {
+            for(k = 0; k < BENCHRAYS; k++) {
+                angle_t angle;
+
+                rnd = rnd * 1103515245u + 12345u;
+                angle = (mo->angle + ((int)(rnd >> 8) % 2048 - 1024) * (1 << 19)) >> ANGLETOFINESHIFT;
+                x2[k] = mo->x + F2INT(MISSILERANGE) * finecosine[angle];
+                y2[k] = mo->y + F2INT(MISSILERANGE) * finesine[angle];
+            }
+
+            if(j == 1) {
+                P_GatherRays(mo->x, mo->y, x2, y2, BENCHRAYS, PT_ADDLINES|PT_ADDTHINGS);
+            }
+
+            for(k = 0; k < BENCHRAYS; k++) {
+                benchsum = 0;
+
+                if(j == 0) {
+                    P_PathTraverse(mo->x, mo->y, x2[k], y2[k], PT_ADDLINES|PT_ADDTHINGS, PTR_RayBenchTraverse);
+                    sums[i * BENCHRAYS + k] = benchsum;
+                }
+                else {
+                    P_RayTraverse(k, mo->x, mo->y, x2[k], y2[k], PT_ADDLINES|PT_ADDTHINGS, PTR_RayBenchTraverse);
+
+                    if(sums[i * BENCHRAYS + k] != benchsum) {
+                        differ++;
+                    }
+                }
+            }
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+    }
+
+    p_multitrace = oldmulti;
+
+    CON_Printf(WHITE, "%i spreads of %i rays over %i blocks, %i lines, %i things: single %ims, multi %ims, %i differ\n",
+               count, BENCHRAYS, numblocks, nummultilines, numblockthings, time[0], time[1], differ);
+
+    Z_Free(sums);
+}
+
+//
+// P_InitMultiTrace
+//
+
+void P_InitMultiTrace(void) {
+    P_AddWorldState(&blockgather, sizeof(blockgather));
+    P_AddWorldState(&blockslot, sizeof(blockslot));
+    P_AddWorldState(&linegather, sizeof(linegather));
+    P_AddWorldState(&lineslot, sizeof(lineslot));
+    P_AddWorldState(&gathercount, sizeof(gathercount));
+
+    G_AddCommand("raybench", CMD_RayBench, 0);
+}
@@ -0,0 +1,348 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Noise flooding. Each sector lists the sectors its two sided lines
+//    lead to, and whether each line is open is kept up to date as planes
+//    move, so a noise alert is a breadth first walk over that list.
+//
+//    A noise gets through any number of open lines but only one sound
+//    blocking line: the walk floods everything reachable without one
+//    first, then carries on from the far side of the blocking lines.
+//    That reaches the same sectors the old recursive flood did.
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "p_local.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+typedef struct {
+    int     sector;     // on the other side
+    int     line;
+} soundedge_t;
+
+static int *soundedgestart = NULL;  // [numsectors + 1] into soundedges
+static soundedge_t *soundedges = NULL;
+static byte *soundopen = NULL;      // per line: some gap between the planes
+static int *soundgen = NULL;        // per sector: last flood to reach it
+static int *soundqueue = NULL;
+static int soundgeneration = 0;
+
+//
+// P_SoundLineOpen
+// What P_LineOpening says about openrange, from the current heights
+//
+
+static byte P_SoundLineOpen(int line) {
+    geosector_t *front;
+    geosector_t *back;
+    fixed_t top;
+    fixed_t bottom;
+
+    if(geolinesectors[line][1] == -1) {
+        return false;
+    }
+
+    front = &geosectors[geolinesectors[line][0]];
+    back = &geosectors[geolinesectors[line][1]];
+
+    top = MIN(front->ceilingheight, back->ceilingheight);
+    bottom = MAX(front->floorheight, back->floorheight);
+
+    return top - bottom > 0;
+}
+
+//
+// P_BuildSoundGraph
+// Called after P_BuildLineGeometry
+//
+
+void P_BuildSoundGraph(void) {
+    int numedges = 0;
+    int i;
+    int j;
+
+    // owners are cleared when PU_LEVEL is freed
+    Z_Malloc((numsectors + 1) * sizeof(int), PU_LEVEL, &soundedgestart);
+    Z_Malloc(numlines * sizeof(byte), PU_LEVEL, &soundopen);
+    Z_Calloc(numsectors * sizeof(int), PU_LEVEL, &soundgen);
+    Z_Malloc(numsectors * sizeof(int), PU_LEVEL, &soundqueue);
+    soundgeneration = 0;
+
+    for(i = 0; i < numsectors; i++) {
+        for(j = 0; j < sectors[i].linecount; j++) {
+            if(sectors[i].lines[j]->sidenum[1] != NO_SIDE_INDEX) {
+                numedges++;
+            }
+        }
+    }
+
+    Z_Malloc(numedges * sizeof(soundedge_t), PU_LEVEL, &soundedges);
+    numedges = 0;
+
+    for(i = 0; i < numsectors; i++) {
+        sector_t *sec = &sectors[i];
+
+        soundedgestart[i] = numedges;
+
+        for(j = 0; j < sec->linecount; j++) {
+            line_t *check = sec->lines[j];
+            sector_t *other;
+
+            if(check->sidenum[1] == NO_SIDE_INDEX) {
+                continue;
+            }
+
+            if(sides[check->sidenum[0]].sector == sec) {
+                other = sides[check->sidenum[1]].sector;
+            }
+            else {
+                other = sides[check->sidenum[0]].sector;
+            }
+
+            soundedges[numedges].sector = other - sectors;
+            soundedges[numedges].line = check - lines;
+            numedges++;
+        }
+    }
+
+    soundedgestart[numsectors] = numedges;
+
+    for(i = 0; i < numlines; i++) {
+        soundopen[i] = P_SoundLineOpen(i);
+    }
+}
+
+//
+// P_UpdateSoundGraph
+// Rechecks the lines of a sector whose heights changed
+//
+
+void P_UpdateSoundGraph(sector_t *sec) {
+    int i;
+
+    if(!soundopen) {
+        return;
+    }
+
+    for(i = 0; i < sec->linecount; i++) {
+        soundopen[sec->lines[i] - lines] = P_SoundLineOpen(sec->lines[i] - lines);
+    }
+}
+
+//
+// P_FloodFrom
+// Queues the sectors on the other side of open lines from the queue.
+// Without blocking lines it keeps going from what it queues; through
+// them it only looks from the sectors it was given.
+//
+
+static int P_FloodFrom(int head, int tail, int gen, dboolean blocking) {
+    int given = tail;
+
+    while(head < (blocking ? given : tail)) {
+        int s = soundqueue[head++];
+        soundedge_t *edge = &soundedges[soundedgestart[s]];
+        soundedge_t *end = &soundedges[soundedgestart[s + 1]];
+
+        for(; edge < end; edge++) {
+            int flags = geolineflags[edge->line];
+
+            if(!(flags & ML_TWOSIDED) || !soundopen[edge->line]) {
+                continue;
+            }
+
+            if(!(flags & ML_SOUNDBLOCK) != !blocking) {
+                continue;
+            }
+
+            if(soundgen[edge->sector] != gen) {
+                soundgen[edge->sector] = gen;
+                soundqueue[tail++] = edge->sector;
+            }
+        }
+    }
+
+    return tail;
+}
+
+//
+// P_FloodNoise
+// Makes target the soundtarget of every sector the noise reaches
+//
+
+void P_FloodNoise(sector_t *sec, mobj_t *target) {
+    int gen = ++soundgeneration;
+    int quiet;
+    int tail;
+    int i;
+
+    soundqueue[0] = sec - sectors;
+    soundgen[sec - sectors] = gen;
+
+    // everything reachable without a sound blocking line,
+    quiet = P_FloodFrom(0, 1, gen, false);
+
+    // through one of them,
+    tail = P_FloodFrom(0, quiet, gen, true);
+
+    // and on from there
+    tail = P_FloodFrom(quiet, tail, gen, false);
+
+    for(i = 0; i < tail; i++) {
+        P_SetTarget(&sectors[soundqueue[i]].soundtarget, target);
+    }
+}
+
+//
+// NOISE BENCH
+//
+// noisebench times the graph flood against the recursive flood it
+// replaced. The old flood is only kept here, for the bench to run and
+// compare against; gameplay never calls it.
+//
+
+static mobj_t *benchsoundtarget;
+
+//
+// P_BenchRecursiveSound
+// The old flood
+//
+
+static void P_BenchRecursiveSound(sector_t* sec, int soundblocks) {
+    int        i;
+    line_t*    check;
+    sector_t*    other;
+
+    if(sec->validcount == validcount && sec->soundtraversed <= soundblocks+1) {
+        return;    // already flooded
+    }
+
+    sec->validcount     = validcount;
+    sec->soundtraversed = soundblocks+1;
+
+    P_SetTarget(&sec->soundtarget, benchsoundtarget);
+
+    for(i = 0; i < sec->linecount; i++) {
+        check = sec->lines[i];
+        if(!(check->flags & ML_TWOSIDED)) {
+            continue;
+        }
+
+        P_LineOpening(check);
+
+        if(openrange <= 0) {
+            continue;    // closed door
+        }
+
+        if(sides[check->sidenum[0] ].sector == sec) {
+            other = sides[check->sidenum[1]].sector;
+        }
+        else {
+            other = sides[check->sidenum[0]].sector;
+        }
+
+        if(check->flags & ML_SOUNDBLOCK) {
+            if(!soundblocks) {
+                P_BenchRecursiveSound(other, 1);
+            }
+        }
+        else {
+            P_BenchRecursiveSound(other, soundblocks);
+        }
+    }
+}
+
+//
+// CMD_NoiseBench
+// Times noise alerts from the player against the old flood; monsters
+// hear them as if the player fired
+//
+
+static CMD(NoiseBench) {
+    mobj_t *mo;
+    int count;
+    int reached = 0;
+    int differ = 0;
+    int time[2];
+    int i;
+
+    if(gamestate != GS_LEVEL || !(mo = players[consoleplayer].mo)) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    count = param[0] ? datoi(param[0]) : 10000;
+
+    if(count <= 0) {
+        return;
+    }
+
+    benchsoundtarget = mo;
+    time[0] = I_GetTimeMS();
+
+    for(i = 0; i < count; i++) {
+        D_IncValidCount();
+        P_BenchRecursiveSound(mo->subsector->sector, 0);
+    }
+
+    time[0] = I_GetTimeMS() - time[0];
+    time[1] = I_GetTimeMS();
+
+    for(i = 0; i < count; i++) {
+        P_FloodNoise(mo->subsector->sector, mo);
+    }
+
+    time[1] = I_GetTimeMS() - time[1];
+
+    for(i = 0; i < numsectors; i++) {
+        dboolean old = (sectors[i].validcount == validcount);
+        dboolean now = (soundgen[i] == soundgeneration);
+
+        reached += now;
+
+        if(old != now) {
+            differ++;
+        }
+    }
+
+    CON_Printf(WHITE, "%i noise alerts reaching %i sectors: recursive %ims, graph %ims, %i differ\n",
+               count, reached, time[0], time[1], differ);
+}
+
+//
+// P_InitNoise
+//
+
+void P_InitNoise(void) {
+    P_AddWorldState(&soundedgestart, sizeof(soundedgestart));
+    P_AddWorldState(&soundedges, sizeof(soundedges));
+    P_AddWorldState(&soundopen, sizeof(soundopen));
+    P_AddWorldState(&soundgen, sizeof(soundgen));
+    P_AddWorldState(&soundqueue, sizeof(soundqueue));
+    P_AddWorldState(&soundgeneration, sizeof(soundgeneration));
+
+    G_AddCommand("noisebench", CMD_NoiseBench, 0);
+}
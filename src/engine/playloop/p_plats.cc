@@ -162,7 +162,7 @@ EV_DoPlat
 
         // Find lowest & highest floors around sector
         rtn = 1;
-        plat = (plat_t*) Z_Malloc(sizeof(*plat), PU_LEVSPEC, 0);
+        plat = (plat_t*) P_AllocThinker(sizeof(*plat), (actionf_p1)T_PlatRaise);
         P_AddThinker(&plat->thinker);
 
         plat->type = type;
@@ -0,0 +1,388 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Portal flow. Starting from a cell, every chain of portals that a
+//    single straight line can pass through is followed, clipping each
+//    next portal to the region a line through the first and the current
+//    portal can still reach. The result is conservative: heights are
+//    ignored and clipping always errs towards keeping.
+//
+//-----------------------------------------------------------------------------
+
+#include <math.h>
+
+#include "doomdef.h"
+#include "z_zone.h"
+#include "p_portal.h"
+
+#define PORTALEPSILON   1.0     // sight traces round to whole units
+
+typedef struct {
+    portalgraph_t   *graph;
+    byte            *visrow;
+    byte            *onpath;
+    int             work;
+    int             maxwork;
+} portalflow_t;
+
+//
+// P_PortalSide
+// Signed area of p against the line a->b, positive on the left
+//
+
+static double P_PortalSide(double ax, double ay, double bx, double by, double px, double py) {
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+//
+// P_ClipPortalSeg
+// Keeps the part of s on the left of a->b. Returns false if nothing is left.
+//
+
+static dboolean P_ClipPortalSeg(portalseg_t *s, double ax, double ay, double bx, double by) {
+    double len = sqrt((bx - ax) * (bx - ax) + (by - ay) * (by - ay));
+    double eps = PORTALEPSILON * len;
+    double d1 = P_PortalSide(ax, ay, bx, by, s->x1, s->y1);
+    double d2 = P_PortalSide(ax, ay, bx, by, s->x2, s->y2);
+    double t;
+
+    if(d1 >= -eps && d2 >= -eps) {
+        return true;
+    }
+
+    if(d1 < -eps && d2 < -eps) {
+        return false;
+    }
+
+    t = d1 / (d1 - d2);
+
+    if(d1 < -eps) {
+        s->x1 = s->x1 + (s->x2 - s->x1) * t;
+        s->y1 = s->y1 + (s->y2 - s->y1) * t;
+    }
+    else {
+        s->x2 = s->x1 + (s->x2 - s->x1) * t;
+        s->y2 = s->y1 + (s->y2 - s->y1) * t;
+    }
+
+    return true;
+}
+
+//
+// P_ClipToSeparator
+// Clips target against the line through sx,sy and px,py when it separates
+// the rest of the source from the rest of the pass. Every line through
+// both source and pass stays on the pass side of it beyond the pass.
+//
+
+static dboolean P_ClipToSeparator(portalseg_t *target, double sx, double sy, double px, double py,
+                                  double sox, double soy, double pox, double poy) {
+    double len = sqrt((px - sx) * (px - sx) + (py - sy) * (py - sy));
+    double eps = PORTALEPSILON * len;
+    double dsrc;
+    double dpass;
+
+    if(len < PORTALEPSILON) {
+        return true;
+    }
+
+    dsrc = P_PortalSide(sx, sy, px, py, sox, soy);
+    dpass = P_PortalSide(sx, sy, px, py, pox, poy);
+
+    if(dpass > eps && dsrc <= eps) {
+        return P_ClipPortalSeg(target, sx, sy, px, py);
+    }
+
+    if(dpass < -eps && dsrc >= -eps) {
+        return P_ClipPortalSeg(target, px, py, sx, sy);
+    }
+
+    return true;
+}
+
+//
+// P_ClipThroughPortals
+// Clips target to what can be reached by a line through source and pass
+//
+
+static dboolean P_ClipThroughPortals(portalseg_t *target, const portalseg_t *src,
+                                     const portalseg_t *pass, const portalseg_t *passline) {
+    const double sx[2] = { src->x1, src->x2 };
+    const double sy[2] = { src->y1, src->y2 };
+    const double px[2] = { pass->x1, pass->x2 };
+    const double py[2] = { pass->y1, pass->y2 };
+    int i;
+    int j;
+
+    // must be beyond both portals
+    if(!P_ClipPortalSeg(target, src->x1, src->y1, src->x2, src->y2)) {
+        return false;
+    }
+
+    if(!P_ClipPortalSeg(target, passline->x1, passline->y1, passline->x2, passline->y2)) {
+        return false;
+    }
+
+    for(i = 0; i < 2; i++) {
+        for(j = 0; j < 2; j++) {
+            if(!P_ClipToSeparator(target, sx[i], sy[i], px[j], py[j],
+                                  sx[i^1], sy[i^1], px[j^1], py[j^1])) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// P_RecursiveFlow
+// Follows every portal that a straight line through src and pass can reach
+//
+
+static void P_RecursiveFlow(portalflow_t *flow, const portalseg_t *src,
+                            const portalseg_t *pass, int passportal) {
+    portalgraph_t *graph = flow->graph;
+    int cell = graph->portals[passportal].to;
+    int i;
+
+    for(i = graph->cellportals[cell]; i < graph->cellportals[cell + 1]; i++) {
+        portal_t *portal = &graph->portals[i];
+        portalseg_t seg;
+
+        if(flow->onpath[portal->to]) {
+            continue;
+        }
+
+        if(++flow->work > flow->maxwork) {
+            return;
+        }
+
+        seg = portal->seg;
+
+        if(!P_ClipThroughPortals(&seg, src, pass, &graph->portals[passportal].seg)) {
+            continue;
+        }
+
+        flow->visrow[portal->to >> 3] |= 1 << (portal->to & 7);
+
+        flow->onpath[portal->to] = 1;
+        P_RecursiveFlow(flow, src, &seg, i);
+        flow->onpath[portal->to] = 0;
+    }
+}
+
+//
+// P_PortalFlow
+//
+
+dboolean P_PortalFlow(portalgraph_t *graph, int cell, byte *visrow, byte *onpath, int maxwork) {
+    portalflow_t flow;
+    int i;
+    int j;
+
+    flow.graph = graph;
+    flow.visrow = visrow;
+    flow.onpath = onpath;
+    flow.work = 0;
+    flow.maxwork = maxwork;
+
+    visrow[cell >> 3] |= 1 << (cell & 7);
+    onpath[cell] = 1;
+
+    for(i = graph->cellportals[cell]; i < graph->cellportals[cell + 1]; i++) {
+        portal_t *src = &graph->portals[i];
+
+        if(onpath[src->to]) {
+            continue;
+        }
+
+        visrow[src->to >> 3] |= 1 << (src->to & 7);
+        onpath[src->to] = 1;
+
+        for(j = graph->cellportals[src->to]; j < graph->cellportals[src->to + 1]; j++) {
+            portal_t *pass = &graph->portals[j];
+            portalseg_t seg;
+
+            if(onpath[pass->to]) {
+                continue;
+            }
+
+            seg = pass->seg;
+
+            if(!P_ClipPortalSeg(&seg, src->seg.x1, src->seg.y1, src->seg.x2, src->seg.y2)) {
+                continue;
+            }
+
+            visrow[pass->to >> 3] |= 1 << (pass->to & 7);
+
+            onpath[pass->to] = 1;
+            P_RecursiveFlow(&flow, &src->seg, &seg, j);
+            onpath[pass->to] = 0;
+        }
+
+        onpath[src->to] = 0;
+    }
+
+    onpath[cell] = 0;
+
+    if(flow.work <= maxwork) {
+        return true;
+    }
+
+    // too many paths to follow; fall back to everything connected
+    for(i = 0; i < graph->numcells; i++) {
+        if(graph->component[i] == graph->component[cell]) {
+            visrow[i >> 3] |= 1 << (i & 7);
+        }
+    }
+
+    return false;
+}
+
+//
+// P_NewPortalGraph
+//
+
+void P_NewPortalGraph(portalgraph_t *graph, int numcells, int maxportals) {
+    graph->numcells = numcells;
+    graph->numportals = 0;
+    graph->maxportals = MAX(maxportals, 1) * 2;
+    graph->portals = (portal_t*)Z_Malloc(graph->maxportals * sizeof(portal_t), PU_STATIC, 0);
+    graph->cellportals = NULL;
+    graph->component = NULL;
+}
+
+//
+// P_AddPortal
+// Adds the opening between two cells in both directions
+//
+
+void P_AddPortal(portalgraph_t *graph, int right, int left, portalseg_t *seg) {
+    portal_t *p;
+
+    if(right == left || graph->numportals + 2 > graph->maxportals) {
+        return;
+    }
+
+    p = &graph->portals[graph->numportals++];
+    p->seg = *seg;
+    p->from = right;
+    p->to = left;
+
+    p = &graph->portals[graph->numportals++];
+    p->seg.x1 = seg->x2;
+    p->seg.y1 = seg->y2;
+    p->seg.x2 = seg->x1;
+    p->seg.y2 = seg->y1;
+    p->from = left;
+    p->to = right;
+}
+
+//
+// P_FinishPortalGraph
+// Groups the portals by cell and flood fills the connected components
+//
+
+void P_FinishPortalGraph(portalgraph_t *graph) {
+    portal_t *sorted;
+    int *fill;
+    int *stack;
+    int numcells = graph->numcells;
+    int i;
+    int j;
+    int sp;
+
+    graph->cellportals = (int*)Z_Calloc((numcells + 1) * sizeof(int), PU_STATIC, 0);
+    graph->component = (int*)Z_Malloc(MAX(numcells, 1) * sizeof(int), PU_STATIC, 0);
+
+    for(i = 0; i < graph->numportals; i++) {
+        graph->cellportals[graph->portals[i].from + 1]++;
+    }
+
+    for(i = 0; i < numcells; i++) {
+        graph->cellportals[i + 1] += graph->cellportals[i];
+    }
+
+    fill = (int*)Z_Malloc((numcells + 1) * sizeof(int), PU_STATIC, 0);
+    dmemcpy(fill, graph->cellportals, (numcells + 1) * sizeof(int));
+
+    sorted = (portal_t*)Z_Malloc(MAX(graph->numportals, 1) * sizeof(portal_t), PU_STATIC, 0);
+
+    for(i = 0; i < graph->numportals; i++) {
+        sorted[fill[graph->portals[i].from]++] = graph->portals[i];
+    }
+
+    Z_Free(graph->portals);
+    graph->portals = sorted;
+
+    // connected components, for when a flow gives up
+    stack = fill;
+
+    for(i = 0; i < numcells; i++) {
+        graph->component[i] = -1;
+    }
+
+    for(i = 0; i < numcells; i++) {
+        if(graph->component[i] != -1) {
+            continue;
+        }
+
+        graph->component[i] = i;
+        stack[0] = i;
+        sp = 1;
+
+        while(sp) {
+            int cell = stack[--sp];
+
+            for(j = graph->cellportals[cell]; j < graph->cellportals[cell + 1]; j++) {
+                int to = graph->portals[j].to;
+
+                if(graph->component[to] == -1) {
+                    graph->component[to] = i;
+                    stack[sp++] = to;
+                }
+            }
+        }
+    }
+
+    Z_Free(fill);
+}
+
+//
+// P_FreePortalGraph
+//
+
+void P_FreePortalGraph(portalgraph_t *graph) {
+    Z_Free(graph->portals);
+
+    if(graph->cellportals) {
+        Z_Free(graph->cellportals);
+    }
+
+    if(graph->component) {
+        Z_Free(graph->component);
+    }
+
+    graph->portals = NULL;
+    graph->cellportals = NULL;
+    graph->component = NULL;
+}
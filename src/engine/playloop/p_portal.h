@@ -0,0 +1,65 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __P_PORTAL__
+#define __P_PORTAL__
+
+#include "doomtype.h"
+
+//
+// Portal graphs for the REJECT and PVS generators. Cells are sectors or
+// subsectors, portals are the openings between them.
+//
+
+typedef struct {
+    double      x1;
+    double      y1;
+    double      x2;
+    double      y2;
+} portalseg_t;
+
+// an opening seen from one of its cells; the far cell is on the left
+// of x1,y1 -> x2,y2
+typedef struct {
+    portalseg_t seg;
+    int         from;
+    int         to;
+} portal_t;
+
+typedef struct {
+    int         numcells;
+    int         numportals;
+    int         maxportals;
+    portal_t    *portals;       // grouped by from cell once finished
+    int         *cellportals;   // first portal of each cell, numcells + 1
+    int         *component;     // connected component of each cell
+} portalgraph_t;
+
+void        P_NewPortalGraph(portalgraph_t *graph, int numcells, int maxportals);
+void        P_AddPortal(portalgraph_t *graph, int right, int left, portalseg_t *seg);
+void        P_FinishPortalGraph(portalgraph_t *graph);
+void        P_FreePortalGraph(portalgraph_t *graph);
+
+// Sets the bit of every cell a straight line from cell can reach. onpath
+// is numcells bytes of zeroed scratch, so several flows can run at once.
+// Returns false if maxwork ran out and all connected cells were marked.
+dboolean    P_PortalFlow(portalgraph_t *graph, int cell, byte *visrow, byte *onpath, int maxwork);
+
+#endif
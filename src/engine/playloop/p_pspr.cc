@@ -43,6 +43,7 @@
 #include "p_pspr.h"
 #include "m_misc.h"
 
+extern BoolProperty p_multitrace;
 
 #define LOWERSPEED                FRACUNIT*7
 #define RAISESPEED                FRACUNIT*7
@@ -653,7 +654,10 @@ void A_FirePistol(player_t* player, pspdef_t* psp) {
 // A_FireShotgun
 //
 void A_FireShotgun(player_t* player, pspdef_t* psp) {
-    int i;
+    int         i;
+    angle_t     angles[7];
+    fixed_t     slopes[7];
+    int         damages[7];
 
     S_StartSound(player->mo, sfx_shotgun);
     P_SetMobjState(player->mo, S_007);
@@ -668,9 +672,21 @@ void A_FireShotgun(player_t* player, pspdef_t* psp) {
 
     player->recoilpitch = RECOILPITCH;
 
+    if(!p_multitrace) {
+        for(i = 0; i < 7; i++) {
+            P_GunShot(player->mo, false);
+        }
+        return;
+    }
+
+    // as P_GunShot would for each pellet
     for(i = 0; i < 7; i++) {
-        P_GunShot(player->mo, false);
+        damages[i] = ((P_Random(pr_gunshot)&3)<<2)+4;
+        angles[i] = player->mo->angle + P_RandomShift(pr_misfire, 18);
+        slopes[i] = bulletslope;
     }
+
+    P_LineAttacks(player->mo, 7, angles, MISSILERANGE, slopes, damages);
 }
 
 
@@ -683,6 +699,9 @@ void A_FireShotgun2(player_t* player, pspdef_t* psp) {
     int         i;
     angle_t     angle;
     int         damage;
+    angle_t     angles[20];
+    fixed_t     slopes[20];
+    int         damages[20];
 
     S_StartSound(player->mo, sfx_sht2fire);
     P_SetMobjState(player->mo, S_007);
@@ -697,13 +716,25 @@ void A_FireShotgun2(player_t* player, pspdef_t* psp) {
         P_Thrust(player, player->mo->angle + ANG180, FRACUNIT);
     }
 
+    if(!p_multitrace) {
+        for(i = 0; i < 20; i++) {
+            damage = 5 * (P_Random(pr_shotgun) % 3 + 1);
+            angle = player->mo->angle;
+            angle += P_RandomShift(pr_shotgun, 19);
+            P_LineAttack(player->mo, angle, MISSILERANGE, bulletslope +
+                         P_RandomShift(pr_shotgun, 5), damage);
+        }
+        return;
+    }
+
     for(i = 0; i < 20; i++) {
-        damage = 5 * (P_Random(pr_shotgun) % 3 + 1);
-        angle = player->mo->angle;
-        angle += P_RandomShift(pr_shotgun, 19);
-        P_LineAttack(player->mo, angle, MISSILERANGE, bulletslope +
-                     P_RandomShift(pr_shotgun, 5), damage);
+        damages[i] = 5 * (P_Random(pr_shotgun) % 3 + 1);
+        angles[i] = player->mo->angle;
+        angles[i] += P_RandomShift(pr_shotgun, 19);
+        slopes[i] = bulletslope + P_RandomShift(pr_shotgun, 5);
     }
+
+    P_LineAttacks(player->mo, 20, angles, MISSILERANGE, slopes, damages);
 }
 
 //
@@ -1113,7 +1144,7 @@ void A_FireLaser(player_t *player, pspdef_t *psp) {
 
         P_LaserCrossBSP(numnodes - 1, laser[i]);
 
-        laserthinker[i] = (laserthinker_t*) Z_Malloc(sizeof(*laserthinker[i]), PU_LEVSPEC, 0);
+        laserthinker[i] = (laserthinker_t*) P_AllocThinker(sizeof(*laserthinker[i]), (actionf_p1)T_LaserThinker);
         P_AddThinker(&laserthinker[i]->thinker);
 
         laserthinker[i]->thinker.function.acp1 = (actionf_p1)T_LaserThinker;
@@ -0,0 +1,612 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Subsector potentially visible set. The leaf polygons give the convex
+//    shape of every subsector; edges shared by two subsectors are the
+//    portals. Each row is built with a portal flow on the worker pool and
+//    cached on disk per map.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <math.h>
+#include <imp/Property>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "p_local.h"
+#include "p_portal.h"
+#include "p_setup.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "m_misc.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "Map.hh"
+
+BoolProperty p_pvs("p_pvs", "Cull rendering, and sight checks with compat_pvssight, with a potentially visible set", true);
+
+byte    *pvsmatrix = NULL;      // numsubsectors rows of pvsrowbytes
+int     pvsrowbytes = 0;
+
+static byte *pvsnodevis = NULL; // per node, for the last view subsector
+static int  pvsnodesubsector = -1;
+
+// lumps the set depends on
+static const int pvslumps[] = {
+    ML_VERTEXES, ML_LINEDEFS, ML_SIDEDEFS, ML_SEGS, ML_SSECTORS, ML_NODES, ML_LEAFS
+};
+
+#define PVSMAXWORK          100000      // portal steps per source subsector
+#define PVSCACHEVERSION     1
+#define PVSEDGETOLERANCE    1.5         // split vertices are rounded to whole units
+#define PVSGRIDSHIFT        7           // 128 unit buckets for matching edges
+
+typedef struct {
+    double      x1;
+    double      y1;
+    double      x2;
+    double      y2;
+    int         cell;
+} pvsedge_t;
+
+typedef struct {
+    portalgraph_t   *graph;
+    byte            *matrix;
+    byte            *onpath;    // numworkers x numsubsectors
+    int             *giveups;   // per worker
+} pvsjob_t;
+
+//
+// P_PVSCentroid
+//
+
+static void P_PVSCentroid(subsector_t *ss, double *x, double *y) {
+    int i;
+
+    *x = *y = 0;
+
+    for(i = 0; i < ss->numleafs; i++) {
+        *x += (double)leafs[ss->leaf + i].vertex->x / FRACUNIT;
+        *y += (double)leafs[ss->leaf + i].vertex->y / FRACUNIT;
+    }
+
+    *x /= ss->numleafs;
+    *y /= ss->numleafs;
+}
+
+//
+// P_MatchPVSEdges
+// Adds a portal if two edges lie on the same line and overlap
+//
+
+static void P_MatchPVSEdges(portalgraph_t *graph, pvsedge_t *a, pvsedge_t *b,
+                            double *cx, double *cy) {
+    double dx = a->x2 - a->x1;
+    double dy = a->y2 - a->y1;
+    double len = sqrt(dx * dx + dy * dy);
+    double d1;
+    double d2;
+    double t1;
+    double t2;
+    double tmin;
+    double tmax;
+    double side;
+    portalseg_t seg;
+
+    // measure against the longer edge
+    if((b->x2 - b->x1) * (b->x2 - b->x1) + (b->y2 - b->y1) * (b->y2 - b->y1) > len * len) {
+        P_MatchPVSEdges(graph, b, a, cx, cy);
+        return;
+    }
+
+    if(len < 0.5) {
+        return;
+    }
+
+    dx /= len;
+    dy /= len;
+
+    // distance of b's ends from a's line
+    d1 = (b->x1 - a->x1) * dy - (b->y1 - a->y1) * dx;
+    d2 = (b->x2 - a->x1) * dy - (b->y2 - a->y1) * dx;
+
+    if(fabs(d1) > PVSEDGETOLERANCE || fabs(d2) > PVSEDGETOLERANCE) {
+        return;
+    }
+
+    // overlap along a
+    t1 = (b->x1 - a->x1) * dx + (b->y1 - a->y1) * dy;
+    t2 = (b->x2 - a->x1) * dx + (b->y2 - a->y1) * dy;
+
+    tmin = MAX(MIN(t1, t2), 0);
+    tmax = MIN(MAX(t1, t2), len);
+
+    if(tmax - tmin < 0.5) {
+        return;
+    }
+
+    seg.x1 = a->x1 + dx * tmin;
+    seg.y1 = a->y1 + dy * tmin;
+    seg.x2 = a->x1 + dx * tmax;
+    seg.y2 = a->y1 + dy * tmax;
+
+    // a's subsector goes on whichever side its centroid is
+    side = (seg.x2 - seg.x1) * (cy[a->cell] - seg.y1) - (seg.y2 - seg.y1) * (cx[a->cell] - seg.x1);
+
+    if(side > 0) {
+        P_AddPortal(graph, b->cell, a->cell, &seg);
+    }
+    else {
+        P_AddPortal(graph, a->cell, b->cell, &seg);
+    }
+}
+
+//
+// P_BuildPVSGraph
+// Finds the leaf edges shared between subsectors. Edges are bucketed on
+// a coarse grid; a pair is only tested in the bucket holding the corner
+// of their common bounding box, so it is never added twice.
+//
+
+static void P_BuildPVSGraph(portalgraph_t *graph, byte *opencells) {
+    pvsedge_t *edges;
+    int numedges = 0;
+    double *cx;
+    double *cy;
+    double minx = 0, miny = 0, maxx = 0, maxy = 0;
+    int gridw;
+    int gridh;
+    int *gridcount;
+    int *gridstart;
+    int *griditems;
+    int i;
+    int j;
+    int k;
+    int x;
+    int y;
+
+    cx = (double*)Z_Malloc(MAX(numsubsectors, 1) * sizeof(double), PU_STATIC, 0);
+    cy = (double*)Z_Malloc(MAX(numsubsectors, 1) * sizeof(double), PU_STATIC, 0);
+
+    for(i = 0, j = 0; i < numsubsectors; i++) {
+        j += subsectors[i].numleafs;
+    }
+
+    edges = (pvsedge_t*)Z_Malloc(MAX(j, 1) * sizeof(pvsedge_t), PU_STATIC, 0);
+
+    for(i = 0; i < numsubsectors; i++) {
+        subsector_t *ss = &subsectors[i];
+
+        // no polygon to work with; treat it as seeing everything
+        if(ss->numleafs < 3) {
+            opencells[i] = 1;
+            cx[i] = cy[i] = 0;
+            continue;
+        }
+
+        P_PVSCentroid(ss, &cx[i], &cy[i]);
+
+        for(j = 0; j < ss->numleafs; j++) {
+            vertex_t *v1 = leafs[ss->leaf + j].vertex;
+            vertex_t *v2 = leafs[ss->leaf + (j + 1) % ss->numleafs].vertex;
+            pvsedge_t *e = &edges[numedges++];
+
+            e->x1 = (double)v1->x / FRACUNIT;
+            e->y1 = (double)v1->y / FRACUNIT;
+            e->x2 = (double)v2->x / FRACUNIT;
+            e->y2 = (double)v2->y / FRACUNIT;
+            e->cell = i;
+
+            if(numedges == 1) {
+                minx = maxx = e->x1;
+                miny = maxy = e->y1;
+            }
+
+            minx = MIN(minx, MIN(e->x1, e->x2));
+            maxx = MAX(maxx, MAX(e->x1, e->x2));
+            miny = MIN(miny, MIN(e->y1, e->y2));
+            maxy = MAX(maxy, MAX(e->y1, e->y2));
+        }
+    }
+
+    minx -= PVSEDGETOLERANCE;
+    miny -= PVSEDGETOLERANCE;
+
+    gridw = ((int)(maxx - minx + PVSEDGETOLERANCE) >> PVSGRIDSHIFT) + 1;
+    gridh = ((int)(maxy - miny + PVSEDGETOLERANCE) >> PVSGRIDSHIFT) + 1;
+
+    gridcount = (int*)Z_Calloc((gridw * gridh + 1) * sizeof(int), PU_STATIC, 0);
+    gridstart = (int*)Z_Calloc((gridw * gridh + 1) * sizeof(int), PU_STATIC, 0);
+
+#define EDGE_X0(e) ((int)(MIN((e)->x1, (e)->x2) - PVSEDGETOLERANCE - minx) >> PVSGRIDSHIFT)
+#define EDGE_X1(e) ((int)(MAX((e)->x1, (e)->x2) + PVSEDGETOLERANCE - minx) >> PVSGRIDSHIFT)
+#define EDGE_Y0(e) ((int)(MIN((e)->y1, (e)->y2) - PVSEDGETOLERANCE - miny) >> PVSGRIDSHIFT)
+#define EDGE_Y1(e) ((int)(MAX((e)->y1, (e)->y2) + PVSEDGETOLERANCE - miny) >> PVSGRIDSHIFT)
+
+    for(i = 0; i < numedges; i++) {
+        pvsedge_t *e = &edges[i];
+
+        for(y = EDGE_Y0(e); y <= EDGE_Y1(e); y++) {
+            for(x = EDGE_X0(e); x <= EDGE_X1(e); x++) {
+                gridcount[y * gridw + x]++;
+            }
+        }
+    }
+
+    for(i = 0; i < gridw * gridh; i++) {
+        gridstart[i + 1] = gridstart[i] + gridcount[i];
+        gridcount[i] = gridstart[i];
+    }
+
+    griditems = (int*)Z_Malloc(MAX(gridstart[gridw * gridh], 1) * sizeof(int), PU_STATIC, 0);
+
+    for(i = 0; i < numedges; i++) {
+        pvsedge_t *e = &edges[i];
+
+        for(y = EDGE_Y0(e); y <= EDGE_Y1(e); y++) {
+            for(x = EDGE_X0(e); x <= EDGE_X1(e); x++) {
+                griditems[gridcount[y * gridw + x]++] = i;
+            }
+        }
+    }
+
+    for(i = 0; i < gridw * gridh; i++) {
+        for(j = gridstart[i]; j < gridstart[i + 1]; j++) {
+            pvsedge_t *a = &edges[griditems[j]];
+
+            for(k = j + 1; k < gridstart[i + 1]; k++) {
+                pvsedge_t *b = &edges[griditems[k]];
+
+                if(a->cell == b->cell) {
+                    continue;
+                }
+
+                // only in the first bucket both edges share
+                x = MAX(EDGE_X0(a), EDGE_X0(b));
+                y = MAX(EDGE_Y0(a), EDGE_Y0(b));
+
+                if(y * gridw + x != i) {
+                    continue;
+                }
+
+                P_MatchPVSEdges(graph, a, b, cx, cy);
+            }
+        }
+    }
+
+#undef EDGE_X0
+#undef EDGE_X1
+#undef EDGE_Y0
+#undef EDGE_Y1
+
+    Z_Free(griditems);
+    Z_Free(gridstart);
+    Z_Free(gridcount);
+    Z_Free(edges);
+    Z_Free(cx);
+    Z_Free(cy);
+}
+
+//
+// P_PVSJob
+//
+
+static void P_PVSJob(int index, int worker, void *data) {
+    pvsjob_t *job = (pvsjob_t*)data;
+
+    if(!P_PortalFlow(job->graph, index, job->matrix + index * pvsrowbytes,
+                     job->onpath + worker * numsubsectors, PVSMAXWORK)) {
+        job->giveups[worker]++;
+    }
+}
+
+//
+// P_BuildPVS
+// Computes the set into matrix. Returns the number of portals.
+//
+
+static int P_BuildPVS(byte *matrix) {
+    portalgraph_t graph;
+    pvsjob_t job;
+    byte *opencells;
+    int numworkers = I_NumWorkers();
+    int giveups = 0;
+    int numportals;
+    int i;
+    int j;
+
+    dmemset(matrix, 0, numsubsectors * pvsrowbytes);
+
+    opencells = (byte*)Z_Calloc(MAX(numsubsectors, 1), PU_STATIC, 0);
+
+    // a subsector rarely has more than a dozen edges
+    P_NewPortalGraph(&graph, numsubsectors, numsubsectors * 16);
+    P_BuildPVSGraph(&graph, opencells);
+    P_FinishPortalGraph(&graph);
+
+    numportals = graph.numportals;
+
+    job.graph = &graph;
+    job.matrix = matrix;
+    job.onpath = (byte*)Z_Calloc(MAX(numworkers * numsubsectors, 1), PU_STATIC, 0);
+    job.giveups = (int*)Z_Calloc(numworkers * sizeof(int), PU_STATIC, 0);
+
+    I_ParallelFor(numsubsectors, P_PVSJob, &job);
+
+    for(i = 0; i < numworkers; i++) {
+        giveups += job.giveups[i];
+    }
+
+    // sight lines are reversible
+    for(i = 0; i < numsubsectors; i++) {
+        for(j = i + 1; j < numsubsectors; j++) {
+            byte *ij = &matrix[i * pvsrowbytes + (j >> 3)];
+            byte *ji = &matrix[j * pvsrowbytes + (i >> 3)];
+
+            if(opencells[i] || opencells[j] || (*ij & (1 << (j & 7))) || (*ji & (1 << (i & 7)))) {
+                *ij |= 1 << (j & 7);
+                *ji |= 1 << (i & 7);
+            }
+        }
+    }
+
+    if(giveups) {
+        CON_DPrintf("P_BuildPVS: %i subsectors fell back to connectivity\n", giveups);
+    }
+
+    Z_Free(job.onpath);
+    Z_Free(job.giveups);
+    Z_Free(opencells);
+    P_FreePortalGraph(&graph);
+
+    return numportals;
+}
+
+//
+// P_ReadPVSCache
+//
+
+static dboolean P_ReadPVSCache(const char *filename, byte *matrix, int size) {
+    byte *data;
+    int length;
+    dboolean ok;
+
+    if(filename == NULL || (length = M_ReadFile(filename, &data)) == -1) {
+        return false;
+    }
+
+    ok = (length == size + 8 &&
+          data[0] == 'P' && data[1] == 'V' && data[2] == 'S' && data[3] == PVSCACHEVERSION &&
+          (data[4] | (data[5] << 8) | (data[6] << 16) | (data[7] << 24)) == numsubsectors);
+
+    if(ok) {
+        dmemcpy(matrix, data + 8, size);
+    }
+
+    Z_Free(data);
+    return ok;
+}
+
+//
+// P_WritePVSCache
+//
+
+static void P_WritePVSCache(const char *filename, byte *matrix, int size) {
+    byte *data;
+
+    if(filename == NULL) {
+        return;
+    }
+
+    data = (byte*)Z_Malloc(size + 8, PU_STATIC, 0);
+
+    data[0] = 'P';
+    data[1] = 'V';
+    data[2] = 'S';
+    data[3] = PVSCACHEVERSION;
+    data[4] = numsubsectors & 0xff;
+    data[5] = (numsubsectors >> 8) & 0xff;
+    data[6] = (numsubsectors >> 16) & 0xff;
+    data[7] = (numsubsectors >> 24) & 0xff;
+    dmemcpy(data + 8, matrix, size);
+
+    if(!M_WriteFile(filename, data, size + 8)) {
+        CON_Warnf("P_WritePVSCache: couldn't write %s\n", filename);
+    }
+
+    Z_Free(data);
+}
+
+//
+// P_PVSVisiblePercent
+//
+
+static int P_PVSVisiblePercent(void) {
+    int64 visible = 0;
+    int i;
+    int j;
+
+    if(!numsubsectors) {
+        return 0;
+    }
+
+    for(i = 0; i < numsubsectors; i++) {
+        for(j = 0; j < numsubsectors; j++) {
+            if(pvsmatrix[i * pvsrowbytes + (j >> 3)] & (1 << (j & 7))) {
+                visible++;
+            }
+        }
+    }
+
+    return (int)((visible * 100) / ((int64)numsubsectors * numsubsectors));
+}
+
+//
+// P_SetupPVS
+// Called after the leafs are loaded, while the map lumps are still cached
+//
+
+void P_SetupPVS(void) {
+    char *filename;
+    int size;
+
+    pvsmatrix = NULL;
+    pvsnodevis = NULL;
+    pvsnodesubsector = -1;
+
+    if(!p_pvs || !numsubsectors || !subsectors[0].numleafs) {
+        return;
+    }
+
+    pvsrowbytes = (numsubsectors + 7) / 8;
+    size = numsubsectors * pvsrowbytes;
+
+    // owners are cleared when PU_LEVEL is freed
+    Z_Malloc(size, PU_LEVEL, &pvsmatrix);
+    Z_Malloc(MAX(numnodes, 1), PU_LEVEL, &pvsnodevis);
+
+    filename = P_MapCacheFile("pvs", pvslumps, sizeof(pvslumps) / sizeof(int));
+
+    if(!P_ReadPVSCache(filename, pvsmatrix, size)) {
+        int starttime = I_GetTimeMS();
+
+        P_BuildPVS(pvsmatrix);
+        P_WritePVSCache(filename, pvsmatrix, size);
+
+        CON_DPrintf("P_SetupPVS: %i subsectors in %ims\n", numsubsectors, I_GetTimeMS() - starttime);
+    }
+
+    if(filename) {
+        free(filename);
+    }
+}
+
+//
+// P_MarkPVSNodes
+//
+
+static dboolean P_MarkPVSNodes(int bspnum, int from) {
+    node_t *node;
+    dboolean front;
+    dboolean back;
+
+    if(bspnum & NF_SUBSECTOR) {
+        return P_CheckPVS(from, bspnum == -1 ? 0 : bspnum & ~NF_SUBSECTOR);
+    }
+
+    node = &nodes[bspnum];
+    front = P_MarkPVSNodes(node->children[0], from);
+    back = P_MarkPVSNodes(node->children[1], from);
+
+    pvsnodevis[bspnum] = (front || back);
+    return pvsnodevis[bspnum];
+}
+
+//
+// P_PVSNodes
+// Returns a byte per node telling whether anything under it can be seen
+// from the given subsector, or NULL if there is no set for this map
+//
+
+byte *P_PVSNodes(int from) {
+    if(pvsmatrix == NULL || pvsnodevis == NULL || !numnodes) {
+        return NULL;
+    }
+
+    if(from != pvsnodesubsector) {
+        P_MarkPVSNodes(numnodes - 1, from);
+        pvsnodesubsector = from;
+    }
+
+    return pvsnodevis;
+}
+
+//
+// P_BuildAllPVS
+// Builds and caches the set for every map, reporting size and build time
+//
+
+void P_BuildAllPVS(void) {
+    int totalbytes = 0;
+    int totaltime = 0;
+    int map;
+
+    for(map = 1; map < 100; map++) {
+        byte *matrix;
+        char *filename;
+        int numportals;
+        int size;
+        int starttime;
+        int buildtime;
+
+        if(P_GetMapInfo(map) == NULL) {
+            continue;
+        }
+
+        P_LoadMapGeometry(map);
+
+        if(!numsubsectors || !subsectors[0].numleafs) {
+            I_Printf("MAP%02d: no leafs, skipped\n", map);
+            Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+            continue;
+        }
+
+        pvsrowbytes = (numsubsectors + 7) / 8;
+        size = numsubsectors * pvsrowbytes;
+        matrix = (byte*)Z_Malloc(size, PU_LEVEL, 0);
+
+        starttime = I_GetTimeMS();
+        numportals = P_BuildPVS(matrix);
+        buildtime = I_GetTimeMS() - starttime;
+
+        pvsmatrix = matrix;
+
+        I_Printf("MAP%02d: %5i subsectors %6i portals %8i bytes %3i%% visible %6i ms\n",
+                 map, numsubsectors, numportals / 2, size, P_PVSVisiblePercent(), buildtime);
+
+        filename = P_MapCacheFile("pvs", pvslumps, sizeof(pvslumps) / sizeof(int));
+        P_WritePVSCache(filename, matrix, size);
+
+        if(filename) {
+            free(filename);
+        }
+
+        totalbytes += size;
+        totaltime += buildtime;
+
+        pvsmatrix = NULL;
+        Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+    }
+
+    I_Printf("total: %i bytes, %i ms on %i threads\n", totalbytes, totaltime, I_NumWorkers());
+}
+
+//
+// P_InitPVS
+//
+
+void P_InitPVS(void) {
+    P_AddWorldState(&pvsmatrix, sizeof(pvsmatrix));
+    P_AddWorldState(&pvsrowbytes, sizeof(pvsrowbytes));
+    P_AddWorldState(&pvsnodevis, sizeof(pvsnodevis));
+    P_AddWorldState(&pvsnodesubsector, sizeof(pvsnodesubsector));
+}
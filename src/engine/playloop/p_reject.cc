@@ -0,0 +1,285 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    REJECT table generator. Many maps ship an empty REJECT lump, which
+//    makes every sight check walk the BSP. The generated table is
+//    conservative: a sector pair is only rejected when no straight line
+//    can pass from one to the other through two sided lines, whatever
+//    the floor and ceiling heights are.
+//
+//-----------------------------------------------------------------------------
+
+#include <imp/Property>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "p_local.h"
+#include "p_portal.h"
+#include "i_system.h"
+#include "m_misc.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+#include "Map.hh"
+
+// 0 = never, 1 = when the map's REJECT rejects nothing, 2 = always
+IntProperty p_buildreject("p_buildreject", "Generate REJECT for maps without a useful one", 1);
+
+// the map's own table once it has been replaced, for the sight stats
+byte *rejectlump = NULL;
+
+// lumps the generated table depends on
+static const int rejectlumps[] = { ML_VERTEXES, ML_SECTORS, ML_SIDEDEFS, ML_LINEDEFS };
+
+#define REJECTMAXWORK       200000      // portal steps per source sector
+#define REJECTCACHEVERSION  1
+
+//
+// P_BuildReject
+// Computes a conservative REJECT table into matrix
+//
+
+static void P_BuildReject(byte *matrix) {
+    portalgraph_t graph;
+    portalseg_t seg;
+    byte *vis;
+    byte *onpath;
+    int rowbytes = (numsectors + 7) / 8;
+    int starttime = I_GetTimeMS();
+    int i;
+    int j;
+    line_t *li;
+
+    P_NewPortalGraph(&graph, numsectors, numlines);
+
+    for(i = 0, li = lines; i < numlines; i++, li++) {
+        if(!li->frontsector || !li->backsector) {
+            continue;
+        }
+
+        if(!li->dx && !li->dy) {
+            continue;
+        }
+
+        // the back side of a linedef is on its left
+        seg.x1 = (double)li->v1->x / FRACUNIT;
+        seg.y1 = (double)li->v1->y / FRACUNIT;
+        seg.x2 = (double)li->v2->x / FRACUNIT;
+        seg.y2 = (double)li->v2->y / FRACUNIT;
+
+        P_AddPortal(&graph, li->frontsector - sectors, li->backsector - sectors, &seg);
+    }
+
+    P_FinishPortalGraph(&graph);
+
+    vis = (byte*)Z_Calloc(MAX(numsectors * rowbytes, 1), PU_STATIC, 0);
+    onpath = (byte*)Z_Calloc(MAX(numsectors, 1), PU_STATIC, 0);
+
+    for(i = 0; i < numsectors; i++) {
+        P_PortalFlow(&graph, i, vis + i * rowbytes, onpath, REJECTMAXWORK);
+    }
+
+    dmemset(matrix, 0, (numsectors * numsectors + 7) / 8);
+
+    // sight lines are reversible, so only reject if neither side can see
+    for(i = 0; i < numsectors; i++) {
+        for(j = 0; j < numsectors; j++) {
+            int pnum = i * numsectors + j;
+
+            if(!(vis[i * rowbytes + (j >> 3)] & (1 << (j & 7))) &&
+                    !(vis[j * rowbytes + (i >> 3)] & (1 << (i & 7)))) {
+                matrix[pnum >> 3] |= 1 << (pnum & 7);
+            }
+        }
+    }
+
+    Z_Free(vis);
+    Z_Free(onpath);
+    P_FreePortalGraph(&graph);
+
+    CON_DPrintf("P_BuildReject: %i sectors in %ims\n", numsectors, I_GetTimeMS() - starttime);
+}
+
+//
+// P_RejectFraction
+// Percentage of sector pairs rejected by a table
+//
+
+static int P_RejectFraction(byte *matrix) {
+    int total = numsectors * numsectors;
+    int rejected = 0;
+    int i;
+
+    if(!total) {
+        return 0;
+    }
+
+    for(i = 0; i < total; i++) {
+        if(matrix[i >> 3] & (1 << (i & 7))) {
+            rejected++;
+        }
+    }
+
+    return (int)(((int64)rejected * 100) / total);
+}
+
+//
+// P_ReadRejectCache
+//
+
+static dboolean P_ReadRejectCache(const char *filename, byte *matrix, int size) {
+    byte *data;
+    int length;
+    dboolean ok;
+
+    if(filename == NULL || (length = M_ReadFile(filename, &data)) == -1) {
+        return false;
+    }
+
+    ok = (length == size + 8 &&
+          data[0] == 'R' && data[1] == 'E' && data[2] == 'J' && data[3] == REJECTCACHEVERSION &&
+          (data[4] | (data[5] << 8) | (data[6] << 16) | (data[7] << 24)) == numsectors);
+
+    if(ok) {
+        dmemcpy(matrix, data + 8, size);
+    }
+
+    Z_Free(data);
+    return ok;
+}
+
+//
+// P_WriteRejectCache
+//
+
+static void P_WriteRejectCache(const char *filename, byte *matrix, int size) {
+    byte *data;
+
+    if(filename == NULL) {
+        return;
+    }
+
+    data = (byte*)Z_Malloc(size + 8, PU_STATIC, 0);
+
+    data[0] = 'R';
+    data[1] = 'E';
+    data[2] = 'J';
+    data[3] = REJECTCACHEVERSION;
+    data[4] = numsectors & 0xff;
+    data[5] = (numsectors >> 8) & 0xff;
+    data[6] = (numsectors >> 16) & 0xff;
+    data[7] = (numsectors >> 24) & 0xff;
+    dmemcpy(data + 8, matrix, size);
+
+    if(!M_WriteFile(filename, data, size + 8)) {
+        CON_Warnf("P_WriteRejectCache: couldn't write %s\n", filename);
+    }
+
+    Z_Free(data);
+}
+
+//
+// P_GenerateReject
+// Replaces rejectmatrix with a generated table, from the cache if possible
+//
+
+static void P_GenerateReject(dboolean usecache) {
+    int size = (numsectors * numsectors + 7) / 8;
+    char *filename;
+    byte *matrix;
+
+    matrix = (byte*)Z_Malloc(size, PU_LEVEL, 0);
+    filename = P_MapCacheFile("reject", rejectlumps, sizeof(rejectlumps) / sizeof(int));
+
+    if(!usecache || !P_ReadRejectCache(filename, matrix, size)) {
+        P_BuildReject(matrix);
+        P_WriteRejectCache(filename, matrix, size);
+    }
+
+    if(filename) {
+        free(filename);
+    }
+
+    CON_Printf(WHITE, "REJECT rejects %i%% of sector pairs (map lump %i%%)\n",
+               P_RejectFraction(matrix), P_RejectFraction(rejectmatrix));
+
+    if(rejectlump == NULL) {
+        rejectlump = rejectmatrix;
+    }
+    else {
+        Z_Free(rejectmatrix);
+    }
+
+    rejectmatrix = matrix;
+}
+
+//
+// P_SetupReject
+// Called after the map's REJECT lump is loaded, while the map lumps are
+// still cached
+//
+
+void P_SetupReject(void) {
+    int size = (numsectors * numsectors + 7) / 8;
+    int i;
+
+    rejectlump = NULL;
+
+    if(p_buildreject <= 0) {
+        return;
+    }
+
+    if(p_buildreject == 1) {
+        for(i = 0; i < size; i++) {
+            if(rejectmatrix[i]) {
+                return;
+            }
+        }
+    }
+
+    P_GenerateReject(true);
+}
+
+//
+// CMD_BuildReject
+// Rebuilds the table for the current map and refreshes the cache
+//
+
+static CMD(BuildReject) {
+    if(gamestate != GS_LEVEL) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    W_CacheMapLump(gamemap);
+    P_GenerateReject(false);
+    W_FreeMapLump();
+}
+
+//
+// P_InitReject
+//
+
+void P_InitReject(void) {
+    P_AddWorldState(&rejectlump, sizeof(rejectlump));
+
+    G_AddCommand("buildreject", CMD_BuildReject, 0);
+}
@@ -40,6 +40,7 @@
 #include "p_saveg.h"
 #include "d_englsh.h"
 #include "m_misc.h"
+#include "m_random.h"
 #include "doomdef.h" // added just so MSVC would shut up about warning C4761
 
 void G_DoLoadLevel(void);
@@ -51,11 +52,20 @@ void G_DoLoadLevel(void);
 #define SAVEGAME_EOF    0x464F45
 #define SAVEGAME_MOBJ   0x4A424F4D
 
+// FNV-1a
+#define STATEHASH_BASIS 2166136261u
+#define STATEHASH_PRIME 16777619u
+
 static FILE*    save_stream;
 static byte*    savebuffer;
 
 static unsigned long save_offset = 0;
 
+// P_HashState runs the writers into a hash instead of the file
+static dboolean     save_hashing = false;
+static unsigned int save_hash = 0;
+static int*         save_hashorder;     // list order by mobj index
+
 //
 // P_GetSaveGameName
 //
@@ -82,6 +92,11 @@ static byte saveg_read8(void) {
 }
 
 static void saveg_write8(byte value) {
+    if(save_hashing) {
+        save_hash = (save_hash ^ value) * STATEHASH_PRIME;
+        return;
+    }
+
     fwrite(&value, 1, 1, save_stream);
     save_offset++;
 }
@@ -213,13 +228,18 @@ static void saveg_setup_mobjread(void) {
     // read and add mobjs
     for(i = 0; i < savegmobjnum; i++) {
         savegmobj[i].index = i + 1;
-        savegmobj[i].mobj = (mobj_t*) Z_Calloc(sizeof(mobj_t), PU_LEVEL, NULL);
+        savegmobj[i].mobj = P_AllocMobj();
     }
 }
 
 static void saveg_write_mobjindex(mobj_t* mobj) {
     int i;
 
+    if(save_hashing) {
+        saveg_write32(mobj ? save_hashorder[mobj->index] : 0);
+        return;
+    }
+
     for(i = 0; i < savegmobjnum; i++) {
         if(savegmobj[i].mobj != mobj) {
             continue;
@@ -744,20 +764,24 @@ static void saveg_read_plat_t(void* data) {
     plat->sector->specialdata = plat;
 }
 
+//
+// Light effects, written as the thinkers they used to be
+//
+
 //
 // lightflash_t
 //
 
 static void saveg_write_lightflash_t(void* data) {
-    lightflash_t* lf = (lightflash_t*) data;
-    saveg_write32(lf->sector - sectors);
+    lighteffect_t* lf = (lighteffect_t*) data;
+    saveg_write32(lf->sector);
     saveg_write32(lf->count);
     saveg_write32(lf->special);
 }
 
 static void saveg_read_lightflash_t(void* data) {
-    lightflash_t* lf = (lightflash_t*) data;
-    lf->sector  = &sectors[saveg_read32()];
+    lighteffect_t* lf = (lighteffect_t*) data;
+    lf->sector  = saveg_read32();
     lf->count   = saveg_read32();
     lf->special = saveg_read32();
 }
@@ -767,23 +791,23 @@ static void saveg_read_lightflash_t(void* data) {
 //
 
 static void saveg_write_strobe_t(void* data) {
-    strobe_t* strobe = (strobe_t*) data;
-    saveg_write32(strobe->sector - sectors);
+    lighteffect_t* strobe = (lighteffect_t*) data;
+    saveg_write32(strobe->sector);
     saveg_write32(strobe->count);
-    saveg_write32(strobe->maxlight);
-    saveg_write32(strobe->darktime);
-    saveg_write32(strobe->brighttime);
+    saveg_write32(strobe->strobe.maxlight);
+    saveg_write32(strobe->strobe.darktime);
+    saveg_write32(strobe->strobe.brighttime);
     saveg_write32(strobe->special);
 }
 
 static void saveg_read_strobe_t(void* data) {
-    strobe_t* strobe = (strobe_t*) data;
-    strobe->sector      = &sectors[saveg_read32()];
-    strobe->count       = saveg_read32();
-    strobe->maxlight    = saveg_read32();
-    strobe->darktime    = saveg_read32();
-    strobe->brighttime  = saveg_read32();
-    strobe->special     = saveg_read32();
+    lighteffect_t* strobe = (lighteffect_t*) data;
+    strobe->sector              = saveg_read32();
+    strobe->count               = saveg_read32();
+    strobe->strobe.maxlight     = saveg_read32();
+    strobe->strobe.darktime     = saveg_read32();
+    strobe->strobe.brighttime   = saveg_read32();
+    strobe->special             = saveg_read32();
 }
 
 //
@@ -791,25 +815,25 @@ static void saveg_read_strobe_t(void* data) {
 //
 
 static void saveg_write_glow_t(void* data) {
-    glow_t* glow = (glow_t*) data;
-    saveg_write32(glow->sector - sectors);
-    saveg_write32(glow->type);
+    lighteffect_t* glow = (lighteffect_t*) data;
+    saveg_write32(glow->sector);
+    saveg_write32(glow->glow.type);
     saveg_write32(glow->count);
-    saveg_write32(glow->minlight);
-    saveg_write32(glow->direction);
-    saveg_write32(glow->maxlight);
+    saveg_write32(glow->glow.minlight);
+    saveg_write32(glow->glow.direction);
+    saveg_write32(glow->glow.maxlight);
     saveg_write32(glow->special);
 }
 
 static void saveg_read_glow_t(void* data) {
-    glow_t* glow = (glow_t*) data;
-    glow->sector    = &sectors[saveg_read32()];
-    glow->type      = saveg_read32();
-    glow->count     = saveg_read32();
-    glow->minlight  = saveg_read32();
-    glow->direction = saveg_read32();
-    glow->maxlight  = saveg_read32();
-    glow->special   = saveg_read32();
+    lighteffect_t* glow = (lighteffect_t*) data;
+    glow->sector            = saveg_read32();
+    glow->glow.type         = saveg_read32();
+    glow->count             = saveg_read32();
+    glow->glow.minlight     = saveg_read32();
+    glow->glow.direction    = saveg_read32();
+    glow->glow.maxlight     = saveg_read32();
+    glow->special           = saveg_read32();
 }
 
 //
@@ -817,15 +841,15 @@ static void saveg_read_glow_t(void* data) {
 //
 
 static void saveg_write_fireflicker_t(void *data) {
-    fireflicker_t* ff = (fireflicker_t*) data;
-    saveg_write32(ff->sector - sectors);
+    lighteffect_t* ff = (lighteffect_t*) data;
+    saveg_write32(ff->sector);
     saveg_write32(ff->count);
     saveg_write32(ff->special);
 }
 
 static void saveg_read_fireflicker_t(void *data) {
-    fireflicker_t* ff = (fireflicker_t*) data;
-    ff->sector  = &sectors[saveg_read32()];
+    lighteffect_t* ff = (lighteffect_t*) data;
+    ff->sector  = saveg_read32();
     ff->count   = saveg_read32();
     ff->special = saveg_read32();
 }
@@ -835,29 +859,23 @@ static void saveg_read_fireflicker_t(void *data) {
 //
 
 static void saveg_write_sequenceGlow_t(void *data) {
-    sequenceGlow_t* seq = (sequenceGlow_t*) data;
-    saveg_write32(seq->sector - sectors);
-    saveg_write32(seq->headsector ? (seq->headsector - sectors) + 1 : 0);
+    lighteffect_t* seq = (lighteffect_t*) data;
+    saveg_write32(seq->sector);
+    saveg_write32(seq->sequence.headsector + 1);
     saveg_write32(seq->count);
-    saveg_write32(seq->start);
-    saveg_write32(seq->index);
+    saveg_write32(seq->sequence.start);
+    saveg_write32(seq->sequence.index);
     saveg_write32(seq->special);
 }
 
 static void saveg_read_sequenceGlow_t(void *data) {
-    sequenceGlow_t* seq = (sequenceGlow_t*) data;
-    seq->sector         = &sectors[saveg_read32()];
-    int headsector = saveg_read32();
-    if(headsector == 0) {
-        seq->headsector = nullptr;
-    }
-    else {
-        seq->headsector = &sectors[headsector - 1];
-    }
-    seq->count          = saveg_read32();
-    seq->start          = saveg_read32();
-    seq->index          = saveg_read32();
-    seq->special        = saveg_read32();
+    lighteffect_t* seq = (lighteffect_t*) data;
+    seq->sector                 = saveg_read32();
+    seq->sequence.headsector    = saveg_read32() - 1;
+    seq->count                  = saveg_read32();
+    seq->sequence.start         = saveg_read32();
+    seq->sequence.index         = saveg_read32();
+    seq->special                = saveg_read32();
 }
 
 //
@@ -865,13 +883,13 @@ static void saveg_read_sequenceGlow_t(void *data) {
 //
 
 static void saveg_write_combine_t(void *data) {
-    combine_t* combine = (combine_t*) data;
-    saveg_write32(combine->sector - sectors);
+    lighteffect_t* combine = (lighteffect_t*) data;
+    saveg_write32(combine->sector);
 }
 
 static void saveg_read_combine_t(void *data) {
-    combine_t* combine = (combine_t*) data;
-    combine->sector = &sectors[saveg_read32()];
+    lighteffect_t* combine = (lighteffect_t*) data;
+    combine->sector = saveg_read32();
 }
 
 //
@@ -879,23 +897,23 @@ static void saveg_read_combine_t(void *data) {
 //
 
 static void saveg_write_lightmorph_t(void *data) {
-    lightmorph_t* morph = (lightmorph_t*) data;
-    saveg_write32(morph->dest - lights);
-    saveg_write32(morph->src - lights);
-    saveg_write32(morph->r);
-    saveg_write32(morph->g);
-    saveg_write32(morph->b);
-    saveg_write32(morph->inc);
+    lighteffect_t* morph = (lighteffect_t*) data;
+    saveg_write32(morph->sector);
+    saveg_write32(morph->morph.src);
+    saveg_write32(morph->morph.r);
+    saveg_write32(morph->morph.g);
+    saveg_write32(morph->morph.b);
+    saveg_write32(morph->morph.inc);
 }
 
 static void saveg_read_lightmorph_t(void *data) {
-    lightmorph_t* morph = (lightmorph_t*) data;
-    morph->dest = &lights[saveg_read32()];
-    morph->src  = &lights[saveg_read32()];
-    morph->r    = saveg_read32();
-    morph->g    = saveg_read32();
-    morph->b    = saveg_read32();
-    morph->inc  = saveg_read32();
+    lighteffect_t* morph = (lighteffect_t*) data;
+    morph->sector       = saveg_read32();
+    morph->morph.src    = saveg_read32();
+    morph->morph.r      = saveg_read32();
+    morph->morph.g      = saveg_read32();
+    morph->morph.b      = saveg_read32();
+    morph->morph.inc    = saveg_read32();
 }
 
 //
@@ -1256,14 +1274,24 @@ static void saveg_write_marker(int marker) {
 //
 
 dboolean P_WriteSaveGame(char* description, int slot) {
-    //char name[256];
+    dboolean ok;
 
     // setup game save file
-    // sprintf(name, SAVEGAMENAME"%d.dsg", slot);
     char* save_name = P_GetSaveGameName(slot);
-    save_stream = fopen(save_name, "wb");
+    ok = P_WriteSaveGameFile(description, save_name);
     free(save_name); // Allocated by I_GetUserFile
 
+    return ok;
+}
+
+//
+// P_WriteSaveGameFile
+// Writes the game to the given file rather than a save slot
+//
+
+dboolean P_WriteSaveGameFile(char* description, const char* filename) {
+    save_stream = fopen(filename, "wb");
+
     // success?
     if(save_stream == NULL) {
         return false;
@@ -1477,6 +1505,7 @@ void P_UnArchiveWorld(void) {
     for(i = 0, sec = sectors; i < numsectors; i++, sec++) {
         sec->floorheight    = INT2F(saveg_read16());
         sec->ceilingheight  = INT2F(saveg_read16());
+        P_SectorChanged(sec);
         sec->floorpic       = saveg_read16();
         sec->ceilingpic     = saveg_read16();
         sec->special        = saveg_read16();
@@ -1499,6 +1528,7 @@ void P_UnArchiveWorld(void) {
     for(i = 0, li = lines; i < numlines; i++, li++) {
         li->flags           = (saveg_read16() << 16);
         li->flags           = li->flags | (saveg_read16() & 0xFFFF);
+        P_SetLineGeometry(li);
         li->special         = saveg_read16();
         li->tag             = saveg_read16();
 
@@ -1530,6 +1560,9 @@ void P_UnArchiveWorld(void) {
         saveg_read_pad();
         light->tag          = saveg_read16();
     }
+
+    // sector and line tags may have changed
+    P_BuildTagIndex();
 }
 
 
@@ -1579,6 +1612,8 @@ void P_UnArchiveMobjs(void) {
 
     saveg_setup_mobjread();
     mobjhead.next = mobjhead.prev = &mobjhead;
+    P_ClearTIDs();
+    P_ClearFrameMobjs();
 
     for(i = 0; i < savegmobjnum; i++) {
         mobj = savegmobj[i].mobj;
@@ -1662,38 +1697,6 @@ struct {
         sizeof(plat_t)
     },
 
-    {
-        T_LightFlash,
-        tc_flash,
-        saveg_write_lightflash_t,
-        saveg_read_lightflash_t,
-        sizeof(lightflash_t)
-    },
-
-    {
-        T_StrobeFlash,
-        tc_strobe,
-        saveg_write_strobe_t,
-        saveg_read_strobe_t,
-        sizeof(strobe_t)
-    },
-
-    {
-        T_Glow,
-        tc_glow,
-        saveg_write_glow_t,
-        saveg_read_glow_t,
-        sizeof(glow_t)
-    },
-
-    {
-        T_FireFlicker,
-        tc_flicker,
-        saveg_write_fireflicker_t,
-        saveg_read_fireflicker_t,
-        sizeof(fireflicker_t)
-    },
-
     {
         T_CountdownTimer,
         tc_delay,
@@ -1726,14 +1729,6 @@ struct {
         sizeof(mobjfade_t)
     },
 
-    {
-        T_Sequence,
-        tc_sequence,
-        saveg_write_sequenceGlow_t,
-        saveg_read_sequenceGlow_t,
-        sizeof(sequenceGlow_t)
-    },
-
     {
         T_Quake,
         tc_quake,
@@ -1742,14 +1737,6 @@ struct {
         sizeof(quake_t)
     },
 
-    {
-        T_Combine,
-        tc_combine,
-        saveg_write_combine_t,
-        saveg_read_combine_t,
-        sizeof(combine_t)
-    },
-
     {
         T_LaserThinker,
         tc_laser,
@@ -1766,14 +1753,6 @@ struct {
         sizeof(splitmove_t)
     },
 
-    {
-        T_LightMorph,
-        tc_morph,
-        saveg_write_lightmorph_t,
-        saveg_read_lightmorph_t,
-        sizeof(lightmorph_t)
-    },
-
     {
         T_MobjExplode,
         tc_exp,saveg_write_mobjexp_t,
@@ -1790,6 +1769,86 @@ struct {
     }
 };
 
+// by lighteffecttype_t
+struct {
+    int     type;
+    void (*writefunc)(void* le);
+    void (*readfunc)(void* le);
+} saveg_lighteffects[NUMLIGHTEFFECTS] = {
+    { tc_flicker,   saveg_write_fireflicker_t,  saveg_read_fireflicker_t },
+    { tc_flash,     saveg_write_lightflash_t,   saveg_read_lightflash_t },
+    { tc_strobe,    saveg_write_strobe_t,       saveg_read_strobe_t },
+    { tc_glow,      saveg_write_glow_t,         saveg_read_glow_t },
+    { tc_sequence,  saveg_write_sequenceGlow_t, saveg_read_sequenceGlow_t },
+    { tc_combine,   saveg_write_combine_t,      saveg_read_combine_t },
+    { tc_morph,     saveg_write_lightmorph_t,   saveg_read_lightmorph_t }
+};
+
+//
+// saveg_write_lightbatch
+// Writes each live effect of the batch as the thinker it stands for
+//
+
+static void saveg_write_lightbatch(lightbatch_t* batch) {
+    lighteffect_t*  le;
+    int             count;
+    int             i;
+
+    le = P_LightBatchEffects(batch, &count);
+
+    for(i = 0; i < count; i++, le++) {
+        if(le->removed) {
+            continue;
+        }
+
+        saveg_write8(saveg_lighteffects[le->type].type);
+        saveg_write_pad();
+        saveg_lighteffects[le->type].writefunc(le);
+        saveg_write32(le->id == macroeffect ? 1 : 0);
+    }
+}
+
+//
+// saveg_read_lighteffect
+// Starts the effect a light thinker of class tclass was saved as
+//
+
+static dboolean saveg_read_lighteffect(byte tclass) {
+    lighteffect_t   le;
+    int             id;
+    int             i;
+
+    for(i = 0; i < NUMLIGHTEFFECTS; i++) {
+        if(tclass == saveg_lighteffects[i].type) {
+            break;
+        }
+    }
+
+    if(i == NUMLIGHTEFFECTS) {
+        return false;
+    }
+
+    dmemset(&le, 0, sizeof(le));
+    le.type = i;
+
+    saveg_read_pad();
+    saveg_lighteffects[i].readfunc(&le);
+
+    if(le.type == le_combine) {
+        P_CombineLightSpecials(&sectors[le.sector]);
+        saveg_read32();
+        return true;
+    }
+
+    id = P_AddLightEffect(&le);
+
+    if(saveg_read32()) {
+        macroeffect = id;
+    }
+
+    return true;
+}
+
 //
 // P_ArchiveSpecials
 //
@@ -1815,6 +1874,11 @@ void P_ArchiveSpecials(void) {
             continue;
         }
 
+        if(th->function.acp1 == (actionf_p1)T_LightBatch) {
+            saveg_write_lightbatch((lightbatch_t*)th);
+            continue;
+        }
+
         for(i = 0; saveg_specials[i].type != tc_endthinkers; i++) {
             if(th->function.acp1 == (actionf_p1)saveg_specials[i].function) {
                 saveg_write8(saveg_specials[i].type);
@@ -1846,12 +1910,13 @@ void P_UnArchiveSpecials(void) {
     currentthinker = thinkercap.next;
     while(currentthinker != &thinkercap) {
         next = currentthinker->next;
-        Z_Free(currentthinker);
+        P_FreeThinker(currentthinker);
 
         currentthinker = next;
     }
 
     thinkercap.prev = thinkercap.next  = &thinkercap;
+    P_ClearLightEffects();
 
     while(1) {
         tclass = saveg_read8();
@@ -1864,10 +1929,14 @@ void P_UnArchiveSpecials(void) {
             I_Error("P_UnarchiveSpecials: Unknown tclass %i in savegame", tclass);
         }
 
+        if(saveg_read_lighteffect(tclass)) {
+            continue;
+        }
+
         for(i = 0; saveg_specials[i].type != tc_endthinkers; i++) {
             if(tclass == saveg_specials[i].type) {
                 saveg_read_pad();
-                thinker = Z_Malloc(saveg_specials[i].structsize, PU_LEVEL, NULL);
+                thinker = P_AllocThinker(saveg_specials[i].structsize, saveg_specials[i].function);
                 saveg_specials[i].readfunc(thinker);
 
                 ((thinker_t*)thinker)->function.acp1 = saveg_specials[i].function;
@@ -1893,10 +1962,6 @@ void P_UnArchiveSpecials(void) {
                     P_AddActivePlat(thinker);
                     break;
 
-                case tc_combine:
-                    P_CombineLightSpecials(((combine_t*)thinker)->sector);
-                    P_RemoveThinker(thinker);
-                    break;
                 }
 
                 if(((thinker_t*)thinker)->function.acp1 != NULL) {
@@ -1983,3 +2048,373 @@ void P_UnArchiveMacros(void) {
 }
 
 
+
+//------------------------------------------------------------------------
+//
+// State hashing
+//
+// Hashes of everything that decides how play goes on, taken every tic to
+// check that two runs of a demo stay in step. What only the renderer or
+// the playloop's own bookkeeping looks at (validcount, blockmap and
+// sector links, interpolation) is left out, so reworking how the
+// playloop gets there doesn't read as a desync.
+//
+//------------------------------------------------------------------------
+
+//
+// saveg_hash_mobj
+//
+
+static unsigned int saveg_hash_mobj(mobj_t* mo) {
+    save_hash = STATEHASH_BASIS;
+
+    saveg_write32(mo->type);
+    saveg_write32(mo->x);
+    saveg_write32(mo->y);
+    saveg_write32(mo->z);
+    saveg_write32(mo->momx);
+    saveg_write32(mo->momy);
+    saveg_write32(mo->momz);
+    saveg_write32(mo->floorz);
+    saveg_write32(mo->ceilingz);
+    saveg_write32(mo->radius);
+    saveg_write32(mo->height);
+    saveg_write32(mo->angle);
+    saveg_write32(mo->pitch);
+    saveg_write32(mo->subsector - subsectors);
+    saveg_write32(mo->flags);
+    saveg_write32(mo->blockflag);
+    saveg_write32(mo->health);
+    saveg_write32(mo->state - states);
+    saveg_write32(mo->tics);
+    saveg_write32(mo->sprite);
+    saveg_write32(mo->frame);
+    saveg_write32(mo->alpha);
+    saveg_write32(mo->movedir);
+    saveg_write32(mo->movecount);
+    saveg_write32(mo->reactiontime);
+    saveg_write32(mo->threshold);
+    saveg_write32(mo->tid);
+    saveg_write32(mo->player ? mo->player - players + 1 : 0);
+    saveg_write_mobjindex(mo->target);
+    saveg_write_mobjindex(mo->tracer);
+    saveg_write32(mo->mobjfunc == P_RespawnSpecials ? 1 : 0);
+
+    return save_hash;
+}
+
+//
+// saveg_hash_sector
+//
+
+static unsigned int saveg_hash_sector(sector_t* sec) {
+    int i;
+
+    save_hash = STATEHASH_BASIS;
+
+    saveg_write32(sec->floorheight);
+    saveg_write32(sec->ceilingheight);
+    saveg_write16(sec->floorpic);
+    saveg_write16(sec->ceilingpic);
+    saveg_write16(sec->lightlevel);
+    saveg_write16(sec->special);
+    saveg_write16(sec->tag);
+    saveg_write16(sec->flags);
+    saveg_write32(sec->xoffset);
+    saveg_write32(sec->yoffset);
+    saveg_write_mobjindex(sec->soundtarget);
+
+    for(i = 0; i < 5; i++) {
+        saveg_write16(sec->colors[i]);
+    }
+
+    return save_hash;
+}
+
+//
+// saveg_hash_line
+//
+
+static unsigned int saveg_hash_line(line_t* li) {
+    side_t* si;
+    int i;
+
+    save_hash = STATEHASH_BASIS;
+
+    saveg_write32(li->flags);
+    saveg_write16(li->special);
+    saveg_write16(li->tag);
+
+    for(i = 0; i < 2; i++) {
+        if(li->sidenum[i] == NO_SIDE_INDEX) {
+            continue;
+        }
+
+        si = &sides[li->sidenum[i]];
+
+        saveg_write32(si->textureoffset);
+        saveg_write32(si->rowoffset);
+        saveg_write16(si->toptexture);
+        saveg_write16(si->bottomtexture);
+        saveg_write16(si->midtexture);
+    }
+
+    return save_hash;
+}
+
+//
+// saveg_hash_special
+// Hashes a thinker the savegame would keep and returns its class,
+// or -1 for one it wouldn't
+//
+
+static int saveg_hash_special(thinker_t* th, unsigned int* hash) {
+    int i;
+
+    save_hash = STATEHASH_BASIS;
+
+    if(th->function.acv == (actionf_v)NULL) {
+        for(i = 0; i < MAXCEILINGS; i++) {
+            if(activeceilings[i] == (ceiling_t *)th) {
+                saveg_write_ceiling_t(th);
+                *hash = save_hash;
+                return tc_ceiling;
+            }
+        }
+
+        return -1;
+    }
+
+    for(i = 0; saveg_specials[i].type != tc_endthinkers; i++) {
+        if(th->function.acp1 == (actionf_p1)saveg_specials[i].function) {
+            saveg_specials[i].writefunc(th);
+            saveg_write32(th == macrothinker ? 1 : 0);
+            *hash = save_hash;
+            return saveg_specials[i].type;
+        }
+    }
+
+    return -1;
+}
+
+//
+// saveg_hash_effect
+// The same for a light effect
+//
+
+static int saveg_hash_effect(lighteffect_t* le, unsigned int* hash) {
+    save_hash = STATEHASH_BASIS;
+
+    saveg_lighteffects[le->type].writefunc(le);
+    saveg_write32(le->id == macroeffect ? 1 : 0);
+    *hash = save_hash;
+
+    return saveg_lighteffects[le->type].type;
+}
+
+//
+// saveg_fold
+//
+
+static void saveg_fold(unsigned int* hash, unsigned int value) {
+    *hash = (*hash ^ value) * STATEHASH_PRIME;
+}
+
+//
+// saveg_setup_hashorder
+// Numbers mobjs in list order, as P_ArchiveMobjs would
+//
+
+static void saveg_setup_hashorder(void) {
+    mobj_t* mobj;
+    int num = 0;
+
+    save_hashorder = (int*)Z_Alloca(P_MobjPoolSize() * sizeof(int));
+    dmemset(save_hashorder, 0, P_MobjPoolSize() * sizeof(int));
+
+    for(mobj = mobjhead.next; mobj != &mobjhead; mobj = mobj->next) {
+        if(mobj->mobjfunc == P_SafeRemoveMobj) {
+            continue;
+        }
+
+        save_hashorder[mobj->index] = ++num;
+    }
+}
+
+//
+// P_HashState
+// Fills hashes[NUMSTATEHASHES] for the world as it stands
+//
+
+void P_HashState(unsigned int* hashes) {
+    mobj_t*     mobj;
+    thinker_t*  th;
+    lighteffect_t* le;
+    int         count;
+    unsigned int hash;
+    int         tclass;
+    int         i;
+
+    for(i = 0; i < NUMSTATEHASHES; i++) {
+        hashes[i] = STATEHASH_BASIS;
+    }
+
+    saveg_setup_hashorder();
+    save_hashing = true;
+
+    for(mobj = mobjhead.next; mobj != &mobjhead; mobj = mobj->next) {
+        if(mobj->mobjfunc == P_SafeRemoveMobj) {
+            continue;
+        }
+
+        saveg_fold(&hashes[SH_MOBJS], saveg_hash_mobj(mobj));
+    }
+
+    for(i = 0; i < MAXPLAYERS; i++) {
+        if(!playeringame[i]) {
+            continue;
+        }
+
+        save_hash = STATEHASH_BASIS;
+        saveg_write_player_t(&players[i]);
+        saveg_fold(&hashes[SH_PLAYERS], save_hash);
+    }
+
+    for(i = 0; i < numsectors; i++) {
+        saveg_fold(&hashes[SH_WORLD], saveg_hash_sector(&sectors[i]));
+    }
+
+    for(i = 0; i < numlines; i++) {
+        saveg_fold(&hashes[SH_WORLD], saveg_hash_line(&lines[i]));
+    }
+
+    save_hash = STATEHASH_BASIS;
+
+    for(i = 0; i < numlights; i++) {
+        saveg_write8(lights[i].r);
+        saveg_write8(lights[i].g);
+        saveg_write8(lights[i].b);
+        saveg_write8(lights[i].active_r);
+        saveg_write8(lights[i].active_g);
+        saveg_write8(lights[i].active_b);
+    }
+
+    saveg_fold(&hashes[SH_WORLD], save_hash);
+
+    for(th = thinkercap.next; th != &thinkercap; th = th->next) {
+        if(th->function.acp1 == (actionf_p1)T_LightBatch) {
+            le = P_LightBatchEffects((lightbatch_t*)th, &count);
+
+            for(i = 0; i < count; i++, le++) {
+                if(!le->removed) {
+                    tclass = saveg_hash_effect(le, &hash);
+                    saveg_fold(&hashes[SH_SPECIALS], tclass);
+                    saveg_fold(&hashes[SH_SPECIALS], hash);
+                }
+            }
+
+            continue;
+        }
+
+        tclass = saveg_hash_special(th, &hash);
+
+        if(tclass != -1) {
+            saveg_fold(&hashes[SH_SPECIALS], tclass);
+            saveg_fold(&hashes[SH_SPECIALS], hash);
+        }
+    }
+
+    save_hash = STATEHASH_BASIS;
+    P_ArchiveMacros();
+    saveg_fold(&hashes[SH_SPECIALS], save_hash);
+
+    save_hash = STATEHASH_BASIS;
+
+    for(i = 0; i < NUMPRCLASS; i++) {
+        saveg_write32(rng.seed[i]);
+    }
+
+    saveg_write32(rng.rndindex);
+    saveg_write32(rng.prndindex);
+    saveg_write32(gametic - basetic);
+    hashes[SH_RANDOM] = save_hash;
+
+    save_hashing = false;
+}
+
+//
+// P_DumpStateHashes
+// Writes a line per object to f, so two dumps of the same tic can be
+// matched up to find what differs
+//
+
+void P_DumpStateHashes(FILE* f, int tic) {
+    mobj_t*     mobj;
+    thinker_t*  th;
+    lighteffect_t* le;
+    int         count;
+    unsigned int hash;
+    int         tclass;
+    int         num;
+    int         i;
+
+    saveg_setup_hashorder();
+    save_hashing = true;
+
+    num = 0;
+    for(mobj = mobjhead.next; mobj != &mobjhead; mobj = mobj->next) {
+        if(mobj->mobjfunc == P_SafeRemoveMobj) {
+            continue;
+        }
+
+        fprintf(f, "dump %i mobj %i %i %08x\n", tic,
+                ++num, mobj->type, saveg_hash_mobj(mobj));
+    }
+
+    for(i = 0; i < numsectors; i++) {
+        fprintf(f, "dump %i sector %i %i %08x\n", tic,
+                i, sectors[i].special, saveg_hash_sector(&sectors[i]));
+    }
+
+    for(i = 0; i < numlines; i++) {
+        fprintf(f, "dump %i line %i %i %08x\n", tic,
+                i, lines[i].special, saveg_hash_line(&lines[i]));
+    }
+
+    for(i = 0; i < MAXPLAYERS; i++) {
+        if(!playeringame[i]) {
+            continue;
+        }
+
+        save_hash = STATEHASH_BASIS;
+        saveg_write_player_t(&players[i]);
+        fprintf(f, "dump %i player %i %i %08x\n", tic,
+                i, players[i].health, save_hash);
+    }
+
+    num = 0;
+    for(th = thinkercap.next; th != &thinkercap; th = th->next) {
+        if(th->function.acp1 == (actionf_p1)T_LightBatch) {
+            le = P_LightBatchEffects((lightbatch_t*)th, &count);
+
+            for(i = 0; i < count; i++, le++) {
+                if(!le->removed) {
+                    tclass = saveg_hash_effect(le, &hash);
+                    fprintf(f, "dump %i special %i %i %08x\n", tic,
+                            ++num, tclass, hash);
+                }
+            }
+
+            continue;
+        }
+
+        tclass = saveg_hash_special(th, &hash);
+
+        if(tclass != -1) {
+            fprintf(f, "dump %i special %i %i %08x\n", tic,
+                    ++num, tclass, hash);
+        }
+    }
+
+    save_hashing = false;
+}
@@ -37,6 +37,7 @@
 
 char *P_GetSaveGameName(int num);
 dboolean P_WriteSaveGame(char* description, int slot);
+dboolean P_WriteSaveGameFile(char* description, const char* filename);
 dboolean P_ReadSaveGame(char* name);
 dboolean P_QuickReadSaveHeader(char* name, char* date, int* thumbnail, int* skill, int* map);
 
@@ -53,4 +54,17 @@ void P_UnArchiveSpecials(void);
 void P_ArchiveMacros(void);
 void P_UnArchiveMacros(void);
 
+// Per tic state hashes, for -statelog
+enum {
+    SH_MOBJS,
+    SH_PLAYERS,
+    SH_WORLD,
+    SH_SPECIALS,
+    SH_RANDOM,
+    NUMSTATEHASHES
+};
+
+void P_HashState(unsigned int* hashes);
+void P_DumpStateHashes(FILE* f, int tic);
+
 #endif
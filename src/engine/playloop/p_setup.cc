@@ -50,6 +50,8 @@
 #include "m_random.h"
 #include "z_zone.h"
 #include "sc_main.h"
+#include "md5.h"
+#include "p_trace.h"
 #include <map>
 #include <imp/Wad>
 #include "Map.hh"
@@ -118,9 +120,9 @@ static skydef_t*    skydefs;
 // Blockmap size.
 int                 bmapwidth;
 int                 bmapheight;     // size in mapblocks
-short*              blockmap;       // int for larger maps
+int*                blockmap;
 // offsets in blockmap are from here
-short*              blockmaplump;
+int*                blockmaplump;
 // origin of block map
 fixed_t             bmaporgx;
 fixed_t             bmaporgy;
@@ -304,10 +306,8 @@ void P_LoadSectors(int lump) {
 
         ss->tag = SHORT(ms->tag);
         ss->thinglist = NULL;
-        ss->frame_z1[0] = ss->floorheight;
-        ss->frame_z1[1] = ss->floorheight;
-        ss->frame_z2[0] = ss->ceilingheight;
-        ss->frame_z2[1] = ss->ceilingheight;
+        ss->frame_z1 = ss->floorheight;
+        ss->frame_z2 = ss->ceilingheight;
 
         for(j = 0; j < numskydef; j++) {
             if(ss->ceilingpic == wad::find(skydefs[j].flat)->section_index()) {
@@ -728,17 +728,52 @@ void P_LoadSideDefs(int lump) {
     }
 }
 
+//
+// P_MapCacheFile
+// Path of a file caching data generated for the current map, named
+// after a hash of the map lumps it was built from
+//
+
+char *P_MapCacheFile(const char *prefix, const int *maplumps, int count) {
+    md5_context_t md5;
+    md5_digest_t digest;
+    char name[64];
+    int len;
+    int i;
+
+    MD5_Init(&md5);
+
+    for(i = 0; i < count; i++) {
+        MD5_Update(&md5, (byte*)W_GetMapLump(maplumps[i]), W_MapLumpLength(maplumps[i]));
+    }
+
+    MD5_Final(digest, &md5);
+
+    len = snprintf(name, sizeof(name), "%s-", prefix);
+    for(i = 0; i < 16; i++) {
+        len += snprintf(name + len, sizeof(name) - len, "%02x", digest[i]);
+    }
+    snprintf(name + len, sizeof(name) - len, ".%s", prefix);
+
+    return I_GetUserFile(name);
+}
+
 //
 // P_LoadReject
 //
 
 void P_LoadReject(int lump) {
     int size = 0;
+    int length = 0;
 
-    size = W_MapLumpLength(lump);
+    // a short or missing lump rejects nothing for the sectors it lacks
+    size = (numsectors * numsectors + 7) / 8;
+    length = MIN(W_MapLumpLength(lump), size);
     rejectmatrix = (byte*)Z_Malloc(size, PU_LEVEL, 0);
     dmemset(rejectmatrix, 0, size);
-    dmemcpy(rejectmatrix, (byte*)W_GetMapLump(lump), size);
+    dmemcpy(rejectmatrix, (byte*)W_GetMapLump(lump), length);
+
+    P_SetupReject();
 }
 
 static const char *bmaperrormsg;
@@ -751,15 +786,15 @@ static const char *bmaperrormsg;
 static dboolean P_VerifyBlockMap(int count) {
     dboolean isvalid = true;
     int x, y;
-    short *maxoffs = blockmaplump + count;
+    int *maxoffs = blockmaplump + count;
 
     bmaperrormsg = NULL;
 
     for(y = 0; y < bmapheight; ++y) {
         for(x = 0; x < bmapwidth; ++x) {
             int offset;
-            short *list, *tmplist;
-            short *blockoffset;
+            int *list, *tmplist;
+            int *blockoffset;
 
             offset = y * bmapwidth + x;
             blockoffset = blockmaplump + offset + 4;
@@ -772,6 +807,13 @@ static dboolean P_VerifyBlockMap(int count) {
             }
 
             offset = *blockoffset;
+
+            if(offset < 0 || offset >= count) {
+                isvalid = false;
+                bmaperrormsg = "offset out of range";
+                break;
+            }
+
             list   = blockmaplump + offset;
 
             // scan forward for a -1 terminator before maxoffs
@@ -820,32 +862,50 @@ static dboolean P_VerifyBlockMap(int count) {
 void P_LoadBlockMap(int lump) {
     int         i;
     int         count;
-    void*       mapdata;
-    size_t      len;
+    short*      mapdata;
+    dboolean    valid;
 
-    mapdata = W_GetMapLump(lump);
-    len = W_MapLumpLength(lump);
+    mapdata = (short*)W_GetMapLump(lump);
+    count = W_MapLumpLength(lump) / 2;
 
     //
-    // GhostlyDeath <10/3/11> -- Reallocate and copy since
-    // W_GetMapLump() doesn't quite work like we want it to on 64-bit
-    // it works, just the way it is laid out
+    // Widen to ints, reading offsets and line numbers as unsigned so
+    // lumps up to 64k entries work. Maps that need more get a built one.
     //
-    blockmaplump = (short*) Z_Malloc(len, PU_LEVEL, NULL);
-    memmove(blockmaplump, mapdata, len);
+    blockmaplump = (int*) Z_Malloc(MAX(count, 4) * sizeof(int), PU_LEVEL, NULL);
     blockmap = blockmaplump + 4;
-    count = len / 2;
 
     for(i = 0; i < count; i++) {
-        blockmaplump[i] = SHORT(blockmaplump[i]);
+        short t = SHORT(mapdata[i]);
+
+        if(i < 4) {
+            blockmaplump[i] = t;
+        }
+        else {
+            blockmaplump[i] = (t == -1) ? -1 : (t & 0xffff);
+        }
     }
 
-    bmaporgx = INT2F(blockmaplump[0]);
-    bmaporgy = INT2F(blockmaplump[1]);
-    bmapwidth = blockmaplump[2];
-    bmapheight = blockmaplump[3];
+    if(count >= 4) {
+        bmaporgx = INT2F(blockmaplump[0]);
+        bmaporgy = INT2F(blockmaplump[1]);
+        bmapwidth = blockmaplump[2];
+        bmapheight = blockmaplump[3];
+
+        valid = (bmapwidth > 0 && bmapheight > 0 && P_VerifyBlockMap(count));
 
-    if(!P_VerifyBlockMap(count)) {
+        // offsets past 64k wrapped around when the lump was written
+        if(valid && count > 0x10000) {
+            bmaperrormsg = "too large for 16-bit offsets";
+            valid = false;
+        }
+    }
+    else {
+        bmaperrormsg = "missing lump";
+        valid = false;
+    }
+
+    if(!P_SetupBlockMap(valid ? NULL : bmaperrormsg)) {
         I_Error("P_LoadBlockMap: Bad blockmap - %s", bmaperrormsg);
     }
 
@@ -853,6 +913,8 @@ void P_LoadBlockMap(int lump) {
     count = sizeof(*blocklinks)* bmapwidth*bmapheight;
     blocklinks = (mobj_t**) Z_Malloc(count,PU_LEVEL, 0);
     dmemset(blocklinks, 0, count);
+
+    P_ClearThingGrid();
 }
 
 
@@ -1050,16 +1112,24 @@ void P_SetupLevel(int map, int playermask, skill_t skill) {
     P_LoadMacros(ML_MACROS);
     P_LoadVertexes(ML_VERTEXES);
     P_LoadSectors(ML_SECTORS);
+    P_SetupFrameStates();
     P_LoadSideDefs(ML_SIDEDEFS);
     P_LoadLineDefs(ML_LINEDEFS);
     P_LoadSubsectors(ML_SSECTORS);
     P_LoadBlockMap(ML_BLOCKMAP);
     P_LoadNodes(ML_NODES);
+    R_SetupPointGrid();
     P_LoadSegs(ML_SEGS);
     P_LoadLeafs(ML_LEAFS);
+    P_SetupPVS();
     P_LoadReject(ML_REJECT);
     P_LoadLights(ML_LIGHTS);
     P_GroupLines();
+    P_BuildLineGeometry();
+    P_BuildTagIndex();
+    P_BuildSoundGraph();
+    P_ClearTouching();
+    P_ClearLightEffects();
     P_LoadThings(ML_THINGS);
     W_FreeMapLump();
 
@@ -1091,7 +1161,10 @@ void P_SetupLevel(int map, int playermask, skill_t skill) {
     }
 
     // preload graphics
-    R_PrecacheLevel();
+    if(!headless) {
+        R_PrecacheLevel();
+    }
+
     R_SetupLevel();
 
     Z_CheckHeap();
@@ -1099,6 +1172,27 @@ void P_SetupLevel(int map, int playermask, skill_t skill) {
     CON_DPrintf("Used memory: %d kb\n", Z_FreeMemory() >> 10);
 }
 
+//
+// P_LoadMapGeometry
+// Loads just the BSP and line data of a map, for tools that work on
+// the geometry without starting a level
+//
+
+void P_LoadMapGeometry(int map) {
+    P_InitTextureHashTable();
+
+    W_CacheMapLump(map);
+    P_LoadMacros(ML_MACROS);
+    P_LoadVertexes(ML_VERTEXES);
+    P_LoadSectors(ML_SECTORS);
+    P_LoadSideDefs(ML_SIDEDEFS);
+    P_LoadLineDefs(ML_LINEDEFS);
+    P_LoadSubsectors(ML_SSECTORS);
+    P_LoadNodes(ML_NODES);
+    P_LoadSegs(ML_SEGS);
+    P_LoadLeafs(ML_LEAFS);
+}
+
 //
 // P_InitMapInfo
 //
@@ -1441,6 +1535,22 @@ static void P_InitSkyDef(void) {
 
 void P_Init(void) {
     SC_Init();
+    P_InitWorld();
+    P_InitThinkerPools();
+    P_InitSight();
+    P_InitMovePlans();
+    P_InitPVS();
+    P_InitReject();
+    P_InitGridTrace();
+    P_InitMultiTrace();
+    P_InitBlockMap();
+    P_InitThingGrid();
+    P_InitTouching();
+    P_InitLineGeometry();
+    P_InitTags();
+    P_InitNoise();
+    P_InitFrameStates();
+    P_InitLightEffects();
     P_InitPicAnims();
     R_InitSprites(sprnames);
     P_InitMapInfo();
@@ -37,6 +37,12 @@ void P_SetupLevel(int map, int playermask, skill_t skill);
 // Called by startup code.
 void P_Init(void);
 
+// Loads only the geometry of a map, for offline tools.
+void P_LoadMapGeometry(int map);
+
+// Builds and caches the PVS of every map (-buildpvs).
+void P_BuildAllPVS(void);
+
 
 //
 // [kex] mapinfo
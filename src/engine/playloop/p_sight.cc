@@ -27,25 +27,103 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <imp/Property>
+
 #include "doomdef.h"
 #include "m_fixed.h"
 #include "i_system.h"
+#include "i_thread.h"
 #include "p_local.h"
+#include "p_trace.h"
 #include "doomstat.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+BoolProperty p_parallelsight("p_parallelsight", "Run monster sight checks on worker threads", true);
+IntProperty p_sightcache("p_sightcache", "Cache sight checks (2 = verify hits with a full trace)", 1);
+
+// still used by the aiming code in p_map
+fixed_t     topslope;
+fixed_t     bottomslope;
+
+int         sightcounts[3];
+int         sightcachecounts[2];    // hits, misses
+
+#define SIGHTSECTORS    16      // sectors a cacheable trace may cross
 
 //
-// P_CheckSight
+// Sight trace context
 //
-fixed_t     sightzstart;        // eye z of looker
-fixed_t     topslope;
-fixed_t     bottomslope;        // slopes to top and bottom of target
+// Everything a single sight trace needs, so that several traces can run at
+// once on different threads. Lines are marked as checked in the context's
+// own linevalid array rather than with the global validcount.
+//
+
+typedef struct {
+    fixed_t     sightzstart;    // eye z of looker
+    fixed_t     topslope;
+    fixed_t     bottomslope;    // slopes to top and bottom of target
+
+    divline_t   strace;         // from t1 to t2
+    fixed_t     t2x;
+    fixed_t     t2y;
+
+    int         validcount;
+    int         *linevalid;     // per-line validcount; freed with the level
+
+    int         counts[3];      // rejected, traced, rejected by map lump
+
+    // two sided lines crossed by the last trace, for the sight cache
+    int         numsectors;
+    int         sectors[SIGHTSECTORS];
+    dboolean    overflow;
+
+    gridtrace_t grid;           // for p_gridtrace
+} sighttrace_t;
+
+#define MAXSIGHTCONTEXTS    64
+
+static sighttrace_t sightcontexts[MAXSIGHTCONTEXTS];
 
-divline_t   strace;             // from t1 to t2
-fixed_t     t2x;
-fixed_t     t2y;
+//
+// P_PrepareSightContext
+// Makes sure the context has a line mark array for the current level.
+//
 
-int         sightcounts[2];
+static void P_PrepareSightContext(sighttrace_t *st) {
+    if(st->linevalid == NULL) {
+        // owner is cleared when PU_LEVEL is freed
+        Z_Calloc(numlines * sizeof(int), PU_LEVEL, &st->linevalid);
+        st->validcount = 0;
+    }
 
+    if(p_gridtrace) {
+        P_PrepareGridTrace(&st->grid);
+    }
+}
+
+//
+// P_NoteSightSector
+// Remembers a sector whose heights the current trace depends on.
+//
+
+static void P_NoteSightSector(sighttrace_t *st, int index) {
+    int i;
+
+    for(i = 0; i < st->numsectors; i++) {
+        if(st->sectors[i] == index) {
+            return;
+        }
+    }
+
+    if(st->numsectors == SIGHTSECTORS) {
+        st->overflow = true;
+        return;
+    }
+
+    st->sectors[st->numsectors++] = index;
+}
 
 //
 // P_DivlineSide
@@ -126,27 +204,81 @@ fixed_t P_InterceptVector2(divline_t* v2, divline_t* v1) {
     return frac;
 }
 
+//
+// P_SightOpening
+// Narrows the slopes through the opening of a crossed two sided line.
+// Returns false once nothing can be seen through it.
+//
+
+static dboolean P_SightOpening(sighttrace_t *st, int frontnum, int backnum, fixed_t frac) {
+    geosector_t *front = &geosectors[frontnum];
+    geosector_t *back = &geosectors[backnum];
+    fixed_t opentop;
+    fixed_t openbottom;
+    fixed_t slope;
+
+    P_NoteSightSector(st, frontnum);
+    P_NoteSightSector(st, backnum);
+
+    // no wall to block sight with?
+    if(front->floorheight == back->floorheight
+            && front->ceilingheight == back->ceilingheight) {
+        return true;
+    }
+
+    // possible occluder
+    // because of ceiling height differences
+    if(front->ceilingheight < back->ceilingheight) {
+        opentop = front->ceilingheight;
+    }
+    else {
+        opentop = back->ceilingheight;
+    }
+
+    // because of ceiling height differences
+    if(front->floorheight > back->floorheight) {
+        openbottom = front->floorheight;
+    }
+    else {
+        openbottom = back->floorheight;
+    }
+
+    // quick test for totally closed doors
+    if(openbottom >= opentop) {
+        return false;    // stop
+    }
+
+    if(front->floorheight != back->floorheight) {
+        slope = FixedDiv(openbottom - st->sightzstart , frac);
+        if(slope > st->bottomslope) {
+            st->bottomslope = slope;
+        }
+    }
+
+    if(front->ceilingheight != back->ceilingheight) {
+        slope = FixedDiv(opentop - st->sightzstart , frac);
+        if(slope < st->topslope) {
+            st->topslope = slope;
+        }
+    }
+
+    return st->topslope > st->bottomslope;
+}
+
 //
 // P_CrossSubsector
-// Returns true if strace crosses the given subsector successfully.
+// Returns true if the trace crosses the given subsector successfully.
 //
 
-dboolean P_CrossSubsector(int num) {
+static dboolean P_CrossSubsector(sighttrace_t *st, int num) {
     seg_t*          seg;
     line_t*         line;
+    geoline_t*      gl;
     int             s1;
     int             s2;
     int             count;
     subsector_t*    sub;
-    sector_t*       front;
-    sector_t*       back;
-    fixed_t         opentop;
-    fixed_t         openbottom;
     divline_t       divl;
-    vertex_t*       v1;
-    vertex_t*       v2;
-    fixed_t         frac;
-    fixed_t         slope;
 
 #ifdef RANGECHECK
     if(num>=numsubsectors)
@@ -168,28 +300,27 @@ dboolean P_CrossSubsector(int num) {
         }
 
         // allready checked other side?
-        if(line->validcount == validcount) {
+        if(st->linevalid[line - lines] == st->validcount) {
             continue;
         }
 
-        line->validcount = validcount;
+        st->linevalid[line - lines] = st->validcount;
 
-        v1 = line->v1;
-        v2 = line->v2;
-        s1 = P_DivlineSide(v1->x,v1->y, &strace);
-        s2 = P_DivlineSide(v2->x, v2->y, &strace);
+        gl = &geolines[line - lines];
+        s1 = P_DivlineSide(gl->x, gl->y, &st->strace);
+        s2 = P_DivlineSide(gl->x + gl->dx, gl->y + gl->dy, &st->strace);
 
         // line isn't crossed?
         if(s1 == s2) {
             continue;
         }
 
-        divl.x = v1->x;
-        divl.y = v1->y;
-        divl.dx = v2->x - v1->x;
-        divl.dy = v2->y - v1->y;
-        s1 = P_DivlineSide(strace.x, strace.y, &divl);
-        s2 = P_DivlineSide(t2x, t2y, &divl);
+        divl.x = gl->x;
+        divl.y = gl->y;
+        divl.dx = gl->dx;
+        divl.dy = gl->dy;
+        s1 = P_DivlineSide(st->strace.x, st->strace.y, &divl);
+        s2 = P_DivlineSide(st->t2x, st->t2y, &divl);
 
         // line isn't crossed?
         if(s1 == s2) {
@@ -198,59 +329,13 @@ dboolean P_CrossSubsector(int num) {
 
         // stop because it is not two sided anyway
         // might do this after updating validcount?
-        if(!(line->flags & ML_TWOSIDED)) {
+        if(!(geolineflags[line - lines] & ML_TWOSIDED)) {
             return false;
         }
 
         // crosses a two sided line
-        front = seg->frontsector;
-        back = seg->backsector;
-
-        // no wall to block sight with?
-        if(front->floorheight == back->floorheight
-                && front->ceilingheight == back->ceilingheight) {
-            continue;
-        }
-
-        // possible occluder
-        // because of ceiling height differences
-        if(front->ceilingheight < back->ceilingheight) {
-            opentop = front->ceilingheight;
-        }
-        else {
-            opentop = back->ceilingheight;
-        }
-
-        // because of ceiling height differences
-        if(front->floorheight > back->floorheight) {
-            openbottom = front->floorheight;
-        }
-        else {
-            openbottom = back->floorheight;
-        }
-
-        // quick test for totally closed doors
-        if(openbottom >= opentop) {
-            return false;    // stop
-        }
-
-        frac = P_InterceptVector2(&strace, &divl);
-
-        if(front->floorheight != back->floorheight) {
-            slope = FixedDiv(openbottom - sightzstart , frac);
-            if(slope > bottomslope) {
-                bottomslope = slope;
-            }
-        }
-
-        if(front->ceilingheight != back->ceilingheight) {
-            slope = FixedDiv(opentop - sightzstart , frac);
-            if(slope < topslope) {
-                topslope = slope;
-            }
-        }
-
-        if(topslope <= bottomslope) {
+        if(!P_SightOpening(st, seg->frontsector - sectors, seg->backsector - sectors,
+                           P_InterceptVector2(&st->strace, &divl))) {
             return false;    // stop
         }
     }
@@ -263,53 +348,102 @@ dboolean P_CrossSubsector(int num) {
 
 //
 // P_CrossBSPNode
-// Returns true if strace crosses the given node successfully.
+// Returns true if the trace crosses the given node successfully.
 //
 
-dboolean P_CrossBSPNode(int bspnum) {
+static dboolean P_CrossBSPNode(sighttrace_t *st, int bspnum) {
     node_t* bsp;
     int     side;
 
     if(bspnum & NF_SUBSECTOR) {
         if(bspnum == -1) {
-            return P_CrossSubsector(0);
+            return P_CrossSubsector(st, 0);
         }
         else {
-            return P_CrossSubsector(bspnum&(~NF_SUBSECTOR));
+            return P_CrossSubsector(st, bspnum&(~NF_SUBSECTOR));
         }
     }
 
     bsp = &nodes[bspnum];
 
     // decide which side the start point is on
-    side = P_DivlineSide(strace.x, strace.y, (divline_t *)bsp);
+    side = P_DivlineSide(st->strace.x, st->strace.y, (divline_t *)bsp);
     if(side == 2) {
         side = 0;    // an "on" should cross both sides
     }
 
     // cross the starting side
-    if(!P_CrossBSPNode(bsp->children[side])) {
+    if(!P_CrossBSPNode(st, bsp->children[side])) {
         return false;
     }
 
     // the partition plane is crossed here
-    if(side == P_DivlineSide(t2x, t2y,(divline_t *)bsp)) {
+    if(side == P_DivlineSide(st->t2x, st->t2y,(divline_t *)bsp)) {
         // the line doesn't touch the other side
         return true;
     }
 
     // cross the ending side
-    return P_CrossBSPNode(bsp->children[side^1]);
+    return P_CrossBSPNode(st, bsp->children[side^1]);
 }
 
 
 //
-// P_CheckSight
-// Returns true if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// P_GridSightTraverse
+// Sight through the lines found by the grid tracer
 //
 
-dboolean P_CheckSight(mobj_t* t1, mobj_t* t2) {
+static dboolean P_GridSightTraverse(gridtrace_t *gt, intercept_t *in) {
+    sighttrace_t *st = (sighttrace_t*)gt->data;
+    int num = in->d.line - lines;
+
+    if(!(geolineflags[num] & ML_TWOSIDED) || geolinesectors[num][1] == -1) {
+        return false;
+    }
+
+    return P_SightOpening(st, geolinesectors[num][0], geolinesectors[num][1], in->frac);
+}
+
+//
+// P_TraceSightLine
+// Looks from the eyes of t1 to any part of t2, walking the BSP or the
+// blockmap grid
+//
+
+static dboolean P_TraceSightLine(sighttrace_t *st, mobj_t* t1, mobj_t* t2, dboolean grid) {
+    st->validcount++;
+
+    st->sightzstart = t1->z + t1->height - (t1->height>>2);
+    st->topslope = (t2->z+t2->height) - st->sightzstart;
+    st->bottomslope = (t2->z) - st->sightzstart;
+
+    st->strace.x = t1->x;
+    st->strace.y = t1->y;
+    st->t2x = t2->x;
+    st->t2y = t2->y;
+    st->strace.dx = t2->x - t1->x;
+    st->strace.dy = t2->y - t1->y;
+
+    st->numsectors = 0;
+    st->overflow = false;
+
+    if(grid) {
+        return P_GridTrace(&st->grid, t1->x, t1->y, t2->x, t2->y, PT_ADDLINES,
+                           P_GridSightTraverse, st);
+    }
+
+    // the head node is the last node output
+    return P_CrossBSPNode(st, numnodes-1);
+}
+
+
+//
+// P_TraceSight
+// Returns true if a straight line between t1 and t2 is unobstructed,
+// using the given trace context. Reentrant.
+//
+
+static dboolean P_TraceSight(sighttrace_t *st, mobj_t* t1, mobj_t* t2) {
     int     s1;
     int     s2;
     int     pnum;
@@ -325,33 +459,250 @@ dboolean P_CheckSight(mobj_t* t1, mobj_t* t2) {
     bytenum = pnum>>3;
     bitnum = 1 << (pnum&7);
 
+    // what the map's own table would have done, if it was replaced
+    if(rejectlump ? (rejectlump[bytenum]&bitnum) : (rejectmatrix[bytenum]&bitnum)) {
+        st->counts[2]++;
+    }
+
     // Check in REJECT table.
     if(rejectmatrix[bytenum]&bitnum) {
-        sightcounts[0]++;
+        st->counts[0]++;
 
         // can't possibly be connected
         return false;
     }
 
+    // nor if the subsectors can't see each other
+    if((compatflags & COMPATF_PVSSIGHT) &&
+            !P_CheckPVS(t1->subsector - subsectors, t2->subsector - subsectors)) {
+        st->counts[0]++;
+        return false;
+    }
+
     // An unobstructed LOS is possible.
-    // Now look from eyes of t1 to any part of t2.
-    sightcounts[1]++;
+    st->counts[1]++;
 
-    D_IncValidCount();
+    return P_TraceSightLine(st, t1, t2, p_gridtrace);
+}
 
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
+//
+// P_BenchSight
+// The trace alone, for tracebench
+//
 
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
+dboolean P_BenchSight(mobj_t *t1, mobj_t *t2, dboolean grid) {
+    sighttrace_t *st = &sightcontexts[0];
 
-    // the head node is the last node output
-    return P_CrossBSPNode(numnodes-1);
+    P_PrepareSightContext(st);
+
+    if(grid) {
+        P_PrepareGridTrace(&st->grid);
+    }
+
+    return P_TraceSightLine(st, t1, t2, grid);
+}
+
+//
+// SIGHT CACHE
+//
+// Monsters keep checking the same target from the same spot for many tics.
+// Results are cached by looker/target subsector and height band, and an
+// entry only hits when both ends are exactly where they were, so a cached
+// answer is always the one a full trace would give. Each entry also
+// remembers which sectors the trace crossed; moving any of their planes
+// bumps the sector's changecount past the entry's stamp and invalidates it.
+//
+
+#define SIGHTCACHESIZE      4096    // must be a power of two
+#define SIGHTZBANDSHIFT     (FRACBITS+5)
+
+typedef struct {
+    int         ss1;            // subsector + 1, 0 if unused
+    int         ss2;
+    fixed_t     x1, y1, z1, h1;
+    fixed_t     x2, y2, z2, h2;
+    int         stamp;          // sectorchangeclock when traced
+    dboolean    result;
+    int         numsectors;
+    int         sectors[SIGHTSECTORS];
+} sightentry_t;
+
+static sightentry_t *sightcache = NULL;
+static int sectorchangeclock = 0;
+
+//
+// P_SectorChanged
+// Called whenever a floor or ceiling height is changed
+//
+
+void P_SectorChanged(sector_t *sec) {
+    sec->changecount = ++sectorchangeclock;
+    P_SetSectorGeometry(sec);
+    P_UpdateSoundGraph(sec);
+    P_MarkSectorFrame(sec);
+}
+
+//
+// P_SectorChangeClock
+// Changes whenever any sector's heights do
+//
+
+int P_SectorChangeClock(void) {
+    return sectorchangeclock;
+}
+
+//
+// P_SightSlot
+//
+
+static sightentry_t *P_SightSlot(mobj_t *t1, mobj_t *t2) {
+    unsigned int hash;
+
+    if(sightcache == NULL) {
+        // owner is cleared when PU_LEVEL is freed
+        Z_Calloc(SIGHTCACHESIZE * sizeof(sightentry_t), PU_LEVEL, &sightcache);
+    }
+
+    hash  = (unsigned int)(t1->subsector - subsectors) * 0x9E3779B1u;
+    hash ^= (unsigned int)(t2->subsector - subsectors) * 0x85EBCA77u;
+    hash ^= (unsigned int)(t1->z >> SIGHTZBANDSHIFT) * 0xC2B2AE3Du;
+    hash ^= (unsigned int)(t2->z >> SIGHTZBANDSHIFT) * 0x27D4EB2Fu;
+    hash ^= hash >> 15;
+
+    return &sightcache[hash & (SIGHTCACHESIZE - 1)];
+}
+
+//
+// P_SightLookup
+// Returns the cached entry for t1 looking at t2, or NULL
+//
+
+static sightentry_t *P_SightLookup(mobj_t *t1, mobj_t *t2) {
+    sightentry_t *e = P_SightSlot(t1, t2);
+    int i;
+
+    if(e->ss1 != (t1->subsector - subsectors) + 1 ||
+            e->ss2 != (t2->subsector - subsectors) + 1) {
+        return NULL;
+    }
+
+    if(e->x1 != t1->x || e->y1 != t1->y || e->z1 != t1->z || e->h1 != t1->height ||
+            e->x2 != t2->x || e->y2 != t2->y || e->z2 != t2->z || e->h2 != t2->height) {
+        return NULL;
+    }
+
+    for(i = 0; i < e->numsectors; i++) {
+        if(sectors[e->sectors[i]].changecount > e->stamp) {
+            return NULL;
+        }
+    }
+
+    return e;
+}
+
+//
+// P_SightStore
+// Caches a traced result along with the sectors it depended on
+//
+
+static void P_SightStore(mobj_t *t1, mobj_t *t2, dboolean result, int numsecs, const int *secs) {
+    sightentry_t *e = P_SightSlot(t1, t2);
+
+    e->ss1 = (t1->subsector - subsectors) + 1;
+    e->ss2 = (t2->subsector - subsectors) + 1;
+    e->x1 = t1->x;
+    e->y1 = t1->y;
+    e->z1 = t1->z;
+    e->h1 = t1->height;
+    e->x2 = t2->x;
+    e->y2 = t2->y;
+    e->z2 = t2->z;
+    e->h2 = t2->height;
+    e->stamp = sectorchangeclock;
+    e->result = result;
+    e->numsectors = numsecs;
+    dmemcpy(e->sectors, secs, numsecs * sizeof(int));
+}
+
+//
+// P_SightRejected
+// Trivial rejection from the REJECT table and, with compat_pvssight,
+// the PVS
+//
+
+static dboolean P_SightRejected(mobj_t *t1, mobj_t *t2) {
+    int pnum;
+
+    pnum = (t1->subsector->sector - sectors) * numsectors + (t2->subsector->sector - sectors);
+
+    if(rejectmatrix[pnum >> 3] & (1 << (pnum & 7))) {
+        return true;
+    }
+
+    if(compatflags & COMPATF_PVSSIGHT) {
+        return !P_CheckPVS(t1->subsector - subsectors, t2->subsector - subsectors);
+    }
+
+    return false;
+}
+
+//
+// P_VerifySight
+// Checks a cache hit against a fresh trace
+//
+
+static void P_VerifySight(sightentry_t *e, mobj_t *t1, mobj_t *t2) {
+    sighttrace_t *st = &sightcontexts[0];
+
+    P_PrepareSightContext(st);
+
+    if(P_TraceSight(st, t1, t2) != e->result) {
+        CON_Warnf("P_VerifySight: cached sight for type %i at (%i, %i) is stale\n",
+                  t1->type, F2INT(t1->x), F2INT(t1->y));
+    }
+
+    st->counts[0] = st->counts[1] = st->counts[2] = 0;
+}
+
+//
+// P_CheckSight
+// Returns true if a straight line between t1 and t2 is unobstructed.
+// Uses REJECT.
+//
+
+dboolean P_CheckSight(mobj_t* t1, mobj_t* t2) {
+    sighttrace_t *st = &sightcontexts[0];
+    sightentry_t *e;
+    dboolean result;
+
+    if(p_sightcache && !P_SightRejected(t1, t2)) {
+        if((e = P_SightLookup(t1, t2)) != NULL) {
+            sightcachecounts[0]++;
+
+            if(p_sightcache == 2) {
+                P_VerifySight(e, t1, t2);
+            }
+
+            return e->result;
+        }
+
+        sightcachecounts[1]++;
+    }
+
+    P_PrepareSightContext(st);
+
+    st->counts[0] = st->counts[1] = st->counts[2] = 0;
+    result = P_TraceSight(st, t1, t2);
+
+    sightcounts[0] += st->counts[0];
+    sightcounts[1] += st->counts[1];
+    sightcounts[2] += st->counts[2];
+
+    if(p_sightcache && st->counts[1] && !st->overflow) {
+        P_SightStore(t1, t2, result, st->numsectors, st->sectors);
+    }
+
+    return result;
 }
 
 //
@@ -360,9 +711,46 @@ dboolean P_CheckSight(mobj_t* t1, mobj_t* t2) {
 // in main tick loop rather from multiple
 // mobj action routines
 //
+// The lookers are gathered in mobj list order and checked against the
+// sight cache, the misses are traced in parallel and the results applied
+// in the same order, so the outcome is identical to checking them one by
+// one.
+//
+
+typedef struct {
+    mobj_t      *mobj;
+    dboolean    result;
+    dboolean    traced;
+    int         numsectors;
+    int         sectors[SIGHTSECTORS];
+    dboolean    overflow;
+} sightlooker_t;
+
+static sightlooker_t    *sightlookers = NULL;
+static int              maxsightlookers = 0;
+
+static void P_SightJob(int index, int worker, void *data) {
+    sightlooker_t *looker = &((sightlooker_t*)data)[index];
+    sighttrace_t *st = &sightcontexts[worker];
+    int rejected = st->counts[0];
+
+    looker->result = P_TraceSight(st, looker->mobj, looker->mobj->target);
+    looker->traced = (st->counts[0] == rejected);
+
+    if(looker->traced) {
+        looker->numsectors = st->numsectors;
+        looker->overflow = st->overflow;
+        dmemcpy(looker->sectors, st->sectors, st->numsectors * sizeof(int));
+    }
+}
 
 void P_ScanSights(void) {
     mobj_t* mobj;
+    sightentry_t *e;
+    sightlooker_t *looker;
+    int numlookers = 0;
+    int numworkers;
+    int i;
 
     for(mobj = mobjhead.next; mobj != &mobjhead; mobj = mobj->next) {
         // must be killable
@@ -382,11 +770,170 @@ void P_ScanSights(void) {
             continue;
         }
 
-        if(!P_CheckSight(mobj, mobj->target)) {
-            continue;
+        if(p_sightcache && !P_SightRejected(mobj, mobj->target)) {
+            if((e = P_SightLookup(mobj, mobj->target)) != NULL) {
+                sightcachecounts[0]++;
+
+                if(p_sightcache == 2) {
+                    P_VerifySight(e, mobj, mobj->target);
+                }
+
+                if(e->result) {
+                    mobj->flags |= MF_SEETARGET;
+                }
+
+                continue;
+            }
+
+            sightcachecounts[1]++;
+        }
+
+        if(numlookers == maxsightlookers) {
+            maxsightlookers = maxsightlookers ? maxsightlookers * 2 : 128;
+            sightlookers = (sightlooker_t*)Z_Realloc(sightlookers,
+                           maxsightlookers * sizeof(sightlooker_t), PU_STATIC, NULL);
+        }
+
+        sightlookers[numlookers++].mobj = mobj;
+    }
+
+    if(!numlookers) {
+        return;
+    }
+
+    numworkers = p_parallelsight ? I_NumWorkers() : 1;
+
+    if(numworkers > MAXSIGHTCONTEXTS) {
+        static dboolean warned = false;
+
+        // each worker needs its own trace context
+        if(!warned) {
+            CON_Warnf("P_ScanSights: %i workers but only %i sight contexts, scanning serially\n",
+                      numworkers, MAXSIGHTCONTEXTS);
+            warned = true;
+        }
+
+        numworkers = 1;
+    }
+
+    for(i = 0; i < numworkers; i++) {
+        P_PrepareSightContext(&sightcontexts[i]);
+        sightcontexts[i].counts[0] = sightcontexts[i].counts[1] = sightcontexts[i].counts[2] = 0;
+    }
+
+    if(numworkers > 1) {
+        I_ParallelFor(numlookers, P_SightJob, sightlookers);
+    }
+    else {
+        for(i = 0; i < numlookers; i++) {
+            P_SightJob(i, 0, sightlookers);
+        }
+    }
+
+    // apply in list order
+    for(i = 0, looker = sightlookers; i < numlookers; i++, looker++) {
+        if(looker->result) {
+            looker->mobj->flags |= MF_SEETARGET;
         }
 
-        mobj->flags |= MF_SEETARGET;
+        if(p_sightcache && looker->traced && !looker->overflow) {
+            P_SightStore(looker->mobj, looker->mobj->target, looker->result,
+                         looker->numsectors, looker->sectors);
+        }
+    }
+
+    for(i = 0; i < numworkers; i++) {
+        sightcounts[0] += sightcontexts[i].counts[0];
+        sightcounts[1] += sightcontexts[i].counts[1];
+        sightcounts[2] += sightcontexts[i].counts[2];
     }
 }
 
+//
+// CMD_SightBench
+// Spawns a slaughter map's worth of monsters around the player, all
+// hunting the player, and times P_ScanSights on one thread and on the
+// worker threads with the sight cache off. Both must give every monster
+// the same result.
+//
+
+#define BENCHTICS       35
+
+static CMD(SightBench) {
+    mobj_t **things;
+    byte *seen;
+    dboolean oldparallel = p_parallelsight;
+    int oldcache = p_sightcache;
+    fixed_t box[4];
+    int count;
+    int visible = 0;
+    int differ = 0;
+    int time[2];
+    int i;
+    int j;
+    int t;
+
+    count = param[0] ? datoi(param[0]) : 2000;
+
+    if(!(things = P_SpawnBenchCrowd(count, box))) {
+        return;
+    }
+
+    seen = (byte*)Z_Calloc(count, PU_STATIC, 0);
+
+    for(i = 0; i < count; i++) {
+        P_SetTarget(&things[i]->target, players[consoleplayer].mo);
+    }
+
+    p_sightcache = 0;
+
+    for(j = 0; j < 2; j++) {
+        p_parallelsight = j;
+        time[j] = I_GetTimeMS();
+
+        for(t = 0; t < BENCHTICS; t++) {
+            // only monsters about to act are scanned
+            for(i = 0; i < count; i++) {
+                things[i]->tics = 1;
+            }
+
+            P_ScanSights();
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+
+        for(i = 0; i < count; i++) {
+            byte result = (things[i]->flags & MF_SEETARGET) ? 1 : 0;
+
+            if(j == 0) {
+                seen[i] = result;
+                visible += result;
+            }
+            else if(seen[i] != result) {
+                differ++;
+            }
+        }
+    }
+
+    p_parallelsight = oldparallel;
+    p_sightcache = oldcache;
+
+    P_RemoveBenchCrowd(things, count);
+    Z_Free(seen);
+
+    CON_Printf(WHITE, "%i monsters, %i tics: serial %ims, %i workers %ims\n",
+               count, BENCHTICS, time[0], I_NumWorkers(), time[1]);
+    CON_Printf(WHITE, "%i see the player, %i differ\n", visible, differ);
+}
+
+//
+// P_InitSight
+//
+
+void P_InitSight(void) {
+    P_AddWorldState(sightcontexts, sizeof(sightcontexts));
+    P_AddWorldState(&sightcache, sizeof(sightcache));
+    P_AddWorldState(&sectorchangeclock, sizeof(sectorchangeclock));
+
+    G_AddCommand("sightbench", CMD_SightBench, 0);
+}
@@ -476,14 +476,7 @@ fixed_t    P_FindHighestCeilingSurrounding(sector_t* sec) {
 //
 
 int P_FindSectorFromLineTag(line_t* line, int start) {
-    int    i;
-
-    for(i = start + 1; i < numsectors; i++) {
-        if(sectors[i].tag == line->tag) {
-            return i;
-        }
-    }
-    return -1;
+    return P_NextTaggedSector(line->tag, start);
 }
 
 
@@ -492,15 +485,7 @@ int P_FindSectorFromLineTag(line_t* line, int start) {
 //
 
 int P_FindLinedefFromTag(int tag) {
-    int i = 0;
-
-    for(i = 0; i < numlines; i++) {
-        if(lines[i].tag == tag) {
-            return i;
-        }
-    }
-
-    return -1;
+    return P_NextTaggedLine(tag, -1);
 }
 
 //
@@ -509,15 +494,7 @@ int P_FindLinedefFromTag(int tag) {
 //
 
 int P_FindSectorFromTag(int tag) {
-    int i = 0;
-
-    for(i = 0; i < numsectors; i++) {
-        if(sectors[i].tag == tag) {
-            return i;
-        }
-    }
-
-    return -1;
+    return P_NextTaggedSector(tag, -1);
 }
 
 //
@@ -525,12 +502,10 @@ int P_FindSectorFromTag(int tag) {
 //
 
 dboolean P_ActivateLineByTag(int tag, mobj_t* activator) {
-    int i;
+    int i = P_NextTaggedLine(tag, -1);
 
-    for(i = 0; i < numlines; i++) {
-        if(lines[i].tag == tag) {
-            return P_UseSpecialLine(activator, &lines[i], 0);
-        }
+    if(i != -1) {
+        return P_UseSpecialLine(activator, &lines[i], 0);
     }
 
     return 1;
@@ -559,58 +534,59 @@ static int P_ModifyLine(int tag1, int tag2, int type) {
     
     line2 = &lines[linenum];
 
-    for(i = 0; i < numlines; i++) {
+    for(i = P_NextTaggedLine(tag1, -1); i != -1; i = P_NextTaggedLine(tag1, i)) {
         line1 = &lines[i];
-        if(line1->tag == tag1) {
-            switch(type) {
-            case modl_flags:
-                if(line1->flags & ML_TWOSIDED) {
-                    line1->flags = (line2->flags | ML_TWOSIDED);
-                }
-                else {
-                    line1->flags = line2->flags;
-                    line1->flags &= ~ML_TWOSIDED;
-                }
-                break;
-            case modl_texture:
-                sides[line1->sidenum[0]].bottomtexture = sides[line2->sidenum[0]].bottomtexture;
-                sides[line1->sidenum[0]].midtexture = sides[line2->sidenum[0]].midtexture;
-                sides[line1->sidenum[0]].toptexture = sides[line2->sidenum[0]].toptexture;
-
-                if(line1->flags & ML_TWOSIDED || line1->sidenum[1] != NO_SIDE_INDEX) {
-                    sides[line1->sidenum[1]].bottomtexture = sides[line2->sidenum[1]].bottomtexture;
-                    sides[line1->sidenum[1]].midtexture = sides[line2->sidenum[1]].midtexture;
-                    sides[line1->sidenum[1]].toptexture = sides[line2->sidenum[1]].toptexture;
-                }
 
-                if(line1->flags & ML_SWITCHX02 &&
-                        !sides[line1->sidenum[0]].toptexture) {
-                    line1->flags &= ~ML_SWITCHX02;
-                }
+        switch(type) {
+        case modl_flags:
+            if(line1->flags & ML_TWOSIDED) {
+                line1->flags = (line2->flags | ML_TWOSIDED);
+            }
+            else {
+                line1->flags = line2->flags;
+                line1->flags &= ~ML_TWOSIDED;
+            }
+            break;
+        case modl_texture:
+            sides[line1->sidenum[0]].bottomtexture = sides[line2->sidenum[0]].bottomtexture;
+            sides[line1->sidenum[0]].midtexture = sides[line2->sidenum[0]].midtexture;
+            sides[line1->sidenum[0]].toptexture = sides[line2->sidenum[0]].toptexture;
+
+            if(line1->flags & ML_TWOSIDED || line1->sidenum[1] != NO_SIDE_INDEX) {
+                sides[line1->sidenum[1]].bottomtexture = sides[line2->sidenum[1]].bottomtexture;
+                sides[line1->sidenum[1]].midtexture = sides[line2->sidenum[1]].midtexture;
+                sides[line1->sidenum[1]].toptexture = sides[line2->sidenum[1]].toptexture;
+            }
 
-                if(line1->flags & (ML_SWITCHX04 | ML_SWITCHX08) &&
-                        !sides[line1->sidenum[0]].bottomtexture) {
-                    line1->flags &= ~(ML_SWITCHX04 | ML_SWITCHX08);
-                }
+            if(line1->flags & ML_SWITCHX02 &&
+                    !sides[line1->sidenum[0]].toptexture) {
+                line1->flags &= ~ML_SWITCHX02;
+            }
 
-                if(line1->flags & (ML_SWITCHX02 | ML_SWITCHX04) &&
-                        !sides[line1->sidenum[0]].midtexture) {
-                    line1->flags &= ~(ML_SWITCHX02 | ML_SWITCHX04);
-                }
+            if(line1->flags & (ML_SWITCHX04 | ML_SWITCHX08) &&
+                    !sides[line1->sidenum[0]].bottomtexture) {
+                line1->flags &= ~(ML_SWITCHX04 | ML_SWITCHX08);
+            }
 
-                if(line1->flags & (ML_SWITCHX02 | ML_SWITCHX08) &&
-                        !sides[line1->sidenum[0]].toptexture) {
-                    line1->flags &= ~(ML_SWITCHX02 | ML_SWITCHX08);
-                }
+            if(line1->flags & (ML_SWITCHX02 | ML_SWITCHX04) &&
+                    !sides[line1->sidenum[0]].midtexture) {
+                line1->flags &= ~(ML_SWITCHX02 | ML_SWITCHX04);
+            }
 
-                break;
-            case modl_data:
-                line1->special = line2->special;
-                break;
-            default:
-                break;
+            if(line1->flags & (ML_SWITCHX02 | ML_SWITCHX08) &&
+                    !sides[line1->sidenum[0]].toptexture) {
+                line1->flags &= ~(ML_SWITCHX02 | ML_SWITCHX08);
             }
+
+            break;
+        case modl_data:
+            line1->special = line2->special;
+            break;
+        default:
+            break;
         }
+
+        P_SetLineGeometry(line1);
     }
 
     return 1;
@@ -725,9 +701,8 @@ int P_RandomLineTrigger(line_t* line, mobj_t* thing, int side) {
     int i = 0;
     int count = 0;
 
-    for(i = 0; i < numlines; i++) {
-        if(lines[i].tag == line->tag &&
-                SPECIALMASK(lines[i].special) != SPECIALMASK(line->special)) {
+    for(i = P_NextTaggedLine(line->tag, -1); i != -1; i = P_NextTaggedLine(line->tag, i)) {
+        if(SPECIALMASK(lines[i].special) != SPECIALMASK(line->special)) {
             count++;
         }
     }
@@ -738,9 +713,8 @@ int P_RandomLineTrigger(line_t* line, mobj_t* thing, int side) {
     linelist = (line_t **)Z_Malloc(count*sizeof(line_t *), PU_LEVEL, NULL);
     randLine = linelist;
 
-    for(i = 0; i < numlines; i++) {
-        if(lines[i].tag == line->tag &&
-                SPECIALMASK(lines[i].special) != SPECIALMASK(line->special)) {
+    for(i = P_NextTaggedLine(line->tag, -1); i != -1; i = P_NextTaggedLine(line->tag, i)) {
+        if(SPECIALMASK(lines[i].special) != SPECIALMASK(line->special)) {
             *randLine++ = &lines[i];
         }
     }
@@ -774,7 +748,7 @@ void T_CountdownTimer(void *data) {
 void P_SpawnDelayTimer(line_t* line, void (*func)(void)) {
     delay_t* timer;
 
-    timer = (delay_t*) Z_Malloc(sizeof(*timer), PU_LEVSPEC, 0);
+    timer = (delay_t*) P_AllocThinker(sizeof(*timer), (actionf_p1)T_CountdownTimer);
     P_AddThinker(&timer->thinker);
     timer->thinker.function.acp1 = (actionf_p1)T_CountdownTimer;
     timer->tics = line->tag;
@@ -807,7 +781,7 @@ static void P_SpawnQuake(void *data) {
     line_t* line = (line_t*) data;
     quake_t* quake;
 
-    quake = (quake_t*) Z_Malloc(sizeof(*quake), PU_LEVSPEC, 0);
+    quake = (quake_t*) P_AllocThinker(sizeof(*quake), (actionf_p1)T_Quake);
     P_AddThinker(&quake->thinker);
     quake->thinker.function.acp1 = (actionf_p1)T_Quake;
     quake->tics = line->tag;
@@ -824,11 +798,7 @@ static void P_AlertTaggedMobj(mobj_t *activator, int tid) {
     player_t *player;
     state_t* st;
 
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
-        // not matching the tid
-        if(mo->tid != tid) {
-            continue;
-        }
+    for(mo = P_FindMobjFromTID(tid, NULL); mo; mo = P_FindMobjFromTID(tid, mo)) {
 
         if(!mo->info->seestate) {
             continue;
@@ -912,11 +882,7 @@ int P_SetAimCamera(player_t* player, line_t* line, dboolean aim) {
     P_ClearUserCamera(player);
     player->cheats |= CF_LOCKCAM;
 
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
-        // not matching the tid
-        if(mo->tid != line->tag) {
-            continue;
-        }
+    for(mo = P_FindMobjFromTID(line->tag, NULL); mo; mo = P_FindMobjFromTID(line->tag, mo)) {
 
         // skip if cameratarget matches tag
         if(player->cameratarget->tid == line->tag) {
@@ -942,7 +908,7 @@ int P_SetAimCamera(player_t* player, line_t* line, dboolean aim) {
 
         mo->angle = R_PointToAngle2(mo->x, mo->y, player->mo->x, player->mo->y);
 
-        camera = (aimcamera_t*) Z_Malloc(sizeof(*camera), PU_LEVSPEC, 0);
+        camera = (aimcamera_t*) P_AllocThinker(sizeof(*camera), (actionf_p1)T_LookAtCamera);
         P_AddThinker(&camera->thinker);
         camera->thinker.function.acp1 = (actionf_p1)T_LookAtCamera;
         camera->viewmobj = mo;
@@ -994,6 +960,7 @@ void T_MovingCamera(void *data) {
     if(camera->tic < CAMMOVESPEED) {
         camtarget->x += camera->slopex;
         camtarget->y += camera->slopey;
+        P_MoveThingGrid(camtarget);
         camtarget->z += camera->slopez;
 
         return;
@@ -1002,17 +969,12 @@ void T_MovingCamera(void *data) {
     //
     // jump to next camera spot
     //
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
+    for(mo = P_FindMobjFromTID(camera->current, NULL); mo; mo = P_FindMobjFromTID(camera->current, mo)) {
         // not a camera
         if(mo->type != MT_CAMERA) {
             continue;
         }
 
-        // must match tid
-        if(mo->tid != camera->current) {
-            continue;
-        }
-
         camera->slopex = (mo->x - camtarget->x) / CAMMOVESPEED;
         camera->slopey = (mo->y - camtarget->y) / CAMMOVESPEED;
         camera->slopez = (mo->z - camtarget->z) / CAMMOVESPEED;
@@ -1043,7 +1005,7 @@ void P_SetMovingCamera(player_t* player, line_t* line) {
         return;
     }
 
-    camera = (movecamera_t*) Z_Malloc(sizeof(*camera), PU_LEVSPEC, 0);
+    camera = (movecamera_t*) P_AllocThinker(sizeof(*camera), (actionf_p1)T_MovingCamera);
     P_AddThinker(&camera->thinker);
     camera->thinker.function.acp1 = (actionf_p1)T_MovingCamera;
 
@@ -1052,11 +1014,7 @@ void P_SetMovingCamera(player_t* player, line_t* line) {
         player->cheats |= CF_LOCKCAM;
     }
 
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
-        // not matching the tid
-        if(mo->tid != line->tag) {
-            continue;
-        }
+    for(mo = P_FindMobjFromTID(line->tag, NULL); mo; mo = P_FindMobjFromTID(line->tag, mo)) {
 
         // setup moving camera
         camera->x = mo->x;
@@ -1072,6 +1030,7 @@ void P_SetMovingCamera(player_t* player, line_t* line) {
         mo->angle = player->cameratarget->angle;
         mo->x = player->cameratarget->x;
         mo->y = player->cameratarget->y;
+        P_MoveThingGrid(mo);
         player->cameratarget = mo;
 
         // [kex] store player information
@@ -1092,11 +1051,7 @@ static dboolean P_ModifyMobjFlags(int tid, int flags) {
     mobj_t* mo;
     dboolean ok = false;
 
-    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
-        // not matching the tid
-        if(mo->tid != tid) {
-            continue;
-        }
+    for(mo = P_FindMobjFromTID(tid, NULL); mo; mo = P_FindMobjFromTID(tid, mo)) {
 
         ok = true;
 
@@ -71,6 +71,12 @@ fixed_t     P_FindHighestCeilingSurrounding(sector_t* sec);
 int         P_FindSectorFromLineTag(line_t* line, int start);
 dboolean    P_ActivateLineByTag(int tag, mobj_t* activator);
 
+// p_tags.cc
+void        P_BuildTagIndex(void);
+int         P_NextTaggedSector(int tag, int start);
+int         P_NextTaggedLine(int tag, int start);
+void        P_InitTags(void);
+
 
 //
 // SPECIAL
@@ -83,68 +89,66 @@ int EV_DoFloorAndCeiling(line_t * line, dboolean fast, dboolean elevatorOrSplit)
 // P_LIGHTS
 //
 
-typedef struct {
-    thinker_t    thinker;
-    sector_t*    sector;
-    int          count;
-    int          special;
-} fireflicker_t;
-
-typedef struct {
-    thinker_t    thinker;
-    sector_t*    sector;
-    int          count;
-    int          special;
-} lightflash_t;
-
-typedef struct {
-    thinker_t    thinker;
-    sector_t*    sector;
-    int          count;
-    int          maxlight;
-    int          darktime;
-    int          brighttime;
-    int          special;
-} strobe_t;
+//
+// Light effects are kept together in one array in the order they were
+// started, and run by lightbatch_t thinkers that each stand for a run
+// of them in the thinker list
+//
 
-typedef struct {
-    thinker_t    thinker;
-    sector_t*    sector;
-    int          type;
-    int          count;
-    int          minlight;
-    int          direction;
-    int          maxlight;
-    int          special;
-} glow_t;
+typedef enum {
+    le_fireflicker,
+    le_flash,
+    le_strobe,
+    le_glow,
+    le_sequence,
+    le_combine,
+    le_morph,
+    NUMLIGHTEFFECTS
+} lighteffecttype_t;
 
 typedef struct {
-    thinker_t    thinker;
-    sector_t     *sector;
-    sector_t     *headsector;
+    int          id;
+    short        type;
+    short        removed;
+    int          sector;     // light index for le_morph
     int          count;
-    int          start;
-    int          index;
     int          special;
-} sequenceGlow_t;
+    union {
+        struct {
+            int  maxlight;
+            int  darktime;
+            int  brighttime;
+        } strobe;
+        struct {
+            int  type;
+            int  minlight;
+            int  direction;
+            int  maxlight;
+        } glow;
+        struct {
+            int  headsector;  // -1 for none
+            int  start;
+            int  index;
+        } sequence;
+        struct {
+            int  combiner;    // effect id
+            int  type;        // of the combiner
+        } combine;
+        struct {
+            int  src;         // light index
+            int  r;
+            int  g;
+            int  b;
+            int  inc;
+        } morph;
+    };
+} lighteffect_t;
 
 typedef struct {
     thinker_t    thinker;
-    sector_t     *sector;
-    thinker_t    *combiner;
-    int          special;
-    actionf_p1   func;
-} combine_t;
-
-typedef struct {
-    thinker_t thinker;
-    light_t *dest;
-    light_t *src;
-    int r;
-    int g;
-    int b;
-    int inc;
-} lightmorph_t;
+    int          first;      // effect ids
+    int          last;
+} lightbatch_t;
 
 #define GLOWSPEED           2
 #define STROBEBRIGHT        1
@@ -156,22 +160,27 @@ typedef struct {
 #define PULSERANDOM         2
 
 void        P_SpawnFireFlicker(void* sector);
-void        T_LightFlash(void* flash);
 void        P_SpawnLightFlash(void* sector);
-void        T_StrobeFlash(void* flash);
-void        T_FireFlicker(void* flick);
 void        P_UpdateLightThinker(light_t* destlight, light_t* srclight);
-void        T_Sequence(void* seq);
 void        P_SpawnStrobeFlash(sector_t* sector, int speed);
 void        P_SpawnStrobeAltFlash(sector_t* sector, int speed);
 void        EV_StartLightStrobing(void* line);
-void        T_Glow(void* g);
 void        P_SpawnGlowingLight(sector_t* sector, byte type);
 void        P_SpawnSequenceLight(sector_t* sector, dboolean first);
 void        P_CombineLightSpecials(void* sector);
-void        T_Combine(void* combine);
 dboolean    P_ChangeLightByTag(int tag1, int tag2);
 int         P_DoSectorLightChange(line_t* line, short tag);
+
+void        T_LightBatch(void* batch);
+int         P_AddLightEffect(lighteffect_t* effect);
+void        P_StopLightEffect(int id);
+lighteffect_t* P_LightBatchEffects(lightbatch_t* batch, int* count);
+int         P_LastLightEffect(void);
+void        P_ClearLightEffects(void);
+void        P_StartLightEffects(void);
+int         P_ChangedLightSectors(int** list);
+int         P_ChangedLights(int** list);
+void        P_InitLightEffects(void);
 void        P_FadeInBrightness(void);
 
 
@@ -502,7 +511,6 @@ typedef struct {
 //thinkers
 
 extern "C" {
-void T_LightMorph(void* lt);
 void T_CountdownTimer(void* timer);
 void T_MobjExplode(void* mexp);
 void T_LookAtCamera(void* camera);
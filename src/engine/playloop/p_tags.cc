@@ -0,0 +1,396 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Tag and tid lookups. Sectors and lines are chained by the hash of
+//    their tag in index order, and mobjs by the hash of their tid in mobj
+//    list order, so a lookup only walks things whose tag hashes alike and
+//    finds them in the same order as a walk over the whole array or list.
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "p_local.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+#define TAGHASHSIZE     256
+#define TAGHASH(tag)    ((unsigned int)(tag) & (TAGHASHSIZE - 1))
+
+static int sectortaghead[TAGHASHSIZE];
+static int *sectortagnext = NULL;
+static int linetaghead[TAGHASHSIZE];
+static int *linetagnext = NULL;
+
+static mobj_t *tidhead[TAGHASHSIZE];
+static mobj_t *tidtail[TAGHASHSIZE];
+static unsigned int tidlinkcount = 0;
+
+//
+// P_BuildTagIndex
+// Called once sectors and lines are loaded, and again if their tags
+// are read from a savegame
+//
+
+void P_BuildTagIndex(void) {
+    int i;
+
+    // owners are cleared when PU_LEVEL is freed
+    if(!sectortagnext) {
+        Z_Malloc(numsectors * sizeof(int), PU_LEVEL, &sectortagnext);
+    }
+
+    if(!linetagnext) {
+        Z_Malloc(numlines * sizeof(int), PU_LEVEL, &linetagnext);
+    }
+
+    for(i = 0; i < TAGHASHSIZE; i++) {
+        sectortaghead[i] = -1;
+        linetaghead[i] = -1;
+    }
+
+    // built backwards so each chain runs in index order
+    for(i = numsectors - 1; i >= 0; i--) {
+        sectortagnext[i] = sectortaghead[TAGHASH(sectors[i].tag)];
+        sectortaghead[TAGHASH(sectors[i].tag)] = i;
+    }
+
+    for(i = numlines - 1; i >= 0; i--) {
+        linetagnext[i] = linetaghead[TAGHASH(lines[i].tag)];
+        linetaghead[TAGHASH(lines[i].tag)] = i;
+    }
+}
+
+//
+// P_NextTaggedSector
+// First sector after start with the tag, or -1
+//
+
+int P_NextTaggedSector(int tag, int start) {
+    int i;
+
+    if(!sectortagnext) {
+        for(i = start + 1; i < numsectors; i++) {
+            if(sectors[i].tag == tag) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    if(start < 0) {
+        i = sectortaghead[TAGHASH(tag)];
+    }
+    else if(TAGHASH(sectors[start].tag) == TAGHASH(tag)) {
+        i = sectortagnext[start];
+    }
+    else {
+        // not on this chain; find where it picks up after start
+        for(i = start + 1; i < numsectors; i++) {
+            if(TAGHASH(sectors[i].tag) == TAGHASH(tag)) {
+                break;
+            }
+        }
+
+        if(i == numsectors) {
+            return -1;
+        }
+    }
+
+    for(; i != -1; i = sectortagnext[i]) {
+        if(sectors[i].tag == tag) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+//
+// P_NextTaggedLine
+// First line after start with the tag, or -1
+//
+
+int P_NextTaggedLine(int tag, int start) {
+    int i;
+
+    if(!linetagnext) {
+        for(i = start + 1; i < numlines; i++) {
+            if(lines[i].tag == tag) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    if(start < 0) {
+        i = linetaghead[TAGHASH(tag)];
+    }
+    else if(TAGHASH(lines[start].tag) == TAGHASH(tag)) {
+        i = linetagnext[start];
+    }
+    else {
+        for(i = start + 1; i < numlines; i++) {
+            if(TAGHASH(lines[i].tag) == TAGHASH(tag)) {
+                break;
+            }
+        }
+
+        if(i == numlines) {
+            return -1;
+        }
+    }
+
+    for(; i != -1; i = linetagnext[i]) {
+        if(lines[i].tag == tag) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+//
+// P_ClearTIDs
+// Called whenever the mobj list is emptied
+//
+
+void P_ClearTIDs(void) {
+    int i;
+
+    for(i = 0; i < TAGHASHSIZE; i++) {
+        tidhead[i] = NULL;
+        tidtail[i] = NULL;
+    }
+
+    tidlinkcount = 0;
+}
+
+//
+// P_InsertTID
+// Puts a listed mobj on its tid chain, keeping mobj list order
+//
+
+static void P_InsertTID(mobj_t *mobj) {
+    int hash = TAGHASH(mobj->tid);
+    mobj_t *prev = tidtail[hash];
+
+    // only a tid change can put it anywhere but the end
+    while(prev && prev->tidorder > mobj->tidorder) {
+        prev = prev->tidprev;
+    }
+
+    mobj->tidprev = prev;
+
+    if(prev) {
+        mobj->tidnext = prev->tidnext;
+        prev->tidnext = mobj;
+    }
+    else {
+        mobj->tidnext = tidhead[hash];
+        tidhead[hash] = mobj;
+    }
+
+    if(mobj->tidnext) {
+        mobj->tidnext->tidprev = mobj;
+    }
+    else {
+        tidtail[hash] = mobj;
+    }
+}
+
+//
+// P_RemoveTID
+//
+
+static void P_RemoveTID(mobj_t *mobj) {
+    int hash = TAGHASH(mobj->tid);
+
+    if(mobj->tidprev) {
+        mobj->tidprev->tidnext = mobj->tidnext;
+    }
+    else {
+        tidhead[hash] = mobj->tidnext;
+    }
+
+    if(mobj->tidnext) {
+        mobj->tidnext->tidprev = mobj->tidprev;
+    }
+    else {
+        tidtail[hash] = mobj->tidprev;
+    }
+
+    mobj->tidnext = mobj->tidprev = NULL;
+}
+
+//
+// P_LinkTID
+// Called as a mobj is added to the end of the mobj list
+//
+
+void P_LinkTID(mobj_t *mobj) {
+    mobj->tidorder = ++tidlinkcount;
+    P_InsertTID(mobj);
+}
+
+//
+// P_UnlinkTID
+// Called as a mobj is taken off the mobj list
+//
+
+void P_UnlinkTID(mobj_t *mobj) {
+    P_RemoveTID(mobj);
+}
+
+//
+// P_SetMobjTID
+//
+
+void P_SetMobjTID(mobj_t *mobj, int tid) {
+    P_RemoveTID(mobj);
+    mobj->tid = tid;
+    P_InsertTID(mobj);
+}
+
+//
+// P_FindMobjFromTID
+// Next mobj after prev on the mobj list with the tid; the first if prev
+// is NULL. Mobjs added to the list while looping are found as they would
+// be walking the list.
+//
+
+mobj_t *P_FindMobjFromTID(int tid, mobj_t *prev) {
+    mobj_t *mo = prev ? prev->tidnext : tidhead[TAGHASH(tid)];
+
+    for(; mo; mo = mo->tidnext) {
+        if(mo->tid == tid) {
+            return mo;
+        }
+    }
+
+    return NULL;
+}
+
+//
+// CMD_TagBench
+// Times tag and tid lookups for every tag on the map against walking
+// the arrays and the mobj list
+//
+
+static CMD(TagBench) {
+    int count;
+    int tagged = 0;
+    int time[2];
+    int found[2];
+    int tag;
+    int i;
+    int j;
+    int k;
+
+    if(gamestate != GS_LEVEL) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    count = param[0] ? datoi(param[0]) : 100;
+
+    for(i = 0; i < numlines; i++) {
+        if(lines[i].tag) {
+            tagged++;
+        }
+    }
+
+    for(j = 0; j < 2; j++) {
+        found[j] = 0;
+        time[j] = I_GetTimeMS();
+
+        for(k = 0; k < count; k++) {
+            for(i = 0; i < numlines; i++) {
+                mobj_t *mo;
+                int num;
+
+                tag = lines[i].tag;
+
+                if(!tag) {
+                    continue;
+                }
+
+                if(j == 0) {
+                    for(num = 0; num < numsectors; num++) {
+                        if(sectors[num].tag == tag) {
+                            found[j] += num;
+                        }
+                    }
+
+                    for(num = 0; num < numlines; num++) {
+                        if(lines[num].tag == tag) {
+                            found[j] += num;
+                        }
+                    }
+
+                    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
+                        if(mo->tid == tag) {
+                            found[j] += mo->index;
+                        }
+                    }
+                }
+                else {
+                    for(num = P_NextTaggedSector(tag, -1); num != -1; num = P_NextTaggedSector(tag, num)) {
+                        found[j] += num;
+                    }
+
+                    for(num = P_NextTaggedLine(tag, -1); num != -1; num = P_NextTaggedLine(tag, num)) {
+                        found[j] += num;
+                    }
+
+                    for(mo = P_FindMobjFromTID(tag, NULL); mo; mo = P_FindMobjFromTID(tag, mo)) {
+                        found[j] += mo->index;
+                    }
+                }
+            }
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+    }
+
+    CON_Printf(WHITE, "lookups for %i tagged lines x %i: scan %ims, index %ims%s\n",
+               tagged, count, time[0], time[1], found[0] == found[1] ? "" : ", results differ");
+}
+
+//
+// P_InitTags
+//
+
+void P_InitTags(void) {
+    P_AddWorldState(sectortaghead, sizeof(sectortaghead));
+    P_AddWorldState(&sectortagnext, sizeof(sectortagnext));
+    P_AddWorldState(linetaghead, sizeof(linetaghead));
+    P_AddWorldState(&linetagnext, sizeof(linetagnext));
+    P_AddWorldState(tidhead, sizeof(tidhead));
+    P_AddWorldState(tidtail, sizeof(tidtail));
+    P_AddWorldState(&tidlinkcount, sizeof(tidlinkcount));
+
+    G_AddCommand("tagbench", CMD_TagBench, 0);
+}
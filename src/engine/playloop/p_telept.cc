@@ -93,17 +93,12 @@ int EV_Teleport(line_t* line, int side, mobj_t* thing) {
     }
 
     tag = line->tag;
-    for(m = mobjhead.next; m != &mobjhead; m = m->next) {
+    for(m = P_FindMobjFromTID(tag, NULL); m; m = P_FindMobjFromTID(tag, m)) {
         // not a teleportman
         if(m->type != MT_DEST_TELEPORT) {
             continue;
         }
 
-        // not matching the tid
-        if(m->tid != tag) {
-            continue;
-        }
-
         // no use teleporting if the thing has no room
         if(m->ceilingz - m->floorz < m->height) {
             continue;
@@ -162,17 +157,12 @@ int EV_SilentTeleport(line_t* line, mobj_t* thing) {
     mobj_t*     m;
 
     tag = line->tag;
-    for(m = mobjhead.next; m != &mobjhead; m = m->next) {
+    for(m = P_FindMobjFromTID(tag, NULL); m; m = P_FindMobjFromTID(tag, m)) {
         // not a teleportman
         if(m->type != MT_DEST_TELEPORT) {
             continue;
         }
 
-        // not matching the tid
-        if(m->tid != tag) {
-            continue;
-        }
-
         if(thing->player) {
             P_Telefrag(thing, m->x, m->y);
         }
@@ -0,0 +1,667 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Thing grid. Every thing on a blocklinks chain is also filed under the
+//    64 unit cell its origin is in, in a hash of small arrays that hold
+//    its position and size. A box query walks the same mapblocks as the
+//    chains would, but only looks at the cells of each block that things
+//    touching the box can be in, without going through the mobjs.
+//
+//    Things come out in the same order as from the chains: each one
+//    remembers when it was linked, and chains are newest first. Blocks are
+//    only looked at when the walk gets to them, so things linked into them
+//    by a callback are found just as on the chains.
+//
+//-----------------------------------------------------------------------------
+
+#include <imp/Property>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "m_misc.h"
+#include "p_local.h"
+#include "i_system.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+BoolProperty p_thinggrid("p_thinggrid", "Find things for collision and splash damage on a fine grid", true);
+
+#define CELLSHIFT       (MAPBLOCKSHIFT-1)   // 64 unit cells, 2x2 to a mapblock
+#define MINBUCKETS      256
+#define MAXBUCKETS      262144
+#define MAXGRIDDEPTH    8                   // queries started from inside callbacks
+
+typedef struct {
+    int         index;                  // mobj
+    int         cell;                   // cells can share a bucket
+    fixed_t     x;
+    fixed_t     y;
+    fixed_t     radius;
+    int64       seq;
+} griditem_t;
+
+typedef struct {
+    griditem_t  *items;
+    int         numitems;
+    int         maxitems;
+} gridbucket_t;
+
+typedef struct {
+    int         blockx;                 // blocklinks chain, -1 if on none
+    int         blocky;
+    int64       seq;                    // when it was put on the chain
+    int         cell;                   // filed under, -1 if none
+    dboolean    drifted;                // on the drift list instead
+} gridentry_t;
+
+typedef struct {
+    int64       seq;
+    int         index;
+} gridthing_t;
+
+typedef struct {
+    gridthing_t *things;
+    int         numthings;
+    int         maxthings;
+} gridquery_t;
+
+static gridbucket_t *gridbuckets;
+static unsigned int gridmask;
+static int gridwidth;                   // in cells
+
+static gridentry_t *gridentries;
+static int numgridentries;
+
+static int64 gridseq;
+static fixed_t gridmaxradius;           // of everything filed this level
+
+// things moved without being relinked; see P_MoveThingGrid
+static int *driftlist;
+static int numdrift;
+static int maxdrift;
+static unsigned int numdrifts;          // things put on the list so far
+
+static gridquery_t gridqueries[MAXGRIDDEPTH];
+static int griddepth;
+
+//
+// P_ClearThingGrid
+// Called after the blockmap is loaded; the old level's grid went with PU_LEVEL
+//
+
+void P_ClearThingGrid(void) {
+    int numbuckets = MINBUCKETS;
+
+    gridwidth = bmapwidth << (MAPBLOCKSHIFT - CELLSHIFT);
+
+    // neighbouring cells go in neighbouring buckets; only big maps wrap
+    while(numbuckets < MAXBUCKETS && numbuckets < gridwidth * (bmapheight << (MAPBLOCKSHIFT - CELLSHIFT))) {
+        numbuckets <<= 1;
+    }
+
+    gridbuckets = (gridbucket_t*)Z_Calloc(numbuckets * sizeof(gridbucket_t), PU_LEVEL, 0);
+    gridmask = numbuckets - 1;
+
+    gridentries = NULL;
+    numgridentries = 0;
+    gridseq = 0;
+    gridmaxradius = 0;
+
+    driftlist = NULL;
+    numdrift = 0;
+    maxdrift = 0;
+}
+
+//
+// P_GridEntry
+// Grows the entries along with the mobj pool
+//
+
+static gridentry_t *P_GridEntry(mobj_t *thing) {
+    if(thing->index >= numgridentries) {
+        int count = MAX(P_MobjPoolSize(), thing->index + 1);
+        int i;
+
+        gridentries = (gridentry_t*)Z_Realloc(gridentries, count * sizeof(gridentry_t), PU_LEVEL, 0);
+
+        for(i = numgridentries; i < count; i++) {
+            gridentries[i].blockx = gridentries[i].blocky = -1;
+            gridentries[i].seq = 0;
+            gridentries[i].cell = -1;
+            gridentries[i].drifted = false;
+        }
+
+        numgridentries = count;
+    }
+
+    return &gridentries[thing->index];
+}
+
+//
+// P_UnfileThing
+//
+
+static void P_UnfileThing(int index, gridentry_t *e) {
+    gridbucket_t *b;
+    int i;
+
+    if(e->cell >= 0) {
+        b = &gridbuckets[e->cell & gridmask];
+
+        for(i = 0; i < b->numitems; i++) {
+            if(b->items[i].index == index) {
+                b->items[i] = b->items[--b->numitems];
+                break;
+            }
+        }
+
+        e->cell = -1;
+    }
+
+    if(e->drifted) {
+        for(i = 0; i < numdrift; i++) {
+            if(driftlist[i] == index) {
+                driftlist[i] = driftlist[--numdrift];
+                break;
+            }
+        }
+
+        e->drifted = false;
+    }
+}
+
+//
+// P_LinkThingGrid
+// The thing was just put at the head of the chain for blockx, blocky
+//
+
+void P_LinkThingGrid(mobj_t *thing, int blockx, int blocky) {
+    gridentry_t *e = P_GridEntry(thing);
+    gridbucket_t *b;
+    griditem_t *item = NULL;
+    int cell;
+    int i;
+
+    cell = ((thing->y - bmaporgy) >> CELLSHIFT) * gridwidth + ((thing->x - bmaporgx) >> CELLSHIFT);
+
+    e->blockx = blockx;
+    e->blocky = blocky;
+    e->seq = ++gridseq;
+
+    // most moves stay in the same cell
+    if(e->cell == cell) {
+        b = &gridbuckets[cell & gridmask];
+
+        for(i = 0; i < b->numitems; i++) {
+            if(b->items[i].index == thing->index) {
+                item = &b->items[i];
+                break;
+            }
+        }
+    }
+    else {
+        P_UnfileThing(thing->index, e);
+
+        b = &gridbuckets[cell & gridmask];
+
+        if(b->numitems == b->maxitems) {
+            b->maxitems = MAX(b->maxitems * 2, 4);
+            b->items = (griditem_t*)Z_Realloc(b->items, b->maxitems * sizeof(griditem_t), PU_LEVEL, 0);
+        }
+
+        item = &b->items[b->numitems++];
+        item->index = thing->index;
+        item->cell = cell;
+        e->cell = cell;
+    }
+
+    item->x = thing->x;
+    item->y = thing->y;
+    item->radius = thing->radius;
+    item->seq = e->seq;
+
+    if(thing->radius > gridmaxradius) {
+        gridmaxradius = thing->radius;
+    }
+}
+
+//
+// P_UnlinkThingGrid
+// The thing left its chain. It stays filed, since it is usually linked
+// again right away close by; queries check the entry before using it.
+//
+
+void P_UnlinkThingGrid(mobj_t *thing) {
+    if(thing->index < numgridentries) {
+        gridentries[thing->index].blockx = -1;
+        gridentries[thing->index].blocky = -1;
+    }
+}
+
+//
+// P_MoveThingGrid
+// The thing was moved without being relinked, so it is still on the chain
+// for its old position. It goes on the drift list, which queries check in
+// full, until it is linked again.
+//
+
+void P_MoveThingGrid(mobj_t *thing) {
+    gridentry_t *e;
+
+    P_MarkMobjFrame(thing);
+
+    if(thing->index >= numgridentries) {
+        return;
+    }
+
+    e = &gridentries[thing->index];
+
+    if(e->blockx < 0 || e->drifted) {
+        return;
+    }
+
+    P_UnfileThing(thing->index, e);
+
+    if(numdrift == maxdrift) {
+        maxdrift = MAX(maxdrift * 2, 16);
+        driftlist = (int*)Z_Realloc(driftlist, maxdrift * sizeof(int), PU_LEVEL, 0);
+    }
+
+    driftlist[numdrift++] = thing->index;
+    e->drifted = true;
+    numdrifts++;
+}
+
+//
+// P_FreeThingGrid
+// The mobj is going back to the pool
+//
+
+void P_FreeThingGrid(mobj_t *thing) {
+    if(thing->index < numgridentries) {
+        P_UnfileThing(thing->index, &gridentries[thing->index]);
+        gridentries[thing->index].blockx = -1;
+        gridentries[thing->index].blocky = -1;
+    }
+}
+
+//
+// P_AddGridThing
+//
+
+static void P_AddGridThing(gridquery_t *q, int64 seq, int index) {
+    gridthing_t *t;
+
+    if(q->numthings == q->maxthings) {
+        q->maxthings = MAX(q->maxthings * 2, 64);
+        q->things = (gridthing_t*)Z_Realloc(q->things, q->maxthings * sizeof(gridthing_t), PU_STATIC, 0);
+    }
+
+    // keep them newest first, as on the chain
+    for(t = &q->things[q->numthings]; t > q->things && t[-1].seq < seq; t--) {
+        *t = t[-1];
+    }
+
+    t->seq = seq;
+    t->index = index;
+    q->numthings++;
+}
+
+//
+// P_AddDriftedThings
+// Adds the drifted things on chain bx, by that come after seq, unless
+// they are in q from first on already
+//
+
+static void P_AddDriftedThings(gridquery_t *q, int bx, int by, int first, int64 seq) {
+    int i;
+    int j;
+
+    for(i = 0; i < numdrift; i++) {
+        gridentry_t *e = &gridentries[driftlist[i]];
+
+        if(e->blockx != bx || e->blocky != by || e->seq >= seq) {
+            continue;
+        }
+
+        for(j = first; j < q->numthings; j++) {
+            if(q->things[j].index == driftlist[i]) {
+                break;
+            }
+        }
+
+        if(j == q->numthings) {
+            P_AddGridThing(q, e->seq, driftlist[i]);
+        }
+    }
+}
+
+//
+// P_GridBlockThings
+// P_BlockThingsIterator for the things in block bx, by whose box reaches
+// box. Only cells within the range are looked at.
+//
+
+static dboolean P_GridBlockThings(gridquery_t *q, int bx, int by, fixed_t *box, int *range,
+                                  dboolean(*func)(mobj_t*)) {
+    int x1 = MAX(range[BOXLEFT], bx << (MAPBLOCKSHIFT - CELLSHIFT));
+    int x2 = MIN(range[BOXRIGHT], ((bx + 1) << (MAPBLOCKSHIFT - CELLSHIFT)) - 1);
+    int y1 = MAX(range[BOXBOTTOM], by << (MAPBLOCKSHIFT - CELLSHIFT));
+    int y2 = MIN(range[BOXTOP], ((by + 1) << (MAPBLOCKSHIFT - CELLSHIFT)) - 1);
+    unsigned int drifts;
+    int cx;
+    int cy;
+    int i;
+
+    q->numthings = 0;
+
+    for(cy = y1; cy <= y2; cy++) {
+        for(cx = x1; cx <= x2; cx++) {
+            int cell = cy * gridwidth + cx;
+            gridbucket_t *b = &gridbuckets[cell & gridmask];
+
+            for(i = 0; i < b->numitems; i++) {
+                griditem_t *item = &b->items[i];
+
+                if(item->cell != cell ||
+                        item->x - item->radius > box[BOXRIGHT] || item->x + item->radius < box[BOXLEFT] ||
+                        item->y - item->radius > box[BOXTOP] || item->y + item->radius < box[BOXBOTTOM]) {
+                    continue;
+                }
+
+                P_AddGridThing(q, item->seq, item->index);
+            }
+        }
+    }
+
+    for(i = 0; i < numdrift; i++) {
+        gridentry_t *e = &gridentries[driftlist[i]];
+
+        if(e->blockx == bx && e->blocky == by) {
+            P_AddGridThing(q, e->seq, driftlist[i]);
+        }
+    }
+
+    drifts = numdrifts;
+
+    for(i = 0; i < q->numthings; i++) {
+        int64 seq = q->things[i].seq;
+        int index = q->things[i].index;
+        gridentry_t *e = &gridentries[index];
+
+        // a callback took it off the chain, or relinked it at the head
+        if(e->seq != seq || e->blockx != bx || e->blocky != by) {
+            continue;
+        }
+
+        if(!func(P_MobjFromIndex(index))) {
+            return false;
+        }
+
+        // a callback moved something further down this chain into reach
+        if(drifts != numdrifts) {
+            P_AddDriftedThings(q, bx, by, i + 1, seq);
+            drifts = numdrifts;
+        }
+    }
+
+    return true;
+}
+
+//
+// P_BoxThingsIterator
+// Calls func for every thing on the chains of blocks xl..xh, yl..yh whose
+// box reaches box, in the order P_BlockThingsIterator would reach them
+// walking the blocks column by column, or row by row if rows is set.
+// Things farther away may or may not be passed to func.
+//
+
+dboolean P_BoxThingsIterator(fixed_t *box, int xl, int xh, int yl, int yh,
+                             dboolean rows, dboolean(*func)(mobj_t*)) {
+    gridquery_t *q;
+    int range[4];
+    int x;
+    int y;
+
+    xl = MAX(xl, 0);
+    xh = MIN(xh, bmapwidth - 1);
+    yl = MAX(yl, 0);
+    yh = MIN(yh, bmapheight - 1);
+
+    if(!p_thinggrid || !gridbuckets) {
+        if(rows) {
+            for(y = yl; y <= yh; y++) {
+                for(x = xl; x <= xh; x++) {
+                    if(!P_BlockThingsIterator(x, y, func)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        else {
+            for(x = xl; x <= xh; x++) {
+                for(y = yl; y <= yh; y++) {
+                    if(!P_BlockThingsIterator(x, y, func)) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // cells holding things that can reach the box
+    range[BOXTOP]       = (box[BOXTOP] + gridmaxradius - bmaporgy) >> CELLSHIFT;
+    range[BOXBOTTOM]    = (box[BOXBOTTOM] - gridmaxradius - bmaporgy) >> CELLSHIFT;
+    range[BOXRIGHT]     = (box[BOXRIGHT] + gridmaxradius - bmaporgx) >> CELLSHIFT;
+    range[BOXLEFT]      = (box[BOXLEFT] - gridmaxradius - bmaporgx) >> CELLSHIFT;
+
+    if(griddepth == MAXGRIDDEPTH) {
+        I_Error("P_BoxThingsIterator: queries nested too deep");
+    }
+
+    q = &gridqueries[griddepth++];
+
+    if(rows) {
+        for(y = yl; y <= yh; y++) {
+            for(x = xl; x <= xh; x++) {
+                if(!P_GridBlockThings(q, x, y, box, range, func)) {
+                    griddepth--;
+                    return false;
+                }
+            }
+        }
+    }
+    else {
+        for(x = xl; x <= xh; x++) {
+            for(y = yl; y <= yh; y++) {
+                if(!P_GridBlockThings(q, x, y, box, range, func)) {
+                    griddepth--;
+                    return false;
+                }
+            }
+        }
+    }
+
+    griddepth--;
+    return true;
+}
+
+//
+// ThingGridBench
+//
+
+#define BENCHTICS       35
+
+static mobj_t *benchthing;
+static fixed_t benchx;
+static fixed_t benchy;
+static int benchhits;
+static unsigned int benchorder;
+
+static dboolean PIT_BenchThing(mobj_t *thing) {
+    fixed_t blockdist = thing->radius + benchthing->radius;
+
+    if(thing != benchthing &&
+            D_abs(thing->x - benchx) < blockdist && D_abs(thing->y - benchy) < blockdist) {
+        benchhits++;
+        benchorder = benchorder * 31 + thing->index + 1;
+    }
+
+    return true;
+}
+
+static void P_BenchQuery(mobj_t *mo, fixed_t x, fixed_t y) {
+    fixed_t box[4];
+
+    benchthing = mo;
+    benchx = x;
+    benchy = y;
+
+    box[BOXTOP]     = y + mo->radius;
+    box[BOXBOTTOM]  = y - mo->radius;
+    box[BOXRIGHT]   = x + mo->radius;
+    box[BOXLEFT]    = x - mo->radius;
+
+    P_BoxThingsIterator(box,
+                        (box[BOXLEFT] - bmaporgx - MAXRADIUS) >> MAPBLOCKSHIFT,
+                        (box[BOXRIGHT] - bmaporgx + MAXRADIUS) >> MAPBLOCKSHIFT,
+                        (box[BOXBOTTOM] - bmaporgy - MAXRADIUS) >> MAPBLOCKSHIFT,
+                        (box[BOXTOP] - bmaporgy + MAXRADIUS) >> MAPBLOCKSHIFT,
+                        false, PIT_BenchThing);
+}
+
+static void P_BenchMove(mobj_t *mo, fixed_t x, fixed_t y) {
+    P_UnsetThingPosition(mo);
+    mo->x = x;
+    mo->y = y;
+    P_SetThingPosition(mo);
+}
+
+static CMD(ThingGridBench) {
+    mobj_t **things;
+    fixed_t *spots;
+    unsigned int rnd;
+    dboolean oldgrid = p_thinggrid;
+    fixed_t box[4];
+    int count;
+    int differ = 0;
+    int hits[2];
+    int time[2];
+    int i;
+    int j;
+    int t;
+
+    count = param[0] ? datoi(param[0]) : 5000;
+
+    if(!(things = P_SpawnBenchCrowd(count, box))) {
+        return;
+    }
+
+    // where each run starts from
+    spots = (fixed_t*)Z_Malloc(count * 2 * sizeof(fixed_t), PU_STATIC, 0);
+
+    for(i = 0; i < count; i++) {
+        spots[i*2] = things[i]->x;
+        spots[i*2+1] = things[i]->y;
+    }
+
+    // both ways must find the same things in the same order
+    for(i = 0; i < count; i++) {
+        unsigned int order[2];
+
+        for(j = 0; j < 2; j++) {
+            p_thinggrid = j;
+            benchhits = 0;
+            benchorder = 0;
+            P_BenchQuery(things[i], things[i]->x, things[i]->y);
+            order[j] = benchorder;
+        }
+
+        if(order[0] != order[1]) {
+            differ++;
+        }
+    }
+
+    // every thing tries a step and takes it, for a second of tics
+    for(j = 0; j < 2; j++) {
+        p_thinggrid = j;
+        rnd = 1;
+        benchhits = 0;
+
+        for(i = 0; i < count; i++) {
+            P_BenchMove(things[i], spots[i*2], spots[i*2+1]);
+        }
+
+        time[j] = I_GetTimeMS();
+
+        for(t = 0; t < BENCHTICS; t++) {
+            for(i = 0; i < count; i++) {
+                fixed_t x;
+                fixed_t y;
+
+                rnd = rnd * 1103515245u + 12345u;
+                x = things[i]->x + (fixed_t)((rnd >> 8) % (32*FRACUNIT)) - 16*FRACUNIT;
+                rnd = rnd * 1103515245u + 12345u;
+                y = things[i]->y + (fixed_t)((rnd >> 8) % (32*FRACUNIT)) - 16*FRACUNIT;
+
+                x = MAX(MIN(x, box[BOXRIGHT]), box[BOXLEFT]);
+                y = MAX(MIN(y, box[BOXTOP]), box[BOXBOTTOM]);
+
+                P_BenchQuery(things[i], x, y);
+                P_BenchMove(things[i], x, y);
+            }
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+        hits[j] = benchhits;
+    }
+
+    p_thinggrid = oldgrid;
+
+    P_RemoveBenchCrowd(things, count);
+    Z_Free(spots);
+
+    CON_Printf(WHITE, "%i things, %i tics: blocks %ims, grid %ims\n", count, BENCHTICS, time[0], time[1]);
+    CON_Printf(WHITE, "%i of %i queries differ, %i/%i contacts\n", differ, count, hits[0], hits[1]);
+}
+
+//
+// P_InitThingGrid
+//
+
+void P_InitThingGrid(void) {
+    P_AddWorldState(&gridbuckets, sizeof(gridbuckets));
+    P_AddWorldState(&gridmask, sizeof(gridmask));
+    P_AddWorldState(&gridwidth, sizeof(gridwidth));
+    P_AddWorldState(&gridentries, sizeof(gridentries));
+    P_AddWorldState(&numgridentries, sizeof(numgridentries));
+    P_AddWorldState(&gridseq, sizeof(gridseq));
+    P_AddWorldState(&gridmaxradius, sizeof(gridmaxradius));
+    P_AddWorldState(&driftlist, sizeof(driftlist));
+    P_AddWorldState(&numdrift, sizeof(numdrift));
+    P_AddWorldState(&maxdrift, sizeof(maxdrift));
+    P_AddWorldState(&numdrifts, sizeof(numdrifts));
+
+    G_AddCommand("thinggridbench", CMD_ThingGridBench, 0);
+}
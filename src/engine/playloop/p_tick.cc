@@ -36,10 +36,13 @@
 #include "r_main.h"
 #include "s_sound.h"
 #include "m_random.h"
+#include "m_misc.h"
 #include "con_console.h"
 #include "r_wipe.h"
 #include "p_setup.h"
 #include "g_demo.h"
+#include "d_devstat.h"
+#include "g_actions.h"
 
 extern BoolProperty i_interpolateframes;
 extern BoolProperty p_damageindicator;
@@ -49,12 +52,13 @@ int     leveltime;
 
 void G_PlayerFinishLevel(int player);
 void G_DoReborn(int playernum);
+void P_RunMobjs(void);
 
 //
 // THINKERS
 //
-// All thinkers should be allocated by Z_Malloc
-// so they can be operated on uniformly.
+// All thinkers come from P_AllocThinker and are
+// given back to their pool with P_FreeThinker.
 // The actual structures will vary in size,
 // but the first element must be thinker_t.
 //
@@ -68,6 +72,459 @@ mobj_t      *currentmobj;
 thinker_t   *currentthinker;
 
 
+//
+// THINKER POOLS
+//
+// Special thinkers are carved out of per-type slabs rather than being
+// Z_Malloc'd one at a time, so thinkers of the same kind sit next to each
+// other in memory and spawning one rarely touches the heap. A thinker's
+// type is identified by the function it is spawned with, so two types
+// that happen to share a struct size still get their own slabs. Slots
+// never move, so a pointer to a thinker stays valid for as long as the
+// thinker lives.
+//
+// The thinker list still decides the order thinkers run in, which demos
+// and savegames depend on.
+//
+
+#define MAXTHINKERPOOLS     32
+#define THINKERSLABSLOTS    64
+
+// each slot starts with a pointer back to its pool
+#define THINKERHEADER       sizeof(void*)
+
+typedef struct {
+    actionf_p1 function; // thinker type the pool holds
+    int     size;       // size of the thinker type
+    int     slotsize;   // size + header, pointer aligned
+    byte    *freelist;  // slots available for reuse
+    int     numslabs;
+    int     live;       // thinkers currently allocated
+} thinkerpool_t;
+
+static thinkerpool_t thinkerpools[MAXTHINKERPOOLS];
+static int numthinkerpools = 0;
+
+//
+// P_GetThinkerPool
+//
+
+static thinkerpool_t *P_GetThinkerPool(int size, actionf_p1 function) {
+    thinkerpool_t *pool;
+    int i;
+
+    for(i = 0; i < numthinkerpools; i++) {
+        if(thinkerpools[i].function == function) {
+            if(thinkerpools[i].size != size) {
+                I_Error("P_GetThinkerPool: thinker type spawned with sizes %i and %i",
+                        thinkerpools[i].size, size);
+            }
+
+            return &thinkerpools[i];
+        }
+    }
+
+    if(numthinkerpools == MAXTHINKERPOOLS) {
+        I_Error("P_GetThinkerPool: too many thinker types (%i)", numthinkerpools);
+    }
+
+    pool = &thinkerpools[numthinkerpools++];
+    pool->function = function;
+    pool->size = size;
+    pool->slotsize = (THINKERHEADER + size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    pool->freelist = NULL;
+    pool->numslabs = 0;
+    pool->live = 0;
+
+    return pool;
+}
+
+//
+// P_GrowThinkerPool
+//
+
+static void P_GrowThinkerPool(thinkerpool_t *pool) {
+    byte *slab;
+    int i;
+
+    slab = (byte*)Z_Malloc(pool->slotsize * THINKERSLABSLOTS, PU_LEVSPEC, NULL);
+
+    // link backwards so slots are handed out in address order
+    for(i = THINKERSLABSLOTS - 1; i >= 0; i--) {
+        byte *slot = slab + (i * pool->slotsize);
+
+        *(byte**)(slot + THINKERHEADER) = pool->freelist;
+        pool->freelist = slot;
+    }
+
+    pool->numslabs++;
+}
+
+//
+// P_AllocThinker
+// Returns a zeroed thinker of the given size from the pool of thinkers
+// that run function.
+//
+
+void *P_AllocThinker(int size, actionf_p1 function) {
+    thinkerpool_t *pool;
+    byte *slot;
+
+    pool = P_GetThinkerPool(size, function);
+
+    if(pool->freelist == NULL) {
+        P_GrowThinkerPool(pool);
+    }
+
+    slot = pool->freelist;
+    pool->freelist = *(byte**)(slot + THINKERHEADER);
+    pool->live++;
+
+    *(thinkerpool_t**)slot = pool;
+    dmemset(slot + THINKERHEADER, 0, size);
+
+    return slot + THINKERHEADER;
+}
+
+//
+// P_FreeThinker
+// Returns a thinker to its pool. It must already be off the thinker list.
+//
+
+void P_FreeThinker(void *thinker) {
+    byte *slot = (byte*)thinker - THINKERHEADER;
+    thinkerpool_t *pool = *(thinkerpool_t**)slot;
+
+    *(byte**)thinker = pool->freelist;
+    pool->freelist = slot;
+    pool->live--;
+}
+
+//
+// MOBJ POOL
+//
+// Mobjs live in PU_LEVEL slabs of MOBJSLABSIZE. Every mobj has a fixed
+// index into the pool, so code that keeps per-mobj side data can use
+// plain arrays, and a mobj can be referred to by index where a pointer
+// is inconvenient. Pointers stay valid for the lifetime of the mobj.
+//
+
+#define MOBJSLABSHIFT   8
+#define MOBJSLABSIZE    (1 << MOBJSLABSHIFT)
+
+static mobj_t   **mobjslabs = NULL;
+static int      nummobjslabs = 0;
+static mobj_t   *mobjfreelist = NULL;
+
+//
+// Frame states
+//
+// The renderer draws sectors and mobjs between where they were at the
+// start of the tic and where they are now. Only what moved since the
+// last snapshot is copied: P_SectorChanged marks sectors, and
+// P_SetThingPosition, P_MoveThingGrid and the z movers mark mobjs.
+//
+
+framesector_t   *framesectors = NULL;
+
+static int      *framesectorlist = NULL;
+static byte     *framesectordirty = NULL;
+static int      numframesectors = 0;
+
+static int      *framemobjlist = NULL;
+static byte     *framemobjdirty = NULL;   // 1 listed, 2 listed but gone
+static int      numframemobjs = 0;
+static int      maxframemobjs = 0;
+
+static int      numlinkedmobjs = 0;
+
+static int      framestattics = 0;
+static int      framestatfull = 0;
+static int      framestattouched = 0;
+
+//
+// P_AllocMobj
+// Returns a zeroed mobj with its pool index set.
+//
+
+mobj_t *P_AllocMobj(void) {
+    mobj_t *mobj;
+    int index;
+
+    if(mobjfreelist == NULL) {
+        mobj_t *slab;
+        int i;
+
+        mobjslabs = (mobj_t**)Z_Realloc(mobjslabs, (nummobjslabs + 1) * sizeof(mobj_t*), PU_LEVEL, NULL);
+        slab = (mobj_t*)Z_Malloc(MOBJSLABSIZE * sizeof(mobj_t), PU_LEVEL, NULL);
+        mobjslabs[nummobjslabs] = slab;
+
+        // link backwards so mobjs are handed out in address order
+        for(i = MOBJSLABSIZE - 1; i >= 0; i--) {
+            slab[i].index = (nummobjslabs << MOBJSLABSHIFT) + i;
+            slab[i].next = mobjfreelist;
+            mobjfreelist = &slab[i];
+        }
+
+        nummobjslabs++;
+    }
+
+    mobj = mobjfreelist;
+    mobjfreelist = mobj->next;
+
+    index = mobj->index;
+    dmemset(mobj, 0, sizeof(mobj_t));
+    mobj->index = index;
+
+    return mobj;
+}
+
+//
+// P_FreeMobj
+// Returns a mobj to the pool. It must already be unlinked from everything.
+//
+
+void P_FreeMobj(mobj_t *mobj) {
+    P_FreeThingGrid(mobj);
+
+    mobj->next = mobjfreelist;
+    mobjfreelist = mobj;
+}
+
+//
+// P_MobjFromIndex
+//
+
+mobj_t *P_MobjFromIndex(int index) {
+    return &mobjslabs[index >> MOBJSLABSHIFT][index & (MOBJSLABSIZE - 1)];
+}
+
+//
+// P_MobjPoolSize
+// Number of indexes handed out so far; every mobj index is below this.
+//
+
+int P_MobjPoolSize(void) {
+    return nummobjslabs << MOBJSLABSHIFT;
+}
+
+//
+// CMD_ThinkerBench
+// Spawns a mix of mover and light thinkers the way a busy map does,
+// runs over them for a second of tics and removes them again, once with
+// every thinker Z_Malloc'd on its own and once from the pools.
+//
+
+#define BENCHTHINKERTYPES   5
+#define BENCHTICS           35
+
+static CMD(ThinkerBench) {
+    static const struct {
+        int size;
+        actionf_p1 function;
+    } types[BENCHTHINKERTYPES] = {
+        { sizeof(lightbatch_t), (actionf_p1)T_LightBatch },
+        { sizeof(vldoor_t),     (actionf_p1)T_VerticalDoor },
+        { sizeof(floormove_t),  (actionf_p1)T_MoveFloor },
+        { sizeof(plat_t),       (actionf_p1)T_PlatRaise },
+        { sizeof(ceiling_t),    (actionf_p1)T_MoveCeiling }
+    };
+    thinker_t cap;
+    thinker_t *th;
+    thinker_t *next;
+    unsigned int sum = 0;
+    int count;
+    int time[2];
+    int i;
+    int j;
+    int t;
+
+    if(gamestate != GS_LEVEL) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    count = param[0] ? datoi(param[0]) : 1000;
+
+    if(count <= 0) {
+        return;
+    }
+
+    for(j = 0; j < 2; j++) {
+        time[j] = I_GetTimeMS();
+        cap.prev = cap.next = &cap;
+
+        for(i = 0; i < count; i++) {
+            int type = i % BENCHTHINKERTYPES;
+
+            if(j == 0) {
+                th = (thinker_t*)Z_Calloc(types[type].size, PU_LEVSPEC, 0);
+            }
+            else {
+                th = (thinker_t*)P_AllocThinker(types[type].size, types[type].function);
+            }
+
+            cap.prev->next = th;
+            th->next = &cap;
+            th->prev = cap.prev;
+            cap.prev = th;
+        }
+
+        // touch each thinker's fields the way its think function would
+        for(t = 0; t < BENCHTICS; t++) {
+            for(th = cap.next, i = 0; th != &cap; th = th->next, i++) {
+                sum += ((byte*)th)[types[i % BENCHTHINKERTYPES].size - 1]++;
+            }
+        }
+
+        for(th = cap.next; th != &cap; th = next) {
+            next = th->next;
+
+            if(j == 0) {
+                Z_Free(th);
+            }
+            else {
+                P_FreeThinker(th);
+            }
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+    }
+
+    CON_Printf(WHITE, "%i thinkers, %i tics: Z_Malloc %ims, pools %ims (%u)\n",
+               count, BENCHTICS, time[0], time[1], sum);
+}
+
+//
+// BENCH CROWDS
+//
+// The bench commands spawn a crowd of monsters around the player and
+// run parts of the playsim on the live level. That changes the game,
+// so they are refused in netgames and demos, and the random state is
+// put back when the crowd is removed.
+//
+
+#define BENCHSPREAD         (2048*FRACUNIT)
+
+static rng_t benchrng;
+
+//
+// P_SpawnBenchCrowd
+// Spawns count monsters spread around the player inside the blockmap.
+// The same count gives the same crowd each time. box gets the area
+// they were spread over. Returns NULL if no bench can run now
+//
+
+mobj_t **P_SpawnBenchCrowd(int count, fixed_t *box) {
+    mobj_t **things;
+    mobj_t *mo;
+    unsigned int rnd = 1;
+    int i;
+
+    if(gamestate != GS_LEVEL || !(mo = players[consoleplayer].mo)) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return NULL;
+    }
+
+    if(netgame || demorecording || demoplayback) {
+        CON_Printf(WHITE, "Can't run benches in netgames or demos\n");
+        return NULL;
+    }
+
+    if(count <= 0) {
+        return NULL;
+    }
+
+    box[BOXLEFT]    = MAX(mo->x - BENCHSPREAD, bmaporgx + MAXRADIUS);
+    box[BOXRIGHT]   = MIN(mo->x + BENCHSPREAD, bmaporgx + (bmapwidth << MAPBLOCKSHIFT) - MAXRADIUS);
+    box[BOXBOTTOM]  = MAX(mo->y - BENCHSPREAD, bmaporgy + MAXRADIUS);
+    box[BOXTOP]     = MIN(mo->y + BENCHSPREAD, bmaporgy + (bmapheight << MAPBLOCKSHIFT) - MAXRADIUS);
+
+    benchrng = rng;
+
+    things = (mobj_t**)Z_Malloc(count * sizeof(mobj_t*), PU_STATIC, 0);
+
+    for(i = 0; i < count; i++) {
+        fixed_t x;
+        fixed_t y;
+
+        rnd = rnd * 1103515245u + 12345u;
+        x = box[BOXLEFT] + (fixed_t)((rnd >> 8) % (unsigned int)(box[BOXRIGHT] - box[BOXLEFT] + 1));
+        rnd = rnd * 1103515245u + 12345u;
+        y = box[BOXBOTTOM] + (fixed_t)((rnd >> 8) % (unsigned int)(box[BOXTOP] - box[BOXBOTTOM] + 1));
+
+        things[i] = P_SpawnMobj(x, y, ONFLOORZ, MT_POSSESSED1);
+    }
+
+    return things;
+}
+
+//
+// P_RemoveBenchCrowd
+// Removes a crowd from P_SpawnBenchCrowd and puts the random state back
+//
+
+void P_RemoveBenchCrowd(mobj_t **things, int count) {
+    int i;
+
+    for(i = 0; i < count; i++) {
+        P_RemoveMobj(things[i]);
+    }
+
+    Z_Free(things);
+    rng = benchrng;
+}
+
+//
+// CMD_MobjBench
+// Spawns a crowd of monsters around the player, runs just the mobjs
+// for a second of tics and reports the time per tic
+//
+
+static CMD(MobjBench) {
+    mobj_t **things;
+    fixed_t box[4];
+    int count;
+    int time;
+    int t;
+
+    count = param[0] ? datoi(param[0]) : 2000;
+
+    if(!(things = P_SpawnBenchCrowd(count, box))) {
+        return;
+    }
+
+    time = I_GetTimeMS();
+
+    for(t = 0; t < BENCHTICS; t++) {
+        P_RunMobjs();
+    }
+
+    time = I_GetTimeMS() - time;
+
+    P_RemoveBenchCrowd(things, count);
+
+    CON_Printf(WHITE, "%i monsters, %i mobjs, %i tics: %ims (%i.%02ims per tic)\n",
+               count, numlinkedmobjs, BENCHTICS, time,
+               time / BENCHTICS, (time * 100 / BENCHTICS) % 100);
+}
+
+//
+// P_InitThinkerPools
+// The pools belong to the world their thinkers and mobjs are in
+//
+
+void P_InitThinkerPools(void) {
+    P_AddWorldState(thinkerpools, sizeof(thinkerpools));
+    P_AddWorldState(&numthinkerpools, sizeof(numthinkerpools));
+    P_AddWorldState(&mobjslabs, sizeof(mobjslabs));
+    P_AddWorldState(&nummobjslabs, sizeof(nummobjslabs));
+    P_AddWorldState(&mobjfreelist, sizeof(mobjfreelist));
+
+    G_AddCommand("thinkerbench", CMD_ThinkerBench, 0);
+    G_AddCommand("mobjbench", CMD_MobjBench, 0);
+}
+
 //
 // P_InitThinkers
 //
@@ -75,6 +532,18 @@ thinker_t   *currentthinker;
 void P_InitThinkers(void) {
     thinkercap.prev = thinkercap.next  = &thinkercap;
     mobjhead.next = mobjhead.prev = &mobjhead;
+    P_ClearTIDs();
+
+    // the slabs went away with the rest of PU_LEVEL and PU_LEVSPEC
+    numthinkerpools = 0;
+    mobjslabs = NULL;
+    nummobjslabs = 0;
+    mobjfreelist = NULL;
+
+    framemobjlist = NULL;
+    framemobjdirty = NULL;
+    maxframemobjs = 0;
+    P_ClearFrameMobjs();
 }
 
 //
@@ -99,7 +568,7 @@ static void P_UnlinkThinker(void *data) {
     thinker_t* next = currentthinker->next;
     (next->prev = currentthinker = thinker->prev)->next = next;
 
-    Z_Free(thinker);
+    P_FreeThinker(thinker);
 }
 
 //
@@ -124,6 +593,9 @@ void P_LinkMobj(void *data) {
     mobj->next = &mobjhead;
     mobj->prev = mobjhead.prev;
     mobjhead.prev = mobj;
+
+    P_LinkTID(mobj);
+    numlinkedmobjs++;
 }
 
 //
@@ -140,6 +612,14 @@ void P_UnlinkMobj(void *data) {
     * point it to mobj->prev, so the iterator will correctly move on to
     * mobj->prev->next = mobj->next */
     (next->prev = currentmobj = mobj->prev)->next = next;
+
+    P_UnlinkTID(mobj);
+    numlinkedmobjs--;
+
+    // the index may be handed out again before the next snapshot
+    if(mobj->index < maxframemobjs && framemobjdirty[mobj->index]) {
+        framemobjdirty[mobj->index] = 2;
+    }
 }
 
 //
@@ -195,15 +675,91 @@ void P_RunThinkers(void) {
 }
 
 //
-// P_UpdateFrameStates
+// P_SetupFrameStates
+// Called once sectors are loaded, before any things are spawned
+//
+
+void P_SetupFrameStates(void) {
+    int i;
+
+    // owners are cleared when PU_LEVEL is freed
+    Z_Malloc(numsectors * sizeof(framesector_t), PU_LEVEL, &framesectors);
+    Z_Malloc(numsectors * sizeof(int), PU_LEVEL, &framesectorlist);
+    Z_Calloc(numsectors * sizeof(byte), PU_LEVEL, &framesectordirty);
+    numframesectors = 0;
+
+    for(i = 0; i < numsectors; i++) {
+        framesectors[i].floorheight = sectors[i].floorheight;
+        framesectors[i].ceilingheight = sectors[i].ceilingheight;
+    }
+}
+
+//
+// P_ClearFrameMobjs
+// Called whenever the mobj list is emptied
 //
 
+void P_ClearFrameMobjs(void) {
+    if(framemobjdirty) {
+        dmemset(framemobjdirty, 0, maxframemobjs);
+    }
+
+    numframemobjs = 0;
+    numlinkedmobjs = 0;
+}
+
+//
+// P_MarkSectorFrame
+//
+
+void P_MarkSectorFrame(sector_t *sec) {
+    int i;
+
+    if(!framesectordirty) {
+        return;
+    }
+
+    i = sec - sectors;
+
+    if(!framesectordirty[i]) {
+        framesectordirty[i] = 1;
+        framesectorlist[numframesectors++] = i;
+    }
+}
+
+//
+// P_MarkMobjFrame
+//
+
+void P_MarkMobjFrame(mobj_t *mobj) {
+    int i = mobj->index;
+
+    if(i >= maxframemobjs) {
+        int size = P_MobjPoolSize();
+
+        framemobjlist = (int*)Z_Realloc(framemobjlist, size * sizeof(int), PU_LEVEL, 0);
+        framemobjdirty = (byte*)Z_Realloc(framemobjdirty, size, PU_LEVEL, 0);
+        dmemset(framemobjdirty + maxframemobjs, 0, size - maxframemobjs);
+        maxframemobjs = size;
+    }
+
+    if(!framemobjdirty[i]) {
+        framemobjlist[numframemobjs++] = i;
+    }
+
+    framemobjdirty[i] = 1;
+}
+
 angle_t frame_angle = 0;
 angle_t frame_pitch = 0;
 fixed_t frame_viewx = 0;
 fixed_t frame_viewy = 0;
 fixed_t frame_viewz = 0;
 
+//
+// P_UpdateFrameStates
+//
+
 static void P_UpdateFrameStates(void) {
     player_t    *player = &players[displayplayer];
     pspdef_t    *psp;
@@ -241,33 +797,80 @@ static void P_UpdateFrameStates(void) {
     //
     // update sector frames for interpolation
     //
-    for(i = 0; i < numsectors; i++) {
-        sector_t* sector = &sectors[i];
+    for(i = 0; i < numframesectors; i++) {
+        int num = framesectorlist[i];
 
-        sector->frame_z1[0] = sector->floorheight;
-        sector->frame_z2[0] = sector->ceilingheight;
-        sector->frame_z1[1] = sector->frame_z1[0];
-        sector->frame_z2[1] = sector->frame_z1[0];
+        framesectors[num].floorheight = sectors[num].floorheight;
+        framesectors[num].ceilingheight = sectors[num].ceilingheight;
+        framesectordirty[num] = 0;
     }
 
+    framestattouched += numframesectors;
+    numframesectors = 0;
+
     //
     // update mobj frames for interpolation
     //
-    for(mobj = mobjhead.next; mobj != &mobjhead; mobj = mobj->next) {
-        if(!mobj) {
-            CON_Warnf("P_UpdateFrameStates: Null mobj in linked list!\n");
-            continue;
-        }
+    for(i = 0; i < numframemobjs; i++) {
+        int num = framemobjlist[i];
 
-        // Special case only
-        if(mobj->flags & MF_NOSECTOR) {
-            continue;
+        if(framemobjdirty[num] == 1) {
+            mobj = P_MobjFromIndex(num);
+
+            // Special case only
+            if(!(mobj->flags & MF_NOSECTOR)) {
+                mobj->frame_x = mobj->x;
+                mobj->frame_y = mobj->y;
+                mobj->frame_z = mobj->z;
+            }
         }
 
-        mobj->frame_x = mobj->x;
-        mobj->frame_y = mobj->y;
-        mobj->frame_z = mobj->z;
+        framemobjdirty[num] = 0;
+    }
+
+    framestattouched += numframemobjs;
+    numframemobjs = 0;
+
+    // what copying everything would have cost
+    framestatfull += numsectors + numlinkedmobjs;
+    framestattics++;
+}
+
+//
+// CMD_FrameStats
+// Frame state entries updated per tic since the last time it was asked
+//
+
+static CMD(FrameStats) {
+    if(!framestattics) {
+        CON_Printf(WHITE, "No frame states updated\n");
+        return;
     }
+
+    CON_Printf(WHITE, "%i tics: %i of %i sectors and mobjs updated per tic\n",
+               framestattics, framestattouched / framestattics, framestatfull / framestattics);
+
+    framestattics = 0;
+    framestatfull = 0;
+    framestattouched = 0;
+}
+
+//
+// P_InitFrameStates
+//
+
+void P_InitFrameStates(void) {
+    P_AddWorldState(&framesectors, sizeof(framesectors));
+    P_AddWorldState(&framesectorlist, sizeof(framesectorlist));
+    P_AddWorldState(&framesectordirty, sizeof(framesectordirty));
+    P_AddWorldState(&numframesectors, sizeof(numframesectors));
+    P_AddWorldState(&framemobjlist, sizeof(framemobjlist));
+    P_AddWorldState(&framemobjdirty, sizeof(framemobjdirty));
+    P_AddWorldState(&numframemobjs, sizeof(numframemobjs));
+    P_AddWorldState(&maxframemobjs, sizeof(maxframemobjs));
+    P_AddWorldState(&numlinkedmobjs, sizeof(numlinkedmobjs));
+
+    G_AddCommand("framestats", CMD_FrameStats, 0);
 }
 
 //
@@ -337,9 +940,15 @@ void P_Stop(void) {
         ST_ClearDamageMarkers();
     }
 
+    // report steady state allocations for this level
+    Z_AllocWatchReport();
+
     // free level tags
     Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
 
+    // compare what survived the level with the previous one
+    D_MemoryLevelDiff();
+
     if(automapactive) {
         AM_Stop();
     }
@@ -400,7 +1009,9 @@ void P_Drawer(void) {
     GL_ClearView(0xFF000000);
 
     if(!automapactive || am_overlay) {
+        Z_BeginAllocWatch(ZW_RENDER, leveltime);
         R_RenderPlayerView(&players[displayplayer]);
+        Z_EndAllocWatch(ZW_RENDER);
     }
 
     AM_Drawer();
@@ -428,6 +1039,9 @@ bool P_Ticker(void) {
         return 0;
     }
 
+    Z_BeginAllocWatch(ZW_TICKER, leveltime);
+    P_StartLightEffects();
+
     for(i = 0; i < MAXPLAYERS; i++) {
         if(playeringame[i]) {
             // do player reborns if needed
@@ -441,16 +1055,22 @@ bool P_Ticker(void) {
 
     P_RunThinkers();
     P_ScanSights();
+    P_ScanMoves();
     P_RunMobjs();
+    P_DropMovePlans();
     P_UpdateSpecials();
     P_RunMacros();
 
     ST_Ticker();
     AM_Ticker();
 
+    Z_EndAllocWatch(ZW_TICKER);
+
     // for par times
     leveltime++;
 
+    G_LogStateHash();
+
     return gameaction;
 }
 
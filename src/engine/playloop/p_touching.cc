@@ -0,0 +1,569 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Things touching sectors. A thing touches the sector it stands in and
+//    the sectors on both sides of every line its box crosses, which are
+//    the sectors P_CheckPosition takes its floor and ceiling from. Each
+//    touch is a node on two lists, the thing's and the sector's, so a
+//    moving plane only has to look at the things on its sector's list
+//    instead of everything in the blocks around it.
+//
+//    The lists are kept while COMPATF_SECTORTHINGS is set, starting from
+//    the first time they are asked for. Nodes live in one array and link
+//    by index, so it can grow as it likes.
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "m_misc.h"
+#include "i_system.h"
+#include "p_local.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+typedef struct {
+    int     sector;
+    int     thing;      // mobj index
+    int     tnext;      // next sector the thing touches
+    int     sprev;      // things touching the sector
+    int     snext;
+    int     visit;      // touchgeneration when last iterated
+} touchnode_t;
+
+static touchnode_t  *touchnodes = NULL;
+static int          numtouchnodes = 0;
+static int          maxtouchnodes = 0;
+static int          touchfree = -1;
+static int          *sectortouch = NULL;    // [numsectors] first node
+static int          *thingtouch = NULL;     // by mobj index, first node
+static int          numthingtouch = 0;
+static int          *touchlinevalid = NULL; // [numlines]
+static int          touchvalidcount = 0;
+static int          touchgeneration = 0;
+static int          touchchanges = 0;       // bumped whenever a list changes
+static dboolean     touchbuilt = false;
+
+static int          *touchsectors = NULL;   // sectors found by P_AddTouching
+static int          maxtouchsectors = 0;
+
+//
+// P_ClearTouching
+// Called before the things are spawned; the old level's lists went with PU_LEVEL
+//
+
+void P_ClearTouching(void) {
+    touchnodes = NULL;
+    numtouchnodes = 0;
+    maxtouchnodes = 0;
+    touchfree = -1;
+    thingtouch = NULL;
+    numthingtouch = 0;
+    touchvalidcount = 0;
+    touchbuilt = false;
+
+    Z_Malloc(numsectors * sizeof(int), PU_LEVEL, &sectortouch);
+    dmemset(sectortouch, 0xff, numsectors * sizeof(int));
+
+    Z_Calloc(numlines * sizeof(int), PU_LEVEL, &touchlinevalid);
+}
+
+//
+// P_NewTouchNode
+//
+
+static int P_NewTouchNode(void) {
+    int node;
+
+    if(touchfree != -1) {
+        node = touchfree;
+        touchfree = touchnodes[node].tnext;
+        return node;
+    }
+
+    if(numtouchnodes == maxtouchnodes) {
+        maxtouchnodes = maxtouchnodes ? maxtouchnodes * 2 : 1024;
+        touchnodes = (touchnode_t*)Z_Realloc(touchnodes, maxtouchnodes * sizeof(touchnode_t), PU_LEVEL, 0);
+    }
+
+    return numtouchnodes++;
+}
+
+//
+// P_ThingTouch
+// Grows the thing heads along with the mobj pool
+//
+
+static int *P_ThingTouch(mobj_t *thing) {
+    if(thing->index >= numthingtouch) {
+        int count = MAX(P_MobjPoolSize(), thing->index + 1);
+
+        thingtouch = (int*)Z_Realloc(thingtouch, count * sizeof(int), PU_LEVEL, 0);
+        dmemset(thingtouch + numthingtouch, 0xff, (count - numthingtouch) * sizeof(int));
+        numthingtouch = count;
+    }
+
+    return &thingtouch[thing->index];
+}
+
+//
+// P_NoteTouchedSector
+//
+
+static int P_NoteTouchedSector(int count, int sec) {
+    int i;
+
+    for(i = 0; i < count; i++) {
+        if(touchsectors[i] == sec) {
+            return count;
+        }
+    }
+
+    if(count == maxtouchsectors) {
+        maxtouchsectors = maxtouchsectors ? maxtouchsectors * 2 : 64;
+        touchsectors = (int*)Z_Realloc(touchsectors, maxtouchsectors * sizeof(int), PU_STATIC, NULL);
+    }
+
+    touchsectors[count] = sec;
+    return count + 1;
+}
+
+//
+// P_AddTouching
+// Puts a thing on the lists of the sectors it touches
+//
+
+static void P_AddTouching(mobj_t *thing) {
+    fixed_t box[4];
+    int xl, xh, yl, yh;
+    int count;
+    int bx, by;
+    int *list;
+    int *head;
+    int i;
+
+    box[BOXTOP] = thing->y + thing->radius;
+    box[BOXBOTTOM] = thing->y - thing->radius;
+    box[BOXRIGHT] = thing->x + thing->radius;
+    box[BOXLEFT] = thing->x - thing->radius;
+
+    // lines are filed in every block they pass through
+    xl = MAX((box[BOXLEFT] - bmaporgx) >> MAPBLOCKSHIFT, 0);
+    xh = MIN((box[BOXRIGHT] - bmaporgx) >> MAPBLOCKSHIFT, bmapwidth - 1);
+    yl = MAX((box[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT, 0);
+    yh = MIN((box[BOXTOP] - bmaporgy) >> MAPBLOCKSHIFT, bmapheight - 1);
+
+    count = P_NoteTouchedSector(0, thing->subsector->sector - sectors);
+    touchvalidcount++;
+
+    for(bx = xl; bx <= xh; bx++) {
+        for(by = yl; by <= yh; by++) {
+            for(list = blockmaplump + blockmap[by * bmapwidth + bx]; *list != -1; list++) {
+                int num = *list;
+                fixed_t *bbox;
+
+                if(num >= numlines || touchlinevalid[num] == touchvalidcount) {
+                    continue;
+                }
+
+                touchlinevalid[num] = touchvalidcount;
+                bbox = geolines[num].bbox;
+
+                // what PIT_CheckLine counts as contact
+                if(box[BOXRIGHT] <= bbox[BOXLEFT] || box[BOXLEFT] >= bbox[BOXRIGHT] ||
+                        box[BOXTOP] <= bbox[BOXBOTTOM] || box[BOXBOTTOM] >= bbox[BOXTOP]) {
+                    continue;
+                }
+
+                if(P_BoxOnLineSide(box, &lines[num]) != -1) {
+                    continue;
+                }
+
+                for(i = 0; i < 2; i++) {
+                    if(geolinesectors[num][i] != -1) {
+                        count = P_NoteTouchedSector(count, geolinesectors[num][i]);
+                    }
+                }
+            }
+        }
+    }
+
+    head = P_ThingTouch(thing);
+
+    for(i = 0; i < count; i++) {
+        int node = P_NewTouchNode();
+        touchnode_t *n = &touchnodes[node];
+
+        n->sector = touchsectors[i];
+        n->thing = thing->index;
+        n->visit = touchgeneration;     // not visited by an iteration already going
+        n->tnext = *head;
+        *head = node;
+
+        n->sprev = -1;
+        n->snext = sectortouch[n->sector];
+
+        if(n->snext != -1) {
+            touchnodes[n->snext].sprev = node;
+        }
+
+        sectortouch[n->sector] = node;
+    }
+
+    touchchanges++;
+}
+
+//
+// P_DropTouching
+// Forgets every list
+//
+
+static void P_DropTouching(void) {
+    numtouchnodes = 0;
+    touchfree = -1;
+    dmemset(sectortouch, 0xff, numsectors * sizeof(int));
+    dmemset(thingtouch, 0xff, numthingtouch * sizeof(int));
+    touchbuilt = false;
+    touchchanges++;
+}
+
+//
+// P_BuildTouching
+// Puts every thing in the blockmap on its lists
+//
+
+static void P_BuildTouching(void) {
+    mobj_t *mo;
+    int bx;
+    int by;
+
+    touchbuilt = true;
+
+    for(mo = mobjhead.next; mo != &mobjhead; mo = mo->next) {
+        if(mo->flags & MF_NOBLOCKMAP) {
+            continue;
+        }
+
+        bx = (mo->x - bmaporgx) >> MAPBLOCKSHIFT;
+        by = (mo->y - bmaporgy) >> MAPBLOCKSHIFT;
+
+        if(bx >= 0 && bx < bmapwidth && by >= 0 && by < bmapheight) {
+            P_AddTouching(mo);
+        }
+    }
+}
+
+//
+// P_LinkTouching
+// Called by P_SetThingPosition once the thing is in the blockmap
+//
+
+void P_LinkTouching(mobj_t *thing) {
+    if(!touchbuilt) {
+        return;
+    }
+
+    if(!(compatflags & COMPATF_SECTORTHINGS)) {
+        P_DropTouching();
+        return;
+    }
+
+    // in case it was never unset
+    P_UnlinkTouching(thing);
+    P_AddTouching(thing);
+}
+
+//
+// P_UnlinkTouching
+// Called by P_UnsetThingPosition
+//
+
+void P_UnlinkTouching(mobj_t *thing) {
+    int *head;
+    int node;
+
+    if(!touchbuilt || thing->index >= numthingtouch) {
+        return;
+    }
+
+    head = &thingtouch[thing->index];
+
+    if(*head == -1) {
+        return;
+    }
+
+    for(node = *head; node != -1;) {
+        touchnode_t *n = &touchnodes[node];
+        int next = n->tnext;
+
+        if(n->sprev != -1) {
+            touchnodes[n->sprev].snext = n->snext;
+        }
+        else {
+            sectortouch[n->sector] = n->snext;
+        }
+
+        if(n->snext != -1) {
+            touchnodes[n->snext].sprev = n->sprev;
+        }
+
+        n->tnext = touchfree;
+        touchfree = node;
+        node = next;
+    }
+
+    *head = -1;
+    touchchanges++;
+}
+
+//
+// P_TouchingThingsIterator
+// Calls func for every thing touching the sector. func may move, spawn
+// and remove things; things put on the list while it runs are skipped.
+//
+
+dboolean P_TouchingThingsIterator(sector_t *sector, dboolean(*func)(mobj_t*)) {
+    int gen;
+    int node;
+    int changes;
+
+    if(!touchbuilt) {
+        P_BuildTouching();
+    }
+
+    gen = ++touchgeneration;
+
+restart:
+    for(node = sectortouch[sector - sectors]; node != -1; node = touchnodes[node].snext) {
+        if(touchnodes[node].visit == gen) {
+            continue;
+        }
+
+        touchnodes[node].visit = gen;
+        changes = touchchanges;
+
+        if(!func(P_MobjFromIndex(touchnodes[node].thing))) {
+            return false;
+        }
+
+        // the node may be gone, so start over and skip what was visited
+        if(touchchanges != changes) {
+            goto restart;
+        }
+    }
+
+    return true;
+}
+
+//
+// CMD_ChangeSectorBench
+// Times finding the things a moving sector has to check, through the
+// blockmap and through the touching lists. Uses the sectors that are
+// moving, or all of them if none are. Start lifts and crushers first
+// to time them moving.
+//
+// It also checks that the lists cover the blockmap sweep: every thing
+// the sweep finds that stands in the sector or has its box across one
+// of the sector's lines must be on the sector's list, or a moving plane
+// would miss it.
+//
+
+static int benchvisits;
+static int benchmissed;
+static sector_t *benchsector;
+static int *benchseen;      // by mobj index, sector number + 1 when listed
+
+static dboolean PIT_CountThing(mobj_t *thing) {
+    benchvisits++;
+    return true;
+}
+
+static dboolean PIT_MarkListed(mobj_t *thing) {
+    benchseen[thing->index] = (benchsector - sectors) + 1;
+    return true;
+}
+
+//
+// P_BenchThingTouches
+// Works out from the lines, not the lists, whether the thing touches
+// the sector the way P_CheckPosition would see it
+//
+
+static dboolean P_BenchThingTouches(mobj_t *thing, sector_t *sec) {
+    fixed_t box[4];
+    int i;
+
+    if(thing->subsector->sector == sec) {
+        return true;
+    }
+
+    box[BOXTOP] = thing->y + thing->radius;
+    box[BOXBOTTOM] = thing->y - thing->radius;
+    box[BOXRIGHT] = thing->x + thing->radius;
+    box[BOXLEFT] = thing->x - thing->radius;
+
+    for(i = 0; i < sec->linecount; i++) {
+        line_t *ld = sec->lines[i];
+
+        if(box[BOXRIGHT] <= ld->bbox[BOXLEFT] || box[BOXLEFT] >= ld->bbox[BOXRIGHT] ||
+                box[BOXTOP] <= ld->bbox[BOXBOTTOM] || box[BOXBOTTOM] >= ld->bbox[BOXTOP]) {
+            continue;
+        }
+
+        if(P_BoxOnLineSide(box, ld) == -1) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static dboolean PIT_CheckListed(mobj_t *thing) {
+    if(benchseen[thing->index] != (benchsector - sectors) + 1 &&
+            P_BenchThingTouches(thing, benchsector)) {
+        benchmissed++;
+    }
+
+    return true;
+}
+
+static CMD(ChangeSectorBench) {
+    int numsecs = 0;
+    int moving = 0;
+    int count;
+    int visits[2];
+    int time[2];
+    int i;
+    int j;
+    int x;
+    int y;
+
+    if(gamestate != GS_LEVEL) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    count = param[0] ? datoi(param[0]) : 100;
+
+    if(count <= 0) {
+        return;
+    }
+
+    for(i = 0; i < numsectors; i++) {
+        if(sectors[i].specialdata) {
+            moving++;
+        }
+    }
+
+    if(!touchbuilt) {
+        P_BuildTouching();
+    }
+
+    benchvisits = 0;
+    time[0] = I_GetTimeMS();
+
+    for(j = 0; j < count; j++) {
+        for(i = 0; i < numsectors; i++) {
+            sector_t *sec = &sectors[i];
+
+            if(moving && !sec->specialdata) {
+                continue;
+            }
+
+            for(x = sec->blockbox[BOXLEFT]; x <= sec->blockbox[BOXRIGHT]; x++) {
+                for(y = sec->blockbox[BOXBOTTOM]; y <= sec->blockbox[BOXTOP]; y++) {
+                    P_BlockThingsIterator(x, y, PIT_CountThing);
+                }
+            }
+        }
+    }
+
+    time[0] = I_GetTimeMS() - time[0];
+    visits[0] = benchvisits;
+
+    benchvisits = 0;
+    time[1] = I_GetTimeMS();
+
+    for(j = 0; j < count; j++) {
+        for(i = 0; i < numsectors; i++) {
+            if(moving && !sectors[i].specialdata) {
+                continue;
+            }
+
+            if(!j) {
+                numsecs++;
+            }
+
+            P_TouchingThingsIterator(&sectors[i], PIT_CountThing);
+        }
+    }
+
+    time[1] = I_GetTimeMS() - time[1];
+    visits[1] = benchvisits;
+
+    benchseen = (int*)Z_Calloc(P_MobjPoolSize() * sizeof(int), PU_STATIC, 0);
+    benchmissed = 0;
+
+    for(i = 0; i < numsectors; i++) {
+        sector_t *sec = &sectors[i];
+
+        if(moving && !sec->specialdata) {
+            continue;
+        }
+
+        benchsector = sec;
+        P_TouchingThingsIterator(sec, PIT_MarkListed);
+
+        for(x = sec->blockbox[BOXLEFT]; x <= sec->blockbox[BOXRIGHT]; x++) {
+            for(y = sec->blockbox[BOXBOTTOM]; y <= sec->blockbox[BOXTOP]; y++) {
+                P_BlockThingsIterator(x, y, PIT_CheckListed);
+            }
+        }
+    }
+
+    Z_Free(benchseen);
+
+    CON_Printf(WHITE, "%i x %i%s sectors: blockmap %ims visiting %i things, touching %ims visiting %i\n",
+               count, numsecs, moving ? " moving" : "", time[0], visits[0] / count, time[1], visits[1] / count);
+    CON_Printf(WHITE, "%i things touching a sector are missing from its list\n", benchmissed);
+}
+
+//
+// P_InitTouching
+//
+
+void P_InitTouching(void) {
+    P_AddWorldState(&touchnodes, sizeof(touchnodes));
+    P_AddWorldState(&numtouchnodes, sizeof(numtouchnodes));
+    P_AddWorldState(&maxtouchnodes, sizeof(maxtouchnodes));
+    P_AddWorldState(&touchfree, sizeof(touchfree));
+    P_AddWorldState(&sectortouch, sizeof(sectortouch));
+    P_AddWorldState(&thingtouch, sizeof(thingtouch));
+    P_AddWorldState(&numthingtouch, sizeof(numthingtouch));
+    P_AddWorldState(&touchlinevalid, sizeof(touchlinevalid));
+    P_AddWorldState(&touchvalidcount, sizeof(touchvalidcount));
+    P_AddWorldState(&touchgeneration, sizeof(touchgeneration));
+    P_AddWorldState(&touchchanges, sizeof(touchchanges));
+    P_AddWorldState(&touchbuilt, sizeof(touchbuilt));
+
+    G_AddCommand("changesectorbench", CMD_ChangeSectorBench, 0);
+}
@@ -0,0 +1,532 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Blockmap grid tracer. The blocks under a trace are visited with an
+//    exact DDA, and intercepts are handed out as soon as nothing found in
+//    a later block can come before them, so a callback that stops early
+//    never pays for the rest of the trace.
+//
+//    Lines are listed in every block they touch, so one crossing the trace
+//    is always found in or before the block holding the crossing point.
+//    Things are only linked into the block of their center, and their box
+//    can reach back over the trace by up to GRIDMARGIN.
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "m_fixed.h"
+#include "p_trace.h"
+#include "i_system.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+BoolProperty p_gridtrace("p_gridtrace", "Trace sight, attacks and use lines on the blockmap grid (not demo compatible)", false);
+
+#define GRIDMARGIN      (2*MAPBLOCKSIZE)    // how far a thing can be hit before its block
+#define GRIDSLOP        16                  // rounding between block and intercept fracs
+#define GRIDNEVER       ((int64)1 << 62)
+
+//
+// P_PrepareGridTrace
+// Makes sure the context has a line mark array for the current level.
+//
+
+void P_PrepareGridTrace(gridtrace_t *gt) {
+    if(gt->linevalid == NULL) {
+        // owner is cleared when PU_LEVEL is freed
+        Z_Calloc(MAX(numlines, 1) * sizeof(int), PU_LEVEL, &gt->linevalid);
+        gt->validcount = 0;
+    }
+}
+
+//
+// P_AddGridIntercept
+// Inserts after any intercept with the same frac, so ties keep the order
+// they were found in
+//
+
+static void P_AddGridIntercept(gridtrace_t *gt, fixed_t frac, line_t *ld, mobj_t *thing) {
+    intercept_t *list;
+    intercept_t in;
+    int i;
+
+    P_AddIntercept(&gt->pending, frac, ld, thing);
+
+    list = gt->pending.intercepts;
+    i = gt->pending.numintercepts - 1;
+    in = list[i];
+
+    for(; i > gt->first && list[i - 1].frac > frac; i--) {
+        list[i] = list[i - 1];
+    }
+
+    list[i] = in;
+}
+
+//
+// P_GridLine
+// Same test as PIT_AddLineIntercepts. Returns false on an early out.
+//
+
+static dboolean P_GridLine(gridtrace_t *gt, line_t *ld) {
+    divline_t *tr = &gt->trace;
+    divline_t dl;
+    fixed_t frac;
+    int s1;
+    int s2;
+
+    // avoid precision problems with two routines
+    if(tr->dx > FRACUNIT*16 || tr->dy > FRACUNIT*16 ||
+            tr->dx < -FRACUNIT*16 || tr->dy < -FRACUNIT*16) {
+        s1 = P_PointOnDivlineSide(ld->v1->x, ld->v1->y, tr);
+        s2 = P_PointOnDivlineSide(ld->v2->x, ld->v2->y, tr);
+    }
+    else {
+        s1 = P_PointOnLineSide(tr->x, tr->y, ld);
+        s2 = P_PointOnLineSide(tr->x + tr->dx, tr->y + tr->dy, ld);
+    }
+
+    if(s1 == s2) {
+        return true;    // line isn't crossed
+    }
+
+    P_MakeDivline(ld, &dl);
+    frac = P_InterceptVector(tr, &dl);
+
+    if(frac < 0 || frac > FRACUNIT) {
+        return true;    // behind source or past the end
+    }
+
+    if((gt->flags & PT_EARLYOUT) && frac < FRACUNIT && !ld->backsector) {
+        return false;
+    }
+
+    P_AddGridIntercept(gt, frac, ld, NULL);
+    return true;
+}
+
+//
+// P_GridThing
+// Same test as PIT_AddThingIntercepts
+//
+
+static void P_GridThing(gridtrace_t *gt, mobj_t *thing) {
+    divline_t *tr = &gt->trace;
+    divline_t dl;
+    fixed_t frac;
+    int s1;
+    int s2;
+
+    // check a corner to corner crossection for hit
+    if((tr->dx ^ tr->dy) > 0) {
+        dl.x = thing->x - thing->radius;
+        dl.y = thing->y + thing->radius;
+        dl.dx = thing->radius * 2;
+        dl.dy = -thing->radius * 2;
+    }
+    else {
+        dl.x = thing->x - thing->radius;
+        dl.y = thing->y - thing->radius;
+        dl.dx = thing->radius * 2;
+        dl.dy = thing->radius * 2;
+    }
+
+    s1 = P_PointOnDivlineSide(dl.x, dl.y, tr);
+    s2 = P_PointOnDivlineSide(dl.x + dl.dx, dl.y + dl.dy, tr);
+
+    if(s1 == s2) {
+        return;    // line isn't crossed
+    }
+
+    frac = P_InterceptVector(tr, &dl);
+
+    if(frac < 0 || frac > FRACUNIT) {
+        return;
+    }
+
+    P_AddGridIntercept(gt, frac, NULL, thing);
+}
+
+//
+// P_GridBlock
+// Collects the intercepts of one block. Returns false on an early out.
+//
+
+static dboolean P_GridBlock(gridtrace_t *gt, int x, int y) {
+    int *list;
+    line_t *ld;
+    mobj_t *mo;
+
+    if(x < 0 || y < 0 || x >= bmapwidth || y >= bmapheight) {
+        return true;
+    }
+
+    gt->blocks++;
+
+    if(gt->flags & PT_ADDLINES) {
+        for(list = blockmaplump + blockmap[y*bmapwidth+x]; *list != -1; list++) {
+            ld = &lines[*list];
+
+            if(gt->linevalid[*list] == gt->validcount) {
+                continue;    // line has already been checked
+            }
+
+            gt->linevalid[*list] = gt->validcount;
+
+            if(!P_GridLine(gt, ld)) {
+                return false;
+            }
+        }
+    }
+
+    if(gt->flags & PT_ADDTHINGS) {
+        for(mo = blocklinks[y*bmapwidth+x]; mo; mo = mo->bnext) {
+            P_GridThing(gt, mo);
+        }
+    }
+
+    return true;
+}
+
+//
+// P_FlushGridIntercepts
+// Hands out everything up to frac upto, nearest first
+//
+
+static dboolean P_FlushGridIntercepts(gridtrace_t *gt, int64 upto) {
+    interceptbuf_t *buf = &gt->pending;
+
+    while(gt->first < buf->numintercepts && buf->intercepts[gt->first].frac <= upto) {
+        if(!gt->func(gt, &buf->intercepts[gt->first++])) {
+            return false;
+        }
+    }
+
+    if(gt->first == buf->numintercepts) {
+        gt->first = 0;
+        P_ClearIntercepts(buf, 0);
+    }
+
+    return true;
+}
+
+//
+// P_GridFrac
+// Fraction of den that num is, without overflowing
+//
+
+static int64 P_GridFrac(int64 num, fixed_t den) {
+    return (num << FRACBITS) / den;
+}
+
+//
+// P_GridTrace
+// Traces x1,y1 to x2,y2, calling func for each crossed line and/or thing
+// in order. Returns false if func or PT_EARLYOUT stopped the trace.
+// Reentrant as long as each thread uses its own context.
+//
+
+dboolean P_GridTrace(gridtrace_t *gt, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
+                     int flags, gridtraverser_t func, void *data) {
+    fixed_t ox = x1 - bmaporgx;
+    fixed_t oy = y1 - bmaporgy;
+    fixed_t dx = x2 - x1;
+    fixed_t dy = y2 - y1;
+    int mapx = ox >> MAPBLOCKSHIFT;
+    int mapy = oy >> MAPBLOCKSHIFT;
+    int endx = (x2 - bmaporgx) >> MAPBLOCKSHIFT;
+    int endy = (y2 - bmaporgy) >> MAPBLOCKSHIFT;
+    int stepx;
+    int stepy;
+    int count;
+    int64 tmaxx;
+    int64 tmaxy;
+    int64 tdeltax;
+    int64 tdeltay;
+    int64 texit;
+    int64 margin;
+
+    P_PrepareGridTrace(gt);
+
+    gt->validcount++;
+    gt->trace.x = x1;
+    gt->trace.y = y1;
+    gt->trace.dx = dx;
+    gt->trace.dy = dy;
+    gt->flags = flags;
+    gt->func = func;
+    gt->data = data;
+    gt->first = 0;
+    gt->blocks = 0;
+
+    P_ClearIntercepts(&gt->pending, 0);
+
+    // fractions at which the trace crosses the next block edge
+    if(dx > 0) {
+        stepx = 1;
+        tmaxx = P_GridFrac(((int64)(mapx + 1) << MAPBLOCKSHIFT) - ox, dx);
+        tdeltax = P_GridFrac(MAPBLOCKSIZE, dx);
+    }
+    else if(dx < 0) {
+        stepx = -1;
+        tmaxx = P_GridFrac(ox - ((int64)mapx << MAPBLOCKSHIFT), -dx);
+        tdeltax = P_GridFrac(MAPBLOCKSIZE, -dx);
+    }
+    else {
+        stepx = 0;
+        tmaxx = tdeltax = GRIDNEVER;
+    }
+
+    if(dy > 0) {
+        stepy = 1;
+        tmaxy = P_GridFrac(((int64)(mapy + 1) << MAPBLOCKSHIFT) - oy, dy);
+        tdeltay = P_GridFrac(MAPBLOCKSIZE, dy);
+    }
+    else if(dy < 0) {
+        stepy = -1;
+        tmaxy = P_GridFrac(oy - ((int64)mapy << MAPBLOCKSHIFT), -dy);
+        tdeltay = P_GridFrac(MAPBLOCKSIZE, -dy);
+    }
+    else {
+        stepy = 0;
+        tmaxy = tdeltay = GRIDNEVER;
+    }
+
+    // things found later may still be hit this much before their block
+    margin = GRIDSLOP;
+
+    if((flags & PT_ADDTHINGS) && (dx || dy)) {
+        margin += P_GridFrac(GRIDMARGIN, MAX(D_abs(dx), D_abs(dy)));
+    }
+
+    // every step moves one block closer to the end block
+    count = D_abs(endx - mapx) + D_abs(endy - mapy);
+
+    while(1) {
+        texit = MIN(MIN(tmaxx, tmaxy), FRACUNIT);
+
+        if(!P_GridBlock(gt, mapx, mapy)) {
+            return false;
+        }
+
+        if(!P_FlushGridIntercepts(gt, texit - margin)) {
+            return false;
+        }
+
+        if(texit >= FRACUNIT || count-- <= 0) {
+            break;
+        }
+
+        if(tmaxx < tmaxy) {
+            mapx += stepx;
+            tmaxx += tdeltax;
+        }
+        else {
+            mapy += stepy;
+            tmaxy += tdeltay;
+        }
+    }
+
+    return P_FlushGridIntercepts(gt, FRACUNIT);
+}
+
+//
+// P_GridPathTraverse
+//
+
+#define MAXGRIDDEPTH    8
+
+// one context for each level of nested traces
+static gridtrace_t pathtraces[MAXGRIDDEPTH];
+static int pathdepth = 0;
+
+static dboolean P_GridPathCallback(gridtrace_t *gt, intercept_t *in) {
+    return (*(traverser_t*)gt->data)(in);
+}
+
+dboolean P_GridPathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
+                            int flags, traverser_t trav) {
+    divline_t outertrace = trace;
+    dboolean result;
+
+    if(pathdepth == MAXGRIDDEPTH) {
+        I_Error("P_GridPathTraverse: traces nested too deeply");
+    }
+
+    // the PTR_ functions read the global trace
+    trace.x = x1;
+    trace.y = y1;
+    trace.dx = x2 - x1;
+    trace.dy = y2 - y1;
+
+    pathdepth++;
+    result = P_GridTrace(&pathtraces[pathdepth - 1], x1, y1, x2, y2, flags, P_GridPathCallback, &trav);
+    pathdepth--;
+
+    if(pathdepth > 0) {
+        trace = outertrace;    // still used by the outer traverser
+    }
+
+    return result;
+}
+
+//
+// CMD_TraceBench
+// Times sight and path traces between pairs of things in the current map
+// with the BSP/blockmap code and with the grid tracer
+//
+
+#define BENCHTHINGS     1024
+
+static int benchcount;
+static int64 benchsum;
+
+static dboolean PTR_BenchTraverse(intercept_t *in) {
+    benchcount++;
+    benchsum += in->frac + (in->isaline ? (int64)(in->d.line - lines) : (int64)in->d.thing->x);
+    return true;
+}
+
+static CMD(TraceBench) {
+    mobj_t *things[BENCHTHINGS];
+    mobj_t *mo;
+    byte *results;
+    int64 *sums;
+    unsigned int rnd = 1;
+    dboolean oldgrid = p_gridtrace;
+    int numthings = 0;
+    int count;
+    int differ;
+    int time[2];
+    int i;
+    int j;
+
+    if(gamestate != GS_LEVEL) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    count = param[0] ? datoi(param[0]) : 20000;
+
+    if(count <= 0) {
+        return;
+    }
+
+    for(mo = mobjhead.next; mo != &mobjhead && numthings < BENCHTHINGS; mo = mo->next) {
+        if(!(mo->flags & MF_NOBLOCKMAP)) {
+            things[numthings++] = mo;
+        }
+    }
+
+    if(numthings < 2) {
+        CON_Printf(WHITE, "Not enough things\n");
+        return;
+    }
+
+    results = (byte*)Z_Malloc(count, PU_STATIC, 0);
+    sums = (int64*)Z_Malloc(count * sizeof(int64), PU_STATIC, 0);
+
+    // sight, BSP walk against grid trace; the same pairs every run
+    for(j = 0; j < 2; j++) {
+        time[j] = I_GetTimeMS();
+        differ = 0;
+        rnd = 1;
+
+        for(i = 0; i < count; i++) {
+            mobj_t *t1;
+            mobj_t *t2;
+            dboolean seen;
+
+            rnd = rnd * 1103515245u + 12345u;
+            t1 = things[(rnd >> 8) % numthings];
+            rnd = rnd * 1103515245u + 12345u;
+            t2 = things[(rnd >> 8) % numthings];
+
+            seen = P_BenchSight(t1, t2, j);
+
+            if(j == 0) {
+                results[i] = seen;
+            }
+            else if(results[i] != seen) {
+                differ++;
+            }
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+    }
+
+    CON_Printf(WHITE, "sight: bsp %ims, grid %ims, %i of %i differ\n", time[0], time[1], differ, count);
+
+    // hitscan style path traces, blockmap stepping against grid trace
+    p_gridtrace = false;
+
+    for(j = 0; j < 2; j++) {
+        time[j] = I_GetTimeMS();
+        differ = 0;
+        rnd = 1;
+
+        for(i = 0; i < count; i++) {
+            mobj_t *t1;
+            mobj_t *t2;
+
+            rnd = rnd * 1103515245u + 12345u;
+            t1 = things[(rnd >> 8) % numthings];
+            rnd = rnd * 1103515245u + 12345u;
+            t2 = things[(rnd >> 8) % numthings];
+
+            benchcount = 0;
+            benchsum = 0;
+
+            if(j == 0) {
+                P_PathTraverse(t1->x, t1->y, t2->x, t2->y, PT_ADDLINES|PT_ADDTHINGS, PTR_BenchTraverse);
+                sums[i] = benchsum;
+            }
+            else {
+                P_GridPathTraverse(t1->x, t1->y, t2->x, t2->y, PT_ADDLINES|PT_ADDTHINGS, PTR_BenchTraverse);
+
+                if(sums[i] != benchsum) {
+                    differ++;
+                }
+            }
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+    }
+
+    p_gridtrace = oldgrid;
+
+    CON_Printf(WHITE, "path: blockmap %ims, grid %ims, %i of %i differ\n", time[0], time[1], differ, count);
+
+    Z_Free(results);
+    Z_Free(sums);
+}
+
+//
+// P_InitGridTrace
+//
+
+void P_InitGridTrace(void) {
+    P_AddWorldState(pathtraces, sizeof(pathtraces));
+
+    G_AddCommand("tracebench", CMD_TraceBench, 0);
+}
@@ -0,0 +1,70 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __P_TRACE__
+#define __P_TRACE__
+
+#include <imp/Property>
+
+#include "p_local.h"
+
+//
+// Blockmap grid tracer. Walks the blocks a trace passes through in order
+// and hands every crossed line and thing to a callback, nearest first,
+// stopping as soon as the callback returns false. All state lives in the
+// gridtrace_t, so traces on different contexts can run at once.
+//
+
+struct gridtrace_s;
+
+typedef dboolean(*gridtraverser_t)(struct gridtrace_s *gt, intercept_t *in);
+
+typedef struct gridtrace_s {
+    divline_t       trace;          // from the start to the end point
+    int             flags;          // PT_ADDLINES, PT_ADDTHINGS, PT_EARLYOUT
+    gridtraverser_t func;
+    void            *data;          // for the callback
+
+    int             validcount;
+    int             *linevalid;     // per-line validcount; freed with the level
+
+    // found but not handed out yet, sorted by frac from first on
+    interceptbuf_t  pending;
+    int             first;
+
+    int             blocks;         // visited by the last trace
+} gridtrace_t;
+
+extern BoolProperty p_gridtrace;
+
+void        P_PrepareGridTrace(gridtrace_t *gt);
+dboolean    P_GridTrace(gridtrace_t *gt, fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
+                        int flags, gridtraverser_t func, void *data);
+
+// P_PathTraverse on the grid tracer; also sets the global trace
+dboolean    P_GridPathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2,
+                               int flags, traverser_t trav);
+
+// sight without REJECT, PVS or the cache, from p_sight.cc
+dboolean    P_BenchSight(mobj_t *t1, mobj_t *t2, dboolean grid);
+
+void        P_InitGridTrace(void);
+
+#endif
@@ -486,6 +486,7 @@ void P_PlayerZMovement(mobj_t* mo) {
 
     // adjust height
     mo->z += mo->momz;
+    P_MarkMobjFrame(mo);
 
     // clip movement
     if(mo->z <= mo->floorz) {
@@ -0,0 +1,274 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Game worlds. The playloop keeps its level in globals, so a world is
+//    a copy of those globals together with the zone's level blocks. The
+//    current world lives in the globals as always, and the others wait
+//    in their copies until P_SetWorld swaps one in.
+//
+//    Modules register their level state with P_AddWorldState as they
+//    start up. Only registered state belongs to a world; anything else
+//    is shared between them. Switch worlds between tics, never in one.
+//
+//-----------------------------------------------------------------------------
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "p_local.h"
+#include "p_spec.h"
+#include "p_macros.h"
+#include "m_random.h"
+#include "z_zone.h"
+
+#define MAXWORLDSTATES  256
+
+extern line_t** linespeciallist;
+extern short    numlinespecials;
+
+typedef struct {
+    void    *data;
+    int     size;
+    int     offset;     // into a world's state
+} worldstate_t;
+
+struct gameworld_s {
+    byte        *state;     // NULL while the world is current and never swapped out
+    zonetags_t  tags;       // empty while the world is current
+};
+
+static worldstate_t worldstates[MAXWORLDSTATES];
+static int          numworldstates = 0;
+static int          worldstatesize = 0;
+static byte         *worldinitial = NULL;   // registered state as it was at startup
+static dboolean     worldcreated = false;
+
+static gameworld_t  mainworld;
+static gameworld_t  *currentworld = &mainworld;
+
+//
+// P_AddWorldState
+// Makes size bytes at data part of every world. New worlds start with
+// what is there now.
+//
+
+void P_AddWorldState(void *data, int size) {
+    worldstate_t *ws;
+
+    if(worldcreated) {
+        I_Error("P_AddWorldState: Added after a world was created");
+    }
+
+    if(numworldstates == MAXWORLDSTATES) {
+        I_Error("P_AddWorldState: Too many world states (%i)", numworldstates);
+    }
+
+    ws = &worldstates[numworldstates++];
+    ws->data = data;
+    ws->size = size;
+    ws->offset = worldstatesize;
+
+    worldstatesize += size;
+    worldinitial = (byte*)Z_Realloc(worldinitial, worldstatesize, PU_STATIC, 0);
+    dmemcpy(worldinitial + ws->offset, data, size);
+}
+
+//
+// P_StoreWorld
+//
+
+static void P_StoreWorld(gameworld_t *world) {
+    int i;
+
+    if(!world->state) {
+        world->state = (byte*)Z_Malloc(worldstatesize, PU_STATIC, 0);
+    }
+
+    for(i = 0; i < numworldstates; i++) {
+        dmemcpy(world->state + worldstates[i].offset, worldstates[i].data, worldstates[i].size);
+    }
+}
+
+//
+// P_RestoreWorld
+//
+
+static void P_RestoreWorld(gameworld_t *world) {
+    int i;
+
+    for(i = 0; i < numworldstates; i++) {
+        dmemcpy(worldstates[i].data, world->state + worldstates[i].offset, worldstates[i].size);
+    }
+}
+
+//
+// P_NewWorld
+// An empty world, as the game was before any level was loaded
+//
+
+gameworld_t *P_NewWorld(void) {
+    gameworld_t *world;
+
+    worldcreated = true;
+
+    world = (gameworld_t*)Z_Calloc(sizeof(gameworld_t), PU_STATIC, 0);
+    world->state = (byte*)Z_Malloc(worldstatesize, PU_STATIC, 0);
+    dmemcpy(world->state, worldinitial, worldstatesize);
+
+    return world;
+}
+
+//
+// P_SetWorld
+// Sets the current world aside and makes world current
+//
+
+void P_SetWorld(gameworld_t *world) {
+    if(world == currentworld) {
+        return;
+    }
+
+    worldcreated = true;
+
+    P_StoreWorld(currentworld);
+    Z_SwapTags(&currentworld->tags);
+
+    Z_SwapTags(&world->tags);
+    P_RestoreWorld(world);
+
+    currentworld = world;
+}
+
+//
+// P_CurrentWorld
+//
+
+gameworld_t *P_CurrentWorld(void) {
+    return currentworld;
+}
+
+//
+// P_FreeWorld
+// Frees a world that isn't current along with its level
+//
+
+void P_FreeWorld(gameworld_t *world) {
+    gameworld_t *current = currentworld;
+
+    if(world == current || world == &mainworld) {
+        I_Error("P_FreeWorld: Can't free the current or main world");
+    }
+
+    // its blocks can only be freed while they are current, and the
+    // owners they clear are its own
+    P_SetWorld(world);
+    Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+    P_SetWorld(current);
+
+    Z_Free(world->state);
+    Z_Free(world);
+}
+
+//
+// P_InitWorld
+// Registers the level globals that aren't owned by one module
+//
+
+void P_InitWorld(void) {
+    // map
+    P_AddWorldState(&numvertexes, sizeof(numvertexes));
+    P_AddWorldState(&vertexes, sizeof(vertexes));
+    P_AddWorldState(&numsegs, sizeof(numsegs));
+    P_AddWorldState(&segs, sizeof(segs));
+    P_AddWorldState(&numsectors, sizeof(numsectors));
+    P_AddWorldState(&sectors, sizeof(sectors));
+    P_AddWorldState(&numsubsectors, sizeof(numsubsectors));
+    P_AddWorldState(&subsectors, sizeof(subsectors));
+    P_AddWorldState(&numnodes, sizeof(numnodes));
+    P_AddWorldState(&nodes, sizeof(nodes));
+    P_AddWorldState(&numleafs, sizeof(numleafs));
+    P_AddWorldState(&leafs, sizeof(leafs));
+    P_AddWorldState(&numlines, sizeof(numlines));
+    P_AddWorldState(&lines, sizeof(lines));
+    P_AddWorldState(&numsides, sizeof(numsides));
+    P_AddWorldState(&sides, sizeof(sides));
+    P_AddWorldState(&numlights, sizeof(numlights));
+    P_AddWorldState(&lights, sizeof(lights));
+    P_AddWorldState(&macros, sizeof(macros));
+    P_AddWorldState(&spawnlist, sizeof(spawnlist));
+    P_AddWorldState(&numspawnlist, sizeof(numspawnlist));
+    P_AddWorldState(playerstarts, sizeof(playerstarts));
+    P_AddWorldState(deathmatchstarts, sizeof(deathmatchstarts));
+    P_AddWorldState(&deathmatch_p, sizeof(deathmatch_p));
+
+    // blockmap and reject
+    P_AddWorldState(&bmapwidth, sizeof(bmapwidth));
+    P_AddWorldState(&bmapheight, sizeof(bmapheight));
+    P_AddWorldState(&blockmap, sizeof(blockmap));
+    P_AddWorldState(&blockmaplump, sizeof(blockmaplump));
+    P_AddWorldState(&bmaporgx, sizeof(bmaporgx));
+    P_AddWorldState(&bmaporgy, sizeof(bmaporgy));
+    P_AddWorldState(&blocklinks, sizeof(blocklinks));
+    P_AddWorldState(&rejectmatrix, sizeof(rejectmatrix));
+
+    // thinkers and specials
+    P_AddWorldState(&thinkercap, sizeof(thinkercap));
+    P_AddWorldState(&mobjhead, sizeof(mobjhead));
+    P_AddWorldState(activeceilings, sizeof(activeceilings));
+    P_AddWorldState(activeplats, sizeof(activeplats));
+    P_AddWorldState(buttonlist, sizeof(buttonlist));
+    P_AddWorldState(&levelTimer, sizeof(levelTimer));
+    P_AddWorldState(&levelTimeCount, sizeof(levelTimeCount));
+    P_AddWorldState(&globalint, sizeof(globalint));
+    P_AddWorldState(&linespeciallist, sizeof(linespeciallist));
+    P_AddWorldState(&numlinespecials, sizeof(numlinespecials));
+
+    // macros
+    P_AddWorldState(&macrothinker, sizeof(macrothinker));
+    P_AddWorldState(&macroeffect, sizeof(macroeffect));
+    P_AddWorldState(&macro, sizeof(macro));
+    P_AddWorldState(&nextmacro, sizeof(nextmacro));
+    P_AddWorldState(&mobjmacro, sizeof(mobjmacro));
+    P_AddWorldState(&macrocounter, sizeof(macrocounter));
+    P_AddWorldState(&macroid, sizeof(macroid));
+    P_AddWorldState(taglist, sizeof(taglist));
+    P_AddWorldState(&taglistidx, sizeof(taglistidx));
+
+    // players and the game they are playing
+    P_AddWorldState(players, sizeof(players));
+    P_AddWorldState(playeringame, sizeof(playeringame));
+    P_AddWorldState(&rng, sizeof(rng));
+    P_AddWorldState(&basetic, sizeof(basetic));
+    P_AddWorldState(&leveltime, sizeof(leveltime));
+    P_AddWorldState(&totalkills, sizeof(totalkills));
+    P_AddWorldState(&totalitems, sizeof(totalitems));
+    P_AddWorldState(&totalsecret, sizeof(totalsecret));
+    P_AddWorldState(&gameskill, sizeof(gameskill));
+    P_AddWorldState(&gamemap, sizeof(gamemap));
+    P_AddWorldState(&nextmap, sizeof(nextmap));
+    P_AddWorldState(&gameflags, sizeof(gameflags));
+    P_AddWorldState(&compatflags, sizeof(compatflags));
+    P_AddWorldState(&deathmatch, sizeof(deathmatch));
+    P_AddWorldState(&nomonsters, sizeof(nomonsters));
+    P_AddWorldState(&respawnmonsters, sizeof(respawnmonsters));
+    P_AddWorldState(&respawnspecials, sizeof(respawnspecials));
+    P_AddWorldState(&fastparm, sizeof(fastparm));
+}
@@ -0,0 +1,245 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <imp/App>
+#include <imp/Wad>
+#include "doomdef.h"
+#include "doomstat.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_game.h"
+#include "m_menu.h"
+#include "r_main.h"
+#include "st_stuff.h"
+#include "p_local.h"
+#include "p_setup.h"
+#include "p_saveg.h"
+#include "p_tick.h"
+
+void G_DoLoadLevel(void);
+
+namespace {
+  // stands in for a module's level state
+  int *level_cells;
+  int level_size;
+  unsigned int level_seed;
+
+  // the real levels need the IWAD and doom64ex.pk3
+  bool have_iwad = false;
+
+  // state has to be registered before the first world is made, so
+  // everything starts up here
+  void register_state()
+  {
+      static bool registered = false;
+
+      if (!registered)
+      {
+          Z_Init();
+
+          have_iwad = app::find_data_file("doom64.wad") && app::find_data_file("doom64ex.pk3");
+
+          if (have_iwad)
+          {
+              headless = true;
+              CON_Init();
+              G_Init();
+              wad::init();
+              M_Init();
+              R_Init();
+              P_Init();
+              ST_Init();
+          }
+
+          P_AddWorldState(&level_cells, sizeof(level_cells));
+          P_AddWorldState(&level_size, sizeof(level_size));
+          P_AddWorldState(&level_seed, sizeof(level_seed));
+          registered = true;
+      }
+  }
+
+  // what P_SetupLevel does: free the last level, allocate the new one
+  void load_level(int size, unsigned int seed)
+  {
+      Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+      Z_Calloc(size * sizeof(int), PU_LEVEL, &level_cells);
+      level_size = size;
+      level_seed = seed;
+  }
+
+  void tick()
+  {
+      level_seed = level_seed * 1103515245u + 12345u;
+      level_cells[(level_seed >> 8) % level_size] += level_seed & 0xff;
+  }
+
+  std::vector<int> cells()
+  {
+      return std::vector<int>(level_cells, level_cells + level_size);
+  }
+
+  // what G_InitNew and G_DoLoadLevel do for a new game on map
+  void load_map(int map)
+  {
+      G_InitNew(sk_medium, map);
+      G_DoLoadLevel();
+      gamestate = GS_LEVEL;
+  }
+
+  std::vector<unsigned int> state_hashes()
+  {
+      unsigned int hashes[NUMSTATEHASHES];
+
+      P_HashState(hashes);
+      return std::vector<unsigned int>(hashes, hashes + NUMSTATEHASHES);
+  }
+}
+
+TEST(World, worlds_keep_their_own_level)
+{
+    register_state();
+
+    gameworld_t *main = P_CurrentWorld();
+    gameworld_t *other = P_NewWorld();
+
+    load_level(64, 1);
+    tick();
+    auto main_cells = cells();
+    int main_usage = Z_SubsystemUsage(ZS_LEVEL);
+    int main_tags = Z_TagUsage(PU_LEVEL) + Z_TagUsage(PU_LEVSPEC);
+
+    P_SetWorld(other);
+    ASSERT_EQ(level_cells, nullptr);
+    ASSERT_EQ(level_size, 0);
+
+    // usage only counts the current world's level blocks
+    ASSERT_EQ(Z_SubsystemUsage(ZS_LEVEL), main_usage - main_tags);
+
+    // loading a level here must leave the main world's blocks alone
+    load_level(32, 2);
+    tick();
+    tick();
+
+    P_SetWorld(main);
+    ASSERT_EQ(level_size, 64);
+    ASSERT_EQ(cells(), main_cells);
+    ASSERT_EQ(Z_SubsystemUsage(ZS_LEVEL), main_usage);
+
+    int blocks = Z_TagBlocks(PU_LEVEL);
+    P_FreeWorld(other);
+    ASSERT_EQ(Z_TagBlocks(PU_LEVEL), blocks);
+    ASSERT_EQ(cells(), main_cells);
+
+    Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+    ASSERT_EQ(level_cells, nullptr);
+}
+
+TEST(World, interleaved_worlds_match_running_alone)
+{
+    constexpr int num_worlds = 8;
+    constexpr int num_tics = 2000;
+
+    register_state();
+
+    gameworld_t *main = P_CurrentWorld();
+    std::vector<std::vector<int>> alone;
+
+    for (int i = 0; i < num_worlds; i++)
+    {
+        load_level(16 + i, i + 1);
+
+        for (int t = 0; t < num_tics; t++)
+            tick();
+
+        alone.push_back(cells());
+    }
+
+    std::vector<gameworld_t *> worlds;
+
+    for (int i = 0; i < num_worlds; i++)
+    {
+        worlds.push_back(P_NewWorld());
+        P_SetWorld(worlds[i]);
+        load_level(16 + i, i + 1);
+    }
+
+    for (int t = 0; t < num_tics; t++)
+    {
+        for (auto world : worlds)
+        {
+            P_SetWorld(world);
+            tick();
+        }
+    }
+
+    for (int i = 0; i < num_worlds; i++)
+    {
+        P_SetWorld(worlds[i]);
+        ASSERT_EQ(cells(), alone[i]);
+    }
+
+    P_SetWorld(main);
+
+    for (auto world : worlds)
+        P_FreeWorld(world);
+
+    Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+    ASSERT_EQ(Z_TagUsage(PU_LEVEL), 0);
+}
+
+TEST(World, real_levels_interleaved_match_running_alone)
+{
+    constexpr int num_tics = 350;
+    const int maps[] = { 1, 2 };
+    constexpr int num_maps = sizeof(maps) / sizeof(maps[0]);
+
+    register_state();
+
+    if (!have_iwad)
+        return;
+
+    gameworld_t *main = P_CurrentWorld();
+    std::vector<std::vector<unsigned int>> alone[num_maps];
+
+    // every level on its own, in a fresh world
+    for (int i = 0; i < num_maps; i++)
+    {
+        gameworld_t *world = P_NewWorld();
+
+        P_SetWorld(world);
+        load_map(maps[i]);
+
+        for (int t = 0; t < num_tics; t++)
+        {
+            P_Ticker();
+            alone[i].push_back(state_hashes());
+        }
+
+        P_SetWorld(main);
+        P_FreeWorld(world);
+    }
+
+    // the same levels again, a tic of each in turn
+    gameworld_t *worlds[num_maps];
+
+    for (int i = 0; i < num_maps; i++)
+    {
+        worlds[i] = P_NewWorld();
+        P_SetWorld(worlds[i]);
+        load_map(maps[i]);
+    }
+
+    for (int t = 0; t < num_tics; t++)
+    {
+        for (int i = 0; i < num_maps; i++)
+        {
+            P_SetWorld(worlds[i]);
+            P_Ticker();
+            ASSERT_EQ(state_hashes(), alone[i][t]) << "map " << maps[i] << " tic " << t;
+        }
+    }
+
+    P_SetWorld(main);
+
+    for (auto world : worlds)
+        P_FreeWorld(world);
+}
@@ -42,6 +42,9 @@
 
 sector_t    *frontsector;
 
+static int  viewsubsector;
+static byte *viewpvsnodes;  // NULL if the map has no PVS
+
 static vtx_t  *subsector_buffer = NULL;
 
 static void R_AddLeaf(subsector_t *sub);
@@ -282,8 +285,8 @@ dboolean R_GenerateSwitchPlane(void *data, vtx_t *v) {
 
 d_inline static void GetSideTopBottom(sector_t* sector, rfloat *top, rfloat *bottom) {
     if(i_interpolateframes) {
-        fixed_t frame_c = sector->frame_z2[1];
-        fixed_t frame_f = sector->frame_z1[1];
+        fixed_t frame_c = sector->frame_z2;
+        fixed_t frame_f = sector->frame_z1;
 
         *bottom = F2D3D(frame_f);
         *top = F2D3D(frame_c);
@@ -698,6 +701,74 @@ void R_Subsector(int num) {
     R_AddSprites(sub);
 }
 
+//
+// R_PointInLeaf
+// True if the point lies inside or on the edge of the subsector's polygon
+//
+
+static dboolean R_PointInLeaf(subsector_t *ss, fixed_t x, fixed_t y) {
+    int side = 0;
+    int i;
+
+    if(ss->numleafs < 3) {
+        return false;
+    }
+
+    for(i = 0; i < ss->numleafs; i++) {
+        vertex_t *v1 = leafs[ss->leaf + i].vertex;
+        vertex_t *v2 = leafs[ss->leaf + (i + 1) % ss->numleafs].vertex;
+        double cross;
+
+        cross = ((double)v2->x - v1->x) * ((double)y - v1->y) -
+                ((double)v2->y - v1->y) * ((double)x - v1->x);
+
+        if(cross == 0) {
+            continue;
+        }
+
+        // the polygon is convex, so inside is on one side of every edge
+        if(!side) {
+            side = (cross > 0) ? 1 : -1;
+        }
+        else if((cross > 0) != (side > 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//
+// R_SetViewPVS
+// Looks up what can be seen from the view point's subsector. A view
+// outside the map (noclip, chasecam) still lands in some leaf, but what
+// that leaf sees says nothing about the view, so nothing is culled.
+//
+
+void R_SetViewPVS(void) {
+    subsector_t *ss = R_PointInSubsector(viewx, viewy);
+
+    viewsubsector = ss - subsectors;
+    viewpvsnodes = R_PointInLeaf(ss, viewx, viewy) ? P_PVSNodes(viewsubsector) : NULL;
+}
+
+//
+// R_PVSVisible
+// Returns false if nothing under the node can be seen from the view
+//
+
+static dboolean R_PVSVisible(int bspnum) {
+    if(!viewpvsnodes) {
+        return true;
+    }
+
+    if(bspnum & NF_SUBSECTOR) {
+        return P_CheckPVS(viewsubsector, bspnum & ~NF_SUBSECTOR);
+    }
+
+    return viewpvsnodes[bspnum];
+}
+
 //
 // R_RenderBSPNode
 //
@@ -713,12 +784,12 @@ void R_RenderBSPNode(int bspnum) {
         side = R_PointOnSide(viewx, viewy, bsp);
 
         // check the front space
-        if(R_CheckBBox(bsp->bbox[side])) {
+        if(R_PVSVisible(bsp->children[side]) && R_CheckBBox(bsp->bbox[side])) {
             R_RenderBSPNode(bsp->children[side]);
         }
 
         // continue down the back space
-        if(!R_CheckBBox(bsp->bbox[side^1])) {
+        if(!R_PVSVisible(bsp->children[side^1]) || !R_CheckBBox(bsp->bbox[side^1])) {
             return;
         }
 
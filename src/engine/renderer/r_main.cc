@@ -301,6 +301,8 @@ void R_Init(void) {
     GL_ResetTextures();
 
     G_AddCommand("wireframe", CMD_Wireframe, 0);
+
+    R_InitPointGrid();
 }
 
 //
@@ -317,7 +319,7 @@ subsector_t* R_PointInSubsector(fixed_t x, fixed_t y) {
         return subsectors;
     }
 
-    nodenum = numnodes-1;
+    nodenum = R_PointGridNode(x, y);
 
     while(!(nodenum & NF_SUBSECTOR)) {
         node = &nodes[nodenum];
@@ -567,8 +569,8 @@ static void R_InterpolateSectors(void) {
     for(i = 0; i < numsectors; i++) {
         sector_t* s = &sectors[i];
 
-        s->frame_z1[1] = R_Interpolate(s->floorheight, s->frame_z1[0], 1);
-        s->frame_z2[1] = R_Interpolate(s->ceilingheight, s->frame_z2[0], 1);
+        s->frame_z1 = R_Interpolate(s->floorheight, framesectors[i].floorheight, 1);
+        s->frame_z2 = R_Interpolate(s->ceilingheight, framesectors[i].ceilingheight, 1);
     }
 }
 
@@ -872,6 +874,7 @@ void R_RenderPlayerView(player_t *player) {
     //
     // traverse BSP for rendering
     //
+    R_SetViewPVS();
     R_RenderBSPNode(numnodes-1);
 
     //
@@ -62,10 +62,15 @@ extern FloatProperty r_fov;
 extern BoolProperty r_fillmode;
 extern BoolProperty r_uniformtime;
 extern BoolProperty r_drawtrace;
+extern BoolProperty r_pointgrid;
 
 void R_Init(void);
 void R_RenderPlayerView(player_t *player);
 subsector_t *R_PointInSubsector(fixed_t x, fixed_t y);
+void R_InitPointGrid(void);
+void R_SetupPointGrid(void);
+int R_PointGridNode(fixed_t x, fixed_t y);
+void R_CheckAllPointGrids(void);
 angle_t R_PointToAngle2(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2);
 angle_t R_PointToAngle(fixed_t x, fixed_t y);//note difference from sw version
 angle_t R_PointToPitch(fixed_t z1, fixed_t z2, fixed_t dist);
@@ -78,6 +83,7 @@ void R_SetViewOffset(int offset);
 void R_DrawWireframe(dboolean enable);    //villsa
 void R_SetViewMatrix(void);
 void R_RenderWorld(void);
+void R_SetViewPVS(void);
 void R_RenderBSPNode(int bspnum);
 void R_AllocSubsectorBuffer(void);
 
@@ -0,0 +1,389 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Point grid. Each cell of a grid over the map holds the deepest BSP
+//    node whose partition lines leave the whole cell on one side all the
+//    way down, or the subsector itself when no line crosses the cell.
+//    R_PointInSubsector starts there instead of at the root.
+//
+//    A cell is only taken past a node when R_PointOnSide gives the same
+//    side for its four corners. Its two products each depend on only one
+//    coordinate and never decrease or never increase along it, so the
+//    corners bound every point in between, as long as nothing overflows.
+//
+//-----------------------------------------------------------------------------
+
+#include <imp/Property>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "r_local.h"
+#include "m_fixed.h"
+#include "m_misc.h"
+#include "i_system.h"
+#include "p_local.h"
+#include "p_setup.h"
+#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
+
+BoolProperty r_pointgrid("r_pointgrid", "Start subsector lookups from a grid over the BSP", true);
+
+#define MINGRIDSHIFT        (FRACBITS+5)    // 32 unit cells on maps that fit
+#define MAXGRIDCELLS        (1 << 18)
+#define CHECKSAMPLES        9               // corners, center and four inside
+
+static unsigned short *pointgrid;
+static fixed_t pointgridorgx;
+static fixed_t pointgridorgy;
+static int pointgridwidth;
+static int pointgridheight;
+static int pointgridshift;
+
+//
+// R_CornerSide
+// R_PointOnSide, or -1 if the sums in it could overflow at this point
+//
+
+static int R_CornerSide(fixed_t x, fixed_t y, node_t *node) {
+    if(node->dx && node->dy) {
+        int64 dx = (int64)x - node->x;
+        int64 dy = (int64)y - node->y;
+        int64 left;
+        int64 right;
+
+        if(dx != (fixed_t)dx || dy != (fixed_t)dy) {
+            return -1;
+        }
+
+        left = ((int64)F2INT(node->dy) * dx) >> FRACBITS;
+        right = (dy * F2INT(node->dx)) >> FRACBITS;
+
+        if(left != (fixed_t)left || right != (fixed_t)right) {
+            return -1;
+        }
+    }
+
+    return R_PointOnSide(x, y, node);
+}
+
+//
+// R_CellNode
+// Goes down from the root as far as every point in the box agrees
+//
+
+static unsigned short R_CellNode(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2) {
+    int nodenum = numnodes - 1;
+
+    while(!(nodenum & NF_SUBSECTOR)) {
+        node_t *node = &nodes[nodenum];
+        int side = R_CornerSide(x1, y1, node);
+
+        if(side == -1 ||
+                R_CornerSide(x2, y1, node) != side ||
+                R_CornerSide(x1, y2, node) != side ||
+                R_CornerSide(x2, y2, node) != side) {
+            break;
+        }
+
+        nodenum = node->children[side];
+    }
+
+    return (unsigned short)nodenum;
+}
+
+//
+// R_SetupPointGrid
+// Called once the nodes are loaded
+//
+
+void R_SetupPointGrid(void) {
+    fixed_t bbox[4];
+    int leafs = 0;
+    int size;
+    int x;
+    int y;
+
+    pointgrid = NULL;
+
+    if(!numnodes) {
+        return;
+    }
+
+    M_ClearBox(bbox);
+    M_AddToBox(bbox, nodes[numnodes - 1].bbox[0][BOXLEFT], nodes[numnodes - 1].bbox[0][BOXBOTTOM]);
+    M_AddToBox(bbox, nodes[numnodes - 1].bbox[0][BOXRIGHT], nodes[numnodes - 1].bbox[0][BOXTOP]);
+    M_AddToBox(bbox, nodes[numnodes - 1].bbox[1][BOXLEFT], nodes[numnodes - 1].bbox[1][BOXBOTTOM]);
+    M_AddToBox(bbox, nodes[numnodes - 1].bbox[1][BOXRIGHT], nodes[numnodes - 1].bbox[1][BOXTOP]);
+
+    pointgridorgx = bbox[BOXLEFT];
+    pointgridorgy = bbox[BOXBOTTOM];
+
+    for(pointgridshift = MINGRIDSHIFT; ; pointgridshift++) {
+        pointgridwidth = (int)(((int64)bbox[BOXRIGHT] - bbox[BOXLEFT]) >> pointgridshift) + 1;
+        pointgridheight = (int)(((int64)bbox[BOXTOP] - bbox[BOXBOTTOM]) >> pointgridshift) + 1;
+
+        if(pointgridwidth * pointgridheight <= MAXGRIDCELLS) {
+            break;
+        }
+    }
+
+    pointgrid = (unsigned short*)Z_Malloc(pointgridwidth * pointgridheight * sizeof(unsigned short), PU_LEVEL, 0);
+    size = 1 << pointgridshift;
+
+    for(y = 0; y < pointgridheight; y++) {
+        for(x = 0; x < pointgridwidth; x++) {
+            fixed_t x1 = pointgridorgx + x * size;
+            fixed_t y1 = pointgridorgy + y * size;
+            unsigned short nodenum = R_CellNode(x1, y1, x1 + size - 1, y1 + size - 1);
+
+            pointgrid[y * pointgridwidth + x] = nodenum;
+
+            if(nodenum & NF_SUBSECTOR) {
+                leafs++;
+            }
+        }
+    }
+
+    CON_DPrintf("%ix%i point grid, %i%% of cells in one subsector\n", pointgridwidth, pointgridheight,
+                leafs * 100 / (pointgridwidth * pointgridheight));
+}
+
+//
+// R_PointGridNode
+// Node to start looking for x, y from; the root if off the grid
+//
+
+int R_PointGridNode(fixed_t x, fixed_t y) {
+    unsigned int cx;
+    unsigned int cy;
+
+    if(!pointgrid || !r_pointgrid) {
+        return numnodes - 1;
+    }
+
+    if(x < pointgridorgx || y < pointgridorgy) {
+        return numnodes - 1;
+    }
+
+    // both are at or past the origin, so the unsigned difference is exact
+    cx = ((unsigned int)x - (unsigned int)pointgridorgx) >> pointgridshift;
+    cy = ((unsigned int)y - (unsigned int)pointgridorgy) >> pointgridshift;
+
+    if(cx >= (unsigned int)pointgridwidth || cy >= (unsigned int)pointgridheight) {
+        return numnodes - 1;
+    }
+
+    return pointgrid[cy * pointgridwidth + cx];
+}
+
+//
+// R_DescendBSP
+// Subsector for x, y from nodenum down, counting the nodes passed
+//
+
+static int R_DescendBSP(fixed_t x, fixed_t y, int nodenum, int *steps) {
+    while(!(nodenum & NF_SUBSECTOR)) {
+        nodenum = nodes[nodenum].children[R_PointOnSide(x, y, &nodes[nodenum])];
+        (*steps)++;
+    }
+
+    return nodenum & ~NF_SUBSECTOR;
+}
+
+//
+// R_CheckPointGrid
+// Compares grid lookups against going down from the root for sample
+// points in every cell. Returns the number that differ.
+//
+
+static int R_CheckPointGrid(int *samples, int *fullsteps, int *gridsteps) {
+    unsigned int rnd = 1;
+    int differ = 0;
+    int size = 1 << pointgridshift;
+    int x;
+    int y;
+    int i;
+
+    for(y = 0; y < pointgridheight; y++) {
+        for(x = 0; x < pointgridwidth; x++) {
+            fixed_t x1 = pointgridorgx + x * size;
+            fixed_t y1 = pointgridorgy + y * size;
+            fixed_t px[CHECKSAMPLES];
+            fixed_t py[CHECKSAMPLES];
+
+            px[0] = x1;             py[0] = y1;
+            px[1] = x1 + size - 1;  py[1] = y1;
+            px[2] = x1;             py[2] = y1 + size - 1;
+            px[3] = x1 + size - 1;  py[3] = y1 + size - 1;
+            px[4] = x1 + size / 2;  py[4] = y1 + size / 2;
+
+            for(i = 5; i < CHECKSAMPLES; i++) {
+                rnd = rnd * 1103515245u + 12345u;
+                px[i] = x1 + (fixed_t)((rnd >> 8) & (size - 1));
+                rnd = rnd * 1103515245u + 12345u;
+                py[i] = y1 + (fixed_t)((rnd >> 8) & (size - 1));
+            }
+
+            for(i = 0; i < CHECKSAMPLES; i++) {
+                int full = R_DescendBSP(px[i], py[i], numnodes - 1, fullsteps);
+                int grid = R_DescendBSP(px[i], py[i], R_PointGridNode(px[i], py[i]), gridsteps);
+
+                if(full != grid) {
+                    differ++;
+                }
+            }
+
+            *samples += CHECKSAMPLES;
+        }
+    }
+
+    return differ;
+}
+
+//
+// R_CheckAllPointGrids
+// Builds and checks the grid for every map
+//
+
+void R_CheckAllPointGrids(void) {
+    int totaldiffer = 0;
+    int map;
+
+    for(map = 1; map < 100; map++) {
+        int samples = 0;
+        int fullsteps = 0;
+        int gridsteps = 0;
+        int differ;
+        int starttime;
+        int buildtime;
+
+        if(P_GetMapInfo(map) == NULL) {
+            continue;
+        }
+
+        P_LoadMapGeometry(map);
+
+        if(!numnodes) {
+            I_Printf("MAP%02d: no nodes, skipped\n", map);
+            Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+            continue;
+        }
+
+        starttime = I_GetTimeMS();
+        R_SetupPointGrid();
+        buildtime = I_GetTimeMS() - starttime;
+
+        differ = R_CheckPointGrid(&samples, &fullsteps, &gridsteps);
+        totaldiffer += differ;
+
+        I_Printf("MAP%02d: %4ix%-4i cells of %3i units, %8i samples %5i differ, "
+                 "%.1f nodes per lookup instead of %.1f, %4i ms\n",
+                 map, pointgridwidth, pointgridheight, 1 << (pointgridshift - FRACBITS),
+                 samples, differ, (float)gridsteps / samples, (float)fullsteps / samples, buildtime);
+
+        pointgrid = NULL;
+        Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+    }
+
+    I_Printf("total: %i differ\n", totaldiffer);
+}
+
+//
+// CMD_PointGridBench
+// Moves a thing through random spots with and without the grid
+//
+
+static CMD(PointGridBench) {
+    fixed_t *spots;
+    int *found;
+    mobj_t *mo;
+    unsigned int rnd = 1;
+    dboolean oldgrid = r_pointgrid;
+    int count;
+    int differ = 0;
+    int size;
+    int time[2];
+    int i;
+    int j;
+
+    if(gamestate != GS_LEVEL || !pointgrid) {
+        CON_Printf(WHITE, "Must be in a level\n");
+        return;
+    }
+
+    count = param[0] ? datoi(param[0]) : 200000;
+
+    if(count <= 0) {
+        return;
+    }
+
+    spots = (fixed_t*)Z_Malloc(count * 2 * sizeof(fixed_t), PU_STATIC, 0);
+    found = (int*)Z_Malloc(count * sizeof(int), PU_STATIC, 0);
+    size = 1 << pointgridshift;
+
+    for(i = 0; i < count; i++) {
+        rnd = rnd * 1103515245u + 12345u;
+        spots[i*2] = pointgridorgx + (fixed_t)((rnd >> 8) % (unsigned int)pointgridwidth) * size + (fixed_t)(rnd & (size - 1));
+        rnd = rnd * 1103515245u + 12345u;
+        spots[i*2+1] = pointgridorgy + (fixed_t)((rnd >> 8) % (unsigned int)pointgridheight) * size + (fixed_t)(rnd & (size - 1));
+    }
+
+    // only this thing is relinked, so nothing else changes order
+    mo = P_SpawnMobj(spots[0], spots[1], ONFLOORZ, MT_POSSESSED1);
+
+    for(j = 0; j < 2; j++) {
+        r_pointgrid = j;
+        time[j] = I_GetTimeMS();
+
+        for(i = 0; i < count; i++) {
+            P_UnsetThingPosition(mo);
+            mo->x = spots[i*2];
+            mo->y = spots[i*2+1];
+            P_SetThingPosition(mo);
+
+            if(j == 0) {
+                found[i] = mo->subsector - subsectors;
+            }
+            else if(found[i] != mo->subsector - subsectors) {
+                differ++;
+            }
+        }
+
+        time[j] = I_GetTimeMS() - time[j];
+    }
+
+    r_pointgrid = oldgrid;
+    P_RemoveMobj(mo);
+
+    Z_Free(spots);
+    Z_Free(found);
+
+    CON_Printf(WHITE, "%i P_SetThingPosition: bsp %ims, grid %ims, %i differ\n", count, time[0], time[1], differ);
+}
+
+//
+// R_InitPointGrid
+//
+
+void R_InitPointGrid(void) {
+    G_AddCommand("pointgridbench", CMD_PointGridBench, 0);
+}
@@ -110,14 +110,14 @@ static dboolean ProcessFlats(vtxlist_t* vl, int* drawcount) {
 
         if(vl->flags & DLF_CEILING) {
             if(i_interpolateframes) {
-                v->z = F2D3D(sector->frame_z2[1]);
+                v->z = F2D3D(sector->frame_z2);
             } else {
                 v->z = F2D3D(sector->ceilingheight);
             }
         }
         else {
             if(i_interpolateframes) {
-                v->z = F2D3D(sector->frame_z1[1]);
+                v->z = F2D3D(sector->frame_z1);
             }
             else {
                 v->z = F2D3D(sector->floorheight);
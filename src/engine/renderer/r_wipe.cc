@@ -68,6 +68,10 @@ void WIPE_FadeScreen(int fadetics) {
     vtx_t v[4];
     float left, right, top, bottom;
 
+    if(headless) {
+        return;
+    }
+
     allowmenu = false;
 
     wipeFadeAlpha = 0xff;
@@ -148,6 +152,10 @@ void WIPE_MeltScreen(void) {
     float left, right, top, bottom;
     int i = 0;
 
+    if(headless) {
+        return;
+    }
+
     M_ClearMenus();
     allowmenu = false;
 
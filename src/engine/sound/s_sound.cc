@@ -108,6 +108,12 @@ int S_AdjustSoundParams(fixed_t x, fixed_t y, int* vol, int* sep);
 //
 
 void S_Init(void) {
+    // no audio device at all
+    if(headless) {
+        nosound = true;
+        nomusic = true;
+    }
+
     if(M_CheckParm("-nosound")) {
         nosound = true;
         CON_DPrintf("Sounds disabled\n");
@@ -173,7 +179,7 @@ void S_StartMusic(int mnum) {
 */
 
 void S_StartMusic(const char* music) {
-    if(*music == 0 || music == lastmusic) {
+    if(nomusic || *music == 0 || music == lastmusic) {
         return;
     }
 
@@ -194,6 +200,10 @@ void S_StartMusic(const char* music) {
 //
 
 void S_StopMusic(void) {
+    if(nomusic) {
+        return;
+    }
+
     I_StopMusic();
     lastmusic = nullptr;
 }
@@ -247,6 +257,10 @@ void S_ResumeSound(void) {
 //
 
 void S_StopSound(mobj_t* origin, int sfx_id) {
+    if(nosound) {
+        return;
+    }
+
     I_StopSound((sndsrc_t*)origin, sfx_id);
 }
 
@@ -255,6 +269,10 @@ void S_StopSound(mobj_t* origin, int sfx_id) {
 //
 
 int S_GetActiveSounds(void) {
+    if(nosound) {
+        return 0;
+    }
+
     return I_GetVoiceCount();
 }
 
@@ -277,6 +295,10 @@ void S_RemoveOrigin(mobj_t* origin) {
         }
     }
     */
+    if(nosound) {
+        return;
+    }
+
     I_RemoveSoundSource((sndsrc_t*)origin);
 }
 
@@ -292,6 +314,10 @@ void S_UpdateSounds(void) {
     mobj_t* source;
     int     channels;
 
+    if(nosound) {
+        return;
+    }
+
     channels = I_GetMaxChannels();
 
     for(i = 0; i < channels; i++) {
@@ -0,0 +1,37 @@
+#include <imp/Video>
+
+// Video backend for -headless: no window, no GL context and no input
+class NullVideo : public IVideo {
+    VideoMode mode_ { 640, 480 };
+    Vector<VideoMode> modes_ { mode_ };
+
+public:
+    void set_mode(const VideoMode& mode) override
+    {
+        mode_ = mode;
+    }
+
+    VideoMode current_mode() override
+    {
+        return mode_;
+    }
+
+    ArrayView<VideoMode> modes() override
+    {
+        return modes_;
+    }
+
+    void swap_window() override
+    {}
+
+    void grab(bool) override
+    {}
+
+    void poll_events() override
+    {}
+};
+
+void init_video_null()
+{
+    Video = new NullVideo;
+}
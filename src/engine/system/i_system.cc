@@ -46,6 +46,7 @@
 #include "z_zone.h"
 #include "i_system.h"
 #include "i_audio.h"
+#include "i_thread.h"
 #include "gl_draw.h"
 
 BoolProperty i_interpolateframes("i_interpolateframes", "", false);
@@ -318,7 +319,7 @@ void I_Error(const char* string, ...) {
 
     // TODO: Show sysconsole and quit
 
-    exit(0);    // just in case...
+    exit(1);    // just in case...
 }
 
 //
@@ -337,6 +338,7 @@ void I_Quit(void) {
     // I_DestroySysConsole();
 #endif
 
+    I_ShutdownThreads();
     I_ShutdownSound();
     I_ShutdownVideo();
 
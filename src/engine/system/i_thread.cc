@@ -0,0 +1,191 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Worker thread pool
+//
+//-----------------------------------------------------------------------------
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <imp/Property>
+
+#include "doomdef.h"
+#include "i_thread.h"
+
+// 0 picks one thread per core
+IntProperty i_workers("i_workers", "Number of threads used for parallel game logic", 0);
+
+// indexes are handed out in batches to keep the counter off the hot path
+#define JOBBATCH    8
+
+static std::vector<std::thread> workers;
+static std::mutex               joblock;
+static std::condition_variable  jobstart;
+static std::condition_variable  jobdone;
+
+static jobfunc_t        jobfunc;
+static void             *jobdata;
+static int              jobcount;
+static std::atomic<int> jobnext;
+static int              jobgeneration = 0;
+static int              jobsrunning = 0;
+static bool             jobquit = false;
+static bool             workersstarted = false;
+
+//
+// I_RunJobs
+// Takes batches of indexes until the job runs dry.
+//
+
+static void I_RunJobs(int worker) {
+    int start;
+
+    while((start = jobnext.fetch_add(JOBBATCH)) < jobcount) {
+        int end = MIN(start + JOBBATCH, jobcount);
+        int i;
+
+        for(i = start; i < end; i++) {
+            jobfunc(i, worker, jobdata);
+        }
+    }
+}
+
+//
+// I_WorkerThread
+//
+
+static void I_WorkerThread(int worker) {
+    int generation = 0;
+
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> lock(joblock);
+            jobstart.wait(lock, [&] { return jobquit || jobgeneration != generation; });
+
+            if(jobquit) {
+                return;
+            }
+
+            generation = jobgeneration;
+        }
+
+        I_RunJobs(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(joblock);
+
+            if(--jobsrunning == 0) {
+                jobdone.notify_one();
+            }
+        }
+    }
+}
+
+//
+// I_StartWorkers
+//
+
+static void I_StartWorkers(void) {
+    int count = *i_workers;
+    int i;
+
+    workersstarted = true;
+
+    if(count <= 0) {
+        count = (int)std::thread::hardware_concurrency();
+    }
+
+    // the calling thread is always worker 0
+    for(i = 1; i < count; i++) {
+        workers.emplace_back(I_WorkerThread, i);
+    }
+}
+
+//
+// I_NumWorkers
+//
+
+int I_NumWorkers(void) {
+    if(!workersstarted) {
+        I_StartWorkers();
+    }
+
+    return (int)workers.size() + 1;
+}
+
+//
+// I_ParallelFor
+//
+
+void I_ParallelFor(int count, jobfunc_t func, void *data) {
+    int i;
+
+    if(I_NumWorkers() == 1 || count <= JOBBATCH) {
+        for(i = 0; i < count; i++) {
+            func(i, 0, data);
+        }
+
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(joblock);
+
+        jobfunc = func;
+        jobdata = data;
+        jobcount = count;
+        jobnext = 0;
+        jobsrunning = (int)workers.size();
+        jobgeneration++;
+    }
+
+    jobstart.notify_all();
+
+    I_RunJobs(0);
+
+    std::unique_lock<std::mutex> lock(joblock);
+    jobdone.wait(lock, [] { return jobsrunning == 0; });
+}
+
+//
+// I_ShutdownThreads
+//
+
+void I_ShutdownThreads(void) {
+    {
+        std::lock_guard<std::mutex> lock(joblock);
+        jobquit = true;
+    }
+
+    jobstart.notify_all();
+
+    for(auto &worker : workers) {
+        worker.join();
+    }
+
+    workers.clear();
+    jobquit = false;
+    workersstarted = false;
+}
@@ -0,0 +1,42 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __I_THREAD_H__
+#define __I_THREAD_H__
+
+//
+// Worker pool for splitting game logic across cores. Jobs handed to
+// I_ParallelFor must only read shared state, or write to slots owned by
+// their index; results are applied by the caller afterwards so the
+// outcome never depends on scheduling.
+//
+
+typedef void (*jobfunc_t)(int index, int worker, void *data);
+
+// Number of threads that can run jobs, including the calling thread.
+// Worker indexes passed to jobs are below this.
+int I_NumWorkers(void);
+
+// Calls func for every index in [0, count) and returns once all are done.
+void I_ParallelFor(int count, jobfunc_t func, void *data);
+
+void I_ShutdownThreads(void);
+
+#endif // __I_THREAD_H__
@@ -45,8 +45,14 @@ float video_ratio;
 //
 
 void init_video_sdl();
+void init_video_null();
 void I_InitScreen(void) {
-    init_video_sdl();
+    if(headless) {
+        init_video_null();
+    }
+    else {
+        init_video_sdl();
+    }
 
     auto mode = Video->current_mode();
 
@@ -109,7 +115,10 @@ void I_ShutdownVideo(void) {
 //
 
 void I_InitVideo(void) {
-    SDL_ShowCursor(0);
+    if(!headless) {
+        SDL_ShowCursor(0);
+    }
+
     I_InitScreen();
 }
 
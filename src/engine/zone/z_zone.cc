@@ -28,6 +28,8 @@
 //-----------------------------------------------------------------------------
 
 #include <stdlib.h>
+#include <mutex>
+#include <new>
 
 #include "z_zone.h"
 #include "i_system.h"
@@ -43,6 +45,8 @@ struct memblock_s {
     int id; // = ZONEID
     int tag;
     int size;
+    short sizeclass; // index into the thread cache, or -1 if not cacheable
+    short source;    // subsystem of the code that allocated the block
     void **user;
     memblock_t *prev;
     memblock_t *next;
@@ -90,12 +94,231 @@ static void Z_LogPuts(const char *msg) {
 
 static memblock_t *allocated_blocks[PU_MAX];
 
+//
+// The tag lists are shared between every thread that allocates from the
+// zone, so all accesses to allocated_blocks go through zone_lock. The lock
+// is recursive because I_Error may end up back in the zone while a list
+// is being walked.
+//
+
+static std::recursive_mutex zone_lock;
+
+typedef std::lock_guard<std::recursive_mutex> zone_guard_t;
+
+//
+// Thread-local block cache
+//
+// Small blocks are rounded up to a power of two and, when freed, kept in
+// a per-thread free list instead of being handed back to the system. The
+// next allocation of the same class on that thread reuses the block
+// without touching malloc. Cached blocks are not linked into any tag list,
+// so Z_FreeTags never sees them.
+//
+
+#define ZONE_CACHE_MINSHIFT 4    // 16 bytes
+#define ZONE_CACHE_CLASSES  6    // 16 .. 512 bytes
+#define ZONE_CACHE_DEPTH    64   // blocks kept per class, per thread
+
+struct zonecache_t {
+    memblock_t *blocks[ZONE_CACHE_CLASSES];
+    int count[ZONE_CACHE_CLASSES];
+
+    zonecache_t() {
+        dmemset(blocks, 0, sizeof(blocks));
+        dmemset(count, 0, sizeof(count));
+    }
+
+    ~zonecache_t() {
+        Flush();
+    }
+
+    void Flush(void) {
+        for(int i = 0; i < ZONE_CACHE_CLASSES; ++i) {
+            while(blocks[i] != NULL) {
+                memblock_t *next = blocks[i]->next;
+                free(blocks[i]);
+                blocks[i] = next;
+            }
+            count[i] = 0;
+        }
+    }
+};
+
+static thread_local zonecache_t zone_cache;
+
+//
+// Z_SizeClass
+// Returns the cache class for an allocation size, or -1 if the block is too
+// large to be cached.
+//
+
+static int Z_SizeClass(int size) {
+    int sizeclass = 0;
+
+    while((1 << (sizeclass + ZONE_CACHE_MINSHIFT)) < size) {
+        if(++sizeclass >= ZONE_CACHE_CLASSES) {
+            return -1;
+        }
+    }
+
+    return sizeclass;
+}
+
+//
+// Z_CacheTake
+// Pops a block from this thread's cache, if one is available.
+//
+
+static memblock_t *Z_CacheTake(int sizeclass) {
+    memblock_t *block = zone_cache.blocks[sizeclass];
+
+    if(block != NULL) {
+        zone_cache.blocks[sizeclass] = block->next;
+        zone_cache.count[sizeclass]--;
+    }
+
+    return block;
+}
+
+//
+// Z_CacheGive
+// Returns a block to this thread's cache. Returns false if the cache
+// for the block's class is full and the block must be freed instead.
+//
+
+static dboolean Z_CacheGive(memblock_t *block) {
+    int sizeclass = block->sizeclass;
+
+    if(sizeclass < 0 || zone_cache.count[sizeclass] >= ZONE_CACHE_DEPTH) {
+        return false;
+    }
+
+    block->id = 0;
+    block->prev = NULL;
+    block->next = zone_cache.blocks[sizeclass];
+    zone_cache.blocks[sizeclass] = block;
+    zone_cache.count[sizeclass]++;
+
+    return true;
+}
+
+//
+// Running totals, kept up to date as blocks enter and leave the tag lists
+// so that usage queries don't have to walk every block.
+//
+
+static int zone_tagbytes[PU_MAX];
+static int zone_tagblocks[PU_MAX];
+static int zone_subsysbytes[ZS_MAX];
+static int zone_levelsubsysbytes[ZS_MAX];   // the level tags' share, for Z_SwapTags
+
+//
+// Z_SourceSubsystem
+// Classifies an allocation by the directory of the file that made it.
+//
+
+static int Z_SourceSubsystem(const char *file) {
+    static const struct {
+        const char *dir;
+        int subsys;
+    } dirs[] = {
+        { "opengl", ZS_TEXTURES },
+        { "gfx",    ZS_TEXTURES },
+        { "sound",  ZS_AUDIO },
+        { "wad",    ZS_WAD },
+        { "playloop", ZS_LEVEL }
+    };
+    static thread_local const char *lastfile = NULL;
+    static thread_local int lastsubsys = ZS_OTHER;
+    const char *end;
+    const char *start;
+    size_t i;
+
+    if(file == lastfile) {
+        return lastsubsys;
+    }
+
+    lastfile = file;
+    lastsubsys = ZS_OTHER;
+
+    if(file == NULL) {
+        return lastsubsys;
+    }
+
+    // find the name of the directory the file lives in
+    end = file + dstrlen(file);
+
+    while(end > file && end[-1] != '/' && end[-1] != '\\') {
+        end--;
+    }
+
+    if(end == file) {
+        return lastsubsys;
+    }
+
+    start = --end;
+
+    while(start > file && start[-1] != '/' && start[-1] != '\\') {
+        start--;
+    }
+
+    for(i = 0; i < sizeof(dirs) / sizeof(dirs[0]); ++i) {
+        if(strlen(dirs[i].dir) == (size_t)(end - start) &&
+            !strncmp(dirs[i].dir, start, end - start)) {
+            lastsubsys = dirs[i].subsys;
+            break;
+        }
+    }
+
+    return lastsubsys;
+}
+
+//
+// Z_BlockSubsystem
+// The tag takes precedence over the source of the allocation.
+//
+
+static int Z_BlockSubsystem(memblock_t *block) {
+    switch(block->tag) {
+    case PU_MAPLUMP:
+    case PU_LEVEL:
+    case PU_LEVSPEC:
+        return ZS_LEVEL;
+
+    case PU_AUDIO:
+        return ZS_AUDIO;
+
+    case PU_CACHE:
+        return ZS_WAD;
+    }
+
+    return block->source;
+}
+
+//
+// Z_AccountBlock
+//
+
+static void Z_AccountBlock(memblock_t *block, int sign) {
+    int subsys = Z_BlockSubsystem(block);
+
+    zone_tagbytes[block->tag] += sign * block->size;
+    zone_tagblocks[block->tag] += sign;
+    zone_subsysbytes[subsys] += sign * block->size;
+
+    if(block->tag >= PU_LEVEL && block->tag < PU_PURGELEVEL) {
+        zone_levelsubsysbytes[subsys] += sign * block->size;
+    }
+}
+
 //
 // Z_InsertBlock
 // Add a block into the linked list for its type.
 //
 
 static void Z_InsertBlock(memblock_t *block) {
+    Z_AccountBlock(block, 1);
+
     block->prev = NULL;
     block->next = allocated_blocks[block->tag];
     allocated_blocks[block->tag] = block;
@@ -111,6 +334,8 @@ static void Z_InsertBlock(memblock_t *block) {
 //
 
 static void Z_RemoveBlock(memblock_t *block) {
+    Z_AccountBlock(block, -1);
+
     // Unlink from list
     if(block->prev == NULL) {
         allocated_blocks[block->tag] = block->next;    // Start of list
@@ -124,12 +349,250 @@ static void Z_RemoveBlock(memblock_t *block) {
     }
 }
 
+//
+// ALLOCATION WATCH
+//
+// Enabled with -allocwatch. Every Z_Malloc, Z_Realloc and operator new made
+// by the thread that opened a watch scope is counted against that scope.
+// Once a level has run for steadytics tics, the scope is considered to be
+// in steady state: its worst per-tic count is tracked and the source of
+// each allocation is recorded so it can be reported when the level ends.
+//
+
+#define ZONE_WATCH_SITES    64
+
+typedef struct {
+    const char *file;
+    int line;
+    int count;
+} zwatchsite_t;
+
+typedef struct {
+    int tics;           // steady state tics watched this level
+    int total;          // steady state allocations this level
+    int maxpertic;      // worst steady state tic this level
+    int worstever;      // worst steady state tic since startup
+    int count;          // allocations in the open scope
+    int othersites;     // steady state allocations that found no free site
+    dboolean steady;
+    zwatchsite_t sites[ZONE_WATCH_SITES];
+} zwatch_t;
+
+static const char *zone_watchnames[ZW_MAX] = {
+    "P_Ticker",
+    "R_RenderPlayerView"
+};
+
+static dboolean zone_watching = false;
+static int zone_watchsteady;
+static int zone_watchmax;
+static zwatch_t zone_watch[ZW_MAX];
+
+static thread_local zwatch_t *zone_watchscope = NULL;
+
+//
+// Z_NoteAlloc
+//
+
+static void Z_NoteAlloc(const char *file, int line) {
+    zwatch_t *watch = zone_watchscope;
+    unsigned int hash;
+    int i;
+
+    if(watch == NULL) {
+        return;
+    }
+
+    watch->count++;
+
+    if(!watch->steady) {
+        return;
+    }
+
+    hash = ((unsigned int)(uintptr_t)file ^ (unsigned int)line) * 2654435761u;
+
+    for(i = 0; i < ZONE_WATCH_SITES; ++i) {
+        zwatchsite_t *site = &watch->sites[(hash + i) % ZONE_WATCH_SITES];
+
+        if(site->count == 0) {
+            site->file = file;
+            site->line = line;
+        }
+
+        if(site->file == file && site->line == line) {
+            site->count++;
+            return;
+        }
+    }
+
+    // table is full; count it apart so no site is blamed for it
+    watch->othersites++;
+}
+
+//
+// Z_EnableAllocWatch
+//
+
+void Z_EnableAllocWatch(int steadytics, int maxpertic) {
+    zone_watching = true;
+    zone_watchsteady = steadytics;
+    zone_watchmax = maxpertic;
+    dmemset(zone_watch, 0, sizeof(zone_watch));
+}
+
+//
+// Z_BeginAllocWatch
+//
+
+void Z_BeginAllocWatch(int scope, int tic) {
+    if(!zone_watching) {
+        return;
+    }
+
+    zone_watch[scope].count = 0;
+    zone_watch[scope].steady = (tic >= zone_watchsteady);
+    zone_watchscope = &zone_watch[scope];
+}
+
+//
+// Z_EndAllocWatch
+//
+
+void Z_EndAllocWatch(int scope) {
+    zwatch_t *watch = &zone_watch[scope];
+
+    if(!zone_watching) {
+        return;
+    }
+
+    zone_watchscope = NULL;
+
+    if(!watch->steady) {
+        return;
+    }
+
+    watch->tics++;
+    watch->total += watch->count;
+    watch->maxpertic = MAX(watch->maxpertic, watch->count);
+    watch->worstever = MAX(watch->worstever, watch->count);
+}
+
+//
+// Z_AllocWatchReport
+// Prints the steady state allocation sites of each scope and resets
+// the per-level counters.
+//
+
+void Z_AllocWatchReport(void) {
+    int i;
+    int j;
+
+    if(!zone_watching) {
+        return;
+    }
+
+    for(i = 0; i < ZW_MAX; ++i) {
+        zwatch_t *watch = &zone_watch[i];
+        int worstever = watch->worstever;
+
+        I_Printf("Z_AllocWatch: %s: %d allocs over %d steady tics, worst tic %d\n",
+                 zone_watchnames[i], watch->total, watch->tics, watch->maxpertic);
+
+        // simple selection of the busiest sites
+        for(j = 0; j < 8; ++j) {
+            zwatchsite_t *best = NULL;
+            int k;
+
+            for(k = 0; k < ZONE_WATCH_SITES; ++k) {
+                zwatchsite_t *site = &watch->sites[k];
+
+                if(site->count > 0 && (best == NULL || site->count > best->count)) {
+                    best = site;
+                }
+            }
+
+            if(best == NULL) {
+                break;
+            }
+
+            I_Printf("    %6d  %s:%d\n", best->count,
+                     best->file ? best->file : "operator new", best->line);
+            best->count = -best->count;
+        }
+
+        if(watch->othersites > 0) {
+            I_Printf("    %6d  other sites\n", watch->othersites);
+        }
+
+        dmemset(watch, 0, sizeof(zwatch_t));
+        watch->worstever = worstever;
+    }
+}
+
+//
+// Z_AllocWatchFailed
+// True if any steady state tic went over the -allocwatch threshold.
+//
+
+bool Z_AllocWatchFailed(void) {
+    int i;
+
+    if(!zone_watching) {
+        return false;
+    }
+
+    for(i = 0; i < ZW_MAX; ++i) {
+        if(zone_watch[i].worstever > zone_watchmax) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//
+// operator new
+// Replaced so that STL containers and other C++ allocations made inside
+// a watched scope are counted too. C++ only lets the global operator be
+// replaced for the whole program at link time, so the replacement is
+// always there; it is plain malloc/free and only counts anything when
+// -allocwatch has opened a scope on the calling thread.
+//
+
+void *operator new(size_t size) {
+    void *p;
+
+    if(zone_watchscope != NULL) {
+        Z_NoteAlloc(NULL, 0);
+    }
+
+    if(!(p = malloc(size ? size : 1))) {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
 //
 // Z_Init
 //
 
 void Z_Init(void) {
+    zone_guard_t guard(zone_lock);
+
     dmemset(allocated_blocks, 0, sizeof(allocated_blocks));
+    dmemset(zone_tagbytes, 0, sizeof(zone_tagbytes));
+    dmemset(zone_tagblocks, 0, sizeof(zone_tagblocks));
+    dmemset(zone_subsysbytes, 0, sizeof(zone_subsysbytes));
+    dmemset(zone_levelsubsysbytes, 0, sizeof(zone_levelsubsysbytes));
 
 #ifdef ZONEFILE
     atexit(Z_CloseLogFile); // exit handler
@@ -158,10 +621,15 @@ void (Z_Free)(void* ptr, const char *file, int line) {
         *block->user = NULL;
     }
 
-    Z_RemoveBlock(block);
+    {
+        zone_guard_t guard(zone_lock);
+        Z_RemoveBlock(block);
+    }
 
-    // Free back to system
-    free(block);
+    // Keep small blocks around for this thread, free the rest back to system
+    if(!Z_CacheGive(block)) {
+        free(block);
+    }
 
 #ifdef ZONEFILE
     Z_LogPrintf("* Z_Free(ptr=%p, file=%s:%d)\n", ptr, file, line);
@@ -175,6 +643,7 @@ void (Z_Free)(void* ptr, const char *file, int line) {
 // required.
 //
 // Returns true if any blocks were freed.
+// Must be called with zone_lock held.
 //
 
 static dboolean Z_ClearCache(int size) {
@@ -182,6 +651,9 @@ static dboolean Z_ClearCache(int size) {
     memblock_t *next_block;
     int remaining;
 
+    // The thread cache is the cheapest thing to give back
+    zone_cache.Flush();
+
     block = allocated_blocks[PU_CACHE];
 
     if(block == NULL) {
@@ -237,6 +709,7 @@ void *(Z_Malloc)(int size, int tag, void *user, const char *file, int line) {
     memblock_t *newblock;
     unsigned char *data;
     void *result;
+    int sizeclass;
 
     if(tag < 0 || tag >= PU_MAX) {
         I_Error("Z_Malloc: tag out of range: %i (%s:%d)", tag, file, line);
@@ -246,11 +719,27 @@ void *(Z_Malloc)(int size, int tag, void *user, const char *file, int line) {
         I_Error("Z_Malloc: an owner is required for purgable blocks (%s:%d)", file, line);
     }
 
-    // Malloc a block of the required size
+    Z_NoteAlloc(file, line);
 
+    // Reuse a cached block or malloc one of the required size
+
+    sizeclass = Z_SizeClass(size);
     newblock = NULL;
 
-    if(!(newblock = (memblock_t*)malloc(sizeof(memblock_t) + size))) {
+    if(sizeclass >= 0) {
+        if(!(newblock = Z_CacheTake(sizeclass))) {
+            newblock = (memblock_t*)malloc(sizeof(memblock_t) + (1 << (sizeclass + ZONE_CACHE_MINSHIFT)));
+        }
+    }
+    else {
+        newblock = (memblock_t*)malloc(sizeof(memblock_t) + size);
+    }
+
+    if(!newblock) {
+        zone_guard_t guard(zone_lock);
+
+        sizeclass = -1;
+
         if(Z_ClearCache(sizeof(memblock_t) + size)) {
             newblock = (memblock_t*)malloc(sizeof(memblock_t) + size);
         }
@@ -266,8 +755,13 @@ void *(Z_Malloc)(int size, int tag, void *user, const char *file, int line) {
     newblock->id = ZONEID;
     newblock->user = (void**) user;
     newblock->size = size;
+    newblock->sizeclass = sizeclass;
+    newblock->source = Z_SourceSubsystem(file);
 
-    Z_InsertBlock(newblock);
+    {
+        zone_guard_t guard(zone_lock);
+        Z_InsertBlock(newblock);
+    }
 
     data = (unsigned char*)newblock;
     result = data + sizeof(memblock_t);
@@ -312,6 +806,8 @@ void *(Z_Realloc)(void *ptr, int size, int tag, void *user, const char *file, in
         I_Error("Z_Realloc: an owner is required for purgable blocks (%s:%d)", file, line);
     }
 
+    Z_NoteAlloc(file, line);
+
     block = (memblock_t*)((byte *)ptr - sizeof(memblock_t));
 
     newblock = NULL;
@@ -320,7 +816,10 @@ void *(Z_Realloc)(void *ptr, int size, int tag, void *user, const char *file, in
         I_Error("Z_Realloc: Reallocated a pointer without ZONEID (%s:%d)", file, line);
     }
 
-    Z_RemoveBlock(block);
+    {
+        zone_guard_t guard(zone_lock);
+        Z_RemoveBlock(block);
+    }
 
     origsize = block->size;
     block->next = NULL;
@@ -331,6 +830,8 @@ void *(Z_Realloc)(void *ptr, int size, int tag, void *user, const char *file, in
     }
 
     if(!(newblock = (memblock_t*)realloc(block, sizeof(memblock_t) + size))) {
+        zone_guard_t guard(zone_lock);
+
         if(Z_ClearCache(sizeof(memblock_t) + size)) {
             newblock = (memblock_t*)realloc(block, sizeof(memblock_t) + size);
         }
@@ -340,12 +841,17 @@ void *(Z_Realloc)(void *ptr, int size, int tag, void *user, const char *file, in
         I_Error("Z_Realloc: failed on allocation of %u bytes (%s:%d)", size, file, line);
     }
 
+    // realloc'd blocks no longer match their size class
     newblock->tag = tag;
     newblock->id = ZONEID;
     newblock->user = (void**) user;
     newblock->size = size;
+    newblock->sizeclass = -1;
 
-    Z_InsertBlock(newblock);
+    {
+        zone_guard_t guard(zone_lock);
+        Z_InsertBlock(newblock);
+    }
 
     data = (unsigned char*)newblock;
     result = data + sizeof(memblock_t);
@@ -372,6 +878,7 @@ void *(Z_Realloc)(void *ptr, int size, int tag, void *user, const char *file, in
 //
 
 void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line) {
+    zone_guard_t guard(zone_lock);
     int i;
 
     for(i = lowtag; i <= hightag; ++i) {
@@ -393,6 +900,12 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line) {
                 *block->user = NULL;
             }
 
+            zone_subsysbytes[Z_BlockSubsystem(block)] -= block->size;
+
+            if(i >= PU_LEVEL && i < PU_PURGELEVEL) {
+                zone_levelsubsysbytes[Z_BlockSubsystem(block)] -= block->size;
+            }
+
             free(block);
 
             // Jump to the next in the chain
@@ -402,6 +915,8 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line) {
 
         // This chain is empty now
         allocated_blocks[i] = NULL;
+        zone_tagbytes[i] = 0;
+        zone_tagblocks[i] = 0;
     }
 
 #ifdef ZONEFILE
@@ -410,6 +925,43 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line) {
 #endif
 }
 
+//
+// Z_SwapTags
+// Sets the level tag lists aside in tags and takes up the ones held
+// there, so several levels' blocks can be kept while Z_FreeTags only
+// sees the current one. Blocks must only be freed while their lists
+// are current. The usage totals follow the lists, so tag and subsystem
+// usage both count the current level only.
+//
+
+void Z_SwapTags(zonetags_t *tags) {
+    zone_guard_t guard(zone_lock);
+    int i;
+
+    for(i = 0; i < ZONE_LEVELTAGS; i++) {
+        memblock_t *blocks = allocated_blocks[PU_LEVEL + i];
+        int bytes = zone_tagbytes[PU_LEVEL + i];
+        int count = zone_tagblocks[PU_LEVEL + i];
+
+        allocated_blocks[PU_LEVEL + i] = (memblock_t*)tags->blocks[i];
+        zone_tagbytes[PU_LEVEL + i] = tags->bytes[i];
+        zone_tagblocks[PU_LEVEL + i] = tags->count[i];
+
+        tags->blocks[i] = blocks;
+        tags->bytes[i] = bytes;
+        tags->count[i] = count;
+    }
+
+    // the subsystem totals only count the current level's blocks
+    for(i = 0; i < ZS_MAX; i++) {
+        int bytes = zone_levelsubsysbytes[i];
+
+        zone_subsysbytes[i] += tags->subsysbytes[i] - bytes;
+        zone_levelsubsysbytes[i] = tags->subsysbytes[i];
+        tags->subsysbytes[i] = bytes;
+    }
+}
+
 //
 // Z_Calloc
 //
@@ -490,6 +1042,7 @@ void *(Z_Alloca)(int n, const char *file, int line) {
 //
 
 void (Z_CheckHeap)(const char *file, int line) {
+    zone_guard_t guard(zone_lock);
     memblock_t *block;
     memblock_t *prev;
     int i;
@@ -557,9 +1110,12 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line) {
     // Remove the block from its current list, and rehook it into
     // its new list.
     //
-    Z_RemoveBlock(block);
-    block->tag = tag;
-    Z_InsertBlock(block);
+    {
+        zone_guard_t guard(zone_lock);
+        Z_RemoveBlock(block);
+        block->tag = tag;
+        Z_InsertBlock(block);
+    }
 
 #ifdef ZONEFILE
     Z_LogPrintf("* Z_ChangeTag(ptr=%p, tag=%d, file=%s:%d)\n",
@@ -572,18 +1128,41 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line) {
 //
 
 int Z_TagUsage(int tag) {
-    int bytes = 0;
-    memblock_t *block;
-
     if(tag < 0 || tag >= PU_MAX) {
         I_Error("Z_TagUsage: tag out of range: %i", tag);
     }
 
-    for(block = allocated_blocks[tag]; block != NULL; block = block->next) {
-        bytes += block->size;
+    zone_guard_t guard(zone_lock);
+
+    return zone_tagbytes[tag];
+}
+
+//
+// Z_TagBlocks
+//
+
+int Z_TagBlocks(int tag) {
+    if(tag < 0 || tag >= PU_MAX) {
+        I_Error("Z_TagBlocks: tag out of range: %i", tag);
+    }
+
+    zone_guard_t guard(zone_lock);
+
+    return zone_tagblocks[tag];
+}
+
+//
+// Z_SubsystemUsage
+//
+
+int Z_SubsystemUsage(int subsys) {
+    if(subsys < 0 || subsys >= ZS_MAX) {
+        I_Error("Z_SubsystemUsage: subsystem out of range: %i", subsys);
     }
 
-    return bytes;
+    zone_guard_t guard(zone_lock);
+
+    return zone_subsysbytes[subsys];
 }
 
 //
@@ -593,12 +1172,10 @@ int Z_TagUsage(int tag) {
 int Z_FreeMemory(void) {
     int bytes = 0;
     int i;
-    memblock_t *block;
+    zone_guard_t guard(zone_lock);
 
     for(i = 0; i < PU_MAX; i++) {
-        for(block = allocated_blocks[i]; block != NULL; block = block->next) {
-            bytes += block->size;
-        }
+        bytes += zone_tagbytes[i];
     }
 
     return bytes;
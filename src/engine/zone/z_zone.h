@@ -60,9 +60,30 @@ enum {
 
 #define PU_PURGELEVEL PU_CACHE        /* First purgable tag's level */
 
+// Subsystems that zone usage is broken down into
+enum {
+    ZS_OTHER,
+    ZS_TEXTURES,    // opengl and gfx
+    ZS_AUDIO,       // sound and PU_AUDIO blocks
+    ZS_WAD,         // wad data and PU_CACHE blocks
+    ZS_LEVEL,       // playloop and level tags
+    ZS_MAX
+};
+
+// Level blocks set aside by Z_SwapTags
+#define ZONE_LEVELTAGS  (PU_PURGELEVEL - PU_LEVEL)
+
+typedef struct {
+    void    *blocks[ZONE_LEVELTAGS];
+    int     bytes[ZONE_LEVELTAGS];
+    int     count[ZONE_LEVELTAGS];
+    int     subsysbytes[ZS_MAX];    // their share of each subsystem
+} zonetags_t;
+
 void*   (Z_Malloc)(int size, int tag, void *user, const char *, int);
 void (Z_Free)(void *ptr, const char *, int);
 void (Z_FreeTags)(int lowtag, int hightag, const char *, int);
+void Z_SwapTags(zonetags_t *tags);
 void (Z_ChangeTag)(void *ptr, int tag, const char *, int);
 void (Z_Init)(void);
 void*   (Z_Calloc)(int n, int tag, void *user, const char *, int);
@@ -92,7 +113,24 @@ void (Z_Touch)(void *ptr, const char *, int);
 #define strdup(s)           (Z_Strdup) (s, PU_STATIC,0,__FILE__,__LINE__)
 
 int Z_TagUsage(int tag);
+int Z_TagBlocks(int tag);
+int Z_SubsystemUsage(int subsys);
 int Z_FreeMemory(void);
 
+// ALLOCATION WATCH
+
+// Scopes that can be watched for heap allocations
+enum {
+    ZW_TICKER,  // P_Ticker
+    ZW_RENDER,  // R_RenderPlayerView
+    ZW_MAX
+};
+
+void Z_EnableAllocWatch(int steadytics, int maxpertic);
+void Z_BeginAllocWatch(int scope, int tic);
+void Z_EndAllocWatch(int scope);
+void Z_AllocWatchReport(void);
+bool Z_AllocWatchFailed(void);
+
 #endif
 
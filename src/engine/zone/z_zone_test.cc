@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include "z_zone.h"
+
+namespace {
+  constexpr int num_threads = 8;
+  constexpr int num_iterations = 20000;
+  constexpr int num_live = 32;
+
+  void hammer(int seed)
+  {
+      void *live[num_live] = {};
+      unsigned int rnd = seed * 2654435761u;
+
+      for (int i = 0; i < num_iterations; i++)
+      {
+          rnd = rnd * 1103515245u + 12345u;
+
+          int slot = (rnd >> 8) % num_live;
+          int size = 1 + ((rnd >> 16) % 1024);
+
+          if (live[slot] == nullptr)
+          {
+              auto p = static_cast<unsigned char *>(Z_Malloc(size, PU_LEVEL, nullptr));
+              memset(p, seed & 0xff, size);
+              live[slot] = p;
+          }
+          else if (rnd & 1)
+          {
+              live[slot] = Z_Realloc(live[slot], size, PU_LEVEL, nullptr);
+          }
+          else
+          {
+              Z_Free(live[slot]);
+              live[slot] = nullptr;
+          }
+      }
+
+      for (auto p : live)
+      {
+          if (p != nullptr)
+              Z_Free(p);
+      }
+  }
+}
+
+TEST(Zone, threaded_malloc_free)
+{
+    Z_Init();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++)
+        threads.emplace_back(hammer, i + 1);
+
+    for (auto &t : threads)
+        t.join();
+
+    Z_CheckHeap();
+    ASSERT_EQ(Z_TagUsage(PU_LEVEL), 0);
+}
+
+TEST(Zone, threaded_free_tags)
+{
+    Z_Init();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++)
+    {
+        threads.emplace_back([] {
+            for (int j = 0; j < num_iterations; j++)
+                Z_Malloc(16 + (j % 200), PU_LEVSPEC, nullptr);
+        });
+    }
+
+    // Free the tag while the workers are still filling it
+    for (int i = 0; i < 100; i++)
+        Z_FreeTags(PU_LEVSPEC, PU_LEVSPEC);
+
+    for (auto &t : threads)
+        t.join();
+
+    Z_CheckHeap();
+    Z_FreeTags(PU_LEVSPEC, PU_LEVSPEC);
+    ASSERT_EQ(Z_TagUsage(PU_LEVSPEC), 0);
+}
+
+TEST(Zone, cached_blocks_are_reused)
+{
+    Z_Init();
+
+    void *a = Z_Malloc(24, PU_STATIC, nullptr);
+    Z_Free(a);
+    void *b = Z_Malloc(30, PU_STATIC, nullptr);
+
+    // Both sizes fall into the same size class on the same thread
+    ASSERT_EQ(a, b);
+    ASSERT_EQ(Z_TagUsage(PU_STATIC), 30);
+
+    Z_Free(b);
+}